@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+"""
+Compresses a module image, or a delta patch from make_delta_patch.py, for a
+compressed firmware update. The format is described in services/inc/lz_stream.h.
+
+    compress_update.py module.bin module.lz
+    compress_update.py --benchmark module.bin
+
+Send the result as a firmware update with the compressed flag (bit 2 of the
+update begin flags) set. Intel HEX files are read as the image they describe.
+
+--benchmark compares the bytes a bluz receives over the air for the file sent
+as it is and compressed, with the framing of the OTA chunks over BLE.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b'BZLZ'
+VERSION = 1
+MIN_MATCH = 3
+WINDOW_BITS = 11    # LZ_STREAM_WINDOW_BITS, the most the device keeps
+CHAIN = 64          # earlier positions tried for each match
+
+# what a chunk costs on air, see the --benchmark output
+CHUNK_SIZE = 512            # HAL_OTA_ChunkSize on bluz
+COAP_OVERHEAD = 18          # header, token, uri path, crc and index options, payload marker
+CIPHER_BLOCK = 16           # AES-128-CBC, padded to a whole block
+MESSAGE_PREFIX = 2          # length of each encrypted message on the socket
+SCS_FRAME_HEADER = 2        # SCS_FRAME_HEADER_SIZE
+BLE_PAYLOAD = 20            # SCS_MAX_DATA_LEN, the default ATT MTU less the ATT header
+BLE_PACKET_OVERHEAD = 17    # preamble, access address, LL header, L2CAP and ATT headers, CRC
+
+
+def read_image(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if not path.lower().endswith('.hex'):
+        return data
+    image = bytearray()
+    base = start = None
+    upper = 0
+    for line in data.decode('ascii').split():
+        record = bytearray.fromhex(line[1:])
+        length, address, kind = record[0], (record[1] << 8) | record[2], record[3]
+        if kind == 0:
+            address += upper
+            if start is None:
+                start = address
+            offset = address - start
+            if len(image) < offset:
+                image.extend(b'\xff' * (offset - len(image)))
+            image[offset:offset + length] = record[4:4 + length]
+        elif kind == 2:
+            upper = ((record[4] << 8) | record[5]) << 4
+        elif kind == 4:
+            upper = ((record[4] << 8) | record[5]) << 16
+    return bytes(image)
+
+
+def compress(data, window_bits=WINDOW_BITS):
+    length_bits = 16 - window_bits
+    window = 1 << window_bits
+    max_match = MIN_MATCH + (1 << length_bits) - 1
+    heads = {}
+
+    def longest(i):
+        best_length, best_distance = 0, 0
+        for j in reversed(heads.get(data[i:i + MIN_MATCH], ())[-CHAIN:]):
+            if i - j > window:
+                break
+            n = 0
+            while n < max_match and i + n < len(data) and data[j + n] == data[i + n]:
+                n += 1
+            if n > best_length:
+                best_length, best_distance = n, i - j
+                if n == max_match:
+                    break
+        return best_length, best_distance
+
+    def remember(i):
+        heads.setdefault(data[i:i + MIN_MATCH], []).append(i)
+
+    out = bytearray(MAGIC + struct.pack('>BBBBII', VERSION, window_bits, 0, 0,
+                                        len(data), zlib.crc32(data) & 0xFFFFFFFF))
+    items = []
+    i = 0
+    while i < len(data):
+        length, distance = longest(i)
+        if length >= MIN_MATCH and i + 1 < len(data):
+            # take a literal if the match one byte on is longer
+            remember(i)
+            next_length, _ = longest(i + 1)
+            if next_length > length:
+                items.append(data[i:i + 1])
+                i += 1
+                continue
+            for k in range(1, length):
+                remember(i + k)
+        elif length >= MIN_MATCH:
+            remember(i)
+        if length >= MIN_MATCH:
+            value = ((distance - 1) << length_bits) | (length - MIN_MATCH)
+            items.append(struct.pack('>H', value))
+            i += length
+        else:
+            remember(i)
+            items.append(data[i:i + 1])
+            i += 1
+
+    for g in range(0, len(items), 8):
+        group = items[g:g + 8]
+        control = 0
+        for bit, item in enumerate(group):
+            if len(item) == 1:
+                control |= 1 << bit
+        out.append(control)
+        for item in group:
+            out.extend(item)
+    return bytes(out)
+
+
+def bytes_on_air(length):
+    """what a bluz receives over BLE for a file this long, sent in OTA chunks"""
+    total = 0
+    for offset in range(0, length, CHUNK_SIZE):
+        chunk = min(CHUNK_SIZE, length - offset)
+        message = COAP_OVERHEAD + chunk
+        message = (message // CIPHER_BLOCK + 1) * CIPHER_BLOCK + MESSAGE_PREFIX
+        frame = SCS_FRAME_HEADER + message
+        packets = (frame + BLE_PAYLOAD - 1) // BLE_PAYLOAD
+        total += frame + packets * BLE_PACKET_OVERHEAD
+    return total
+
+
+def benchmark(name, data, compressed):
+    plain, packed = bytes_on_air(len(data)), bytes_on_air(len(compressed))
+    sys.stdout.write('%s\n' % name)
+    sys.stdout.write('  file        %8d bytes  %5d chunks  %8d bytes on air\n' % (len(data), (len(data) + CHUNK_SIZE - 1) // CHUNK_SIZE, plain))
+    sys.stdout.write('  compressed  %8d bytes  %5d chunks  %8d bytes on air  (%.1f%%)\n' % (len(compressed), (len(compressed) + CHUNK_SIZE - 1) // CHUNK_SIZE, packed, 100.0 * packed / plain))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compresses a firmware update for bluz.')
+    parser.add_argument('--window-bits', type=int, default=WINDOW_BITS, help='log2 of the window, 8 to 12')
+    parser.add_argument('--benchmark', action='store_true', help='compare the bytes on air instead of writing the file')
+    parser.add_argument('input')
+    parser.add_argument('output', nargs='?')
+    args = parser.parse_args()
+
+    data = read_image(args.input)
+    compressed = compress(data, args.window_bits)
+    if args.benchmark:
+        benchmark(args.input, data, compressed)
+        return
+    if not args.output:
+        parser.error('an output file is needed')
+    with open(args.output, 'wb') as f:
+        f.write(compressed)
+    sys.stdout.write('%d bytes compressed to %d, %.1f%%\n' % (len(data), len(compressed), 100.0 * len(compressed) / len(data)))
+
+
+if __name__ == '__main__':
+    main()
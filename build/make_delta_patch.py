@@ -0,0 +1,163 @@
+#!/usr/bin/env python
+"""
+Makes a delta patch that rebuilds a new module image from the one installed
+on a device, the format is described in services/inc/delta_patch.h.
+
+    make_delta_patch.py installed.bin new.bin patch.bin
+
+The module function, index and version of the installed image and its address
+are read from its module_info. Send the patch as a firmware update with the
+delta flag (bit 1 of the update begin flags) set.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b'BZDP'
+VERSION = 1
+COPY, ADD, INSERT = 1, 2, 3
+MAX_RECORD = 0xFFFF
+
+KEY = 8             # bytes hashed to find candidate matches
+MIN_MATCH = 16      # shorter exact matches are cheaper sent as data
+CANDIDATES = 16     # source positions kept per key
+
+
+def module_info(image):
+    """start address, function, index and version from the module_info of an image"""
+    offset = 0
+    first, = struct.unpack_from('<I', image, 0)
+    if first & 0x2FF10000 == 0x20000000:    # a vector table comes first
+        offset = 0xC0
+    start, end, _, _, version, platform, function, index = struct.unpack_from('<IIBBHHBB', image, offset)
+    return start, function, index, version
+
+
+def index_source(source):
+    index = {}
+    for i in range(len(source) - KEY + 1):
+        positions = index.setdefault(source[i:i + KEY], [])
+        if len(positions) < CANDIDATES:
+            positions.append(i)
+    return index
+
+
+def exact_length(source, s, target, t):
+    n = 0
+    while s + n < len(source) and t + n < len(target) and source[s + n] == target[t + n]:
+        n += 1
+    return n
+
+
+def similar_length(source, s, target, t):
+    """how far the images stay mostly the same, as code does when only addresses move"""
+    score = best = length = run = 0
+    n = 0
+    while s + n < len(source) and t + n < len(target):
+        if source[s + n] == target[t + n]:
+            score += 1
+            run += 1
+        else:
+            score -= 1
+            run = 0
+        n += 1
+        if run == MIN_MATCH:
+            # identical again, a copy does the rest for less
+            return min(length, n - run)
+        if score > best:
+            best, length = score, n
+        elif score < best - 16:
+            break
+    return length
+
+
+def resumes(source, s, target, t):
+    """whether an exact match starts again within a few bytes, as when one word changes"""
+    for k in range(1, 9):
+        if exact_length(source, s + k, target, t + k) >= KEY:
+            return True
+    return False
+
+
+def records(source, target):
+    index = index_source(source)
+    literal = bytearray()
+    delta = None        # source position less target position of the last copy
+    t = 0
+
+    def flush_literal():
+        for i in range(0, len(literal), MAX_RECORD):
+            part = bytes(literal[i:i + MAX_RECORD])
+            yield struct.pack('>BH', INSERT, len(part)) + part
+        del literal[:]
+
+    while t < len(target):
+        best_length, best_s = 0, 0
+        minimum = MIN_MATCH
+        if delta is not None and 0 <= t + delta < len(source):
+            # carrying on where the last copy left off is cheap, moved code stays moved
+            best_length, best_s = exact_length(source, t + delta, target, t), t + delta
+            if best_length >= KEY:
+                minimum = KEY
+        for s in index.get(target[t:t + KEY], ()):
+            n = exact_length(source, s, target, t)
+            if n > best_length:
+                best_length, best_s, minimum = n, s, MIN_MATCH
+        if best_length < minimum:
+            literal.append(target[t])
+            t += 1
+            continue
+
+        for r in flush_literal():
+            yield r
+        s = best_s
+        delta = s - t
+        while best_length:
+            n = min(best_length, MAX_RECORD)
+            yield struct.pack('>BIH', COPY, s, n)
+            s, t, best_length = s + n, t + n, best_length - n
+
+        # carry on through the mostly unchanged code after the match, unless
+        # a few literal bytes and another copy do it for less
+        if resumes(source, s, target, t):
+            continue
+        n = similar_length(source, s, target, t)
+        while n:
+            part = min(n, MAX_RECORD)
+            diff = bytes(bytearray((target[t + i] - source[s + i]) & 0xFF for i in range(part)))
+            yield struct.pack('>BIH', ADD, s, part) + diff
+            s, t, n = s + part, t + part, n - part
+
+    for r in flush_literal():
+        yield r
+
+
+def make_patch(source, target):
+    address, function, index, version = module_info(source)
+    header = MAGIC + struct.pack('>BBBBHHIIIII', VERSION, function, index, 0, version, 0,
+                                 address, len(source), zlib.crc32(source) & 0xFFFFFFFF,
+                                 len(target), zlib.crc32(target) & 0xFFFFFFFF)
+    return header + b''.join(records(source, target))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Makes a delta patch for a bluz module update.')
+    parser.add_argument('installed', help='the module image on the device')
+    parser.add_argument('new', help='the module image to update to')
+    parser.add_argument('patch', help='where to write the patch')
+    args = parser.parse_args()
+
+    with open(args.installed, 'rb') as f:
+        source = bytearray(f.read())
+    with open(args.new, 'rb') as f:
+        target = bytearray(f.read())
+    patch = make_patch(bytes(source), bytes(target))
+    with open(args.patch, 'wb') as f:
+        f.write(patch)
+    sys.stdout.write('%d byte patch for a %d byte module, %.1f%%\n' % (len(patch), len(target), 100.0 * len(patch) / len(target)))
+
+
+if __name__ == '__main__':
+    main()
@@ -38,6 +38,11 @@ ProtocolError ChunkedTransfer::handle_update_begin(
 		file.store = FileTransfer::Store::Enum(decode_uint8(queue + 15));
 		file.file_address = decode_uint32(queue + 16);
 		file.chunk_address = file.file_address;
+		file.flags = FileTransfer::Flags::NONE;
+		if (flags & 2)
+			file.flags |= FileTransfer::Flags::DELTA;
+		if (flags & 4)
+			file.flags |= FileTransfer::Flags::COMPRESSED;
 	}
 	else
 	{
@@ -46,6 +51,7 @@ ProtocolError ChunkedTransfer::handle_update_begin(
 		file.store = FileTransfer::Store::FIRMWARE;
 		file.file_address = 0;
 		file.chunk_address = 0;
+		file.flags = FileTransfer::Flags::NONE;
 	}
 	// check the parameters only
 	bool success = !callbacks->prepare_for_firmware_update(file, 1, NULL);
@@ -83,10 +89,16 @@ ProtocolError ChunkedTransfer::handle_update_begin(
 			// when not in fast OTA mode, the chunk missing buffer is set to 1 since the protocol
 			// handles missing chunks one by one. Also we don't know the actual size of the file to
 			// know the correct size of the bitmap.
-			set_chunks_received(flags & 1 ? 0 : 0xFF);
+			// a patch or compressed file is decoded as it streams in, so its chunks must arrive in order
+			bool fast_ota = (flags & 1) && !(file.flags & (FileTransfer::Flags::DELTA|FileTransfer::Flags::COMPRESSED));
+			set_chunks_received(fast_ota ? 0 : 0xFF);
+			windowed = fast_ota && (flags & 8);
+			chunks_since_bitmap = 0;
+			chunks_end = 0;
 
 			// send update_reaady - use fast OTA if available
-			size_t size = Messages::update_ready(updateReady.buf(), 0, token, (flags & 0x1), channel.is_unreliable());
+			uint8_t ready_flags = (fast_ota ? 1 : 0) | (windowed ? 2 : 0);
+			size_t size = Messages::update_ready(updateReady.buf(), 0, token, ready_flags, channel.is_unreliable());
 			updateReady.set_length(size);
 			updateReady.set_confirm_received(true);
 			error = channel.send(updateReady);
@@ -168,7 +180,9 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
 				crc_valid, fast_ota, updating);
 		if (crc_valid)
 		{
-			callbacks->save_firmware_chunk(file, chunk, NULL);
+			// a chunk sent again after it was received is not written twice
+			if (!fast_ota || !is_chunk_received(chunk_index))
+				callbacks->save_firmware_chunk(file, chunk, &crc);
 			if (!fast_ota)
 			{
 				// message is confirmable for regular OTA or when
@@ -202,6 +216,8 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
 						send_missing_chunks(channel, MISSED_CHUNKS_TO_SEND);
 				}
 			}
+			if (chunk_index >= chunks_end)
+				chunks_end = chunk_index + 1;
 			chunk_index++;
 		}
 		else
@@ -213,6 +229,18 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
 			}
 			// fast OTA will request the chunk later
 		}
+		if (fast_ota && windowed && updating == 1)
+		{
+			// report the chunks received every few chunks and after the last one,
+			// so gaps are filled while the file is still being sent
+			bool last_chunk = chunk_index >= file.chunk_count(chunk_size);
+			if (++chunks_since_bitmap >= CHUNKS_PER_BITMAP || last_chunk)
+			{
+				error = send_chunk_bitmap(channel);
+				if (error)
+					return error;
+			}
+		}
 		if (response_size)
 		{
 			response.set_length(response_size);
@@ -305,12 +333,42 @@ ProtocolError ChunkedTransfer::send_missing_chunks(MessageChannel& channel,
 	return NO_ERROR;
 }
 
+ProtocolError ChunkedTransfer::send_chunk_bitmap(MessageChannel& channel)
+{
+	chunks_since_bitmap = 0;
+	if (!chunks_end)
+		return NO_ERROR;
+	// from the first chunk missing, or the last received when none are
+	chunk_index_t first = next_chunk_missing(0);
+	if (first == NO_CHUNKS_MISSING || first >= chunks_end)
+		first = chunks_end - 1;
+	first &= ~7;
+	size_t bytes = ((chunks_end - 1) >> 3) - (first >> 3) + 1;
+	if (bytes > MAX_CHUNK_BITMAP_BYTES)
+		bytes = MAX_CHUNK_BITMAP_BYTES;
+
+	Message message;
+	ProtocolError error = channel.create(message, 9 + bytes);
+	if (error)
+		return error;
+	size_t size = Messages::chunk_bitmap(message.buf(), 0, first, chunk_bitmap() + (first >> 3), bytes);
+	message.set_length(size);
+	return channel.send(message);
+}
+
 ProtocolError ChunkedTransfer::idle(MessageChannel& channel)
 {
 	system_tick_t millis_since_last_chunk = callbacks->millis() - last_chunk_millis;
 	if (3000 < millis_since_last_chunk)
 	{
-		if (updating == 2)
+		if (updating == 1 && windowed)
+		{
+			// the last bitmap may have been lost
+			ProtocolError error = send_chunk_bitmap(channel);
+			if (error)
+				return error;
+		}
+		else if (updating == 2)
 		{    // send missing chunks
 			WARN("timeout - resending missing chunks");
 			Message message;
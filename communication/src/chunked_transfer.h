@@ -78,6 +78,18 @@ private:
 	unsigned short chunk_index;
 	unsigned short chunk_size;
 
+	/**
+	 * Set when the server resends missed chunks as it goes, from a bitmap
+	 * of the chunks received sent back every CHUNKS_PER_BITMAP chunks
+	 * (windowed fast OTA), rather than only once it is done.
+	 */
+	bool windowed;
+	uint8_t chunks_since_bitmap;
+	/**
+	 * One past the highest chunk index received.
+	 */
+	chunk_index_t chunks_end;
+
 	uint8_t* bitmap;
 
 	Callbacks* callbacks;
@@ -107,10 +119,11 @@ protected:
 
 	chunk_index_t next_chunk_missing(chunk_index_t start);
 	void set_chunks_received(uint8_t value);
+	ProtocolError send_chunk_bitmap(MessageChannel& channel);
 public:
 
 	ChunkedTransfer() :
-			updating(false), callbacks(nullptr)
+			updating(false), windowed(false), callbacks(nullptr)
 	{
 	}
 
@@ -79,4 +79,46 @@ size_t CoAP::option_decode(unsigned char **option)
   return option_length;
 }
 
+/**
+ * Reads an option delta or length nibble and its extended bytes.
+ */
+static bool option_field(unsigned nibble, const uint8_t*& p, const uint8_t* end, size_t& field)
+{
+  if (13 > nibble)
+  {
+    field = nibble;
+  }
+  else if (13 == nibble && p < end)
+  {
+    field = *p++ + 13;
+  }
+  else if (14 == nibble && p + 1 < end)
+  {
+    field = ((p[0] << 8) | p[1]) + 269;
+    p += 2;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool CoAP::next_option(const uint8_t*& p, const uint8_t* end, unsigned& number,
+                       const uint8_t*& value, size_t& length)
+{
+  if (p >= end || *p == 0xFF)
+    return false;
+  uint8_t header = *p++;
+  size_t delta;
+  if (!option_field(header >> 4, p, end, delta) || !option_field(header & 0x0F, p, end, length))
+    return false;
+  if (size_t(end - p) < length)
+    return false;
+  number += delta;
+  value = p;
+  p += length;
+  return true;
+}
+
 }}
@@ -95,6 +95,13 @@ namespace CoAPType {
   };
 }
 
+namespace CoAPOption {
+  enum Enum {
+    URI_PATH = 11,
+    BLOCK2 = 23
+  };
+}
+
 class CoAP
 {
   public:
@@ -128,6 +135,27 @@ class CoAP
     static CoAPCode::Enum code(const unsigned char *message);
     static CoAPType::Enum type(const unsigned char *message);
     static size_t option_decode(unsigned char **option);
+
+    /**
+     * Steps through the options of a message. Start with p just past the token
+     * and number 0.
+     * @return false at the end of the options, or if they are malformed.
+     */
+    static bool next_option(const uint8_t*& p, const uint8_t* end, unsigned& number,
+                            const uint8_t*& value, size_t& length);
+
+    /**
+     * Reads a Block1 or Block2 option value.
+     */
+    static void decode_block(const uint8_t* value, size_t length, unsigned& num, bool& more, uint8_t& szx)
+    {
+        uint32_t v = 0;
+        for (size_t i=0; i<length && i<3; i++)
+            v = (v<<8) | value[i];
+        num = v >> 4;
+        more = v & 0x08;
+        szx = v & 0x07;
+    }
 };
 
 // this uses version 0 to maintain compatiblity with the original comms lib codes
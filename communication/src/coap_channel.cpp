@@ -24,6 +24,83 @@ namespace particle { namespace protocol {
 
 uint16_t CoAPMessage::message_count = 0;
 
+const size_t CoAPMessagePool::SMALL_DATA;
+const size_t CoAPMessagePool::LARGE_DATA;
+const size_t CoAPMessagePool::SMALL_SLOTS;
+const size_t CoAPMessagePool::LARGE_SLOTS;
+
+namespace {
+
+const size_t SMALL_SLOT_SIZE = (sizeof(CoAPMessage)+CoAPMessagePool::SMALL_DATA+3) & ~3;
+const size_t LARGE_SLOT_SIZE = (sizeof(CoAPMessage)+CoAPMessagePool::LARGE_DATA+3) & ~3;
+
+static_assert(CoAPMessagePool::SMALL_SLOTS<=32 && CoAPMessagePool::LARGE_SLOTS<=32, "slots in use are a 32-bit mask");
+
+uint32_t __attribute__((aligned(4))) small_slots[CoAPMessagePool::SMALL_SLOTS][SMALL_SLOT_SIZE/4];
+uint32_t __attribute__((aligned(4))) large_slots[CoAPMessagePool::LARGE_SLOTS][LARGE_SLOT_SIZE/4];
+uint32_t small_used = 0;
+uint32_t large_used = 0;
+
+void* allocate_slot(void* slots, size_t slot_size, size_t count, uint32_t& used)
+{
+	for (size_t i=0; i<count; i++)
+	{
+		if (!(used & (1<<i)))
+		{
+			used |= (1<<i);
+			return (uint8_t*)slots + i*slot_size;
+		}
+	}
+	return nullptr;
+}
+
+bool free_slot(void* memory, void* slots, size_t slot_size, size_t count, uint32_t& used)
+{
+	size_t offset = (uint8_t*)memory-(uint8_t*)slots;
+	if ((uint8_t*)memory<(uint8_t*)slots || offset>=slot_size*count)
+		return false;
+	used &= ~(1<<(offset/slot_size));
+	return true;
+}
+
+size_t free_slots(size_t count, uint32_t used)
+{
+	size_t available = 0;
+	for (size_t i=0; i<count; i++)
+		if (!(used & (1<<i)))
+			available++;
+	return available;
+}
+
+}
+
+void* CoAPMessagePool::allocate(size_t size)
+{
+	void* memory = nullptr;
+	if (size<=SMALL_SLOT_SIZE)
+		memory = allocate_slot(small_slots, SMALL_SLOT_SIZE, SMALL_SLOTS, small_used);
+	// a small message takes a large slot rather than none
+	if (!memory && size<=LARGE_SLOT_SIZE)
+		memory = allocate_slot(large_slots, LARGE_SLOT_SIZE, LARGE_SLOTS, large_used);
+	return memory;
+}
+
+void CoAPMessagePool::free(void* memory)
+{
+	if (memory && !free_slot(memory, small_slots, SMALL_SLOT_SIZE, SMALL_SLOTS, small_used))
+		free_slot(memory, large_slots, LARGE_SLOT_SIZE, LARGE_SLOTS, large_used);
+}
+
+size_t CoAPMessagePool::available(size_t size)
+{
+	size_t available = 0;
+	if (size<=SMALL_SLOT_SIZE)
+		available += free_slots(SMALL_SLOTS, small_used);
+	if (size<=LARGE_SLOT_SIZE)
+		available += free_slots(LARGE_SLOTS, large_used);
+	return available;
+}
+
 ProtocolError CoAPMessageStore::send_message(CoAPMessage* msg, Channel& channel)
 {
 	Message m((uint8_t*)msg->get_data(), msg->get_data_length(), msg->get_data_length());
@@ -56,21 +133,24 @@ void CoAPMessageStore::message_timeout(CoAPMessage& msg, Channel& channel)
  */
 void CoAPMessageStore::process(system_tick_t time, Channel& channel)
 {
-	CoAPMessage* msg = head;
-	CoAPMessage* prev = nullptr;
-	while (msg!=nullptr)
+	for (CoAPMessage*& head : buckets)
 	{
-		if (time_has_passed(time, msg->get_timeout()) && !retransmit(msg, channel, time))
+		CoAPMessage* msg = head;
+		CoAPMessage* prev = nullptr;
+		while (msg!=nullptr)
 		{
-			remove(msg, prev);
-			message_timeout(*msg, channel);
-			delete msg;
-			msg = (prev==nullptr) ? head : prev->get_next();
-		}
-		else
-		{
-			prev = msg;
-			msg = msg->get_next();
+			if (time_has_passed(time, msg->get_timeout()) && !retransmit(msg, channel, time))
+			{
+				remove(msg, prev);
+				message_timeout(*msg, channel);
+				delete msg;
+				msg = (prev==nullptr) ? head : prev->get_next();
+			}
+			else
+			{
+				prev = msg;
+				msg = msg->get_next();
+			}
 		}
 	}
 }
@@ -91,7 +171,11 @@ ProtocolError CoAPMessageStore::send(Message& msg, system_tick_t time)
 		// confirmable message, create a CoAPMessage for this
 		CoAPMessage* coapmsg = CoAPMessage::create(msg);
 		if (coapmsg==nullptr)
-			return INSUFFICIENT_STORAGE;
+		{
+			// a request is refused before it is sent so the application can try again later.
+			// a response is still sent, it just cannot be resent when the request is repeated.
+			return coapType==CoAPType::CON ? INSUFFICIENT_STORAGE : NO_ERROR;
+		}
 		if (coapType==CoAPType::CON)
 			coapmsg->prepare_retransmit(time);
 		else
@@ -140,7 +224,11 @@ ProtocolError CoAPMessageStore::receive(Message& msg, Channel& channel, system_t
 			// first time we're seeing this confirmable message, store it in the message store to prevent it from being resent.
 			CoAPMessage* coapmsg = CoAPMessage::create(msg, 5);
 			if (coapmsg==nullptr)
-				return INSUFFICIENT_STORAGE;
+			{
+				// handled without protection from being resent rather than dropping the connection
+				WARN("no room to store received message %x", msg.get_id());
+				return NO_ERROR;
+			}
 			// the timeout here is ideally purely academic since the application will respond immediately with an ACK/RESET
 			// which will be stored in place of this message, with it's own timeout.
 			coapmsg->set_expiration(time+CoAPMessage::MAX_TRANSMIT_SPAN);
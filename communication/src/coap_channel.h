@@ -82,6 +82,48 @@ public:
 	}
 };
 
+#ifndef COAP_MESSAGE_POOL_SMALL_SLOTS
+#define COAP_MESSAGE_POOL_SMALL_SLOTS 8
+#endif
+
+#ifndef COAP_MESSAGE_POOL_LARGE_SLOTS
+#define COAP_MESSAGE_POOL_LARGE_SLOTS 4
+#endif
+
+/**
+ * The fixed storage CoAPMessage instances are allocated from, so that
+ * messages sent and received never use the heap.
+ *
+ * Small slots take the headers of received requests and the empty
+ * acknowledgements sent for them, large slots take anything up to
+ * PROTOCOL_BUFFER_SIZE. The number of slots bounds the messages that can
+ * be in flight - when the pool is full, allocate() returns nullptr.
+ */
+class CoAPMessagePool
+{
+public:
+	static const size_t SMALL_DATA = 32;
+	static const size_t LARGE_DATA = PROTOCOL_BUFFER_SIZE;
+	static const size_t SMALL_SLOTS = COAP_MESSAGE_POOL_SMALL_SLOTS;
+	static const size_t LARGE_SLOTS = COAP_MESSAGE_POOL_LARGE_SLOTS;
+
+	/**
+	 * Allocates a slot of at least size bytes, a CoAPMessage and its data.
+	 * Returns nullptr when there is no free slot that large.
+	 */
+	static void* allocate(size_t size);
+
+	/**
+	 * Returns a slot to the pool.
+	 */
+	static void free(void* memory);
+
+	/**
+	 * The number of free slots that can hold size bytes.
+	 */
+	static size_t available(size_t size);
+};
+
 /**
  * A CoAP message that is available for (re-)transmission.
  */
@@ -99,7 +141,7 @@ public:
 
 private:
 	/**
-	 * Messages are stored as a singly-linked list.
+	 * Messages with the same hash of their ID are stored as a singly-linked list.
 	 * This pointer is the next message in the list, or nullptr if this is the last message in the list.
 	 */
 	CoAPMessage* next;
@@ -132,7 +174,7 @@ private:
 	uint16_t data_len;
 
 	/**
-	 * The CoAPMessage is dynamically allocated as a single chunk combining both the fields above and the message data.
+	 * The CoAPMessage is allocated from the CoAPMessagePool as a single chunk combining both the fields above and the message data.
 	 */
 	uint8_t data[0];
 
@@ -167,14 +209,15 @@ public:
 	}
 
 	/**
-	 * Create a new CoAPMessage from the given Message instance. The returned CoAPMessage is dynamically allocated
-	 * and has an independent lifetime from the Message
+	 * Create a new CoAPMessage from the given Message instance. The returned CoAPMessage is allocated
+	 * from the CoAPMessagePool and has an independent lifetime from the Message
 	 * instance. When no longer required, `delete` the CoAPMessage..
+	 * Returns nullptr when the pool has no room for it.
 	 */
 	static CoAPMessage* create(Message& msg, size_t data_len = 0)
 	{
 		size_t len = data_len && data_len<msg.length() ? data_len : msg.length();
-		uint8_t* memory = new uint8_t[sizeof(CoAPMessage)+len];
+		void* memory = CoAPMessagePool::allocate(sizeof(CoAPMessage)+len);
 		if (memory) {
 			CoAPMessage* coapmsg = new (memory)CoAPMessage(msg.get_id());		// in-place new
 			coapmsg->set_data(msg.buf(), len);
@@ -183,6 +226,21 @@ public:
 		return nullptr;
 	}
 
+	static void* operator new(size_t size) noexcept
+	{
+		return CoAPMessagePool::allocate(size);
+	}
+
+	static void* operator new(size_t size, void* memory) noexcept
+	{
+		return memory;
+	}
+
+	static void operator delete(void* memory)
+	{
+		CoAPMessagePool::free(memory);
+	}
+
 	~CoAPMessage()
 	{
 		message_count--;
@@ -297,9 +355,22 @@ inline bool time_has_passed(system_tick_t now, system_tick_t tick)
 class CoAPMessageStore
 {
 	/**
-	 * The head of the list of messages.
+	 * Messages are found by their ID in a bucket, message IDs are sequential
+	 * so the messages in flight are spread across them.
 	 */
-	CoAPMessage* head;
+	static const size_t BUCKETS = 8;
+
+	CoAPMessage* buckets[BUCKETS];
+
+	/**
+	 * The number of messages stored.
+	 */
+	uint16_t count;
+
+	CoAPMessage*& bucket(message_id_t id)
+	{
+		return buckets[id & (BUCKETS-1)];
+	}
 
 	/**
 	 * Retrieves the message with the given ID and the previous message.
@@ -308,7 +379,7 @@ class CoAPMessageStore
 	CoAPMessage* for_id(message_id_t id, CoAPMessage*& prev) const
 	{
 		prev = nullptr;
-		CoAPMessage* next = head;
+		CoAPMessage* next = buckets[id & (BUCKETS-1)];
 		while (next)
 		{
 			if (next->matches(id))
@@ -327,15 +398,16 @@ class CoAPMessageStore
 		if (previous)
 			previous->set_next(message->get_next());
 		else
-			head = message->get_next();
+			bucket(message->get_id()) = message->get_next();
 		message->removed();
+		count--;
 	}
 
 	void message_timeout(CoAPMessage& msg, Channel& channel);
 
 public:
 
-	CoAPMessageStore() : head(nullptr) {}
+	CoAPMessageStore() : buckets(), count(0) {}
 
 	~CoAPMessageStore() {
 		clear();
@@ -343,7 +415,12 @@ public:
 
 	bool has_messages()
 	{
-		return head!=nullptr;
+		return count!=0;
+	}
+
+	uint16_t messages() const
+	{
+		return count;
 	}
 
 	/**
@@ -375,8 +452,10 @@ public:
 		clear_message(message.get_id());
 		if (message.get_next())
 			return INVALID_STATE;
+		CoAPMessage*& head = bucket(message.get_id());
 		message.set_next(head);
 		head = &message;
+		count++;
 		return NO_ERROR;
 	}
 
@@ -490,9 +569,12 @@ public:
 	 */
 	void clear()
 	{
-		while (head!=nullptr)
+		for (CoAPMessage*& head : buckets)
 		{
-			delete remove(head->get_id());
+			while (head!=nullptr)
+			{
+				delete remove(head->get_id());
+			}
 		}
 	}
 
@@ -0,0 +1,177 @@
+/**
+ ******************************************************************************
+ * @file    description.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "description.h"
+#include "messages.h"
+#include "protocol_defs.h"
+
+namespace particle
+{
+namespace protocol
+{
+
+bool append_description(const SparkDescriptor& descriptor, Appender& appender, int desc_flags)
+{
+	appender.append('{');
+	bool has_content = false;
+
+	if (desc_flags & DESCRIBE_APPLICATION)
+	{
+		has_content = true;
+		if (descriptor.append_application_info)
+		{
+			descriptor.append_application_info(append_instance, &appender, nullptr);
+		}
+		else
+		{
+			appender.append("\"f\":[");
+
+			int num_keys = descriptor.num_functions();
+			int i;
+			for (i = 0; i < num_keys; ++i)
+			{
+				if (i)
+				{
+					appender.append(',');
+				}
+				appender.append('"');
+
+				const char* key = descriptor.get_function_key(i);
+				size_t function_name_length = strlen(key);
+				if (MAX_FUNCTION_KEY_LENGTH < function_name_length)
+				{
+					function_name_length = MAX_FUNCTION_KEY_LENGTH;
+				}
+				appender.append((const uint8_t*) key, function_name_length);
+				appender.append('"');
+			}
+
+			appender.append("],\"v\":{");
+
+			num_keys = descriptor.num_variables();
+			for (i = 0; i < num_keys; ++i)
+			{
+				if (i)
+				{
+					appender.append(',');
+				}
+				appender.append('"');
+				const char* key = descriptor.get_variable_key(i);
+				size_t variable_name_length = strlen(key);
+				SparkReturnType::Enum t = descriptor.variable_type(key);
+				if (MAX_VARIABLE_KEY_LENGTH < variable_name_length)
+				{
+					variable_name_length = MAX_VARIABLE_KEY_LENGTH;
+				}
+				appender.append((const uint8_t*) key, variable_name_length);
+				appender.append("\":");
+				appender.append('0' + (char) t);
+			}
+			appender.append('}');
+		}
+	}
+
+	if (descriptor.append_system_info && (desc_flags & DESCRIBE_SYSTEM))
+	{
+		if (has_content)
+			appender.append(',');
+		descriptor.append_system_info(append_instance, &appender, nullptr);
+	}
+	return appender.append('}');
+}
+
+bool description_fits(size_t capacity, const SparkDescriptor& descriptor, int desc_flags)
+{
+	uint8_t header[16];
+	BlockAppender measure(nullptr, 0, 0);
+	append_description(descriptor, measure, desc_flags);
+	return Messages::description(header, 0, 0) + measure.total() <= capacity;
+}
+
+size_t build_description(uint8_t* buf, size_t capacity, message_id_t id, token_t token,
+		const SparkDescriptor& descriptor, int desc_flags, int block, uint8_t szx)
+{
+	size_t header = Messages::description(buf, id, token);
+	if (block < 0)
+	{
+		BlockAppender whole(buf + header, 0, capacity - header);
+		append_description(descriptor, whole, desc_flags);
+		if (whole.total() <= capacity - header)
+			return header + whole.total();
+		block = 0;
+		szx = DESCRIBE_BLOCK_SZX;
+	}
+
+	// content header, Block2 option of up to 5 bytes, payload marker
+	const size_t block_header = 5 + 5 + 1;
+	if (szx > 6)
+		szx = 6;
+	while (szx && block_header + (16u << szx) > capacity)
+		szx--;
+	const size_t size = 16u << szx;
+	const size_t offset = size * block;
+
+	// measure first, the option value depends on whether more blocks follow
+	BlockAppender measure(nullptr, 0, 0);
+	append_description(descriptor, measure, desc_flags);
+	bool more = measure.total() > offset + size;
+
+	header = Messages::description_block(buf, id, token, block, more, szx);
+	BlockAppender part(buf + header, offset, size);
+	append_description(descriptor, part, desc_flags);
+	if (!part.written())
+		return header - 1;      // no payload, so no payload marker
+	return header + part.written();
+}
+
+void decode_describe_request(const uint8_t* msg, size_t length, int& desc_flags, int& block, uint8_t& szx)
+{
+	desc_flags = DESCRIBE_ALL;
+	block = -1;
+	szx = DESCRIBE_BLOCK_SZX;
+	if (length < 4)
+		return;
+
+	const uint8_t* p = msg + 4 + (msg[0] & 0x0F);
+	const uint8_t* end = msg + length;
+	unsigned number = 0;
+	unsigned paths = 0;
+	const uint8_t* value;
+	size_t value_length;
+	while (CoAP::next_option(p, end, number, value, value_length))
+	{
+		if (number == CoAPOption::URI_PATH)
+		{
+			// the first path is "d", the second the describe flags
+			if (++paths == 2 && value_length)
+				desc_flags = value[0];
+		}
+		else if (number == CoAPOption::BLOCK2)
+		{
+			unsigned num;
+			bool more;
+			CoAP::decode_block(value, value_length, num, more, szx);
+			block = num;
+		}
+	}
+}
+
+}}
@@ -0,0 +1,122 @@
+/**
+ ******************************************************************************
+ * @file    description.h
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#pragma once
+
+#include "appender.h"
+#include "spark_descriptor.h"
+#include "coap.h"
+
+/**
+ * The block size used for a describe that does not fit in one message,
+ * as a CoAP SZX: 16 << 5 = 512 bytes. Smaller blocks are used when the
+ * message buffer cannot hold this.
+ */
+#ifndef DESCRIBE_BLOCK_SZX
+#define DESCRIBE_BLOCK_SZX 5
+#endif
+
+namespace particle
+{
+namespace protocol
+{
+
+/**
+ * Keeps the bytes appended that fall in a window of the whole output, and
+ * counts all of them. The describe is rendered through this so any block of
+ * it can be produced without holding the whole document.
+ */
+class BlockAppender : public Appender
+{
+	uint8_t* dest;
+	size_t offset;
+	size_t size;
+	size_t count;
+	size_t copied;
+
+public:
+
+	BlockAppender(uint8_t* dest, size_t offset, size_t size) :
+		dest(dest), offset(offset), size(size), count(0), copied(0)
+	{
+	}
+
+	bool append(const uint8_t* data, size_t length) override
+	{
+		size_t end = count + length;
+		if (end > offset && count < offset + size)
+		{
+			size_t from = count < offset ? offset - count : 0;
+			size_t to = end > offset + size ? offset + size - count : length;
+			memcpy(dest + (count + from - offset), data + from, to - from);
+			copied += to - from;
+		}
+		count = end;
+		return true;
+	}
+
+	bool append(const char* data) { return Appender::append(data); }
+	bool append(char c) { return Appender::append(c); }
+
+	/**
+	 * The length of the whole output.
+	 */
+	size_t total() const { return count; }
+
+	/**
+	 * The bytes kept in the window.
+	 */
+	size_t written() const { return copied; }
+};
+
+/**
+ * Writes the describe JSON for the given DESCRIBE_* flags.
+ */
+bool append_description(const SparkDescriptor& descriptor, Appender& appender, int desc_flags);
+
+/**
+ * Builds the response to a describe request.
+ *
+ * When no block is asked for and the document fits it is sent whole, as it
+ * always has been. Otherwise the response carries one block of it with a
+ * Block2 option, and the server asks for the next block until the option
+ * says there are no more.
+ *
+ * @param capacity  the space at buf for the message.
+ * @param block     the block number asked for, or -1 when the request had no Block2 option.
+ * @param szx       the block size asked for. It is reduced to fit capacity.
+ * @return the length of the message.
+ */
+size_t build_description(uint8_t* buf, size_t capacity, message_id_t id, token_t token,
+		const SparkDescriptor& descriptor, int desc_flags, int block, uint8_t szx);
+
+/**
+ * Determines if build_description() sends the description whole, without blocks.
+ */
+bool description_fits(size_t capacity, const SparkDescriptor& descriptor, int desc_flags);
+
+/**
+ * Reads the describe flags and Block2 option of a describe request.
+ * flags is DESCRIBE_ALL and block -1 when the request does not give them.
+ */
+void decode_describe_request(const uint8_t* msg, size_t length, int& desc_flags, int& block, uint8_t& szx);
+
+}}
@@ -0,0 +1,189 @@
+/**
+ ******************************************************************************
+ * @file    event_batch.h
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#pragma once
+
+#include <string.h>
+#include "protocol_defs.h"
+#include "events.h"
+#include "messages.h"
+
+/**
+ * The data bytes a batch holds, the records and the newlines between them. At
+ * most 255, the data of any event.
+ */
+#ifndef EVENT_BATCH_SIZE
+#define EVENT_BATCH_SIZE 255
+#endif
+
+/**
+ * How long in milliseconds the first event of a batch waits for others
+ * before the batch is sent.
+ */
+#ifndef EVENT_BATCH_WINDOW
+#define EVENT_BATCH_WINDOW 1000
+#endif
+
+static_assert(EVENT_BATCH_SIZE <= 255, "a batch is sent as the data of one event");
+
+namespace particle
+{
+namespace protocol
+{
+
+/**
+ * Collects events published with EventType::BATCH so they are sent together
+ * as one ordinary event, built by Messages::event. The events in a batch have
+ * the same name, type and ttl, and the data of the batch is the data of each
+ * event in the order they were published, one per line.
+ *
+ * An event with a newline in its data can't be told apart from two records, so
+ * it is never batched.
+ */
+class EventBatch
+{
+	char name[64];
+	char records[EVENT_BATCH_SIZE+1];
+	EventType::Enum type;
+	int ttl;
+	uint16_t length;
+	uint8_t count;
+	system_tick_t started;
+	uint32_t unbatched_size;        // what the events would take as messages of their own
+	event_batch_stats_t stats;
+
+	static size_t event_size(size_t name_len, const char* data, size_t data_len, int ttl)
+	{
+		size_t size = 6;
+		if (name_len)
+			size += name_len + (name_len < 13 ? 1 : 2);
+		if (ttl != 60)
+			size += 4;
+		if (data)
+			size += 1 + data_len;
+		return size;
+	}
+
+public:
+
+	EventBatch() : type(EventType::PUBLIC), ttl(60), length(0), count(0), started(0), unbatched_size(0)
+	{
+		name[0] = 0;
+		records[0] = 0;
+		memset(&stats, 0, sizeof(stats));
+		stats.size = sizeof(stats);
+	}
+
+	/**
+	 * Determines if an event's data can be a record of a batch.
+	 */
+	static bool can_hold(const char* data)
+	{
+		return !data || !memchr(data, '\n', strnlen(data, 255));
+	}
+
+	bool is_empty() const { return !count; }
+
+	uint8_t events() const { return count; }
+
+	/**
+	 * Determines if the first event has waited the whole window.
+	 */
+	bool is_due(system_tick_t now) const
+	{
+		return count && now - started >= EVENT_BATCH_WINDOW;
+	}
+
+	/**
+	 * Holds back a batch that could not be sent for another window.
+	 */
+	void defer(system_tick_t now)
+	{
+		started = now;
+	}
+
+	/**
+	 * Adds an event to the batch.
+	 * @return false when there is no room for it, or it differs in name, type or ttl
+	 * from the events already in the batch. The batch should be sent and the event
+	 * added again.
+	 */
+	bool add(const char* event_name, const char* data, int event_ttl, EventType::Enum event_type, system_tick_t now)
+	{
+		size_t name_len = strnlen(event_name, 63);
+		size_t data_len = data ? strnlen(data, 255) : 0;
+		size_t record = (count ? 1 : 0) + data_len;
+		if (length + record > EVENT_BATCH_SIZE || count == 255)
+			return false;
+		if (count && (event_type != type || event_ttl != ttl || strncmp(event_name, name, sizeof(name))))
+			return false;
+
+		if (!count)
+		{
+			memcpy(name, event_name, name_len);
+			name[name_len] = 0;
+			type = event_type;
+			ttl = event_ttl;
+			started = now;
+		}
+		else
+			records[length++] = '\n';
+		if (data_len)
+			memcpy(records + length, data, data_len);
+		length += data_len;
+		records[length] = 0;
+
+		count++;
+		unbatched_size += event_size(name_len, data, data_len, event_ttl);
+		return true;
+	}
+
+	/**
+	 * Writes the batch as one event message to buf and empties it.
+	 * @return the length of the message.
+	 */
+	size_t encode(uint8_t* buf, message_id_t id, bool confirmable)
+	{
+		// no payload at all for a single event without data, as Messages::event sends it
+		size_t size = Messages::event(buf, id, name, length ? records : NULL, ttl, type, confirmable);
+		stats.events += count;
+		stats.messages++;
+		if (unbatched_size > size)
+			stats.bytes_saved += unbatched_size - size;
+		clear();
+		return size;
+	}
+
+	void clear()
+	{
+		length = 0;
+		count = 0;
+		unbatched_size = 0;
+		records[0] = 0;
+	}
+
+	const event_batch_stats_t& get_stats() const
+	{
+		return stats;
+	}
+};
+
+}}
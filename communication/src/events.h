@@ -40,12 +40,13 @@ namespace EventType {
   enum Flags {
 	  EMPTY_FLAGS = 0,
 	   NO_ACK = 0x2,
+	   BATCH = 0x8,			// queue the event to be sent with others in one message
 
-	   ALL_FLAGS = NO_ACK
+	   ALL_FLAGS = NO_ACK | BATCH
   };
 
-  static_assert((PUBLIC & NO_ACK)==0, "flags should be distinct from event type");
-  static_assert((PRIVATE & NO_ACK)==0, "flags should be distinct from event type");
+  static_assert((PUBLIC & ALL_FLAGS)==0, "flags should be distinct from event type");
+  static_assert((PRIVATE & ALL_FLAGS)==0, "flags should be distinct from event type");
 
 /**
  * The flags are encoded in with the event type.
@@ -69,6 +70,17 @@ namespace SubscriptionScope {
   };
 }
 
+/**
+ * Counts of the events sent in batches.
+ */
+typedef struct {
+    uint16_t size;
+    uint16_t reserved;
+    uint32_t events;            // events sent in batches
+    uint32_t messages;          // batch messages sent
+    uint32_t bytes_saved;       // by sending the events in batches rather than each in its own message
+} event_batch_stats_t;
+
 typedef void (*EventHandler)(const char *event_name, const char *data);
 typedef void (*EventHandlerWithData)(void *handler_data, const char *event_name, const char *data);
 
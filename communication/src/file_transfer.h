@@ -32,6 +32,14 @@ namespace FileTransfer {
         };
     };
 
+    namespace Flags {
+        enum __attribute__ ((__packed__)) Enum {
+            NONE = 0,
+            DELTA = 1<<0,       // the file is a delta patch against the installed module, see delta_patch.h
+            COMPRESSED = 1<<1,  // the file is compressed, see lz_stream.h
+        };
+    };
+
     struct __attribute__((packed)) Chunk
     {
         uint16_t size;
@@ -54,14 +62,14 @@ namespace FileTransfer {
          * 2 means application-provided storage
          */
         Store::Enum store;
-        uint8_t reserved;       // padding
+        uint8_t flags;          // Flags::Enum
     };
 
     STATIC_ASSERT(Chunk_size, sizeof(Chunk)==12);
 
     struct Descriptor : public Chunk
     {
-        Descriptor() { size = sizeof(*this); }
+        Descriptor() { size = sizeof(*this); flags = Flags::NONE; }
 
         /**
          * The length of the file data.
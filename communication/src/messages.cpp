@@ -224,6 +224,21 @@ size_t Messages::chunk_missed(uint8_t* buf, uint16_t message_id, chunk_index_t c
 	return 9;
 }
 
+size_t Messages::chunk_bitmap(uint8_t* buf, uint16_t message_id, chunk_index_t first, const uint8_t* bitmap, size_t bitmap_length)
+{
+	buf[0] = 0x50; // non-confirmable, no token, a lost bitmap is superseded by the next
+	buf[1] = 0x02; // code 0.02 POST
+	buf[2] = message_id >> 8;
+	buf[3] = message_id & 0xff;
+	buf[4] = 0xb1; // one-byte Uri-Path option
+	buf[5] = 'c';
+	buf[6] = 0xff; // payload marker
+	buf[7] = first >> 8;
+	buf[8] = first & 0xff;
+	memmove(buf + 9, bitmap, bitmap_length);
+	return 9 + bitmap_length;
+}
+
 size_t Messages::content(uint8_t* buf, uint16_t message_id, uint8_t token)
 {
 	buf[0] = 0x61; // acknowledgment, one-byte token
@@ -319,6 +334,20 @@ size_t Messages::event(uint8_t buf[], uint16_t message_id, const char *event_nam
   return p - buf;
 }
 
+size_t Messages::description_block(uint8_t* buf, uint16_t message_id, uint8_t token,
+             unsigned num, bool more, uint8_t szx)
+{
+  uint8_t *p = buf + content(buf, message_id, token) - 1;
+  uint32_t value = (num << 4) | (more ? 0x08 : 0) | (szx & 0x07);
+  uint8_t length = value > 0xfff ? 3 : value > 0xff ? 2 : 1;
+  *p++ = 0xd0 | length; // extended option delta
+  *p++ = CoAPOption::BLOCK2 - 13;
+  for (int i = length - 1; i >= 0; i--)
+    *p++ = (value >> (8 * i)) & 0xff;
+  *p++ = 0xff;
+  return p - buf;
+}
+
 
 
 }}
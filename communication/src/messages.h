@@ -74,6 +74,11 @@ public:
 
 	static size_t chunk_missed(uint8_t* buf, uint16_t message_id, chunk_index_t chunk_index);
 
+	/**
+	 * The chunks received, as a bitmap starting at chunk first (a multiple of 8), lowest bit first.
+	 */
+	static size_t chunk_bitmap(uint8_t* buf, uint16_t message_id, chunk_index_t first, const uint8_t* bitmap, size_t bitmap_length);
+
 	static size_t content(uint8_t* buf, uint16_t message_id, uint8_t token);
 
 	static size_t ping(uint8_t* buf, uint16_t message_id);
@@ -88,6 +93,13 @@ public:
 	static size_t event(uint8_t buf[], uint16_t message_id, const char *event_name,
 	             const char *data, int ttl, EventType::Enum event_type, bool confirmable);
 
+	/**
+	 * Writes the header of a describe response carrying one block of the
+	 * description, up to and including the payload marker.
+	 */
+	static size_t description_block(uint8_t* buf, uint16_t message_id, uint8_t token,
+				 unsigned num, bool more, uint8_t szx);
+
 
     static inline size_t empty_ack(unsigned char *buf,
                           unsigned char message_id_msb,
@@ -52,12 +52,11 @@ ProtocolError Protocol::handle_received_message(Message& message,
 	{
 	case CoAPMessageType::DESCRIBE:
 	{
-		// 4 bytes header, 1 byte token, 2 bytes location path for event
-		// 2 bytes optional single character location path for describe flags
-		int descriptor_type = DESCRIBE_ALL;
-		if (message.length()>8)
-			descriptor_type = queue[8];
-		error = send_description(token, msg_id, descriptor_type);
+		int descriptor_type;
+		int block;
+		uint8_t szx;
+		decode_describe_request(queue, message.length(), descriptor_type, block, szx);
+		error = send_description(token, msg_id, descriptor_type, block, szx);
 		break;
 	}
 
@@ -344,76 +343,15 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type)
 /**
  * Produces and transmits a describe message.
  * @param desc_flags Flags describing the information to provide. A combination of {@code DESCRIBE_APPLICATION) and {@code DESCRIBE_SYSTEM) flags.
+ * @param block The Block2 block asked for, or -1 for the whole description.
  */
-ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int desc_flags)
+ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int desc_flags, int block, uint8_t szx)
 {
 	Message message;
 	channel.create(message);
-	uint8_t* buf = message.buf();
 	message.set_id(msg_id);
-	size_t desc = Messages::description(buf, msg_id, token);
-
-	BufferAppender appender(buf + desc, message.capacity());
-	appender.append("{");
-	bool has_content = false;
-
-	if (desc_flags && DESCRIBE_APPLICATION)
-	{
-		has_content = true;
-		appender.append("\"f\":[");
-
-		int num_keys = descriptor.num_functions();
-		int i;
-		for (i = 0; i < num_keys; ++i)
-		{
-			if (i)
-			{
-				appender.append(',');
-			}
-			appender.append('"');
-
-			const char* key = descriptor.get_function_key(i);
-			size_t function_name_length = strlen(key);
-			if (MAX_FUNCTION_KEY_LENGTH < function_name_length)
-			{
-				function_name_length = MAX_FUNCTION_KEY_LENGTH;
-			}
-			appender.append((const uint8_t*) key, function_name_length);
-			appender.append('"');
-		}
-
-		appender.append("],\"v\":{");
-
-		num_keys = descriptor.num_variables();
-		for (i = 0; i < num_keys; ++i)
-		{
-			if (i)
-			{
-				appender.append(',');
-			}
-			appender.append('"');
-			const char* key = descriptor.get_variable_key(i);
-			size_t variable_name_length = strlen(key);
-			SparkReturnType::Enum t = descriptor.variable_type(key);
-			if (MAX_VARIABLE_KEY_LENGTH < variable_name_length)
-			{
-				variable_name_length = MAX_VARIABLE_KEY_LENGTH;
-			}
-			appender.append((const uint8_t*) key, variable_name_length);
-			appender.append("\":");
-			appender.append('0' + (char) t);
-		}
-		appender.append('}');
-	}
-
-	if (descriptor.append_system_info && (desc_flags & DESCRIBE_SYSTEM))
-	{
-		if (has_content)
-			appender.append(',');
-		descriptor.append_system_info(append_instance, &appender, nullptr);
-	}
-	appender.append('}');
-	int msglen = appender.next() - (uint8_t *) buf;
+	size_t msglen = build_description(message.buf(), message.capacity(), msg_id, token,
+			descriptor, desc_flags, block, szx);
 	message.set_length(msglen);
 	return channel.send(message);
 }
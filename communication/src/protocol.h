@@ -6,6 +6,7 @@
 #include "ping.h"
 #include "chunked_transfer.h"
 #include "spark_descriptor.h"
+#include "description.h"
 #include "spark_protocol_functions.h"
 #include "functions.h"
 #include "events.h"
@@ -204,6 +205,9 @@ protected:
 					{	return ping();});
 			if (error)
 				return error;
+			error = publisher.process(channel, callbacks.millis());
+			if (error)
+				return error;
 		}
 		return NO_ERROR;
 	}
@@ -216,8 +220,9 @@ protected:
 	/**
 	 * Produces and transmits a describe message.
 	 * @param desc_flags Flags describing the information to provide. A combination of {@code DESCRIBE_APPLICATION) and {@code DESCRIBE_SYSTEM) flags.
+	 * @param block The Block2 block asked for, or -1 for the whole description.
 	 */
-	ProtocolError send_description(token_t token, message_id_t msg_id, int desc_flags);
+	ProtocolError send_description(token_t token, message_id_t msg_id, int desc_flags, int block=-1, uint8_t szx=DESCRIBE_BLOCK_SZX);
 
 	/**
 	 * Decodes and dispatches a received message to its handler.
@@ -373,6 +378,14 @@ public:
 		}
 	}
 
+	inline void get_event_batch_stats(event_batch_stats_t& stats)
+	{
+		const event_batch_stats_t& batch = publisher.batch_stats();
+		size_t size = stats.size < sizeof(batch) ? stats.size : sizeof(batch);
+		memcpy(&stats, &batch, size);
+		stats.size = size;
+	}
+
 	inline bool send_time_request()
 	{
 		if (chunkedTransfer.is_updating())
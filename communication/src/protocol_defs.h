@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include "system_tick_hal.h"
 
@@ -40,6 +42,14 @@ typedef uint16_t chunk_index_t;
 const chunk_index_t NO_CHUNKS_MISSING = 65535;
 const chunk_index_t MAX_CHUNKS = 65535;
 const size_t MISSED_CHUNKS_TO_SEND = 50;
+/**
+ * In windowed fast OTA, the chunks received between the bitmaps sent back to the server.
+ */
+const size_t CHUNKS_PER_BITMAP = 16;
+/**
+ * The most bitmap bytes in one chunk bitmap, 8 chunks each.
+ */
+const size_t MAX_CHUNK_BITMAP_BYTES = 16;
 const size_t MAX_FUNCTION_ARG_LENGTH = 64;
 const size_t MAX_FUNCTION_KEY_LENGTH = 12;
 const size_t MAX_VARIABLE_KEY_LENGTH = 12;
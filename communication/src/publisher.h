@@ -19,17 +19,20 @@
 
 #pragma once
 
+#include "protocol_defs.h"
+#include "events.h"
+#include "message_channel.h"
+#include "event_batch.h"
+
 namespace particle
 {
 namespace protocol
 {
 
-#include "protocol_defs.h"
-#include "events.h"
-#include "message_channel.h"
-
 class Publisher
 {
+	EventBatch batch;
+
 public:
 
 	inline bool is_system(const char* event_name)
@@ -85,11 +88,65 @@ public:
 
 public:
 
+	/**
+	 * Sends the events waiting in the batch as one event. The message counts once
+	 * against the rate limit however many events it holds, and it is confirmable
+	 * even when single events are not, so the cloud acknowledges every batch.
+	 */
+	ProtocolError send_batch(MessageChannel& channel, system_tick_t time)
+	{
+		if (batch.is_empty())
+			return NO_ERROR;
+		if (is_rate_limited(false, time))
+		{
+			batch.defer(time);
+			return BANDWIDTH_EXCEEDED;
+		}
+
+		Message message;
+		channel.create(message);
+		size_t msglen = batch.encode(message.buf(), 0, true);
+		message.set_length(msglen);
+		return channel.send(message);
+	}
+
+	/**
+	 * Sends the batch once its window has passed.
+	 */
+	ProtocolError process(MessageChannel& channel, system_tick_t time)
+	{
+		if (!batch.is_due(time))
+			return NO_ERROR;
+		ProtocolError error = send_batch(channel, time);
+		// the batch is tried again when the next window has passed
+		return error==BANDWIDTH_EXCEEDED ? NO_ERROR : error;
+	}
+
+	const event_batch_stats_t& batch_stats() const
+	{
+		return batch.get_stats();
+	}
+
 	ProtocolError send_event(MessageChannel& channel, const char* event_name,
 			const char* data, int ttl, EventType::Enum event_type, int flags,
 			system_tick_t time)
 	{
 		bool is_system_event = is_system(event_name);
+		if ((flags & EventType::BATCH) && !is_system_event && EventBatch::can_hold(data))
+		{
+			if (batch.add(event_name, data, ttl, event_type, time))
+				return NO_ERROR;
+			ProtocolError error = send_batch(channel, time);
+			if (error)
+				return error;
+			return batch.add(event_name, data, ttl, event_type, time) ? NO_ERROR : INSUFFICIENT_STORAGE;
+		}
+
+		// events are sent in the order they were published
+		ProtocolError error = send_batch(channel, time);
+		if (error)
+			return error;
+
 		bool rate_limited = is_rate_limited(is_system_event, time);
 		if (rate_limited)
 			return BANDWIDTH_EXCEEDED;
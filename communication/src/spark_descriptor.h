@@ -61,7 +61,13 @@ struct SparkDescriptor
 
     void (*call_event_handler)(uint16_t size, FilteringEventHandler* handler, const char* event, const char* data, void* reserved);
 
-    void* reserved[3];      // add a few additional pointers
+    /**
+     * Appends the functions and variables to the describe message. When not set
+     * the protocol lists them with the functions above.
+     */
+    bool (*append_application_info)(appender_fn appender, void* append, void* reserved);
+
+    void* reserved[2];      // add a few additional pointers
 };
 
 STATIC_ASSERT(SparkDescriptor_size, sizeof(SparkDescriptor)==60 || sizeof(void*)!=4);
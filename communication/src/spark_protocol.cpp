@@ -177,7 +177,11 @@ bool SparkProtocol::event_loop(CoAPMessageType::Enum& message_type)
       system_tick_t millis_since_last_chunk = callbacks.millis() - last_chunk_millis;
       if (3000 < millis_since_last_chunk)
       {
-          if (updating==2) {    // send missing chunks
+          if (updating==1 && windowed) {    // the last bitmap may have been lost
+              if (0 > send_chunk_bitmap())
+                  return false;
+          }
+          else if (updating==2) {    // send missing chunks
               serial_dump("timeout - resending missing chunks");
               if (!send_missing_chunks(MISSED_CHUNKS_TO_SEND))
                   return false;
@@ -225,6 +229,12 @@ bool SparkProtocol::event_loop(CoAPMessageType::Enum& message_type)
           last_message_millis = callbacks.millis();
         }
       }
+
+      // a rate limited batch is kept for the next window, a failed send leaves it empty
+      if (event_batch.is_due(callbacks.millis()) && !send_event_batch() && event_batch.is_empty())
+      {
+        return false;
+      }
     }
   }
 
@@ -454,25 +464,16 @@ inline bool is_system(const char* event_name) {
     return !strcasecmp(prefix, "spark");
 }
 
-// Returns true on success, false on sending timeout or rate-limiting failure
-bool SparkProtocol::send_event(const char *event_name, const char *data,
-                               int ttl, EventType::Enum event_type)
+static bool is_rate_limited(bool is_system_event, system_tick_t millis)
 {
-  if (updating)
-  {
-    return false;
-  }
-
-  bool is_system_event = is_system(event_name);
-
   if (is_system_event) {
       static uint16_t lastMinute = 0;
       static uint8_t eventsThisMinute = 0;
 
-      uint16_t currentMinute = uint16_t(callbacks.millis()>>16);
+      uint16_t currentMinute = uint16_t(millis>>16);
       if (currentMinute==lastMinute) {      // == handles millis() overflow
           if (eventsThisMinute==255)
-              return false;
+              return true;
       }
       else {
           lastMinute = currentMinute;
@@ -487,15 +488,68 @@ bool SparkProtocol::send_event(const char *event_name, const char *data,
       (system_tick_t) -1000 };
     static int evt_tick_idx = 0;
 
-    system_tick_t now = recent_event_ticks[evt_tick_idx] = callbacks.millis();
+    system_tick_t now = recent_event_ticks[evt_tick_idx] = millis;
     evt_tick_idx++;
     evt_tick_idx %= 5;
     if (now - recent_event_ticks[evt_tick_idx] < 1000)
     {
       // exceeded allowable burst of 4 events per second
-      return false;
+      return true;
     }
   }
+  return false;
+}
+
+// Sends the batched events as one event, which counts once against the rate limit.
+// Unlike the events sent one by one it is confirmable, the cloud acknowledges it with
+// an empty ACK.
+// Returns true on success, false on sending timeout or rate-limiting failure
+bool SparkProtocol::send_event_batch()
+{
+  if (event_batch.is_empty())
+  {
+    return true;
+  }
+  if (is_rate_limited(false, callbacks.millis()))
+  {
+    event_batch.defer(callbacks.millis());
+    return false;
+  }
+  uint16_t msg_id = next_message_id();
+  size_t msglen = event_batch.encode(queue + 2, msg_id, true);
+  size_t wrapped_len = wrap(queue, msglen);
+
+  return (0 <= blocking_send(queue, wrapped_len));
+}
+
+// Returns true on success, false on sending timeout or rate-limiting failure
+bool SparkProtocol::send_event(const char *event_name, const char *data,
+                               int ttl, EventType::Enum event_type, int flags)
+{
+  if (updating)
+  {
+    return false;
+  }
+
+  bool is_system_event = is_system(event_name);
+
+  if ((flags & EventType::BATCH) && !is_system_event && EventBatch::can_hold(data))
+  {
+    if (event_batch.add(event_name, data, ttl, event_type, callbacks.millis()))
+      return true;
+    return send_event_batch() && event_batch.add(event_name, data, ttl, event_type, callbacks.millis());
+  }
+
+  // events are sent in the order they were published
+  if (!send_event_batch())
+  {
+    return false;
+  }
+
+  if (is_rate_limited(is_system_event, callbacks.millis()))
+  {
+    return false;
+  }
   uint16_t msg_id = next_message_id();
   size_t msglen = Messages::event(queue + 2, msg_id, event_name, data, ttl, event_type, false);
   size_t wrapped_len = wrap(queue, msglen);
@@ -704,6 +758,25 @@ int SparkProtocol::send_missing_chunks(int count)
     return sent;
 }
 
+int SparkProtocol::send_chunk_bitmap()
+{
+    chunks_since_bitmap = 0;
+    if (!chunks_end)
+        return 0;
+    // from the first chunk missing, or the last received when none are
+    chunk_index_t first = next_chunk_missing(0);
+    if (first==NO_CHUNKS_MISSING || first>=chunks_end)
+        first = chunks_end - 1;
+    first &= ~7;
+    size_t bytes = ((chunks_end - 1) >> 3) - (first >> 3) + 1;
+    if (bytes > MAX_CHUNK_BITMAP_BYTES)
+        bytes = MAX_CHUNK_BITMAP_BYTES;
+
+    size_t message_size = Messages::chunk_bitmap(queue+2, next_message_id(), first, chunk_bitmap() + (first >> 3), bytes);
+    message_size = wrap(queue, message_size);
+    return blocking_send(queue, message_size);
+}
+
 void SparkProtocol::chunk_missed(unsigned char *buf, unsigned short chunk_index)
 {
   unsigned short message_id = next_message_id();
@@ -734,75 +807,11 @@ void SparkProtocol::update_ready(unsigned char *buf, unsigned char token, uint8_
 }
 
 int SparkProtocol::description(unsigned char *buf, unsigned char token,
-                               unsigned char message_id_msb, unsigned char message_id_lsb, int desc_flags)
-{
-    buf[0] = 0x61; // acknowledgment, one-byte token
-    buf[1] = 0x45; // response code 2.05 CONTENT
-    buf[2] = message_id_msb;
-    buf[3] = message_id_lsb;
-    buf[4] = token;
-    buf[5] = 0xff; // payload marker
-
-    BufferAppender appender(buf+6, QUEUE_SIZE-8);
-    appender.append("{");
-    bool has_content = false;
-
-    if (desc_flags && DESCRIBE_APPLICATION) {
-        has_content = true;
-      appender.append("\"f\":[");
-
-      int num_keys = descriptor.num_functions();
-      int i;
-      for (i = 0; i < num_keys; ++i)
-      {
-        if (i)
-        {
-            appender.append(',');
-        }
-        appender.append('"');
-
-        const char* key = descriptor.get_function_key(i);
-        size_t function_name_length = strlen(key);
-        if (MAX_FUNCTION_KEY_LENGTH < function_name_length)
-        {
-          function_name_length = MAX_FUNCTION_KEY_LENGTH;
-        }
-        appender.append((const uint8_t*)key, function_name_length);
-        appender.append('"');
-      }
-
-      appender.append("],\"v\":{");
-
-      num_keys = descriptor.num_variables();
-      for (i = 0; i < num_keys; ++i)
-      {
-        if (i)
-        {
-            appender.append(',');
-        }
-        appender.append('"');
-        const char* key = descriptor.get_variable_key(i);
-        size_t variable_name_length = strlen(key);
-        SparkReturnType::Enum t = descriptor.variable_type(key);
-        if (MAX_VARIABLE_KEY_LENGTH < variable_name_length)
-        {
-          variable_name_length = MAX_VARIABLE_KEY_LENGTH;
-        }
-        appender.append((const uint8_t*)key, variable_name_length);
-        appender.append("\":");
-        appender.append('0' + (char)t);
-      }
-      appender.append('}');
-    }
-
-    if (descriptor.append_system_info && (desc_flags&DESCRIBE_SYSTEM)) {
-      if (has_content)
-        appender.append(',');
-      descriptor.append_system_info(append_instance, &appender, NULL);
-    }
-    appender.append('}');
-
-    int msglen = appender.next() - (uint8_t *)buf;
+                               unsigned char message_id_msb, unsigned char message_id_lsb, int desc_flags,
+                               int block, uint8_t szx)
+{
+    int msglen = build_description(buf, description_capacity(), (message_id_msb<<8) | message_id_lsb, token,
+                                   descriptor, desc_flags, block, szx);
 
 
     int buflen = (msglen & ~15) + 16;
@@ -979,6 +988,11 @@ bool SparkProtocol::handle_update_begin(msg& message)
         file.store = FileTransfer::Store::Enum(decode_uint8(queue+15));
         file.file_address = decode_uint32(queue+16);
         file.chunk_address = file.file_address;
+        file.flags = FileTransfer::Flags::NONE;
+        if (flags & 2)
+            file.flags |= FileTransfer::Flags::DELTA;
+        if (flags & 4)
+            file.flags |= FileTransfer::Flags::COMPRESSED;
     }
     else {
         file.chunk_size = 0;
@@ -986,6 +1000,7 @@ bool SparkProtocol::handle_update_begin(msg& message)
         file.store = FileTransfer::Store::FIRMWARE;
         file.file_address = 0;
         file.chunk_address = 0;
+        file.flags = FileTransfer::Flags::NONE;
     }
 
     // check the parameters only
@@ -1013,10 +1028,16 @@ bool SparkProtocol::handle_update_begin(msg& message)
             // when not in fast OTA mode, the chunk missing buffer is set to 1 since the protocol
             // handles missing chunks one by one. Also we don't know the actual size of the file to
             // know the correct size of the bitmap.
-            set_chunks_received(flags & 1 ? 0 : 0xFF);
+            // a patch or compressed file is decoded as it streams in, so its chunks must arrive in order
+            bool fast_ota = (flags & 1) && !(file.flags & (FileTransfer::Flags::DELTA|FileTransfer::Flags::COMPRESSED));
+            set_chunks_received(fast_ota ? 0 : 0xFF);
+            windowed = fast_ota && (flags & 8);
+            chunks_since_bitmap = 0;
+            chunks_end = 0;
 
             // send update_reaady - use fast OTA if available
-            update_ready(msg_to_send + 2, message.token, 0);
+            uint8_t ready_flags = (fast_ota ? 1 : 0) | (windowed ? 2 : 0);
+            update_ready(msg_to_send + 2, message.token, ready_flags);
             if (0 > blocking_send(msg_to_send, 18))
             {
               // error
@@ -1082,7 +1103,9 @@ bool SparkProtocol::handle_chunk(msg& message)
         DEBUG("chunk idx=%d crc=%d fast=%d updating=%d", chunk_index, crc_valid, fast_ota, updating);
         if (crc_valid)
         {
-            callbacks.save_firmware_chunk(file, chunk, NULL);
+            // don't rewrite a chunk the server sent again
+            if (!fast_ota || !is_chunk_received(chunk_index))
+                callbacks.save_firmware_chunk(file, chunk, &crc);
             if (!fast_ota || (updating!=2 && (true || (chunk_index & 32)==0))) {
                 chunk_received(msg_to_send + 2, message.token, ChunkReceivedCode::OK);
                 has_response = true;
@@ -1108,6 +1131,8 @@ bool SparkProtocol::handle_chunk(msg& message)
                         send_missing_chunks(MISSED_CHUNKS_TO_SEND);
                 }
             }
+            if (chunk_index >= chunks_end)
+                chunks_end = chunk_index + 1;
             chunk_index++;
         }
         else if (!fast_ota)
@@ -1123,6 +1148,14 @@ bool SparkProtocol::handle_chunk(msg& message)
           // error
           return false;
         }
+
+        if (fast_ota && windowed && updating==1)
+        {
+            // let the server fill the gaps while it is still sending
+            bool last_chunk = chunk_index >= file.chunk_count(chunk_size);
+            if ((++chunks_since_bitmap >= CHUNKS_PER_BITMAP || last_chunk) && 0 > send_chunk_bitmap())
+                return false;
+        }
     }
 
     return true;
@@ -1359,9 +1392,9 @@ void SparkProtocol::handle_event(msg& message)
   }
 }
 
-bool SparkProtocol::send_description(int description_flags, msg& message)
+bool SparkProtocol::send_description(int description_flags, msg& message, int block, uint8_t szx)
 {
-    int desc_len = description(queue + 2, message.token, queue[2], queue[3], description_flags);
+    int desc_len = description(queue + 2, message.token, queue[2], queue[3], description_flags, block, szx);
     queue[0] = (desc_len >> 8) & 0xff;
     queue[1] = desc_len & 0xff;
     return blocking_send(queue, desc_len + 2)>=0;
@@ -1373,7 +1406,22 @@ bool SparkProtocol::handle_message(msg& message, token_t token, CoAPMessageType:
   {
     case CoAPMessageType::DESCRIBE:
     {
-        if (!send_description(DESCRIBE_SYSTEM, message) || !send_description(DESCRIBE_APPLICATION, message)) {
+        int flags, block;
+        uint8_t szx;
+        decode_describe_request(queue, message.len - queue[message.len-1], flags, block, szx);
+        if (block >= 0) {
+            // a later block of a describe too large for one message
+            if (!send_description(flags, message, block, szx))
+                return false;
+        }
+        else if (!description_fits(description_capacity(), descriptor, DESCRIBE_SYSTEM) ||
+                !description_fits(description_capacity(), descriptor, DESCRIBE_APPLICATION)) {
+            // the server asks for the later blocks without flags, so block 0 must come from
+            // the same document: the whole description rather than the system and application parts
+            if (!send_description(DESCRIBE_ALL, message))
+                return false;
+        }
+        else if (!send_description(DESCRIBE_SYSTEM, message) || !send_description(DESCRIBE_APPLICATION, message)) {
             return false;
         }
         break;
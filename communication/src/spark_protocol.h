@@ -28,12 +28,14 @@
 
 #include "protocol_defs.h"
 #include "spark_descriptor.h"
+#include "description.h"
 #include "coap.h"
 #include "events.h"
 #include "tropicssl/rsa.h"
 #include "tropicssl/aes.h"
 #include "device_keys.h"
 #include "file_transfer.h"
+#include "event_batch.h"
 #include "spark_protocol_functions.h"
 #include <stdint.h>
 
@@ -81,6 +83,12 @@ class SparkProtocol
             details.product_version = this->product_firmware_version;
         }
     }
+    void get_event_batch_stats(event_batch_stats_t& stats) {
+        const event_batch_stats_t& batch = event_batch.get_stats();
+        size_t size = stats.size < sizeof(batch) ? stats.size : sizeof(batch);
+        memcpy(&stats, &batch, size);
+        stats.size = size;
+    }
     int set_key(const unsigned char *signed_encrypted_credentials);
     int blocking_send(const unsigned char *buf, int length);
     int blocking_receive(unsigned char *buf, int length);
@@ -103,7 +111,7 @@ class SparkProtocol
                        unsigned char message_id_msb, unsigned char message_id_lsb,
                        const void *return_value, int length);
     bool send_event(const char *event_name, const char *data,
-                    int ttl, EventType::Enum event_type);
+                    int ttl, EventType::Enum event_type, int flags=0);
 
     bool add_event_handler(const char *event_name, EventHandler handler) {
         return add_event_handler(event_name, handler, NULL, SubscriptionScope::FIREHOSE, NULL);
@@ -126,7 +134,8 @@ class SparkProtocol
     void update_ready(unsigned char *buf, unsigned char token, uint8_t flags);
 
     int description(unsigned char *buf, unsigned char token,
-                    unsigned char message_id_msb, unsigned char message_id_lsb, int description_flags);
+                    unsigned char message_id_msb, unsigned char message_id_lsb, int description_flags,
+                    int block=-1, uint8_t szx=DESCRIBE_BLOCK_SZX);
     void ping(unsigned char *buf);
 
     bool function_result(const void* result, SparkReturnType::Enum resultType, uint8_t token);
@@ -175,6 +184,9 @@ class SparkProtocol
     bool expecting_ping_ack;
     bool initialized;
     uint8_t updating;
+    bool windowed;                      // fast OTA with a chunk bitmap every CHUNKS_PER_BITMAP chunks
+    uint8_t chunks_since_bitmap;
+    chunk_index_t chunks_end;           // one past the highest chunk received
     char function_arg[MAX_FUNCTION_ARG_LENGTH];
 
     size_t wrap(unsigned char *buf, size_t msglen);
@@ -212,12 +224,14 @@ class SparkProtocol
     bool handle_chunk(msg& m);
     bool handle_update_done(msg& m);
     void handle_time_response(uint32_t time);
+    bool send_event_batch();
 
     /********** Queue **********/
     unsigned char queue[PROTOCOL_BUFFER_SIZE];
     product_id_t product_id;
     product_firmware_version_t product_firmware_version;
     FileTransfer::Descriptor file;
+    EventBatch event_batch;
     inline void queue_init()
     {
     }
@@ -237,15 +251,22 @@ class SparkProtocol
     void flag_chunk_received(chunk_index_t index);
     chunk_index_t next_chunk_missing(chunk_index_t index);
     int send_missing_chunks(int count);
+    int send_chunk_bitmap();
     void notify_update_done(uint8_t* buf);
 
     /**
      * Send a particular type of describe message.
      * @param description_flags A combination of DescriptionType enum values.
      * @param message
+     * @param block The Block2 block asked for, or -1 for the whole description.
      * @return true on success
      */
-    bool send_description(int description_flags, msg& message);
+    bool send_description(int description_flags, msg& message, int block=-1, uint8_t szx=DESCRIBE_BLOCK_SZX);
+
+    /**
+     * The space for a describe message, leaving room for the length and the padding.
+     */
+    size_t description_capacity() { return QUEUE_SIZE-2-16; }
 
     /**
      * Marks the indices of missed chunks not yet requested.
@@ -132,6 +132,11 @@ void spark_protocol_get_product_details(ProtocolFacade* protocol, product_detail
     protocol->get_product_details(*details);
 }
 
+void spark_protocol_get_event_batch_stats(ProtocolFacade* protocol, event_batch_stats_t* stats, void* reserved) {
+    (void)reserved;
+    protocol->get_event_batch_stats(*stats);
+}
+
 int spark_protocol_set_connection_property(ProtocolFacade* protocol, unsigned property_id,
                                            unsigned data, void* datap, void* reserved)
 {
@@ -186,7 +191,7 @@ int spark_protocol_presence_announcement(SparkProtocol* protocol, unsigned char
 bool spark_protocol_send_event(SparkProtocol* protocol, const char *event_name, const char *data,
                 int ttl, uint32_t flags, void*) {
 	EventType::Enum event_type = EventType::extract_event_type(flags);
-    return protocol->send_event(event_name, data, ttl, event_type);
+    return protocol->send_event(event_name, data, ttl, event_type, flags);
 }
 
 bool spark_protocol_send_subscription_device(SparkProtocol* protocol, const char *event_name, const char *device_id, void*) {
@@ -230,6 +235,11 @@ void spark_protocol_get_product_details(SparkProtocol* protocol, product_details
     protocol->get_product_details(*details);
 }
 
+void spark_protocol_get_event_batch_stats(ProtocolFacade* protocol, event_batch_stats_t* stats, void* reserved) {
+    (void)reserved;
+    protocol->get_event_batch_stats(*stats);
+}
+
 int spark_protocol_set_connection_property(ProtocolFacade* protocol, unsigned property_id,
                                            unsigned data, void* datap, void* reserved)
 {
@@ -182,6 +182,11 @@ namespace ProtocolCommands {
 
 int spark_protocol_command(ProtocolFacade* protocol, ProtocolCommands::Enum cmd, uint32_t data=0, void* reserved=NULL);
 
+/**
+ * Retrieves the counts of events published with EventType::BATCH. Set stats->size before calling.
+ */
+void spark_protocol_get_event_batch_stats(ProtocolFacade* protocol, event_batch_stats_t* stats, void* reserved=NULL);
+
 /**
  * Decrypt a buffer using the given public key.
  * @param ciphertext        The ciphertext to decrypt
@@ -199,10 +199,10 @@ SCENARIO("a message can be added to a message store with the same id more than o
 
 }
 
-SCENARIO("multiple messages are stored in a list in the order they are added, most recent first")
+SCENARIO("multiple messages in the same bucket are stored in a list in the order they are added, most recent first")
 {
 	const message_id_t id1 = 456;
-	const message_id_t id2 = 345;
+	const message_id_t id2 = 448;
 	REQUIRE(CoAPMessage::messages()==0);
 	GIVEN("an empty message store")
 	{
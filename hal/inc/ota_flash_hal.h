@@ -122,6 +122,8 @@ bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved);
 
 /**
  * Updates part of the OTA image.
+ * @param reserved  NULL, or the CRC32 of the buffer as computed by HAL_Core_Compute_CRC32,
+ *                  which a platform can use to verify the write.
  * @result 0 on success. non-zero on error.
  */
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved);
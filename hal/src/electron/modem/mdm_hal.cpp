@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "mdm_hal.h"
 #include "timer_hal.h"
@@ -45,7 +46,14 @@ std::recursive_mutex mdm_mutex;
 
 #define PROFILE         "0"   //!< this is the psd profile used
 #define MAX_SIZE        1024  //!< max expected messages (used with RX)
-#define USO_MAX_WRITE   1024  //!< maximum number of bytes to write to socket (used with TX)
+#define USO_MAX_WRITE   1024  //!< maximum number of bytes to write to socket (used with TX), the most the modem takes after one prompt
+#define USO_MAX_READ    (MAX_SIZE - 64) //!< maximum number of bytes to read from a socket, the whole response has to fit the rx pipe
+#ifndef USO_READ_AHEAD
+#define USO_READ_AHEAD  512   //!< bytes read ahead per TCP socket by socketPoll, 0 to read straight into the caller's buffer
+#endif
+#ifndef USO_PROMPT_GUARD_MS
+#define USO_PROMPT_GUARD_MS 50 //!< ms to wait after the @ prompt before writing socket data, some modem firmware drops data sent straight away. 0 skips the wait
+#endif
 // num sockets
 #define NUMSOCKETS      ((int)(sizeof(_sockets)/sizeof(*_sockets)))
 //! test if it is a socket is ok to use
@@ -78,6 +86,51 @@ inline void CLR_GPRS_TIMEOUT() {
     DEBUG("GPRS WD Cleared, was %d", gprs_timeout_duration);
 }
 
+/** Field parsers for the lines from the modem. Each takes the field at p and
+    moves p past it, and fails without reading past end.
+*/
+static bool _skipPrefix(const char*& p, const char* end, const char* prefix)
+{
+    while (*prefix) {
+        if (p == end || *p++ != *prefix++)
+            return false;
+    }
+    return true;
+}
+
+static void _skipSpaces(const char*& p, const char* end)
+{
+    while (p != end && *p == ' ')
+        p++;
+}
+
+static bool _parseNumber(const char*& p, const char* end, int& value)
+{
+    const char* start = p;
+    value = 0;
+    while (p != end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    return p != start;
+}
+
+static bool _parseQuotedHex(const char*& p, const char* end, int& value)
+{
+    if (!_skipPrefix(p, end, "\""))
+        return false;
+    const char* start = p;
+    value = 0;
+    for (; p != end; p++) {
+        char c = *p | 0x20;
+        if (*p >= '0' && *p <= '9')
+            value = (value << 4) | (*p - '0');
+        else if (c >= 'a' && c <= 'f')
+            value = (value << 4) | (c - 'a' + 10);
+        else
+            break;
+    }
+    return p != start && _skipPrefix(p, end, "\"");
+}
+
 #ifdef MDM_DEBUG
  #if 0 // colored terminal output using ANSI escape sequences
   #define COL(c) "\033[" c
@@ -253,92 +306,8 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
         {
             int type = TYPE(ret);
             // handle unsolicited commands here
-            if (type == TYPE_PLUS) {
-                const char* cmd = buf+3;
-                int a, b, c, d, r;
-                char s[32];
-
-                // SMS Command ---------------------------------
-                // +CNMI: <mem>,<index>
-                if (sscanf(cmd, "CMTI: \"%*[^\"]\",%d", &a) == 1) {
-                    DEBUG_D("New SMS at index %d\r\n", a);
-                }
-                else if ((sscanf(cmd, "CIEV: 9,%d", &a) == 1)) {
-                    DEBUG_D("CIEV matched: 9,%d\r\n", a);
-                    // Wait until the system is attached before attempting to act on GPRS detach
-                    if (_attached) {
-                        _attached_urc = (a==2)?1:0;
-                        if (!_attached_urc) ARM_GPRS_TIMEOUT(15*1000); // If detached, set WDT
-                        else CLR_GPRS_TIMEOUT(); // else if re-attached clear WDT.
-                    }
-                // Socket Specific Command ---------------------------------
-                // +UUSORD: <socket>,<length>
-                } else if ((sscanf(cmd, "UUSORD: %d,%d", &a, &b) == 2)) {
-                    int socket = _findSocket(a);
-                    DEBUG_D("Socket %d: handle %d has %d bytes pending\r\n", socket, a, b);
-                    if (socket != MDM_SOCKET_ERROR)
-                        _sockets[socket].pending = b;
-                // +UUSORF: <socket>,<length>
-                } else if ((sscanf(cmd, "UUSORF: %d,%d", &a, &b) == 2)) {
-                    int socket = _findSocket(a);
-                    DEBUG_D("Socket %d: handle %d has %d bytes pending\r\n", socket, a, b);
-                    if (socket != MDM_SOCKET_ERROR)
-                        _sockets[socket].pending = b;
-                // +UUSOCL: <socket>
-                } else if ((sscanf(cmd, "UUSOCL: %d", &a) == 1)) {
-                    int socket = _findSocket(a);
-                    DEBUG_D("Socket %d: handle %d closed by remote host\r\n", socket, a);
-                    if (socket != MDM_SOCKET_ERROR) {
-                        _socketFree(socket);
-                    }
-                }
-
-                // GSM/UMTS Specific -------------------------------------------
-                // +UUPSDD: <profile_id>
-                if (sscanf(cmd, "UUPSDD: %s", s) == 1) {
-                    DEBUG_D("UUPSDD: %s matched\r\n", PROFILE);
-                    if ( !strcmp(s, PROFILE) ) {
-                        _ip = NOIP;
-                        _attached = false;
-                        DEBUG("PDP context deactivated remotely!\r\n");
-                        // PDP context was remotely deactivated via URC,
-                        // Notify system of disconnect.
-                        HAL_NET_notify_dhcp(false);
-                    }
-                } else {
-                    // +CREG|CGREG: <n>,<stat>[,<lac>,<ci>[,AcT[,<rac>]]] // reply to AT+CREG|AT+CGREG
-                    // +CREG|CGREG: <stat>[,<lac>,<ci>[,AcT[,<rac>]]]     // URC
-                    b = (int)0xFFFF; c = (int)0xFFFFFFFF; d = -1;
-                    r = sscanf(cmd, "%s %*d,%d,\"%x\",\"%x\",%d",s,&a,&b,&c,&d);
-                    if (r <= 1)
-                        r = sscanf(cmd, "%s %d,\"%x\",\"%x\",%d",s,&a,&b,&c,&d);
-                    if (r >= 2) {
-                        Reg *reg = !strcmp(s, "CREG:")  ? &_net.csd :
-                                   !strcmp(s, "CGREG:") ? &_net.psd : NULL;
-                        if (reg) {
-                            // network status
-                            if      (a == 0) *reg = REG_NONE;     // 0: not registered, home network
-                            else if (a == 1) *reg = REG_HOME;     // 1: registered, home network
-                            else if (a == 2) *reg = REG_NONE;     // 2: not registered, but MT is currently searching a new operator to register to
-                            else if (a == 3) *reg = REG_DENIED;   // 3: registration denied
-                            else if (a == 4) *reg = REG_UNKNOWN;  // 4: unknown
-                            else if (a == 5) *reg = REG_ROAMING;  // 5: registered, roaming
-                            if ((r >= 3) && (b != (int)0xFFFF))      _net.lac = b; // location area code
-                            if ((r >= 4) && (c != (int)0xFFFFFFFF))  _net.ci  = c; // cell ID
-                            // access technology
-                            if (r >= 5) {
-                                if      (d == 0) _net.act = ACT_GSM;      // 0: GSM
-                                else if (d == 1) _net.act = ACT_GSM;      // 1: GSM COMPACT
-                                else if (d == 2) _net.act = ACT_UTRAN;    // 2: UTRAN
-                                else if (d == 3) _net.act = ACT_EDGE;     // 3: GSM with EDGE availability
-                                else if (d == 4) _net.act = ACT_UTRAN;    // 4: UTRAN with HSDPA availability
-                                else if (d == 5) _net.act = ACT_UTRAN;    // 5: UTRAN with HSUPA availability
-                                else if (d == 6) _net.act = ACT_UTRAN;    // 6: UTRAN with HSDPA and HSUPA availability
-                            }
-                        }
-                    }
-                }
-            } // end ==TYPE_PLUS
+            if (type == TYPE_PLUS)
+                _handleUrc(buf, LENGTH(ret));
             if (cb) {
                 int len = LENGTH(ret);
                 int ret = cb(type, buf, len, param);
@@ -354,14 +323,207 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
             if (type == TYPE_ABORTED)
                 return RESP_ABORTED; // This means the current command was ABORTED, so retry your command if critical.
         }
-        // relax a bit
-        HAL_Delay_Milliseconds(10);
+        else {
+            // without a timeout only what was already received is handled
+            if (!timeout_ms)
+                break;
+            // relax a bit, but only when there is nothing more to read
+            HAL_Delay_Milliseconds(10);
+        }
     }
     while (!TIMEOUT(start, timeout_ms) && !_cancel_all_operations);
 
     return WAIT;
 }
 
+/** The unsolicited results acted on whatever command is being waited for.
+    The name of a +<name>: line is looked up once in this table, sorted by
+    name, and its handler parses the fields after the colon.
+*/
+void MDMParser::_handleUrc(const char* buf, int len)
+{
+    typedef void (MDMParser::*Handler)(const char* p, const char* end);
+    static const struct {
+        const char* name;   Handler handler;
+    } urcs[] = {
+        { "CGREG",          &MDMParser::_urcCGREG   },
+        { "CIEV",           &MDMParser::_urcCIEV    },
+        { "CMTI",           &MDMParser::_urcCMTI    },
+        { "CREG",           &MDMParser::_urcCREG    },
+        { "UUPSDD",         &MDMParser::_urcUUPSDD  },
+        { "UUSOCL",         &MDMParser::_urcUUSOCL  },
+        { "UUSORD",         &MDMParser::_urcUUSORD  },
+        { "UUSORF",         &MDMParser::_urcUUSORF  },
+    };
+    const int MAX_NAME = 6;
+
+    // \r\n+<name>:
+    const char* end = buf + len;
+    const char* name = buf + 3;
+    const char* p = name;
+    while (p != end && *p != ':' && p - name <= MAX_NAME)
+        p++;
+    if (p == end || *p != ':')
+        return;
+    int length = p - name;
+    int lo = 0;
+    int hi = (int)(sizeof(urcs)/sizeof(*urcs)) - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strncmp(name, urcs[mid].name, length);
+        if (!cmp && urcs[mid].name[length])
+            cmp = -1; // a shorter name sorts first
+        if (!cmp) {
+            (this->*urcs[mid].handler)(p + 1, end);
+            return;
+        }
+        if (cmp < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+}
+
+// SMS Command ---------------------------------
+void MDMParser::_urcCMTI(const char* p, const char* end)
+{
+    // +CMTI: <mem>,<index>
+    int a;
+    _skipSpaces(p, end);
+    if (_skipPrefix(p, end, "\"")) {
+        while (p != end && *p != '\"')
+            p++;
+        if (_skipPrefix(p, end, "\",") && _parseNumber(p, end, a)) {
+            DEBUG_D("New SMS at index %d\r\n", a);
+        }
+    }
+}
+
+void MDMParser::_urcCIEV(const char* p, const char* end)
+{
+    // +CIEV: 9,<gprs>
+    int a;
+    _skipSpaces(p, end);
+    if (_skipPrefix(p, end, "9,") && _parseNumber(p, end, a)) {
+        DEBUG_D("CIEV matched: 9,%d\r\n", a);
+        // Wait until the system is attached before attempting to act on GPRS detach
+        if (_attached) {
+            _attached_urc = (a==2)?1:0;
+            if (!_attached_urc) ARM_GPRS_TIMEOUT(15*1000); // If detached, set WDT
+            else CLR_GPRS_TIMEOUT(); // else if re-attached clear WDT.
+        }
+    }
+}
+
+// Socket Specific Command ---------------------------------
+void MDMParser::_urcUUSORD(const char* p, const char* end)
+{
+    // +UUSORD: <socket>,<length>
+    int a, b;
+    _skipSpaces(p, end);
+    if (_parseNumber(p, end, a) && _skipPrefix(p, end, ",") && _parseNumber(p, end, b)) {
+        int socket = _findSocket(a);
+        DEBUG_D("Socket %d: handle %d has %d bytes pending\r\n", socket, a, b);
+        if (socket != MDM_SOCKET_ERROR)
+            _sockets[socket].pending = b;
+    }
+}
+
+void MDMParser::_urcUUSORF(const char* p, const char* end)
+{
+    // +UUSORF: <socket>,<length>
+    _urcUUSORD(p, end);
+}
+
+void MDMParser::_urcUUSOCL(const char* p, const char* end)
+{
+    // +UUSOCL: <socket>
+    int a;
+    _skipSpaces(p, end);
+    if (_parseNumber(p, end, a)) {
+        int socket = _findSocket(a);
+        DEBUG_D("Socket %d: handle %d closed by remote host\r\n", socket, a);
+        if (socket != MDM_SOCKET_ERROR) {
+            _socketFree(socket);
+        }
+    }
+}
+
+// GSM/UMTS Specific -------------------------------------------
+void MDMParser::_urcUUPSDD(const char* p, const char* end)
+{
+    // +UUPSDD: <profile_id>
+    _skipSpaces(p, end);
+    const char* profile = p;
+    while (p != end && *p != ' ' && *p != '\r' && *p != '\n')
+        p++;
+    DEBUG_D("UUPSDD: %s matched\r\n", PROFILE);
+    if (p - profile == sizeof(PROFILE) - 1 && !memcmp(profile, PROFILE, p - profile)) {
+        _ip = NOIP;
+        _attached = false;
+        DEBUG("PDP context deactivated remotely!\r\n");
+        // PDP context was remotely deactivated via URC,
+        // Notify system of disconnect.
+        HAL_NET_notify_dhcp(false);
+    }
+}
+
+void MDMParser::_urcCREG(const char* p, const char* end)
+{
+    _urcREG(&_net.csd, p, end);
+}
+
+void MDMParser::_urcCGREG(const char* p, const char* end)
+{
+    _urcREG(&_net.psd, p, end);
+}
+
+void MDMParser::_urcREG(Reg* reg, const char* p, const char* end)
+{
+    // +CREG|CGREG: <n>,<stat>[,<lac>,<ci>[,AcT[,<rac>]]] // reply to AT+CREG|AT+CGREG
+    // +CREG|CGREG: <stat>[,<lac>,<ci>[,AcT[,<rac>]]]     // URC
+    int a, b = (int)0xFFFF, c = (int)0xFFFFFFFF, d = -1;
+    int r = 0; // the fields found, a to d
+    _skipSpaces(p, end);
+    if (!_parseNumber(p, end, a))
+        return;
+    r = 1;
+    const char* q = p;
+    int stat;
+    if (_skipPrefix(q, end, ",") && _parseNumber(q, end, stat)) {
+        // the reply, <n> is followed by <stat>
+        a = stat;
+        p = q;
+    }
+    if (_skipPrefix(p, end, ",") && _parseQuotedHex(p, end, b)) {
+        r = 2;
+        if (_skipPrefix(p, end, ",") && _parseQuotedHex(p, end, c)) {
+            r = 3;
+            if (_skipPrefix(p, end, ",") && _parseNumber(p, end, d))
+                r = 4;
+        }
+    }
+    // network status
+    if      (a == 0) *reg = REG_NONE;     // 0: not registered, home network
+    else if (a == 1) *reg = REG_HOME;     // 1: registered, home network
+    else if (a == 2) *reg = REG_NONE;     // 2: not registered, but MT is currently searching a new operator to register to
+    else if (a == 3) *reg = REG_DENIED;   // 3: registration denied
+    else if (a == 4) *reg = REG_UNKNOWN;  // 4: unknown
+    else if (a == 5) *reg = REG_ROAMING;  // 5: registered, roaming
+    if ((r >= 2) && (b != (int)0xFFFF))      _net.lac = b; // location area code
+    if ((r >= 3) && (c != (int)0xFFFFFFFF))  _net.ci  = c; // cell ID
+    // access technology
+    if (r >= 4) {
+        if      (d == 0) _net.act = ACT_GSM;      // 0: GSM
+        else if (d == 1) _net.act = ACT_GSM;      // 1: GSM COMPACT
+        else if (d == 2) _net.act = ACT_UTRAN;    // 2: UTRAN
+        else if (d == 3) _net.act = ACT_EDGE;     // 3: GSM with EDGE availability
+        else if (d == 4) _net.act = ACT_UTRAN;    // 4: UTRAN with HSDPA availability
+        else if (d == 5) _net.act = ACT_UTRAN;    // 5: UTRAN with HSUPA availability
+        else if (d == 6) _net.act = ACT_UTRAN;    // 6: UTRAN with HSDPA and HSUPA availability
+    }
+}
+
 int MDMParser::_cbString(int type, const char* buf, int len, char* str)
 {
     if (str && (type == TYPE_UNKNOWN)) {
@@ -1501,6 +1663,8 @@ int MDMParser::_socketSocket(int socket, IpProtocol ipproto, int port)
         _sockets[socket].connected  = (ipproto == MDM_IPPROTO_UDP);
         _sockets[socket].pending    = 0;
         _sockets[socket].open       = true;
+        _sockets[socket].ipproto    = ipproto;
+        _sockets[socket].ahead_start = _sockets[socket].ahead_end = 0;
     }
     else {
         rv = MDM_SOCKET_ERROR;
@@ -1644,6 +1808,7 @@ bool MDMParser::_socketFree(int socket)
             _sockets[socket].connected  = false;
             _sockets[socket].pending    = 0;
             _sockets[socket].open       = false;
+            _sockets[socket].ahead_start = _sockets[socket].ahead_end = 0;
         }
         ok = true;
     }
@@ -1672,7 +1837,9 @@ int MDMParser::socketSend(int socket, const char * buf, int len)
             if (ISSOCKET(socket)) {
                 sendFormated("AT+USOWR=%d,%d\r\n",_sockets[socket].handle,blk);
                 if (RESP_PROMPT == waitFinalResp()) {
-                    HAL_Delay_Milliseconds(50);
+#if USO_PROMPT_GUARD_MS
+                    HAL_Delay_Milliseconds(USO_PROMPT_GUARD_MS);
+#endif
                     send(buf, blk);
                     if (RESP_OK == waitFinalResp())
                         ok = true;
@@ -1702,7 +1869,9 @@ int MDMParser::socketSendTo(int socket, MDM_IP ip, int port, const char * buf, i
             if (ISSOCKET(socket)) {
                 sendFormated("AT+USOST=%d,\"" IPSTR "\",%d,%d\r\n",_sockets[socket].handle,IPNUM(ip),port,blk);
                 if (RESP_PROMPT == waitFinalResp()) {
-                    HAL_Delay_Milliseconds(50);
+#if USO_PROMPT_GUARD_MS
+                    HAL_Delay_Milliseconds(USO_PROMPT_GUARD_MS);
+#endif
                     send(buf, blk);
                     if (RESP_OK == waitFinalResp())
                         ok = true;
@@ -1729,19 +1898,32 @@ int MDMParser::socketReadable(int socket)
         // allow to receive unsolicited commands
         waitFinalResp(NULL, NULL, 0);
         if (_sockets[socket].connected)
-           pending = _sockets[socket].pending;
+           pending = _sockets[socket].pending + _sockets[socket].ahead_end - _sockets[socket].ahead_start;
     }
     UNLOCK();
     return pending;
 }
 
+/** Checks that the rest of the line is exactly the quoted payload of sz bytes.
+    The payload is binary, so it is located by the length given before it
+    rather than scanned for.
+*/
+static bool _quotedPayload(const char*& p, const char* end, int sz)
+{
+    return _skipPrefix(p, end, "\"") && (end - p == sz + 1) && (end[-1] == '\"');
+}
+
 int MDMParser::_cbUSORD(int type, const char* buf, int len, USORDparam* param)
 {
     if ((type == TYPE_PLUS) && param) {
+        // +USORD: <socket>,<length>,"<data>"
+        const char* p = buf;
+        const char* end = buf + len;
         int sz, sk;
-        if ((sscanf(buf, "\r\n+USORD: %d,%d,", &sk, &sz) == 2) &&
-            (buf[len-sz-2] == '\"') && (buf[len-1] == '\"')) {
-            memcpy(param->buf, &buf[len-1-sz], sz);
+        if (_skipPrefix(p, end, "\r\n+USORD: ") && _parseNumber(p, end, sk) &&
+            _skipPrefix(p, end, ",") && _parseNumber(p, end, sz) && _skipPrefix(p, end, ",") &&
+            _quotedPayload(p, end, sz)) {
+            memcpy(param->buf, p, sz);
             param->len = sz;
         } else {
             param->len = 0;
@@ -1750,6 +1932,77 @@ int MDMParser::_cbUSORD(int type, const char* buf, int len, USORDparam* param)
     return WAIT;
 }
 
+int MDMParser::socketPoll(int first /*= 0*/, bool* first_read /*= NULL*/)
+{
+    int ready = 0;
+    if (first_read)
+        *first_read = false;
+    {
+        LOCK();
+        // the unsolicited results give the data pending on each socket
+        waitFinalResp(NULL, NULL, 0);
+        UNLOCK();
+    }
+    for (int i = 0; i < NUMSOCKETS; i++) {
+        int socket = (first + i) % NUMSOCKETS;
+        LOCK();
+        if (ISSOCKET(socket) && _sockets[socket].connected &&
+            (_sockets[socket].ipproto == MDM_IPPROTO_TCP)) {
+            int before = _sockets[socket].ahead_end;
+            if (_socketReadAhead(socket) &&
+                (_sockets[socket].ahead_end > _sockets[socket].ahead_start))
+                ready++;
+            if (first_read && i == 0)
+                *first_read = (_sockets[socket].ahead_end != before);
+        }
+        UNLOCK();
+    }
+    return ready;
+}
+
+/* Reads as much of the data pending on a TCP socket as fits its read ahead
+   buffer. The buffer stays with the slot, so a +UUSOCL arriving during the
+   read cannot free it from under the read.
+*/
+bool MDMParser::_socketReadAhead(int socket)
+{
+    SockCtrl& sock = _sockets[socket];
+    if (sock.pending <= 0)
+        return true;
+    if (!sock.ahead && !(sock.ahead = (char*)malloc(USO_READ_AHEAD)))
+        return false;
+    if (sock.ahead_start) {
+        memmove(sock.ahead, sock.ahead + sock.ahead_start, sock.ahead_end - sock.ahead_start);
+        sock.ahead_end -= sock.ahead_start;
+        sock.ahead_start = 0;
+    }
+    int blk = USO_READ_AHEAD - sock.ahead_end;
+    if (blk > sock.pending) blk = sock.pending;
+    if (blk > USO_MAX_READ) blk = USO_MAX_READ;
+    if (blk <= 0)
+        return true;
+    sendFormated("AT+USORD=%d,%d\r\n", sock.handle, blk);
+    USORDparam param;
+    param.buf = sock.ahead + sock.ahead_end;
+    if (RESP_OK != waitFinalResp(_cbUSORD, &param))
+        return false;
+    sock.pending -= param.len;
+    sock.ahead_end += param.len;
+    return true;
+}
+
+int MDMParser::_socketTakeAhead(int socket, char* buf, int len)
+{
+    SockCtrl& sock = _sockets[socket];
+    int blk = sock.ahead_end - sock.ahead_start;
+    if (blk > len) blk = len;
+    if (blk > 0) {
+        memcpy(buf, sock.ahead + sock.ahead_start, blk);
+        sock.ahead_start += blk;
+    }
+    return blk;
+}
+
 int MDMParser::socketRecv(int socket, char* buf, int len)
 {
     int cnt = 0;
@@ -1762,13 +2015,22 @@ int MDMParser::socketRecv(int socket, char* buf, int len)
     system_tick_t start = HAL_Timer_Get_Milli_Seconds();
     while (len) {
         // DEBUG_D("socketRecv: LEN: %d\r\n", len);
-        int blk = MAX_SIZE; // still need space for headers and unsolicited  commands
+        int blk = USO_MAX_READ; // still need space for headers and unsolicited  commands
         if (len < blk) blk = len;
         bool ok = false;
+        bool poll = false;
+        bool relax = false;
         {
             LOCK();
             if (ISSOCKET(socket)) {
-                if (_sockets[socket].connected) {
+                // data read ahead comes first
+                int ahead = _socketTakeAhead(socket, buf, len);
+                len -= ahead;
+                cnt += ahead;
+                buf += ahead;
+                if (ahead) {
+                    ok = true;
+                } else if (_sockets[socket].connected) {
                     int available = socketReadable(socket);
                     if (available<0)  {
                         // DEBUG_D("socketRecv: SOCKET CLOSED or NO AVAIL DATA\r\n");
@@ -1782,7 +2044,10 @@ int MDMParser::socketRecv(int socket, char* buf, int len)
                     {
                         if (blk > available)    // only read up to the amount available. When 0,
                             blk = available;// skip reading and check timeout.
-                        if (blk > 0) {
+                        if (blk > 0 && blk < USO_READ_AHEAD) {
+                            // a small read, read ahead for this and the other sockets
+                            poll = ok = true;
+                        } else if (blk > 0) {
                             DEBUG_D("socketRecv: _cbUSORD\r\n");
                             sendFormated("AT+USORD=%d,%d\r\n",_sockets[socket].handle, blk);
                             USORDparam param;
@@ -1795,9 +2060,9 @@ int MDMParser::socketRecv(int socket, char* buf, int len)
                                 buf += blk;
                                 ok = true;
                             }
-                        } else if (!TIMEOUT(start, _sockets[socket].timeout_ms)) {
+                        } else if (_sockets[socket].timeout_ms && !TIMEOUT(start, _sockets[socket].timeout_ms)) {
                             // DEBUG_D("socketRecv: WAIT FOR URCs\r\n");
-                            ok = (WAIT == waitFinalResp(NULL,NULL,0)); // wait for URCs
+                            relax = ok = true;
                         } else {
                             // DEBUG_D("socketRecv: TIMEOUT\r\n");
                             len = 0;
@@ -1816,6 +2081,21 @@ int MDMParser::socketRecv(int socket, char* buf, int len)
             // DEBUG_D("socketRecv: ERROR\r\n");
             return MDM_SOCKET_ERROR;
         }
+        // without the lock, so other sockets can use the modem meanwhile
+        if (poll) {
+            bool read = false;
+            if (!socketPoll(socket, &read))
+                return cnt ? cnt : MDM_SOCKET_ERROR;
+            // data read ahead for the other sockets is no progress on this one
+            if (!read) {
+                system_tick_t timeout_ms = _sockets[socket].timeout_ms;
+                if (!timeout_ms || TIMEOUT(start, timeout_ms))
+                    break;
+                relax = true;
+            }
+        }
+        if (relax)
+            HAL_Delay_Milliseconds(10); // wait for URCs
     }
     // DEBUG_D("socketRecv: %d \"%*s\"\r\n", cnt, cnt, buf-cnt);
     return cnt;
@@ -1824,13 +2104,19 @@ int MDMParser::socketRecv(int socket, char* buf, int len)
 int MDMParser::_cbUSORF(int type, const char* buf, int len, USORFparam* param)
 {
     if ((type == TYPE_PLUS) && param) {
-        int sz, sk, p, a,b,c,d;
-        int r = sscanf(buf, "\r\n+USORF: %d,\"" IPSTR "\",%d,%d,",
-            &sk,&a,&b,&c,&d,&p,&sz);
-        if ((r == 7) && (buf[len-sz-2] == '\"') && (buf[len-1] == '\"')) {
-            memcpy(param->buf, &buf[len-1-sz], sz);
+        // +USORF: <socket>,"<ip>",<port>,<length>,"<data>"
+        const char* p = buf;
+        const char* end = buf + len;
+        int sz, sk, port, a, b, c, d;
+        if (_skipPrefix(p, end, "\r\n+USORF: ") && _parseNumber(p, end, sk) &&
+            _skipPrefix(p, end, ",\"") && _parseNumber(p, end, a) && _skipPrefix(p, end, ".") &&
+            _parseNumber(p, end, b) && _skipPrefix(p, end, ".") && _parseNumber(p, end, c) &&
+            _skipPrefix(p, end, ".") && _parseNumber(p, end, d) && _skipPrefix(p, end, "\",") &&
+            _parseNumber(p, end, port) && _skipPrefix(p, end, ",") && _parseNumber(p, end, sz) &&
+            _skipPrefix(p, end, ",") && _quotedPayload(p, end, sz)) {
+            memcpy(param->buf, p, sz);
             param->ip = IPADR(a,b,c,d);
-            param->port = p;
+            param->port = port;
             param->len = sz;
         } else {
             param->len = 0;
@@ -1848,9 +2134,10 @@ int MDMParser::socketRecvFrom(int socket, MDM_IP* ip, int* port, char* buf, int
 #endif
     system_tick_t start = HAL_Timer_Get_Milli_Seconds();
     while (len) {
-        int blk = MAX_SIZE; // still need space for headers and unsolicited commands
+        int blk = USO_MAX_READ; // still need space for headers and unsolicited commands
         if (len < blk) blk = len;
         bool ok = false;
+        bool relax = false;
         {
                 LOCK();
             if (ISSOCKET(socket)) {
@@ -1871,6 +2158,7 @@ int MDMParser::socketRecvFrom(int socket, MDM_IP* ip, int* port, char* buf, int
                     }
                 } else if (!TIMEOUT(start, _sockets[socket].timeout_ms)) {
                     ok = (WAIT == waitFinalResp(NULL,NULL,0)); // wait for URCs
+                    relax = ok;
                 } else {
                     len = 0; // no more data and socket closed or timed-out
                     ok = true;
@@ -1882,6 +2170,8 @@ int MDMParser::socketRecvFrom(int socket, MDM_IP* ip, int* port, char* buf, int
             DEBUG_D("socketRecv: ERROR\r\n");
             return MDM_SOCKET_ERROR;
         }
+        if (relax)
+            HAL_Delay_Milliseconds(10); // without the lock, so other sockets can use the modem meanwhile
     }
     //DEBUG_D("socketRecv: %d \"%*s\"\r\n", cnt, cnt, buf-cnt);
     return cnt;
@@ -235,12 +235,24 @@ public:
     */
     int socketSendTo(int socket, MDM_IP ip, int port, const char * buf, int len);
 
-    /** Get the number of bytes pending for reading for this socket
+    /** Get the number of bytes pending for reading for this socket.
+        Only handles the unsolicited results already received, it does
+        not wait for more.
         \param socket the socket handle
         \return the number of bytes pending or SOCKET_ERROR on failure
     */
     int socketReadable(int socket);
 
+    /** Read ahead the data pending on every connected TCP socket, one read
+        per socket, so one pass over the modem serves all of them. The modem
+        is only locked for each read, so sends and reads from other threads
+        interleave with the pass.
+        \param first the socket to read first
+        \param first_read set to whether the pass read any data for the first socket
+        \return the number of sockets with data read ahead
+    */
+    int socketPoll(int first = 0, bool* first_read = NULL);
+
     /** Read this socket
         \param socket the socket handle
         \param buf the buffer to read into
@@ -477,6 +489,17 @@ protected:
     //! override the unlock in a rtos system
     virtual void unlock(void)      { }
 protected:
+    // unsolicited results, handled while waiting for any response
+    void _handleUrc(const char* buf, int len);
+    void _urcCMTI(const char* p, const char* end);
+    void _urcCIEV(const char* p, const char* end);
+    void _urcUUSORD(const char* p, const char* end);
+    void _urcUUSORF(const char* p, const char* end);
+    void _urcUUSOCL(const char* p, const char* end);
+    void _urcUUPSDD(const char* p, const char* end);
+    void _urcCREG(const char* p, const char* end);
+    void _urcCGREG(const char* p, const char* end);
+    void _urcREG(Reg* reg, const char* p, const char* end);
     // parsing callbacks for different AT commands and their parameter arguments
     static int _cbString(int type, const char* buf, int len, char* str);
     static int _cbInt(int type, const char* buf, int len, int* val);
@@ -526,6 +549,10 @@ protected:
         volatile bool connected;
         volatile int pending;
         volatile bool open;
+        IpProtocol ipproto;
+        char* ahead;        //!< TCP data read by socketPoll, kept with the slot
+        int ahead_start;
+        int ahead_end;
     } SockCtrl;
     // LISA-C has 6 TCP and 6 UDP sockets
     // LISA-U and SARA-G have 7 sockets
@@ -535,6 +562,8 @@ protected:
     int _socketCloseUnusedHandles(void);
     int _socketSocket(int socket, IpProtocol ipproto, int port);
     bool _socketFree(int socket);
+    bool _socketReadAhead(int socket);
+    int _socketTakeAhead(int socket, char* buf, int len);
     bool _powerOn(void);
     void _setBandSelectString(MDM_BandSelect &data, char* bands, int index=0); // private helper to create bands strings
     static MDMParser* inst;
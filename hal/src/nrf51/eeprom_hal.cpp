@@ -0,0 +1,121 @@
+/**
+ Copyright (c) 2015 MidAir Technology, LLC.  All rights reserved.
+ 
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+ 
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "eeprom_hal.h"
+#include "eeprom_emulation_impl.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+FlashEEPROM flashEEPROM;
+
+// The EEPROMClass constructor calls HAL_EEPROM_Init() before the external
+// flash has been initialized, so the pages are only read on first use
+static bool eepromInitialized = false;
+
+// Before the log-structured store, the EEPROM was a raw image of
+// USER_STORAGE_AVAILABLE bytes at FLASH_STORAGE_ADDRESS followed by a
+// marker byte set to 1. Copy that data into the new records once.
+//
+// The old image sits in page 1, so the records are built in page 2 and the
+// old image is only erased once page 2 is active. A reset before that
+// leaves no active page and the marker in place, and the copy is redone.
+static void migrateLegacyEEPROM()
+{
+    if (sFLASH_ReadSingleByte(FLASH_STORAGE_ADDRESS + USER_STORAGE_AVAILABLE) != 1) {
+        return;
+    }
+
+    uint8_t buf[USER_STORAGE_AVAILABLE];
+    sFLASH_ReadBuffer(buf, FLASH_STORAGE_ADDRESS, sizeof(buf));
+
+    if (flashEEPROM.importImage(FlashEEPROM::LogicalPage::Page2, buf, flashEEPROM.capacity())) {
+        flashEEPROM.performPendingErase();
+    }
+}
+
+static void ensureInitialized()
+{
+    if (eepromInitialized) {
+        return;
+    }
+    eepromInitialized = true;
+
+    flashEEPROM.updateActivePage();
+    if (flashEEPROM.getActivePage() == FlashEEPROM::LogicalPage::NoPage) {
+        migrateLegacyEEPROM();
+    }
+    flashEEPROM.init();
+}
+
+extern "C" {
+
+void HAL_EEPROM_Init(void)
+{
+}
+
+size_t HAL_EEPROM_Length()
+{
+    return flashEEPROM.capacity();
+}
+
+uint8_t HAL_EEPROM_Read(uint32_t address)
+{
+    ensureInitialized();
+    uint8_t value = 0xFF;
+    flashEEPROM.get(address, value);
+    return value;
+}
+
+void HAL_EEPROM_Write(uint32_t address, uint8_t data)
+{
+    ensureInitialized();
+    flashEEPROM.put(address, data);
+}
+
+void HAL_EEPROM_Get(uint32_t index, void *data, size_t length)
+{
+    ensureInitialized();
+    flashEEPROM.get(index, data, length);
+}
+
+void HAL_EEPROM_Put(uint32_t index, const void *data, size_t length)
+{
+    ensureInitialized();
+    flashEEPROM.put(index, data, length);
+}
+
+void HAL_EEPROM_Clear()
+{
+    ensureInitialized();
+    flashEEPROM.clear();
+}
+
+bool HAL_EEPROM_Has_Pending_Erase()
+{
+    ensureInitialized();
+    return flashEEPROM.hasPendingErase();
+}
+
+void HAL_EEPROM_Perform_Pending_Erase()
+{
+    ensureInitialized();
+    flashEEPROM.performPendingErase();
+}
+
+}
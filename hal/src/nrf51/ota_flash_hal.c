@@ -214,7 +214,7 @@ bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved)
 
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
 {
-    return FLASH_Update(pBuffer, address, length);
+    return FLASH_Update(pBuffer, address, length) ? 0 : 1;
 }
 
 hal_update_complete_t HAL_FLASH_End(void* reserved)
@@ -22,6 +22,8 @@
 #include <stdbool.h>
 #include "ble.h"
 #include "ble_srv_common.h"
+#include "data_iovec.h"
+#include "scs_framing.h"
 
 #define BLE_SCS_UUID_BASE {{0xB2, 0x2D, 0x14, 0xAA, 0xB3, 0x9F, 0x41, 0xED, 0xB1, 0x77, 0xFF, 0x38, 0xD8, 0x17, 0x1E, 0x87}};
 #define BLE_SCS_UUID_SERVICE 0x0223
@@ -46,6 +48,7 @@ typedef struct scs_s
     ble_gatts_char_handles_t    data_dn_handles;
     uint8_t                     uuid_type;
     uint16_t                    conn_handle;
+    uint16_t                    max_data_len;                       /**< Largest notification payload on the current connection. */
     scs_data_write_handler_t 	data_write_handler;
 } scs_t;
 
@@ -74,6 +77,15 @@ void scs_on_ble_evt(scs_t * p_scs, ble_evt_t * p_ble_evt);
  */
 uint32_t scs_data_send(scs_t * p_scs, uint8_t* data, uint16_t len);
 
+/**@brief Function for sending a message made of several buffers
+ *
+ * @details The message goes out as one frame (see scs_framing.h) in notifications of up to
+ *          max_data_len bytes. The notifications are built straight from the buffers, only the
+ *          notifications that straddle two buffers are assembled in a small scratch buffer first.
+ *          At most SCS_MAX_IOVCNT buffers are allowed.
+ */
+uint32_t scs_data_send_iov(scs_t * p_scs, const data_iovec_t * p_iov, uint8_t iovcnt);
+
 #endif // BLE_SCS_H__
 
 /** @} */
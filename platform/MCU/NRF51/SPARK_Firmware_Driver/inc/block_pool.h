@@ -0,0 +1,63 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BLOCK_POOL_H
+#define	_BLOCK_POOL_H
+
+#include <stdint.h>
+
+#define BLOCK_POOL_MAX_BLOCKS   32
+
+/**@brief A pool of equally sized blocks, handed out as runs of adjacent blocks.
+ *
+ * Lets buffers that are only needed for a short time be shared instead of reserved
+ * up front. Not thread safe, allocate and free from the same context.
+ */
+typedef struct
+{
+    uint8_t *   p_memory;                                                       /**< block_size * block_count bytes. */
+    uint16_t    block_size;                                                     /**< Size of one block. */
+    uint8_t     block_count;                                                    /**< Number of blocks, at most BLOCK_POOL_MAX_BLOCKS. */
+    uint32_t    used_mask;                                                      /**< Bit n is set while block n is handed out. */
+    uint8_t     blocks_used;                                                    /**< Number of blocks handed out. */
+    uint8_t     blocks_peak;                                                    /**< Most blocks ever handed out at once. */
+    uint16_t    alloc_failures;                                                 /**< Allocations that found no room. */
+} block_pool_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Function for setting up a pool over block_size * block_count bytes of memory.
+ */
+void block_pool_init(block_pool_t * p_pool, uint8_t * p_memory, uint16_t block_size, uint8_t block_count);
+
+/**@brief Function for getting a buffer of at least size bytes.
+ *
+ * @return the buffer, or NULL if there is no run of free blocks large enough.
+ */
+uint8_t * block_pool_alloc(block_pool_t * p_pool, uint16_t size);
+
+/**@brief Function for giving back a buffer, size must be the size it was allocated with.
+ */
+void block_pool_free(block_pool_t * p_pool, uint8_t * p_buffer, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _BLOCK_POOL_H */
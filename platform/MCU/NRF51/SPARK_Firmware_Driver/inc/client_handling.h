@@ -26,11 +26,32 @@
 #include "spi_slave_stream.h"
 #include "hw_gateway_config.h"
 
-void (*tx_callback)(uint8_t *m_tx_buf, uint16_t size);
+uint32_t (*tx_callback)(uint8_t *m_tx_buf, uint16_t size);
+
+/**@brief Traffic statistics of one client link, since the peripheral connected. */
+typedef struct
+{
+    bool        connected;                          /**< Whether a peripheral is connected on this link. */
+    uint32_t    uplink_bytes;                       /**< Message bytes forwarded up from the peripheral. */
+    uint16_t    uplink_messages;                    /**< Messages forwarded up from the peripheral. */
+    uint16_t    dropped_messages;                   /**< Messages lost for lack of a receive buffer or of room in the SPI queue. */
+    uint16_t    latency_avg;                        /**< Average ms from the first to the last packet of a message. */
+    uint16_t    latency_max;                        /**< Longest ms from the first to the last packet of a message. */
+} client_stats_t;
+
+/**@brief Statistics over all client links. */
+typedef struct
+{
+    uint32_t    uplink_throughput;                  /**< Bytes per second forwarded up since the statistics were last read. */
+    uint8_t     pool_blocks_peak;                   /**< Most receive pool blocks ever in use at once. */
+    uint16_t    pool_alloc_failures;                /**< Messages that found the receive pool full. */
+} gateway_stats_t;
 
 /**@brief Funtion for initializing the module.
+ *
+ * @param[in] a  Queues a message for the master, returns NRF_SUCCESS or NRF_ERROR_NO_MEM when there is no room.
  */
-void client_handling_init(void (*a)(uint8_t *m_tx_buf, uint16_t size));
+void client_handling_init(uint32_t (*a)(uint8_t *m_tx_buf, uint16_t size));
 
 /**@brief Funtion for returning the current number of clients.
  *
@@ -46,7 +67,7 @@ uint8_t client_handling_count(void);
  * @param[in] conn_handle Identifies link for which client is created.
  * @return NRF_SUCCESS on success, any other on failure.
  */
-uint32_t client_handling_create(const dm_handle_t * p_handle, uint16_t conn_handle);
+uint32_t client_handling_create(const dm_handle_t * p_handle, uint16_t conn_handle, const ble_gap_addr_t * p_peer_addr);
 
 /**@brief Funtion for freeing up a client by setting its state to idle.
  *
@@ -63,12 +84,21 @@ uint32_t client_handling_destroy(const dm_handle_t * p_handle);
  */
 void client_handling_ble_evt_handler(ble_evt_t * p_ble_evt);
 
-/**@brief Funtion for sending data to the client
+/**@brief Funtion for queueing data for the clients
+ *
+ * @details Takes whole SPI messages, each addressed to a client by its header, and queues them on
+ *          that client's link. Nothing is waited for, the queues are drained as the SoftDevice
+ *          frees up TX buffers.
  *
- * @param[in] data  Data to be sent to the client.
- * @param[in] len   Lengthof the data to be sent to the client.
+ * @param[in]  data       Data to be sent to the client.
+ * @param[in]  len        Lengthof the data to be sent to the client.
+ * @param[out] p_dropped  Number of the messages taken that were dropped rather than queued, because
+ *                        their client isn't running or they could never fit the pool.
+ *
+ * @return Number of bytes taken. Messages from there on did not fit their client's queue and
+ *         should be offered again later.
  */
-void client_send_data(uint8_t *data, uint16_t len);
+uint16_t client_send_data(uint8_t *data, uint16_t len, uint16_t *p_dropped);
 
 
 /**@brief Funtion for handling device manager events.
@@ -84,6 +114,29 @@ ret_code_t client_handling_dm_event_handler(const dm_handle_t    * p_handle,
 void disconnect_all_peripherals(void);
 void connected_peripherals(uint8_t *values);
 
+/**@brief Function for checking whether a peripheral was rotated out too recently to connect again.
+ */
+bool client_handling_recently_rotated(const ble_gap_addr_t * p_addr);
+
+/**@brief Function for noting that a peripheral is advertising while all links are in use.
+ */
+void client_handling_peer_waiting(void);
+
+/**@brief Funtion for rotating connections, call from the main loop.
+ *
+ * @details While peripherals are waiting and CONNECTION_ROTATION_TIME is not 0, disconnects the
+ *          longest connected idle peripheral that has had the link for at least that long. It is kept
+ *          from reconnecting for the same time, so the waiting peripherals get a turn.
+ */
+void client_handling_rotate(void);
+
+/**@brief Function for reading the traffic statistics.
+ *
+ * @param[out] p_stats          MAX_CLIENTS entries, one per link.
+ * @param[out] p_gateway_stats  Statistics over all links. Reading them restarts the throughput measurement.
+ */
+void client_handling_stats(client_stats_t * p_stats, gateway_stats_t * p_gateway_stats);
+
 #endif // CLIENT_HANDLING_H__
 
 /** @} */
@@ -0,0 +1,95 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DATA_IOVEC_H
+#define	_DATA_IOVEC_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**@brief One piece of a message that is sent as a list of separate buffers (scatter-gather).
+ *
+ * Lets a header and a payload go down to the BLE or SPI transport without first being
+ * copied together into one buffer.
+ */
+typedef struct
+{
+    const uint8_t * p_data;                                                    /**< Pointer to data. */
+    uint16_t        data_len;                                                  /**< Length of data. */
+} data_iovec_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Returns the total length of a list of buffers.
+ */
+static inline uint16_t data_iovec_length(const data_iovec_t * p_iov, uint8_t iovcnt)
+{
+    uint16_t length = 0;
+    for (uint8_t i = 0; i < iovcnt; i++) {
+        length += p_iov[i].data_len;
+    }
+    return length;
+}
+
+/**@brief Copies length bytes starting at offset in a list of buffers to dest.
+ */
+static inline void data_iovec_copy(uint8_t * dest, const data_iovec_t * p_iov, uint8_t iovcnt, uint16_t offset, uint16_t length)
+{
+    for (uint8_t i = 0; i < iovcnt && length > 0; i++) {
+        if (offset >= p_iov[i].data_len) {
+            offset -= p_iov[i].data_len;
+            continue;
+        }
+        uint16_t size = p_iov[i].data_len - offset;
+        if (size > length) {
+            size = length;
+        }
+        memcpy(dest, p_iov[i].p_data + offset, size);
+        dest += size;
+        length -= size;
+        offset = 0;
+    }
+}
+
+/**@brief Returns a pointer to length bytes starting at offset in a list of buffers.
+ *
+ * Points straight into the buffer when the bytes are contiguous, otherwise they are
+ * copied to scratch, which must hold at least length bytes.
+ */
+static inline const uint8_t * data_iovec_chunk(const data_iovec_t * p_iov, uint8_t iovcnt, uint16_t offset, uint16_t length, uint8_t * scratch)
+{
+    uint16_t start = offset;
+    for (uint8_t i = 0; i < iovcnt; i++) {
+        if (start < p_iov[i].data_len) {
+            if (start + length <= p_iov[i].data_len) {
+                return p_iov[i].p_data + start;
+            }
+            break;
+        }
+        start -= p_iov[i].data_len;
+    }
+    data_iovec_copy(scratch, p_iov, iovcnt, offset, length);
+    return scratch;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _DATA_IOVEC_H */
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include "data_service.h"
+#include "data_iovec.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +34,8 @@ extern "C" {
 
 
 static const int32_t MAX_NUMBER_OF_SERVICES = 32;
+static const int32_t MAX_SERVICE_ID = 0xFF;
+static const int32_t MAX_SERVICE_HEADER_SIZE = 8;
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,14 +51,17 @@ class DataManagementLayer
 {
 public:
     DataManagementLayer();
-    static void registerService(DataService* service);
+    static bool registerService(DataService* service);
     static void sendData(int16_t length, uint8_t *data);
+    static uint32_t sendData(const uint8_t *header, uint16_t headerLength, const uint8_t *payload, uint16_t payloadLength);
     
     static void feedData(int16_t length, uint8_t *data);
     
 private:
     static int16_t dataServicesRegistered;
     static DataService* services[MAX_NUMBER_OF_SERVICES];
+    //service ID -> 1 + index in services, 0 when nothing is registered for the ID
+    static uint8_t serviceIndex[MAX_SERVICE_ID+1];
 };
 
 #endif
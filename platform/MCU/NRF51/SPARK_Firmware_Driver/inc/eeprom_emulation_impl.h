@@ -0,0 +1,31 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "eeprom_emulation.h"
+#include "flash_storage_impl.h"
+#include "hw_layout.h"
+
+// The two 4KB sectors at the top of the external flash hold the EEPROM pages
+constexpr uintptr_t EEPROM_SectorBase1 = FLASH_STORAGE_ADDRESS;
+constexpr uintptr_t EEPROM_SectorBase2 = FLASH_STORAGE_SWAP_ADDRESS;
+
+constexpr size_t EEPROM_SectorSize1 = sFLASH_PAGESIZE;
+constexpr size_t EEPROM_SectorSize2 = sFLASH_PAGESIZE;
+
+using FlashEEPROM = EEPROMEmulation<ExternalFlashStore, EEPROM_SectorBase1, EEPROM_SectorSize1, EEPROM_SectorBase2, EEPROM_SectorSize2>;
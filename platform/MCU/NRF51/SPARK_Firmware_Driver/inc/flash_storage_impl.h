@@ -0,0 +1,99 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "sst25vf_spi.h"
+#include <string.h>
+
+/**
+ * Implements access to the external SST25VF SPI flash, providing the
+ * Store interface expected by eeprom_emulation.h
+ *
+ * The flash is not memory mapped, so there is no dataAt(). Instead, small
+ * reads are served from a read-ahead cache so that walking the records of a
+ * page sequentially costs one SPI transaction per cache line rather than one
+ * per record.
+ */
+class ExternalFlashStore
+{
+public:
+    static const unsigned CacheSize = 32;
+
+    ExternalFlashStore() : cacheAddress(InvalidAddress)
+    {
+    }
+
+    int eraseSector(unsigned address)
+    {
+        invalidateCache();
+        sFLASH_EraseSector(address);
+        return 0;
+    }
+
+    int write(const unsigned offset, const void* data, const unsigned size)
+    {
+        invalidateCache();
+        sFLASH_WriteBuffer((const uint8_t*)data, offset, size);
+
+        // verify the write, like the internal flash store does
+        uint8_t readback[CacheSize];
+        const uint8_t* data_ptr = (const uint8_t*)data;
+        unsigned address = offset;
+        unsigned remaining = size;
+        while (remaining)
+        {
+            unsigned length = remaining < sizeof(readback) ? remaining : sizeof(readback);
+            sFLASH_ReadBuffer(readback, address, length);
+            if (memcmp(readback, data_ptr, length))
+                return -1;
+            address += length;
+            data_ptr += length;
+            remaining -= length;
+        }
+        return 0;
+    }
+
+    int read(unsigned offset, void* data, unsigned size)
+    {
+        if (size > CacheSize)
+        {
+            sFLASH_ReadBuffer((uint8_t*)data, offset, size);
+            return 0;
+        }
+
+        if (cacheAddress == InvalidAddress || offset < cacheAddress ||
+            offset + size > cacheAddress + CacheSize)
+        {
+            sFLASH_ReadBuffer(cache, offset, CacheSize);
+            cacheAddress = offset;
+        }
+        memcpy(data, cache + (offset - cacheAddress), size);
+        return 0;
+    }
+
+private:
+    static const unsigned InvalidAddress = 0xFFFFFFFF;
+
+    void invalidateCache()
+    {
+        cacheAddress = InvalidAddress;
+    }
+
+    uint8_t cache[CacheSize];
+    unsigned cacheAddress;
+};
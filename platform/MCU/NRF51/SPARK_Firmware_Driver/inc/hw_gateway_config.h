@@ -33,6 +33,11 @@
 #define SPI_SLAVE_TX_BUF_SIZE   1096                        /**< SPI TX buffer size. */
 #define SPI_SLAVE_RX_BUF_SIZE   SPI_SLAVE_TX_BUF_SIZE       /**< SPI RX buffer size. */
 
+//messages going down to the peripherals wait in a queue per client, their buffers come from one shared pool
+#define DOWNLINK_POOL_BLOCK_SIZE        48
+#define DOWNLINK_POOL_BLOCK_COUNT       ((SPI_SLAVE_RX_BUF_SIZE + DOWNLINK_POOL_BLOCK_SIZE - 1) / DOWNLINK_POOL_BLOCK_SIZE)
+#define DOWNLINK_QUEUE_DEPTH            8                                               /**< Messages waiting per client, a power of two. */
+
 #define INFO_DATA_SERVICE_BUF_SIZE  8
 
 #define MAX_TARGET_LENGTH 24
@@ -56,6 +61,24 @@ extern bool                              m_memory_access_in_progress;     /**< F
 #define TIME_BETWEEN_CONNECTIONS        15000
 #define CONNECTION_FAILURE_TIMEOUT      30
 
+//messages coming up from the peripherals are collected in buffers taken from one shared pool
+#define RX_POOL_BLOCK_SIZE              64
+#define RX_POOL_BLOCK_COUNT             24
+#define RX_POOL_SIZE                    (RX_POOL_BLOCK_SIZE * RX_POOL_BLOCK_COUNT)
+#define RX_MAX_MESSAGE_LENGTH           ((RX_POOL_SIZE < SPI_SLAVE_RX_BUF_SIZE ? RX_POOL_SIZE : SPI_SLAVE_RX_BUF_SIZE) - SPI_HEADER_SIZE)  /**< Longest message passed on, it has to fit the pool and one SPI transfer. */
+
+//and the ones going down wait for SoftDevice buffers in a queue per client, also with their buffers from a shared pool
+#define TX_POOL_BLOCK_SIZE              32
+#define TX_POOL_BLOCK_COUNT             32
+#define TX_QUEUE_DEPTH                  4                                               /**< Frames waiting per client. */
+#define TX_POOL_CLIENT_BLOCKS           (TX_POOL_BLOCK_COUNT / MAX_CLIENTS)             /**< Blocks a client may hold once it has a frame queued. */
+
+//connection rotation, lets more peripherals than MAX_CLIENTS take turns on the gateway
+#define CONNECTION_ROTATION_TIME        0                                               /**< ms a peripheral keeps its link once others are waiting, 0 turns rotation off. */
+#define CONNECTION_IDLE_TIME            2000                                            /**< ms without traffic before a link may be rotated out. */
+#define CONNECTION_WAITING_TIMEOUT      5000                                            /**< ms a peripheral counts as waiting after its last advertisement was seen. */
+#define ROTATED_PEERS_MAX               8                                               /**< Rotated out peripherals remembered, so they don't take the slot straight back. */
+
 /**@brief Gateway Protocol states. */
 typedef enum
 {
@@ -64,6 +87,16 @@ typedef enum
     SPI_BUS_DISCONNECT
 } gateway_function_t;
 
+/**@brief Traffic statistics of the messages going down to one client, since the gateway started. */
+typedef struct
+{
+    uint32_t    bytes;                                                          /**< Message bytes handed to the client link. */
+    uint16_t    messages;                                                       /**< Messages handed to the client link. */
+    uint16_t    dropped_messages;                                               /**< Messages lost because the queue or the pool was full, or the client couldn't take them. */
+    uint8_t     queue_depth;                                                    /**< Messages waiting now. */
+    uint8_t     queue_peak;                                                     /**< Most messages ever waiting at once. */
+} downlink_stats_t;
+
 /**@brief Variable length data encapsulation in terms of length and pointer to data */
 typedef struct
 {
@@ -98,6 +131,14 @@ void gateway_loop(void);
 
 void setGatewayConnParameters(int minimum, int maximum);
 
+/**@brief Function for reading the downlink statistics.
+ *
+ * @param[out] p_stats          MAX_CLIENTS entries, one per client.
+ * @param[out] p_pool_peak      Most pool blocks ever in use at once.
+ * @param[out] p_pool_failures  Messages that found the pool full.
+ */
+void gateway_downlink_stats(downlink_stats_t * p_stats, uint8_t * p_pool_peak, uint16_t * p_pool_failures);
+
 void gateway_cancel_connect_and_start_scanning(void);
 
 void set_gateway_target_name(char* name);
@@ -105,7 +146,7 @@ char* get_gateway_target_name();
 
 //Gateway Callback Functions
 #if PLATFORM_ID==269
-void spi_slave_tx_data(uint8_t* tx_buffer, uint16_t size);
+uint32_t spi_slave_tx_data(uint8_t* tx_buffer, uint16_t size);
 void spi_slave_rx_data(uint8_t *rx_buffer, uint16_t size);
 #endif
 
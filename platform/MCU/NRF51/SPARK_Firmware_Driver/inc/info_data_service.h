@@ -30,7 +30,11 @@ typedef enum {
     SET_MODE,
     SET_CONNECTION_PARAMETERS,
     POLL_CONNECTIONS,
-    CONNECTION_RESULTS
+    CONNECTION_RESULTS,
+    POLL_STATISTICS,
+    STATISTICS_RESULTS,
+    POLL_DOWNLINK_STATISTICS,
+    DOWNLINK_STATISTICS_RESULTS
 } INFO_COMMAND;
 
 
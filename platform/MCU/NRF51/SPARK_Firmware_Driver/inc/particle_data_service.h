@@ -22,5 +22,6 @@
 
 //Data Services Functions
 void particle_service_send_data(uint8_t* data, uint16_t len);
+uint32_t particle_service_send_data_iov(const data_iovec_t* iov, uint8_t iovcnt);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCS_FRAMING_H
+#define	_SCS_FRAMING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "ble_gatt.h"
+
+/* Messages on the SCS data characteristics are sent as frames: a 2 byte big endian length
+ * followed by that many bytes of message, split over as many notifications/writes as needed.
+ * Every frame starts at the beginning of a packet, so the receiver knows where a message
+ * ends without a separate end of message packet.
+ */
+#define SCS_FRAME_HEADER_SIZE           2
+
+/* Largest value that fits in one packet at the default ATT MTU, and so the most any link
+ * can use until the MTU is raised. Each link keeps its own current value, see
+ * scs_t.max_data_len and the gateway client context.
+ */
+#define SCS_MAX_DATA_LEN                (GATT_MTU_SIZE_DEFAULT - 3)
+
+/* Most buffers a message may be made of, not counting the frame header. */
+#define SCS_MAX_IOVCNT                  4
+
+/**@brief Receive side state of a framed link.
+ */
+typedef struct
+{
+    uint8_t *   p_buffer;                                                       /**< Where the message is collected. */
+    uint16_t    buffer_size;                                                    /**< Size of p_buffer. */
+    uint16_t    expected;                                                       /**< Length of the frame being received, 0 between frames. */
+    uint16_t    received;                                                       /**< Bytes of the frame received so far. */
+} scs_frame_rx_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Fills in the frame header for a message of length bytes.
+ */
+static inline void scs_frame_header_encode(uint8_t * header, uint16_t length)
+{
+    header[0] = (length & 0xFF00) >> 8;
+    header[1] = length & 0xFF;
+}
+
+/**@brief Sets up the receive state to collect messages into p_buffer.
+ */
+static inline void scs_frame_rx_init(scs_frame_rx_t * p_rx, uint8_t * p_buffer, uint16_t buffer_size)
+{
+    p_rx->p_buffer = p_buffer;
+    p_rx->buffer_size = buffer_size;
+    p_rx->expected = 0;
+    p_rx->received = 0;
+}
+
+/**@brief Feeds one received packet to the frame receiver.
+ *
+ * @return true when a whole message is in p_buffer, its length is then p_rx->received.
+ *         A message that is larger than the buffer is consumed and dropped.
+ */
+static inline bool scs_frame_rx_feed(scs_frame_rx_t * p_rx, const uint8_t * p_data, uint16_t len)
+{
+    if (p_rx->expected == 0) {
+        if (len < SCS_FRAME_HEADER_SIZE) {
+            return false;
+        }
+        p_rx->expected = (p_data[0] << 8) | p_data[1];
+        p_rx->received = 0;
+        p_data += SCS_FRAME_HEADER_SIZE;
+        len -= SCS_FRAME_HEADER_SIZE;
+        if (p_rx->expected == 0) {
+            return false;
+        }
+    }
+
+    uint16_t remaining = p_rx->expected - p_rx->received;
+    if (len > remaining) {
+        //anything past the end of the frame is not part of a message
+        len = remaining;
+    }
+    if (len > 0 && p_rx->received + len <= p_rx->buffer_size) {
+        memcpy(p_rx->p_buffer + p_rx->received, p_data, len);
+    }
+    p_rx->received += len;
+
+    if (p_rx->received < p_rx->expected) {
+        return false;
+    }
+    p_rx->expected = 0;
+    return p_rx->received <= p_rx->buffer_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _SCS_FRAMING_H */
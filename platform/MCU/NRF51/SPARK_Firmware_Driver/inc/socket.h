@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include "data_service.h"
+#include "spsc_ring.h"
 
 enum SOCKET_COMMANDS {
     SOCKET_DATA,
@@ -49,6 +50,7 @@ public:
     
     int32_t feed(uint8_t* buffer, uint32_t len);
     
+    //must be a power of two
     static const int32_t SOCKET_BUFFER_SIZE = 1024;
     bool inUse;
     
@@ -61,9 +63,10 @@ private:
     uint16_t port;
     uint32_t nif;
     
-    volatile uint16_t bufferLength;
-    volatile uint16_t bufferStart;
-    uint8_t buffer[SOCKET_BUFFER_SIZE];
+    //feed() is the producer from the BLE event context, receive() the consumer in the system thread
+    SpscRing<uint8_t, SOCKET_BUFFER_SIZE> rx;
+    
+    uint16_t used() const { return rx.size(); }
 };
 
 #endif
@@ -8,10 +8,13 @@
 #include "app_error.h"
 #include "nrf_gpio.h"
 #include "ble_radio_notification.h"
+#include "data_iovec.h"
 
 #define SPI_SLAVE_HW_TX_BUF_SIZE 255u
 #define SPI_SLAVE_HW_RX_BUF_SIZE SPI_SLAVE_HW_TX_BUF_SIZE
 
+#define SPI_SLAVE_TX_QUEUE_SIZE 1096u   /**< Bytes that can be queued for the master before spi_slave_send_data fails. */
+
 #define DEF_CHARACTER 0xAAu             /**< SPI default character. Character clocked out in case of an ignored transaction. */
 #define ORC_CHARACTER 0x55u             /**< SPI over-read character. Character clocked out after an over-read of the transmit buffer. */
 
@@ -24,7 +27,24 @@
 #define SPIS_CSN_PIN 8
 
 uint32_t spi_slave_stream_init(void (*a)(uint8_t *m_tx_buf, uint16_t size));
-void spi_slave_send_data(uint8_t *buf, uint16_t size);
+
+/**@brief Queues a framed packet for the SPI master and returns immediately.
+ *
+ * Packets queued while a burst is in progress are sent back-to-back in the next burst.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_NO_MEM if the packet doesn't fit in the queue.
+ */
+uint32_t spi_slave_send_data(const uint8_t *buf, uint16_t size);
+
+/**@brief Queues a packet made of several buffers, copying each straight into the TX queue.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_NO_MEM if the packet doesn't fit in the queue.
+ */
+uint32_t spi_slave_send_data_iov(const data_iovec_t *p_iov, uint8_t iovcnt);
+
+/**@brief Starts a pending burst once the master signals it is ready. Call from the main loop.
+ */
+void spi_slave_stream_process(void);
 
 
 #endif
@@ -40,6 +40,7 @@
 #define sFLASH_CMD_WRDI					0x04		/* Write Disable */
 #define sFLASH_CMD_WREN					0x06		/* Write Enable */
 #define sFLASH_CMD_READ					0x03		/* Read Data Bytes */
+#define sFLASH_CMD_FAST_READ			0x0B		/* High-Speed Read Data Bytes */
 #define sFLASH_CMD_WRITE 				0x02		/* Byte Program */
 #define sFLASH_CMD_AAIP                 0xAD		/* Auto Address Increment */
 #define sFLASH_CMD_SE             		0x20		/* 4KB Sector Erase instruction */
@@ -56,17 +57,17 @@
 #define sFLASH_SST25VF020_ID			0xBF258C	/* JEDEC Read-ID Data */
 #define sFLASH_SST25VF040_ID			0xBF258D	/* JEDEC Read-ID Data */
 #define sFLASH_SST25VF016_ID			0xBF2541	/* JEDEC Read-ID Data */
-#define TX_RX_MSG_LENGTH				1			/*Only transmitting one byte at a time for now*/
+#define TX_RX_MSG_LENGTH				1			/* Length of single byte commands */
+#define sFLASH_MAX_TRANSFER_LENGTH		0xFFFF		/* Longest transfer the SPI master can do at once */
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
-uint32_t *spi_base_address;
-
 /* High level functions. */
 void sFLASH_Init(void);
 void sFLASH_EraseSector(uint32_t SectorAddr);
+void sFLASH_EraseSectorStart(uint32_t SectorAddr);
 void sFLASH_EraseBulk(void);
 void sFLASH_WriteBuffer(const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite);
 void sFLASH_ReadBuffer(uint8_t *pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead);
@@ -21,9 +21,9 @@
 #include "ble_srv_common.h"
 #include "app_util.h"
 #include "nrf_gpio.h"
-#include "nrf_delay.h"
+#include "nrf_soc.h"
 
-bool waitForTxComplete = true;
+volatile bool waitForTxComplete = true;
 
 /**@brief Function for handling the Connect event.
  *
@@ -33,6 +33,8 @@ bool waitForTxComplete = true;
 static void on_connect(scs_t * p_scs, ble_evt_t * p_ble_evt)
 {
 	p_scs->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+	//the SoftDevice only supports the default ATT MTU, raise this if a larger one gets negotiated
+	p_scs->max_data_len = SCS_MAX_DATA_LEN;
 }
 
 
@@ -47,8 +49,8 @@ static void on_disconnect(scs_t * p_scs, ble_evt_t * p_ble_evt)
     p_scs->conn_handle = BLE_CONN_HANDLE_INVALID;
 }
 
-volatile uint16_t readBufferLength = 0;
 uint8_t readBuffer[1024];
+static scs_frame_rx_t m_frame_rx;
 /**@brief Function for handling the Write event.
  *
  * @param[in]   p_scs       LED Button Service structure.
@@ -61,16 +63,9 @@ static void on_write(scs_t * p_scs, ble_evt_t * p_ble_evt)
     if ((p_evt_write->handle == p_scs->data_dn_handles.value_handle) &&
         (p_scs->data_write_handler != NULL))
     {
-    	if (p_evt_write->len == 2 && p_evt_write->data[0] == 0x03 && p_evt_write->data[1] == 0x04) {
-    		p_scs->data_write_handler(p_scs, (uint8_t*)&readBuffer, readBufferLength);
-    		readBufferLength = 0;
-    	} else {
-//    		for (int i = 0; i < p_evt_write->len; i++) {
-//    			readBuffer[readBufferLength+i] = p_evt_write->data[i];
-//    		}
-            memcpy(readBuffer+readBufferLength, p_evt_write->data, p_evt_write->len);
-            readBufferLength += p_evt_write->len;
-    	}
+        if (scs_frame_rx_feed(&m_frame_rx, p_evt_write->data, p_evt_write->len)) {
+            p_scs->data_write_handler(p_scs, readBuffer, m_frame_rx.received);
+        }
     }
 }
 
@@ -85,6 +80,7 @@ void scs_on_ble_evt(scs_t * p_scs, ble_evt_t * p_ble_evt)
 
         case BLE_GAP_EVT_DISCONNECTED:
             on_disconnect(p_scs, p_ble_evt);
+            scs_frame_rx_init(&m_frame_rx, readBuffer, sizeof(readBuffer));
             break;
 
         case BLE_GATTS_EVT_WRITE:
@@ -141,7 +137,7 @@ static uint32_t data_dn_add(scs_t * p_scs, const scs_init_t * p_scs_init)
     attr_char_value.p_attr_md    = &attr_md;
     attr_char_value.init_len     = sizeof(uint8_t);
     attr_char_value.init_offs    = 0;
-    attr_char_value.max_len      = 20;
+    attr_char_value.max_len      = SCS_MAX_DATA_LEN;
     attr_char_value.p_value      = NULL;
 
     return sd_ble_gatts_characteristic_add(p_scs->service_handle, &char_md,
@@ -194,7 +190,7 @@ static uint32_t data_up_add(scs_t * p_scs, const scs_init_t * p_scs_init)
     attr_char_value.p_attr_md    = &attr_md;
     attr_char_value.init_len     = sizeof(uint8_t);
     attr_char_value.init_offs    = 0;
-    attr_char_value.max_len      = 20;
+    attr_char_value.max_len      = SCS_MAX_DATA_LEN;
     attr_char_value.p_value      = NULL;
 
     return sd_ble_gatts_characteristic_add(p_scs->service_handle, &char_md,
@@ -209,7 +205,9 @@ uint32_t scs_init(scs_t * p_scs, const scs_init_t * p_scs_init)
 
     // Initialize service structure
     p_scs->conn_handle       = BLE_CONN_HANDLE_INVALID;
+    p_scs->max_data_len      = SCS_MAX_DATA_LEN;
     p_scs->data_write_handler = p_scs_init->data_write_handler;
+    scs_frame_rx_init(&m_frame_rx, readBuffer, sizeof(readBuffer));
 
     // Add service
     ble_uuid128_t base_uuid = BLE_SCS_UUID_BASE;
@@ -244,58 +242,57 @@ uint32_t scs_init(scs_t * p_scs, const scs_init_t * p_scs_init)
 }
 
 uint32_t scs_data_send(scs_t * p_scs, uint8_t *data, uint16_t len)
+{
+    data_iovec_t iov = { data, len };
+    return scs_data_send_iov(p_scs, &iov, 1);
+}
+
+uint32_t scs_data_send_iov(scs_t * p_scs, const data_iovec_t * p_iov, uint8_t iovcnt)
 {
     ble_gatts_hvx_params_t params;
-    //uint16_t len = sizeof(data);
-    int error = NRF_SUCCESS;
-    uint8_t buffer[20];
+    data_iovec_t frame[SCS_MAX_IOVCNT+1];
+    uint8_t header[SCS_FRAME_HEADER_SIZE];
+    uint8_t buffer[SCS_MAX_DATA_LEN];
+
+    if (iovcnt > SCS_MAX_IOVCNT) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    //the length goes in front of the message, so the peer doesn't need an end of message packet
+    scs_frame_header_encode(header, data_iovec_length(p_iov, iovcnt));
+    frame[0].p_data = header;
+    frame[0].data_len = sizeof(header);
+    memcpy(frame+1, p_iov, iovcnt*sizeof(data_iovec_t));
+    iovcnt++;
 
-    for (int i = 0; i < len; i+=20) {
-    	uint16_t size = (len-i > 20 ? 20 : len-i);
-    	memcpy(buffer, data+i, size);
+    uint16_t len = data_iovec_length(frame, iovcnt);
+    uint16_t chunk = p_scs->max_data_len;
+
+    for (int i = 0; i < len; i+=chunk) {
+    	uint16_t size = (len-i > chunk ? chunk : len-i);
 
 		memset(&params, 0, sizeof(params));
 		params.type = BLE_GATT_HVX_NOTIFICATION;
 		params.handle = p_scs->data_up_handles.value_handle;
-		params.p_data = buffer;
+		//the SoftDevice copies the value, so point straight at the caller's data when we can
+		params.p_data = (uint8_t *)data_iovec_chunk(frame, iovcnt, i, size, buffer);
 		params.p_len = &size;
 
 		int error = sd_ble_gatts_hvx(p_scs->conn_handle, &params);
 
-		//when sending data very fast, we can use up all the buffers. this should protect us as we wait for the TX complete event
+		//when sending data very fast, we can use up all the buffers. sleep until the SoftDevice
+		//gives one back with a TX complete event, which comes in the same connection event
 		while (error == BLE_ERROR_NO_TX_BUFFERS) {
 			while (waitForTxComplete) {
-				uint8_t bufferCount = 0;
-				sd_ble_tx_buffer_count_get(&bufferCount);
-                //TO DO: This can probably be reduced...
-				nrf_delay_us(500000);
+				sd_app_evt_wait();
 			}
 			waitForTxComplete = true;
 			error = sd_ble_gatts_hvx(p_scs->conn_handle, &params);
 		}
 
-
 		if (error != NRF_SUCCESS) {
 			return error;
 		}
     }
-
-    //send the end of transmission characters
-    uint8_t eotBuffer[2] = {3, 4};
-    uint16_t eotSize = sizeof(eotBuffer);
-    memset(&params, 0, sizeof(params));
-	params.type = BLE_GATT_HVX_NOTIFICATION;
-	params.handle = p_scs->data_up_handles.value_handle;
-	params.p_data = eotBuffer;
-	params.p_len = &eotSize;
-	error = sd_ble_gatts_hvx(p_scs->conn_handle, &params);
-
-	while (error == BLE_ERROR_NO_TX_BUFFERS) {
-		while (waitForTxComplete) {
-			nrf_delay_us(500);
-		}
-		waitForTxComplete = true;
-		error = sd_ble_gatts_hvx(p_scs->conn_handle, &params);
-	}
-    return error;
+    return NRF_SUCCESS;
 }
@@ -0,0 +1,77 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "block_pool.h"
+#include <stddef.h>
+
+static uint16_t blocks_needed(const block_pool_t * p_pool, uint16_t size)
+{
+    return ((uint32_t)size + p_pool->block_size - 1) / p_pool->block_size;
+}
+
+static uint32_t run_mask(uint16_t blocks)
+{
+    return blocks >= 32 ? 0xFFFFFFFF : ((1UL << blocks) - 1);
+}
+
+void block_pool_init(block_pool_t * p_pool, uint8_t * p_memory, uint16_t block_size, uint8_t block_count)
+{
+    p_pool->p_memory = p_memory;
+    p_pool->block_size = block_size;
+    p_pool->block_count = block_count > BLOCK_POOL_MAX_BLOCKS ? BLOCK_POOL_MAX_BLOCKS : block_count;
+    p_pool->used_mask = 0;
+    p_pool->blocks_used = 0;
+    p_pool->blocks_peak = 0;
+    p_pool->alloc_failures = 0;
+}
+
+uint8_t * block_pool_alloc(block_pool_t * p_pool, uint16_t size)
+{
+    uint16_t needed = blocks_needed(p_pool, size);
+
+    //checked in bytes, a buffer larger than the whole pool never fits
+    if (size > 0 && size <= (uint32_t)p_pool->block_size * p_pool->block_count) {
+        uint32_t mask = run_mask(needed);
+        //first fit, buffers are short lived so the pool doesn't stay fragmented for long
+        for (uint8_t first = 0; first + needed <= p_pool->block_count; first++) {
+            if ((p_pool->used_mask & (mask << first)) == 0) {
+                p_pool->used_mask |= (mask << first);
+                p_pool->blocks_used += needed;
+                if (p_pool->blocks_used > p_pool->blocks_peak) {
+                    p_pool->blocks_peak = p_pool->blocks_used;
+                }
+                return p_pool->p_memory + first * p_pool->block_size;
+            }
+        }
+    }
+
+    p_pool->alloc_failures++;
+    return NULL;
+}
+
+void block_pool_free(block_pool_t * p_pool, uint8_t * p_buffer, uint16_t size)
+{
+    if (p_buffer == NULL) {
+        return;
+    }
+
+    uint8_t first = (p_buffer - p_pool->p_memory) / p_pool->block_size;
+    uint16_t needed = blocks_needed(p_pool, size);
+
+    p_pool->used_mask &= ~(run_mask(needed) << first);
+    p_pool->blocks_used -= needed;
+}
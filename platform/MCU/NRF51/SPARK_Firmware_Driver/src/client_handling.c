@@ -18,20 +18,25 @@
 #include "ble_srv_common.h"
 #include "ble_hci.h"
 #include "nrf_delay.h"
+#include "app_util_platform.h"
 #include "spi_slave_stream.h"
 #include "app_uart.h"
 #include "registered_data_services.h"
+#include "scs_framing.h"
+#include "block_pool.h"
+#include "hw_config.h"
 
 #include "debug.h"
 
 #define MULTILINK_PERIPHERAL_BASE_UUID {{0xB2, 0x2D, 0x14, 0xAA, 0xB3, 0x9F, 0x41, 0xED, 0xB1, 0x77, 0xFF, 0x38, 0xD8, 0x17, 0x1E, 0x87}};
+//ble_scs.h comes in through hw_config.h, the gateway sees the characteristics from the other side
+#undef BLE_SCS_UUID_DATA_DN_CHAR
+#undef BLE_SCS_UUID_DATA_UP_CHAR
 #define BLE_SCS_UUID_SERVICE 0x0223
 #define BLE_SCS_UUID_DATA_DN_CHAR 0x0224
 #define BLE_SCS_UUID_DATA_UP_CHAR 0x0225
 
-#define RX_BUFFER_SIZE 					  512
-
-bool waitForTxComplete = true;
+#define TX_POOL_BLOCKS(size)              (((size) + TX_POOL_BLOCK_SIZE - 1) / TX_POOL_BLOCK_SIZE)
 
 /**@brief Client states. */
 typedef enum
@@ -43,6 +48,13 @@ typedef enum
     STATE_ERROR                                     /**< Error state. */
 } client_state_t;
 
+/**@brief A framed message waiting to go down to a peripheral, in a buffer from the TX pool. */
+typedef struct
+{
+    uint8_t                    * p_frame;           /**< The frame header and the message. */
+    uint16_t                     length;            /**< Bytes in p_frame. */
+} tx_frame_t;
+
 /**@brief Client context information. */
 typedef struct
 {
@@ -51,16 +63,49 @@ typedef struct
     uint8_t                      up_char_index;        /**< Client characteristics index in discovered service information. */
     uint8_t                      dn_char_index;        /**< Client characteristics index in discovered service information. */
     uint8_t                      state;             /**< Client state. */
-    uint8_t                      ble_read_buffer[RX_BUFFER_SIZE];
-    uint16_t                     ble_read_buffer_length;
+    uint8_t                    * rx_buffer;         /**< Pool buffer holding the SPI header and the message being received, NULL between messages. */
+    uint16_t                     rx_buffer_size;    /**< Size rx_buffer was allocated with. */
+    uint32_t                     rx_start_time;     /**< When the first packet of the message being received arrived. */
+    scs_frame_rx_t               frame_rx;          /**< Collects framed messages into rx_buffer, after the SPI header. */
+    uint16_t                     max_data_len;      /**< Largest write payload on this connection. */
+    tx_frame_t                   tx_queue[TX_QUEUE_DEPTH];  /**< Frames waiting for SoftDevice buffers. */
+    uint8_t                      tx_queue_head;     /**< Index of the oldest queued frame. */
+    uint8_t                      tx_queue_count;    /**< Number of queued frames. */
+    uint8_t                      tx_blocks;         /**< TX pool blocks held by the queued frames. */
+    uint16_t                     tx_frame_offset;   /**< Bytes of the frame at the head of the queue already written. */
+    uint8_t                      tx_credits;        /**< SoftDevice TX buffers this link may still fill. */
+    uint8_t                      tx_in_flight;      /**< Packets written on this link and not yet TX complete. */
     uint8_t                      id;
     bool                         socketedParticle;
     bool                         peripheralConnected;
+    ble_gap_addr_t               peer_addr;         /**< Address of the peripheral, to keep it out for a while once rotated out. */
+    uint32_t                     connect_time;      /**< When the peripheral connected. */
+    uint32_t                     last_activity;     /**< When a packet last went either way. */
+    uint32_t                     uplink_bytes;      /**< Message bytes forwarded up from the peripheral. */
+    uint16_t                     uplink_messages;   /**< Messages forwarded up from the peripheral. */
+    uint16_t                     dropped_messages;  /**< Messages lost for lack of a pool buffer or of room in the SPI queue. */
+    uint32_t                     latency_total;     /**< Sum of the time messages took to arrive, first packet to last. */
+    uint16_t                     latency_max;       /**< Longest time a message took to arrive. */
 } client_t;
 
 static client_t         m_client[MAX_CLIENTS];      /**< Client context information list. */
 static uint8_t          m_client_count;             /**< Number of clients. */
 static uint8_t          m_base_uuid_type;           /**< UUID type. */
+static uint8_t          m_tx_next;                  /**< Client the TX scheduler serves first next time round. */
+
+static uint8_t          m_rx_pool_memory[RX_POOL_SIZE];
+static block_pool_t     m_rx_pool;                  /**< Buffers for messages coming up from the peripherals. */
+
+static uint8_t          m_tx_pool_memory[TX_POOL_BLOCK_SIZE * TX_POOL_BLOCK_COUNT];
+static block_pool_t     m_tx_pool;                  /**< Buffers for the frames queued to go down to the peripherals. */
+
+static ble_gap_addr_t   m_rotated_peers[ROTATED_PEERS_MAX];     /**< Peripherals recently rotated out. */
+static uint32_t         m_rotated_times[ROTATED_PEERS_MAX];     /**< When each of them was rotated out. */
+static uint8_t          m_rotated_next;             /**< Entry to overwrite next. */
+static uint32_t         m_peer_waiting_time;        /**< When a peripheral was last seen waiting for a free link, 0 if none. */
+
+static uint32_t         m_stats_bytes;              /**< Uplink message bytes since the statistics were last read. */
+static uint32_t         m_stats_time;               /**< When the statistics were last read. */
 
 static void blink_led(int count)
 {
@@ -136,12 +181,78 @@ static void notif_enable(client_t * p_client)
     APP_ERROR_CHECK(err_code);
 }
 
-void spi_slave_set_tx_buffer(client_t * p_client, gateway_function_t type, uint8_t * data, uint16_t len)
+/**@brief Function for handing a client's receive buffer back to the pool.
+ */
+static void client_rx_release(client_t * p_client)
+{
+    block_pool_free(&m_rx_pool, p_client->rx_buffer, p_client->rx_buffer_size);
+    p_client->rx_buffer = NULL;
+    p_client->rx_buffer_size = 0;
+    scs_frame_rx_init(&p_client->frame_rx, NULL, 0);
+}
+
+/**@brief Function for collecting a packet of a framed message from a client.
+ *
+ * @details A pool buffer is taken when the first packet of a message comes in, sized from the frame
+ *          header, and is held only until the message has been passed on. If the pool has no room the
+ *          message is still consumed, but dropped.
+ *
+ * @return true once a whole message is in rx_buffer, after the SPI header. The caller then passes it
+ *         on and calls client_rx_release.
+ */
+static bool client_rx_packet(client_t * p_client, const uint8_t * data, uint16_t len)
+{
+    uint32_t now = system_millis();
+    p_client->last_activity = now;
+
+    if (p_client->frame_rx.expected == 0 && len >= SCS_FRAME_HEADER_SIZE) {
+        uint16_t frameLength = (data[0] << 8) | data[1];
+
+        client_rx_release(p_client);
+        p_client->rx_start_time = now;
+        //a message that can't be passed on in one SPI transfer is dropped without taking a buffer
+        if (frameLength <= RX_MAX_MESSAGE_LENGTH) {
+            p_client->rx_buffer = block_pool_alloc(&m_rx_pool, SPI_HEADER_SIZE + frameLength);
+        }
+        if (p_client->rx_buffer != NULL) {
+            p_client->rx_buffer_size = SPI_HEADER_SIZE + frameLength;
+            scs_frame_rx_init(&p_client->frame_rx, p_client->rx_buffer + SPI_HEADER_SIZE, frameLength);
+        }
+    }
+
+    if (scs_frame_rx_feed(&p_client->frame_rx, data, len)) {
+        uint32_t latency = now - p_client->rx_start_time;
+        p_client->uplink_messages++;
+        p_client->uplink_bytes += p_client->frame_rx.received;
+        p_client->latency_total += latency;
+        if (latency > p_client->latency_max) {
+            p_client->latency_max = latency > 0xFFFF ? 0xFFFF : latency;
+        }
+        m_stats_bytes += p_client->frame_rx.received;
+        return true;
+    }
+
+    if (p_client->frame_rx.expected == 0) {
+        //the frame ended without a message, it had no buffer or was empty
+        if (p_client->rx_buffer == NULL && p_client->frame_rx.received > 0) {
+            p_client->dropped_messages++;
+        }
+        client_rx_release(p_client);
+    }
+    return false;
+}
+
+uint32_t spi_slave_set_tx_buffer(client_t * p_client, gateway_function_t type, uint8_t * data, uint16_t len)
 {
     data[0] = (( (len-SPI_HEADER_SIZE-BLE_HEADER_SIZE) & 0xFF00) >> 8);
     data[1] = ( (len-SPI_HEADER_SIZE-BLE_HEADER_SIZE) & 0xFF);
     data[2] = p_client->id;
-	tx_callback(data, len);
+    uint32_t err_code = tx_callback(data, len);
+    if (err_code != NRF_SUCCESS) {
+        //the master hasn't been reading, the message is lost
+        p_client->dropped_messages++;
+    }
+    return err_code;
 }
 
 /**@brief Funtion for sending data to the client
@@ -153,81 +264,162 @@ void on_write(client_t * p_client, ble_evt_t * p_ble_evt)
 {
 	ble_gatts_evt_write_t * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
 
-	for (int i = 0; i < p_evt_write->len; i++) {
-        p_client->ble_read_buffer[p_client->ble_read_buffer_length+i] = p_evt_write->data[i];
+	if (client_rx_packet(p_client, p_evt_write->data, p_evt_write->len)) {
+		//got a whole message, write this to SPI
+		spi_slave_set_tx_buffer(p_client, SPI_BUS_DATA, p_client->rx_buffer, SPI_HEADER_SIZE + p_client->frame_rx.received);
+		client_rx_release(p_client);
 	}
-    p_client->ble_read_buffer_length += p_evt_write->len;
+}
 
-	if (p_evt_write->len == 2 && p_evt_write->data[0] == 0x03 && p_evt_write->data[1] == 0x04) {
-		//got the EOS characters, write this to UART
-		spi_slave_set_tx_buffer(p_client, SPI_BUS_DATA, p_client->ble_read_buffer, p_client->ble_read_buffer_length);
-        p_client->ble_read_buffer_length = SPI_HEADER_SIZE;
-	}
+/**@brief Function for dropping everything queued for a client.
+ */
+static void tx_queue_clear(client_t * p_client)
+{
+    while (p_client->tx_queue_count > 0) {
+        tx_frame_t * p_frame = &p_client->tx_queue[p_client->tx_queue_head];
+        block_pool_free(&m_tx_pool, p_frame->p_frame, p_frame->length);
+        p_client->tx_queue_head = (p_client->tx_queue_head + 1) % TX_QUEUE_DEPTH;
+        p_client->tx_queue_count--;
+    }
+    p_client->tx_blocks = 0;
+    p_client->tx_queue_head = 0;
+    p_client->tx_frame_offset = 0;
 }
 
-/**@brief Funtion for sending data to the client
+/**@brief Function for writing the next packet queued for a client.
  *
- * @param[in] data  Data to be sent to the client.
- * @param[in] len   Lengthof the data to be sent to the client.
+ * @details A packet never crosses a frame boundary, the peripheral expects every frame to start a new packet.
+ *
+ * @return true if a packet was handed to the SoftDevice.
  */
-void client_send_data(uint8_t *data, uint16_t len)
+static bool tx_send_packet(client_t * p_client)
 {
-    while (len > 0) {
-        int chunkLength = (data[0] << 8) | data[1];
-        int id = data[2];
+    ble_gattc_write_params_t write_params;
+    tx_frame_t * p_frame = &p_client->tx_queue[p_client->tx_queue_head];
+
+    uint16_t remaining = p_frame->length - p_client->tx_frame_offset;
+    uint16_t size = remaining > p_client->max_data_len ? p_client->max_data_len : remaining;
+
+    write_params.write_op = BLE_GATT_OP_WRITE_CMD;
+    write_params.handle = p_client->srv_db.services[0].charateristics[p_client->up_char_index].characteristic.handle_value;
+    write_params.offset = 0;
+    write_params.len = size;
+    //the SoftDevice copies write commands, so the frame can go back to the pool once it is all written
+    write_params.p_value = p_frame->p_frame + p_client->tx_frame_offset;
+
+    uint32_t err_code = sd_ble_gattc_write(p_client->srv_db.conn_handle, &write_params);
+    if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+        //the other links have the buffers. with nothing in flight on this one no TX complete
+        //would come for it, so it keeps a credit and tries again on the next one of any link
+        p_client->tx_credits = p_client->tx_in_flight > 0 ? 0 : 1;
+        return false;
+    } else if (err_code != NRF_SUCCESS) {
+        //the link is going away, nothing queued for it can be delivered
+        tx_queue_clear(p_client);
+        return false;
+    }
 
-        int err_code = 0;
-        ble_gattc_write_params_t write_params;
-        uint8_t buffer[20];
+    p_client->tx_credits--;
+    p_client->tx_in_flight++;
+    p_client->last_activity = system_millis();
+    p_client->tx_frame_offset += size;
+    if (p_client->tx_frame_offset == p_frame->length) {
+        block_pool_free(&m_tx_pool, p_frame->p_frame, p_frame->length);
+        p_client->tx_blocks -= TX_POOL_BLOCKS(p_frame->length);
+        p_client->tx_queue_head = (p_client->tx_queue_head + 1) % TX_QUEUE_DEPTH;
+        p_client->tx_queue_count--;
+        p_client->tx_frame_offset = 0;
+    }
+    return true;
+}
 
-        int actualBytesSent = 0;
+/**@brief Function for filling the free SoftDevice buffers from the client queues.
+ *
+ * @details Clients are served one packet at a time in turn, so a peripheral that is slow to
+ *          take data only holds up its own queue. Called whenever data is queued and on every
+ *          TX complete event.
+ */
+static void client_tx_process(void)
+{
+    CRITICAL_REGION_ENTER();
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            client_t * p_client = &m_client[(m_tx_next + i) % MAX_CLIENTS];
+            if (p_client->state == STATE_RUNNING && p_client->tx_queue_count > 0 && p_client->tx_credits > 0) {
+                progress |= tx_send_packet(p_client);
+            }
+        }
+    }
+    m_tx_next = (m_tx_next + 1) % MAX_CLIENTS;
+    CRITICAL_REGION_EXIT();
+}
+
+/**@brief Funtion for sending data to the client
+ *
+ * @param[in]  data       Data to be sent to the client.
+ * @param[in]  len        Lengthof the data to be sent to the client.
+ * @param[out] p_dropped  Number of the messages taken that were dropped.
+ */
+uint16_t client_send_data(uint8_t *data, uint16_t len, uint16_t *p_dropped)
+{
+    uint16_t consumed = 0;
+    *p_dropped = 0;
 
+    while (len - consumed >= SPI_HEADER_SIZE) {
+        uint8_t * message = data + consumed;
+        int chunkLength = (message[0] << 8) | message[1];
+        int id = message[2];
         int formattedLength = chunkLength + BLE_HEADER_SIZE;
-        DEBUG("Sending data of size %d", formattedLength);
-        for (int i = 0; i < formattedLength; i += 20) {
-            uint16_t size = (formattedLength - i > 20 ? 20 : formattedLength - i);
-            actualBytesSent += size;
-            memcpy(buffer, data + i + SPI_HEADER_SIZE, size);
-            DEBUG("Sending packaet of size %d", size);
-            write_params.write_op = BLE_GATT_OP_WRITE_CMD;
-            write_params.handle = m_client[id].srv_db.services[0].charateristics[m_client[id].up_char_index].characteristic.handle_value;
-            write_params.offset = 0;
-            write_params.len = size;
-            write_params.p_value = buffer;
-
-            err_code = sd_ble_gattc_write(m_client[id].srv_db.conn_handle, &write_params);
-            while (err_code == BLE_ERROR_NO_TX_BUFFERS) {
-                uint8_t bufferCount = 0;
-                //8000 chunks of 500 microseconds is 4 seconds, the longest this should possibly take
-                int timeout = 8000;
-                while (timeout-- > 0 && waitForTxComplete) {
-                    sd_ble_tx_buffer_count_get(&bufferCount);
-                    nrf_delay_us(500);
-                }
-                waitForTxComplete = true;
-                err_code = sd_ble_gattc_write(m_client[id].srv_db.conn_handle, &write_params);
-            }
+        uint16_t messageLength = SPI_HEADER_SIZE + formattedLength;
+
+        if (messageLength > len - consumed) {
+            //a message is never split between transfers, so this is garbage
+            (*p_dropped)++;
+            return len;
         }
 
-        //now send the EOS characters
-        uint8_t eotBuffer[2] = {3, 4};
-        write_params.write_op = BLE_GATT_OP_WRITE_CMD;
-        write_params.handle = m_client[id].srv_db.services[0].charateristics[m_client[id].up_char_index].characteristic.handle_value;
-        write_params.offset = 0;
-        write_params.len = 2;
-        write_params.p_value = eotBuffer;
-
-        err_code = sd_ble_gattc_write(m_client[id].srv_db.conn_handle, &write_params);
-        while (err_code == BLE_ERROR_NO_TX_BUFFERS) {
-            int timeout = 8000;
-            while (timeout-- > 0 && waitForTxComplete) {
-                nrf_delay_us(500);
+        if (id < MAX_CLIENTS && m_client[id].state == STATE_RUNNING && SCS_FRAME_HEADER_SIZE + formattedLength <= TX_POOL_BLOCK_SIZE * TX_POOL_BLOCK_COUNT) {
+            client_t * p_client = &m_client[id];
+            uint16_t frameLength = SCS_FRAME_HEADER_SIZE + formattedLength;
+            uint8_t * p_buffer = NULL;
+
+            //past its share of the pool a client waits for its own frames to go, so a slow peripheral
+            //can't take the blocks the others need. a frame larger than the share can still go on its own
+            uint8_t blocks = TX_POOL_BLOCKS(frameLength);
+            //the critical region is a block of its own, so p_buffer says what happened in it
+            CRITICAL_REGION_ENTER();
+            if (p_client->tx_queue_count == 0 ||
+                (p_client->tx_queue_count < TX_QUEUE_DEPTH && p_client->tx_blocks + blocks <= TX_POOL_CLIENT_BLOCKS)) {
+                p_buffer = block_pool_alloc(&m_tx_pool, frameLength);
+            }
+            if (p_buffer != NULL) {
+                //the length goes in front of the message, so the peripheral doesn't need an end of message packet
+                scs_frame_header_encode(p_buffer, formattedLength);
+                memcpy(p_buffer + SCS_FRAME_HEADER_SIZE, message + SPI_HEADER_SIZE, formattedLength);
+                tx_frame_t * p_frame = &p_client->tx_queue[(p_client->tx_queue_head + p_client->tx_queue_count) % TX_QUEUE_DEPTH];
+                p_frame->p_frame = p_buffer;
+                p_frame->length = frameLength;
+                p_client->tx_queue_count++;
+                p_client->tx_blocks += blocks;
+            }
+            CRITICAL_REGION_EXIT();
+
+            if (p_buffer == NULL) {
+                //leave the rest for when this client has caught up
+                break;
             }
-            waitForTxComplete = true;
-            err_code = sd_ble_gattc_write(m_client[id].srv_db.conn_handle, &write_params);
+            DEBUG("Queued data of size %d for client %d", formattedLength, id);
+        } else {
+            //messages for clients that are gone or that could never fit are dropped
+            (*p_dropped)++;
         }
-        len-=(chunkLength+SPI_HEADER_SIZE + BLE_HEADER_SIZE);
+        consumed += messageLength;
     }
+
+    client_tx_process();
+    return consumed;
 }
 
 
@@ -318,22 +510,20 @@ static void on_evt_hvx(ble_evt_t * p_ble_evt, client_t * p_client, uint32_t inde
         {
 			ble_gattc_evt_hvx_t * p_evt_write = &p_ble_evt->evt.gattc_evt.params.hvx;
 
-			if (p_evt_write->len == 2 && p_evt_write->data[0] == 0x03 && p_evt_write->data[1] == 0x04) {
+			if (client_rx_packet(p_client, p_evt_write->data, p_evt_write->len)) {
+                uint16_t length = SPI_HEADER_SIZE + p_client->frame_rx.received;
 				if ( p_client->peripheralConnected && !p_client->socketedParticle) {
                     p_client->socketedParticle = true;
 
                     //this is a hack-fx. v1.0.47 of bluz FW didn't properly fill out the connection field of the BLE header, so we have to do it here
-                    p_client->ble_read_buffer[SPI_HEADER_SIZE+1] = ((SPI_BUS_CONNECT << 4) & 0xF0) | (p_client->ble_read_buffer[1] & 0x0F);
+                    p_client->rx_buffer[SPI_HEADER_SIZE+1] = ((SPI_BUS_CONNECT << 4) & 0xF0) | (p_client->rx_buffer[SPI_HEADER_SIZE+1] & 0x0F);
 
-                    spi_slave_set_tx_buffer(p_client, SPI_BUS_CONNECT, p_client->ble_read_buffer, p_client->ble_read_buffer_length);
+                    spi_slave_set_tx_buffer(p_client, SPI_BUS_CONNECT, p_client->rx_buffer, length);
 				} else {
-					//got the EOS characters, write this to UART
-					spi_slave_set_tx_buffer(p_client, SPI_BUS_DATA, p_client->ble_read_buffer, p_client->ble_read_buffer_length);
+					//got a whole message, write this to SPI
+					spi_slave_set_tx_buffer(p_client, SPI_BUS_DATA, p_client->rx_buffer, length);
 				}
-                p_client->ble_read_buffer_length = SPI_HEADER_SIZE;
-			} else {
-				memcpy(p_client->ble_read_buffer+p_client->ble_read_buffer_length, p_evt_write->data, p_evt_write->len);
-                p_client->ble_read_buffer_length += p_evt_write->len;
+				client_rx_release(p_client);
 			}
         }
     }
@@ -412,8 +602,13 @@ void client_handling_ble_evt_handler(ble_evt_t * p_ble_evt)
             break;
 
         case BLE_EVT_TX_COMPLETE:
-			waitForTxComplete = false;
-			break;
+            if (p_client != NULL) {
+                uint8_t count = p_ble_evt->evt.common_evt.params.tx_complete.count;
+                p_client->tx_credits += count;
+                p_client->tx_in_flight = count < p_client->tx_in_flight ? p_client->tx_in_flight - count : 0;
+            }
+            client_tx_process();
+            break;
 
         case BLE_GAP_EVT_DISCONNECTED:
 			break;
@@ -444,7 +639,7 @@ static void db_discovery_init(void)
 
 /**@brief Function for initializing the client handling.
  */
-void client_handling_init(void (*b)(uint8_t *m_tx_buf, uint16_t size))
+void client_handling_init(uint32_t (*b)(uint8_t *m_tx_buf, uint16_t size))
 {
     blink_led(1);
 	tx_callback = b;
@@ -464,6 +659,10 @@ void client_handling_init(void (*b)(uint8_t *m_tx_buf, uint16_t size))
 
     m_client_count = 0;
 
+    block_pool_init(&m_rx_pool, m_rx_pool_memory, RX_POOL_BLOCK_SIZE, RX_POOL_BLOCK_COUNT);
+    block_pool_init(&m_tx_pool, m_tx_pool_memory, TX_POOL_BLOCK_SIZE, TX_POOL_BLOCK_COUNT);
+    m_stats_time = system_millis();
+
     db_discovery_init();
 
     // Register with discovery module for the discovery of the service.
@@ -488,9 +687,24 @@ uint8_t client_handling_count(void)
 
 /**@brief Function for creating a new client.
  */
-uint32_t client_handling_create(const dm_handle_t * p_handle, uint16_t conn_handle)
+uint32_t client_handling_create(const dm_handle_t * p_handle, uint16_t conn_handle, const ble_gap_addr_t * p_peer_addr)
 {
-    m_client[p_handle->connection_id].ble_read_buffer_length = SPI_HEADER_SIZE;
+    client_t * p_client = &m_client[p_handle->connection_id];
+
+    p_client->rx_buffer = NULL;
+    client_rx_release(p_client);
+    p_client->peer_addr = *p_peer_addr;
+    p_client->connect_time = system_millis();
+    p_client->last_activity = p_client->connect_time;
+    p_client->uplink_bytes = 0;
+    p_client->uplink_messages = 0;
+    p_client->dropped_messages = 0;
+    p_client->latency_total = 0;
+    p_client->latency_max = 0;
+    m_client[p_handle->connection_id].max_data_len       = SCS_MAX_DATA_LEN;
+    tx_queue_clear(&m_client[p_handle->connection_id]);
+    sd_ble_tx_buffer_count_get(&m_client[p_handle->connection_id].tx_credits);
+    m_client[p_handle->connection_id].tx_in_flight       = 0;
     m_client[p_handle->connection_id].state              = STATE_SERVICE_DISC;
     m_client[p_handle->connection_id].srv_db.conn_handle = conn_handle;
                 m_client_count++;
@@ -515,6 +729,8 @@ uint32_t client_handling_destroy(const dm_handle_t * p_handle)
     {
         m_client_count--;
         p_client->state = IDLE;
+        tx_queue_clear(p_client);
+        client_rx_release(p_client);
         //first 3 bytes are SPI header, will get filled in by function. next two bytes are BLE header
         uint8_t dummy[6] = {0, 0, 0, SOCKET_DATA_SERVICE, (((SPI_BUS_DISCONNECT << 4) & 0xF0) | (0 & 0x0F)), 22};
         spi_slave_set_tx_buffer(p_client, SPI_BUS_DISCONNECT, dummy, 6);
@@ -546,3 +762,76 @@ void connected_peripherals(uint8_t *values) {
 
     }
 }
+
+/**@brief Function for checking whether a peripheral was rotated out too recently to take a link again.
+ */
+bool client_handling_recently_rotated(const ble_gap_addr_t * p_addr)
+{
+    uint32_t now = system_millis();
+    for (int i = 0; i < ROTATED_PEERS_MAX; i++) {
+        if (m_rotated_times[i] != 0 &&
+            now - m_rotated_times[i] < CONNECTION_ROTATION_TIME &&
+            memcmp(m_rotated_peers[i].addr, p_addr->addr, BLE_GAP_ADDR_LEN) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void client_handling_peer_waiting(void)
+{
+    m_peer_waiting_time = system_millis();
+}
+
+void client_handling_rotate(void)
+{
+    uint32_t now = system_millis();
+
+    if (CONNECTION_ROTATION_TIME == 0 || m_client_count < MAX_CLIENTS ||
+        m_peer_waiting_time == 0 || now - m_peer_waiting_time > CONNECTION_WAITING_TIMEOUT) {
+        return;
+    }
+
+    //give up the link that has had its turn the longest, as long as it is quiet
+    client_t * p_oldest = NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t * p_client = &m_client[i];
+        if (p_client->state == STATE_RUNNING &&
+            now - p_client->connect_time > CONNECTION_ROTATION_TIME &&
+            now - p_client->last_activity > CONNECTION_IDLE_TIME &&
+            p_client->tx_queue_count == 0 && p_client->rx_buffer == NULL &&
+            (p_oldest == NULL || p_client->connect_time < p_oldest->connect_time)) {
+            p_oldest = p_client;
+        }
+    }
+
+    if (p_oldest != NULL) {
+        m_rotated_peers[m_rotated_next] = p_oldest->peer_addr;
+        m_rotated_times[m_rotated_next] = now;
+        m_rotated_next = (m_rotated_next + 1) % ROTATED_PEERS_MAX;
+        m_peer_waiting_time = 0;
+        sd_ble_gap_disconnect(p_oldest->srv_db.conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    }
+}
+
+void client_handling_stats(client_stats_t * p_stats, gateway_stats_t * p_gateway_stats)
+{
+    uint32_t now = system_millis();
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t * p_client = &m_client[i];
+        p_stats[i].connected = (p_client->state == STATE_RUNNING);
+        p_stats[i].uplink_bytes = p_client->uplink_bytes;
+        p_stats[i].uplink_messages = p_client->uplink_messages;
+        p_stats[i].dropped_messages = p_client->dropped_messages;
+        p_stats[i].latency_avg = p_client->uplink_messages > 0 ? p_client->latency_total / p_client->uplink_messages : 0;
+        p_stats[i].latency_max = p_client->latency_max;
+    }
+
+    uint32_t elapsed = now - m_stats_time;
+    p_gateway_stats->uplink_throughput = elapsed > 0 ? (uint32_t)(((uint64_t)m_stats_bytes * 1000) / elapsed) : 0;
+    p_gateway_stats->pool_blocks_peak = m_rx_pool.blocks_peak;
+    p_gateway_stats->pool_alloc_failures = m_rx_pool.alloc_failures;
+    m_stats_bytes = 0;
+    m_stats_time = now;
+}
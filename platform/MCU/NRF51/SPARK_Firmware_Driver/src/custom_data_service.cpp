@@ -36,11 +36,10 @@ void CustomDataService::registerCallback(void (*dc)(uint8_t *data, uint16_t leng
 
 void CustomDataService::sendData(uint8_t *data, uint16_t length)
 {
-    uint8_t rsp[length+1];
-    rsp[0] = CUSTOM_DATA_SERVICE & 0xFF;
-    memcpy(rsp+1, data, length);
+    uint8_t header[1];
+    header[0] = CUSTOM_DATA_SERVICE & 0xFF;
 
-    DataManagementLayer::sendData(length+1, rsp);
+    DataManagementLayer::sendData(header, sizeof(header), data, length);
 }
 
 void customDataServiceRegisterCallback(void (*data_callback)(uint8_t *data, uint16_t length))
@@ -17,35 +17,45 @@
 
 #include <stdint.h>
 #include <cstdlib>
+#include <cstring>
 #include "data_management_layer.h"
 #include "socket.h"
 extern "C" {
+#if PLATFORM_ID==103
 #include "particle_data_service.h"
+#endif
+#if PLATFORM_ID==269
 #include "hw_gateway_config.h"
 #include "spi_slave_stream.h"
+#endif
 }
 
 #include "debug.h"
 
 int16_t DataManagementLayer::dataServicesRegistered = 0;
 DataService* DataManagementLayer::services[MAX_NUMBER_OF_SERVICES] = {NULL};
+uint8_t DataManagementLayer::serviceIndex[MAX_SERVICE_ID+1] = {0};
 
 DataManagementLayer::DataManagementLayer() { dataServicesRegistered=0; }
 
-void DataManagementLayer::registerService(DataService* service)
+//returns false if the table is full, the service ID doesn't fit in a byte or is already taken
+bool DataManagementLayer::registerService(DataService* service)
 {
+    int32_t serviceID = service->getServiceID();
+    if (dataServicesRegistered >= MAX_NUMBER_OF_SERVICES || serviceID < 0 || serviceID > MAX_SERVICE_ID || serviceIndex[serviceID] != 0) {
+        return false;
+    }
+
     services[dataServicesRegistered++] = service;
+    serviceIndex[serviceID] = dataServicesRegistered;
+    return true;
 }
 
 void DataManagementLayer::feedData(int16_t length, uint8_t *data)
 {
-    uint16_t serviceID = 0x00 | data[0];
-    for (int i = 0; i < dataServicesRegistered; i++)
-    {
-        if (services[i] != NULL && serviceID == services[i]->getServiceID()) {
-            services[i]->DataCallback(data+1, length-1);
-            break;
-        }
+    uint8_t index = serviceIndex[data[0]];
+    if (index != 0) {
+        services[index-1]->DataCallback(data+1, length-1);
     }
 }
 
@@ -64,6 +74,33 @@ void DataManagementLayer::sendData(int16_t length, uint8_t *data)
 #endif
 }
 
+//sends a service header and a payload without joining them first, the payload is only
+//copied once, by the BLE stack or into the SPI queue. returns the transport's error code,
+//NRF_ERROR_NO_MEM on the gateway when the SPI queue has no room for the message
+uint32_t DataManagementLayer::sendData(const uint8_t *header, uint16_t headerLength, const uint8_t *payload, uint16_t payloadLength)
+{
+#if PLATFORM_ID==103
+    data_iovec_t iov[2] = { { header, headerLength }, { payload, payloadLength } };
+    return particle_service_send_data_iov(iov, 2);
+#elif PLATFORM_ID==269
+    if (headerLength > MAX_SERVICE_HEADER_SIZE) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint8_t spiHeader[SPI_HEADER_SIZE+MAX_SERVICE_HEADER_SIZE];
+    uint16_t length = SPI_HEADER_SIZE + headerLength + payloadLength;
+    spiHeader[0] = (( (length-BLE_HEADER_SIZE-SPI_HEADER_SIZE) & 0xFF00) >> 8);
+    spiHeader[1] = ( (length-BLE_HEADER_SIZE-SPI_HEADER_SIZE) & 0xFF);
+    spiHeader[2] = GATEWAY_ID;
+    memcpy(spiHeader+SPI_HEADER_SIZE, header, headerLength);
+
+    data_iovec_t iov[2] = { { spiHeader, (uint16_t)(SPI_HEADER_SIZE + headerLength) }, { payload, payloadLength } };
+    return spi_slave_send_data_iov(iov, 2);
+#else
+    return 0;
+#endif
+}
+
 void dataManagementFeedData(int16_t length, uint8_t *data)
 {
     DataManagementLayer::feedData(length, data);
@@ -43,6 +43,14 @@ uint16_t Flash_Update_Index = 0;
 uint32_t External_Flash_Address = 0;
 uint32_t External_Flash_Start_Address = 0;
 
+/* Sectors of the OTA region are erased one ahead of the chunk being written,
+ * External_Flash_Erase_Address is the first one not erased yet */
+static uint32_t External_Flash_Erase_Address = 0;
+static uint32_t External_Flash_End_Address = 0;
+
+/* The bytes read back at each end of a chunk to check the write */
+#define FLASH_VERIFY_BLOCK_SIZE 32
+
 static void blink_led(int count)
 {
     for (int i = 0; i < count; i++) {
@@ -174,10 +182,14 @@ void FLASH_Begin(uint32_t sFLASH_Address, uint32_t fileSize)
     /* Define the number of External Flash pages to be erased */
     NbrOfPage = FLASH_PagesMask(fileSize);
 
-    /* Erase the SPI Flash pages */
-    for (uint32_t EraseCounter = 0; (EraseCounter < NbrOfPage); EraseCounter++)
+    /* The pages are erased as the chunks come in, start on the first one
+     * while the server gets the first chunk ready */
+    External_Flash_Erase_Address = External_Flash_Start_Address;
+    External_Flash_End_Address = External_Flash_Start_Address + (sFLASH_PAGESIZE * NbrOfPage);
+    if (External_Flash_Erase_Address < External_Flash_End_Address)
     {
-        sFLASH_EraseSector(External_Flash_Start_Address + (sFLASH_PAGESIZE * EraseCounter));
+        sFLASH_EraseSectorStart(External_Flash_Erase_Address);
+        External_Flash_Erase_Address += sFLASH_PAGESIZE;
     }
 }
 
@@ -198,22 +210,70 @@ uint32_t FLASH_PagesMask(uint32_t fileSize)
     return numPages;
 }
 
-uint16_t FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t bufferSize)
+/* The SST25VF has no status bit for a failed program, so a chunk is checked by
+ * reading back its first and last FLASH_VERIFY_BLOCK_SIZE bytes. The writes that
+ * go wrong on this part show up there:
+ * - a write the part ignores, when it is protected, missed the WREN or is still
+ *   erasing, leaves both ends as they were;
+ * - AAI programs in address order, so a write cut short leaves the last end;
+ * - a chunk written over a sector that wasn't erased reads back as the old and
+ *   the new bits ANDed together, at both ends.
+ * The data itself was checked on its way from the cloud, reading all of
+ * it back would only cover a bit flip on the SPI bus in the middle of the chunk. */
+static bool FLASH_VerifyBlock(const uint8_t *pBuffer, uint32_t address, uint32_t length)
+{
+    uint8_t block[FLASH_VERIFY_BLOCK_SIZE];
+
+    sFLASH_ReadBuffer(block, address, length);
+    return memcmp(block, pBuffer, length) == 0;
+}
+
+static bool FLASH_Verify(const uint8_t *pBuffer, uint32_t address, uint32_t length)
+{
+    uint32_t blockLength = (length > FLASH_VERIFY_BLOCK_SIZE) ? FLASH_VERIFY_BLOCK_SIZE : length;
+    uint32_t lastOffset = length - blockLength;
+
+    if (!FLASH_VerifyBlock(pBuffer, address, blockLength))
+    {
+        return false;
+    }
+    return lastOffset == 0 || FLASH_VerifyBlock(pBuffer + lastOffset, address + lastOffset, blockLength);
+}
+
+bool FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t bufferSize)
 {
     const uint8_t *writeBuffer = pBuffer;
-    uint8_t readBuffer[bufferSize];
+    uint32_t chunkEnd = address + bufferSize;
+
+    /* Erase whatever the chunk needs that the erase ahead has not got to yet,
+     * usually the sector is done already */
+    if (address >= External_Flash_Start_Address)
+    {
+        while (External_Flash_Erase_Address < chunkEnd && External_Flash_Erase_Address < External_Flash_End_Address)
+        {
+            sFLASH_EraseSector(External_Flash_Erase_Address);
+            External_Flash_Erase_Address += sFLASH_PAGESIZE;
+        }
+    }
 
     /* Write Data Buffer to SPI Flash memory */
     sFLASH_WriteBuffer(writeBuffer, address, bufferSize);
 
-    /* Read Data Buffer from SPI Flash memory */
-    sFLASH_ReadBuffer(readBuffer, address, bufferSize);
-
     /* Is the Data Buffer successfully programmed to SPI Flash memory */
-    if (0 == memcmp(writeBuffer, readBuffer, bufferSize))
+    bool verified = FLASH_Verify(pBuffer, address, bufferSize);
+    if (verified)
     {
         External_Flash_Address += bufferSize;
         Flash_Update_Index += 1;
+
+        /* Keep one sector erased ahead of the chunks, the erase runs while
+         * the next chunk is on its way */
+        if (External_Flash_Erase_Address < External_Flash_End_Address &&
+            External_Flash_Erase_Address < chunkEnd + sFLASH_PAGESIZE)
+        {
+            sFLASH_EraseSectorStart(External_Flash_Erase_Address);
+            External_Flash_Erase_Address += sFLASH_PAGESIZE;
+        }
     }
     else
     {
@@ -222,7 +282,7 @@ uint16_t FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t bufferS
         sFLASH_EraseSector(External_Flash_Address);
         Flash_Update_Index = (uint16_t)((External_Flash_Address - External_Flash_Start_Address) / bufferSize);
     }
-    return Flash_Update_Index;
+    return verified;
 }
 
 void FLASH_End(void)
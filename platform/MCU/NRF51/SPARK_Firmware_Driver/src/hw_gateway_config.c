@@ -28,6 +28,8 @@
 #include "nrf_delay.h"
 #include "data_management_layer.h"
 #include "registered_data_services.h"
+#include "block_pool.h"
+#include "app_util_platform.h"
 
 #include "debug.h"
 
@@ -39,14 +41,27 @@ bool m_memory_access_in_progress = false;
 ble_gap_conn_params_t m_connection_param;
 
 //Buffers needed for callbacks from SPI and BLE events, this is where data passes through
-uint8_t spi_slave_tx_buffer[SPI_SLAVE_TX_BUF_SIZE];
-volatile uint16_t spi_slave_tx_buffer_size;
-volatile uint16_t spi_slave_tx_buffer_start;
+//data going up to the Photon is queued directly by the SPI slave stream
+//data coming down is split into a queue of messages per client, the messages are held in buffers
+//taken from one shared pool so a client that has fallen behind doesn't hold up the others
+typedef struct
+{
+    uint8_t *   p_message;                                                      /**< Whole SPI message, header included. */
+    uint16_t    length;
+} downlink_message_t;
 
+//single producer/single consumer: spi_slave_rx_data only advances head, gateway_loop only tail
+typedef struct
+{
+    downlink_message_t  messages[DOWNLINK_QUEUE_DEPTH];
+    volatile uint8_t    head;
+    volatile uint8_t    tail;
+    downlink_stats_t    stats;
+} downlink_queue_t;
 
-uint8_t spi_slave_rx_buffer[SPI_SLAVE_RX_BUF_SIZE];
-volatile uint16_t spi_slave_rx_buffer_size;
-volatile uint16_t spi_slave_rx_buffer_start;
+static uint8_t          m_downlink_pool_memory[DOWNLINK_POOL_BLOCK_SIZE * DOWNLINK_POOL_BLOCK_COUNT];
+static block_pool_t     m_downlink_pool;
+static downlink_queue_t m_downlink[MAX_CLIENTS];
 
 uint8_t info_data_service_buffer_size;
 uint8_t info_data_service_buffer[INFO_DATA_SERVICE_BUF_SIZE];
@@ -110,11 +125,9 @@ void gateway_init(void)
     connectionErrors = 0;
     m_peer_count = 0;
     m_memory_access_in_progress = false;
-    spi_slave_tx_buffer_size = 0;
-    spi_slave_tx_buffer_start = 0;
-    
-    spi_slave_rx_buffer_size = 0;
-    spi_slave_rx_buffer_start = 0;
+
+    block_pool_init(&m_downlink_pool, m_downlink_pool_memory, DOWNLINK_POOL_BLOCK_SIZE, DOWNLINK_POOL_BLOCK_COUNT);
+    memset(m_downlink, 0, sizeof(m_downlink));
 
     info_data_service_buffer_size = 0;
     
@@ -144,66 +157,126 @@ void gateway_scan_start(void)
     state = BLE_SCANNING;
 }
 
-//interrupt driven function to put data into buffers for process in gateway_loop
-void spi_slave_tx_data(uint8_t* tx_buffer, uint16_t size)
+//interrupt driven function to queue data from a client for the Photon, sent without waiting for gateway_loop
+uint32_t spi_slave_tx_data(uint8_t* tx_buffer, uint16_t size)
 {
-    if (spi_slave_tx_buffer_start+spi_slave_tx_buffer_size+size <= SPI_SLAVE_TX_BUF_SIZE) {
-        memcpy(spi_slave_tx_buffer+spi_slave_tx_buffer_start+spi_slave_tx_buffer_size, tx_buffer, size);
-        spi_slave_tx_buffer_size += size;
+    return spi_slave_send_data(tx_buffer, size);
+}
+
+//called from the SPI slave event. the Photon relay has no flow control towards the gateway, so a message that
+//doesn't fit the client's queue or the pool is dropped and counted, the cloud has to keep its window within the pool
+static void downlink_queue_message(uint8_t id, uint8_t *message, uint16_t length)
+{
+    downlink_queue_t * p_queue = &m_downlink[id];
+    uint8_t head = p_queue->head;
+    uint8_t depth = (uint8_t)(head - p_queue->tail);
+    uint8_t * p_buffer = NULL;
+
+    if (depth < DOWNLINK_QUEUE_DEPTH) {
+        p_buffer = block_pool_alloc(&m_downlink_pool, length);
+    }
+    if (p_buffer == NULL) {
+        p_queue->stats.dropped_messages++;
+        return;
+    }
+
+    memcpy(p_buffer, message, length);
+    downlink_message_t * p_slot = &p_queue->messages[head & (DOWNLINK_QUEUE_DEPTH-1)];
+    p_slot->p_message = p_buffer;
+    p_slot->length = length;
+    //the message must be in place before gateway_loop can see it
+    __DMB();
+    p_queue->head = head + 1;
+
+    if (depth + 1 > p_queue->stats.queue_peak) {
+        p_queue->stats.queue_peak = depth + 1;
     }
 }
 
+//called from the SPI slave event with each transfer, which holds one or more whole messages
 void spi_slave_rx_data(uint8_t *rx_buffer, uint16_t size)
 {
-    //this data is for the gateways cloud connection
-    //hack - set the third byte to the socket ID, which is always 0 for now
-    //then send only the data starting at the third byte, which is 1 byte longer than the length reported
-    if (rx_buffer[2] == GATEWAY_ID) {
-        int serviceID = rx_buffer[3];
-        int length = (rx_buffer[0] << 8) | rx_buffer[1];
-        if (serviceID == INFO_DATA_SERVICE) {
-            info_data_service_buffer_size = length;
-            memcpy(info_data_service_buffer, rx_buffer, size);
-        } else {
-            dataManagementFeedData(length + BLE_HEADER_SIZE, rx_buffer + SPI_HEADER_SIZE);
+    uint16_t offset = 0;
+
+    while (size - offset >= SPI_HEADER_SIZE) {
+        uint8_t * message = rx_buffer + offset;
+        int length = (message[0] << 8) | message[1];
+        int id = message[2];
+        uint16_t messageLength = SPI_HEADER_SIZE + BLE_HEADER_SIZE + length;
+        if (messageLength > size - offset) {
+            //a message is never split between transfers, so this is garbage
+            break;
         }
-    } else {
-        if (spi_slave_rx_buffer_start+spi_slave_rx_buffer_size+size <= SPI_SLAVE_RX_BUF_SIZE) {
-            memcpy(spi_slave_rx_buffer+spi_slave_rx_buffer_start+spi_slave_rx_buffer_size, rx_buffer, size);
-            spi_slave_rx_buffer_size += size;
+
+        if (id == GATEWAY_ID) {
+            //this data is for the gateways cloud connection
+            int serviceID = message[3];
+            if (serviceID == INFO_DATA_SERVICE) {
+                if (messageLength <= INFO_DATA_SERVICE_BUF_SIZE) {
+                    info_data_service_buffer_size = length;
+                    memcpy(info_data_service_buffer, message, messageLength);
+                }
+            } else {
+                dataManagementFeedData(length + BLE_HEADER_SIZE, message + SPI_HEADER_SIZE);
+            }
+        } else if (id < MAX_CLIENTS) {
+            downlink_queue_message(id, message, messageLength);
         }
+        offset += messageLength;
     }
 }
 
-//needs to be called in the main loop to process data through the gateway
-void gateway_loop(void)
+//hands each client its waiting messages, one that can't take any more right now is left for the next loop
+static void downlink_dispatch(void)
 {
-    if (spi_slave_rx_buffer_size > 0) {
-        int id = spi_slave_rx_buffer[2];
-        int bytesRx = spi_slave_rx_buffer_size;
-        DEBUG("Starting!");
-        if (id < MAX_CLIENTS) {
-            DEBUG("Sending down data of size %d on id %d", spi_slave_rx_buffer_size, id);
-            //this data is for one of the connected bluz DK boards
-            client_send_data(spi_slave_rx_buffer + spi_slave_rx_buffer_start, bytesRx);
-            spi_slave_rx_buffer_size -= bytesRx;
-            spi_slave_rx_buffer_start += bytesRx;
-            if (spi_slave_rx_buffer_size == 0) {
-                spi_slave_rx_buffer_start = 0;
+    for (int id = 0; id < MAX_CLIENTS; id++) {
+        downlink_queue_t * p_queue = &m_downlink[id];
+
+        while (p_queue->tail != p_queue->head) {
+            //don't read the message before the new head
+            __DMB();
+            downlink_message_t * p_slot = &p_queue->messages[p_queue->tail & (DOWNLINK_QUEUE_DEPTH-1)];
+            uint16_t dropped;
+            if (client_send_data(p_slot->p_message, p_slot->length, &dropped) != p_slot->length) {
+                break;
+            }
+            if (dropped > 0) {
+                //taken off the queue all the same, the client is gone or the message can never fit
+                p_queue->stats.dropped_messages += dropped;
+            } else {
+                DEBUG("Sent down data of size %d on id %d", p_slot->length, id);
+                p_queue->stats.bytes += p_slot->length - SPI_HEADER_SIZE;
+                p_queue->stats.messages++;
             }
+
+            CRITICAL_REGION_ENTER();
+            block_pool_free(&m_downlink_pool, p_slot->p_message, p_slot->length);
+            CRITICAL_REGION_EXIT();
+            p_queue->tail++;
         }
     }
-    
-    if (spi_slave_tx_buffer_size > 0) {
-        int bytesTx = spi_slave_tx_buffer_size;
-        spi_slave_send_data(spi_slave_tx_buffer+spi_slave_tx_buffer_start, bytesTx);
-
-        spi_slave_tx_buffer_size -= bytesTx;
-        spi_slave_tx_buffer_start += bytesTx;
-        if (spi_slave_tx_buffer_size == 0) {
-            spi_slave_tx_buffer_start = 0;
-        }
+}
+
+void gateway_downlink_stats(downlink_stats_t * p_stats, uint8_t * p_pool_peak, uint16_t * p_pool_failures)
+{
+    for (int id = 0; id < MAX_CLIENTS; id++) {
+        p_stats[id] = m_downlink[id].stats;
+        p_stats[id].queue_depth = (uint8_t)(m_downlink[id].head - m_downlink[id].tail);
     }
+    *p_pool_peak = m_downlink_pool.blocks_peak;
+    *p_pool_failures = m_downlink_pool.alloc_failures;
+}
+
+//needs to be called in the main loop to process data through the gateway
+void gateway_loop(void)
+{
+    downlink_dispatch();
+
+    //start sending queued data once the Photon is ready for it
+    spi_slave_stream_process();
+
+    //make room for a waiting peripheral if one has been connected long enough
+    client_handling_rotate();
 
     if (info_data_service_buffer_size > 0) {
         int length = (info_data_service_buffer[0] << 8) | info_data_service_buffer[1];
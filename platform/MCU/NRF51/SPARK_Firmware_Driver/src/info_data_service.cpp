@@ -46,6 +46,21 @@ struct ConnInterval {
     uint8_t set;
 };
 
+#if PLATFORM_ID==269
+static uint8_t* put_uint16(uint8_t *p, uint16_t value)
+{
+    *p++ = (value >> 8) & 0xFF;
+    *p++ = value & 0xFF;
+    return p;
+}
+
+static uint8_t* put_uint32(uint8_t *p, uint32_t value)
+{
+    p = put_uint16(p, value >> 16);
+    return put_uint16(p, value & 0xFFFF);
+}
+#endif
+
 //DataService functions
 int32_t InfoDataService::getServiceID()
 {
@@ -104,6 +119,55 @@ int32_t InfoDataService::DataCallback(uint8_t *data, int16_t length)
 
             break;
         }
+        case POLL_STATISTICS: {
+            client_stats_t stats[MAX_CLIENTS];
+            gateway_stats_t gatewayStats;
+            client_handling_stats(stats, &gatewayStats);
+
+            //<throughput:4><pool peak:1><pool failures:2> then per client <connected:1><bytes:4><messages:2><dropped:2><avg latency:2><max latency:2>
+            uint8_t rsp[2 + 7 + MAX_CLIENTS*13];
+            uint8_t *p = rsp;
+            *p++ = INFO_DATA_SERVICE & 0xFF;
+            *p++ = STATISTICS_RESULTS & 0xFF;
+            p = put_uint32(p, gatewayStats.uplink_throughput);
+            *p++ = gatewayStats.pool_blocks_peak;
+            p = put_uint16(p, gatewayStats.pool_alloc_failures);
+            for (int i = 0; i < MAX_CLIENTS; i++) {
+                *p++ = stats[i].connected;
+                p = put_uint32(p, stats[i].uplink_bytes);
+                p = put_uint16(p, stats[i].uplink_messages);
+                p = put_uint16(p, stats[i].dropped_messages);
+                p = put_uint16(p, stats[i].latency_avg);
+                p = put_uint16(p, stats[i].latency_max);
+            }
+
+            DataManagementLayer::sendData(rsp, 2, rsp + 2, sizeof(rsp) - 2);
+            break;
+        }
+        case POLL_DOWNLINK_STATISTICS: {
+            downlink_stats_t stats[MAX_CLIENTS];
+            uint8_t poolPeak;
+            uint16_t poolFailures;
+            gateway_downlink_stats(stats, &poolPeak, &poolFailures);
+
+            //<pool peak:1><pool failures:2> then per client <bytes:4><messages:2><dropped:2><queue depth:1><queue peak:1>
+            uint8_t rsp[2 + 3 + MAX_CLIENTS*10];
+            uint8_t *p = rsp;
+            *p++ = INFO_DATA_SERVICE & 0xFF;
+            *p++ = DOWNLINK_STATISTICS_RESULTS & 0xFF;
+            *p++ = poolPeak;
+            p = put_uint16(p, poolFailures);
+            for (int i = 0; i < MAX_CLIENTS; i++) {
+                p = put_uint32(p, stats[i].bytes);
+                p = put_uint16(p, stats[i].messages);
+                p = put_uint16(p, stats[i].dropped_messages);
+                *p++ = stats[i].queue_depth;
+                *p++ = stats[i].queue_peak;
+            }
+
+            DataManagementLayer::sendData(rsp, 2, rsp + 2, sizeof(rsp) - 2);
+            break;
+        }
 #endif
     }
     return 1;
@@ -197,8 +197,16 @@ void on_ble_evt(ble_evt_t * p_ble_evt)
             
             // Verify if short or complete name matches target.
             char* target = get_gateway_target_name();
-            if ((err_code == NRF_SUCCESS) &&
-                (0 == memcmp(target,type_data.p_data,type_data.data_len)) &&
+            bool isTarget = (err_code == NRF_SUCCESS) &&
+                            (0 == memcmp(target,type_data.p_data,type_data.data_len)) &&
+                            !client_handling_recently_rotated(&p_ble_evt->evt.gap_evt.params.adv_report.peer_addr);
+
+            if (isTarget && m_peer_count >= MAX_CLIENTS)
+            {
+                //only seen while rotating connections, this one has to wait for a free link
+                client_handling_peer_waiting();
+            }
+            else if (isTarget &&
 //                isCloudConnected &&
                 !isCloudUpdating &&
                 system_millis() - lastConnectionTime > TIME_BETWEEN_CONNECTIONS)
@@ -351,10 +359,12 @@ uint32_t device_manager_evt_handler(dm_handle_t const    * p_handle,
 #if PLATFORM_ID==269
         uint32_t  err_code;
         case DM_EVT_CONNECTION:
-            err_code = client_handling_create(p_handle, p_event->event_param.p_gap_param->conn_handle);
+            err_code = client_handling_create(p_handle, p_event->event_param.p_gap_param->conn_handle,
+                                              &p_event->event_param.p_gap_param->params.connected.peer_addr);
             APP_ERROR_CHECK(err_code);
             m_peer_count++;
-            if (m_peer_count < MAX_CLIENTS)
+            //with rotation on, keep scanning to see whether other peripherals are waiting for a link
+            if (m_peer_count < MAX_CLIENTS || CONNECTION_ROTATION_TIME > 0)
             {
                 gateway_scan_start();
             }
@@ -365,7 +375,7 @@ uint32_t device_manager_evt_handler(dm_handle_t const    * p_handle,
             err_code = client_handling_destroy(p_handle);
             APP_ERROR_CHECK(err_code);
 
-            if (m_peer_count == MAX_CLIENTS)
+            if (m_peer_count == MAX_CLIENTS && CONNECTION_ROTATION_TIME == 0)
             {
                 gateway_scan_start();
             }
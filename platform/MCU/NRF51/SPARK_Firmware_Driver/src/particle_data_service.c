@@ -22,3 +22,8 @@ void particle_service_send_data(uint8_t* data, uint16_t len)
 {
     scs_data_send(&m_scs, data, len);
 }
+
+uint32_t particle_service_send_data_iov(const data_iovec_t* iov, uint8_t iovcnt)
+{
+    return scs_data_send_iov(&m_scs, iov, iovcnt);
+}
@@ -19,15 +19,16 @@
 #include "data_management_layer.h"
 #include "debug.h"
 #include "registered_data_services.h"
+#include "nrf.h"
+#include "nrf_error.h"
 #include <cstring>
 #include <stdio.h>
 
-Socket::Socket() { id=-1;inUse=false; bufferLength=0;bufferStart=0; }
+Socket::Socket() { id=-1;inUse=false; }
 
 int32_t Socket::init(uint8_t family, uint8_t type, uint8_t protocol, uint16_t port, uint32_t nif)
 {
-    bufferLength=0;
-    bufferStart=0;
+    rx.clear();
     inUse = true;
     this->family = family;
     this->type = type;
@@ -72,53 +73,42 @@ int32_t Socket::connect(uint32_t sockid, const sockaddr_b *addr, long addrlen)
 }
 int32_t Socket::send(const void* data, uint32_t len)
 {
-    int offset = 0;
-#if PLATFORM_ID==269
-    offset = 3;
-#endif
-
     DEBUG("Sending on socket %d data of size %d!", id, len);
-    uint8_t dataPlusID[len+2+offset];
-    dataPlusID[0+offset] = SOCKET_DATA_SERVICE & 0xFF;
-    dataPlusID[1+offset] = ((SOCKET_DATA << 4) & 0xF0) | (id & 0x0F);
-    
-    memcpy(dataPlusID+2+offset, data, len);
-    
-//    uint8_t dataPlusID[len];
-//    memcpy(dataPlusID, data, len);
-    
-    DataManagementLayer::sendData(len+2+offset, dataPlusID);
+    uint8_t header[2];
+    header[0] = SOCKET_DATA_SERVICE & 0xFF;
+    header[1] = ((SOCKET_DATA << 4) & 0xF0) | (id & 0x0F);
+
+    //the payload goes down to the transport as is, without being copied behind the header
+    uint32_t err_code = DataManagementLayer::sendData(header, sizeof(header), (const uint8_t*)data, len);
+    if (err_code == NRF_ERROR_NO_MEM) {
+        //the whole message was turned away, nothing went out, so it can be offered again
+        return 0;
+    }
+    if (err_code != NRF_SUCCESS) {
+        return -1;
+    }
     return len;
 }
 int32_t Socket::receive(void* data, uint32_t len, unsigned long _timeout)
 {
-    if (bufferLength > 0) {
-        DEBUG("RX ASK: %d  AVAIL: %d", len, bufferLength);
+    uint16_t available = used();
+    if (available > 0) {
+        DEBUG("RX ASK: %d  AVAIL: %d", len, available);
     } else {
         return 0;
     }
     
-    int bytesToCopy = len;
-    if (len > bufferLength) {
-        //they are asking for too much data
-        bytesToCopy = bufferLength;
-    }
-    
-    memcpy(data, buffer+bufferStart, bytesToCopy);
-    bufferStart += bytesToCopy;
-    bufferLength -= bytesToCopy;
-    
-    if (bufferLength == 0) {
-        bufferStart = 0;
-    }
+    //at most what is available, when they ask for more
+    uint16_t bytesToCopy = rx.pop((uint8_t*)data, len);
 
     return bytesToCopy;
 }
 int32_t Socket::close()
 {
-    bufferLength=0;
-    bufferStart=0;
+    //stop feed() from touching the ring before it is reset
     inUse = false;
+    __DMB();
+    rx.clear();
 //    uint8_t data[2];
 //    data[0] = SOCKET_DATA_SERVICE & 0xFF;
 //    data[1] = (SOCKET_DISCONNECT & 0xF0) | (id & 0x0F);
@@ -129,20 +119,20 @@ int32_t Socket::close()
 
 int32_t Socket::bytes_available()
 {
-    return bufferLength;
+    return used();
 }
 
 int32_t Socket::feed(uint8_t* data, uint32_t len)
 {
-    if (bufferLength+len > SOCKET_BUFFER_SIZE) {
-        //can't put all this data in.
+    if (!len) {
+        return 0;
+    }
+    if (rx.push(data, len, true) != len) {
+        //can't put all this data in, the other end sent more than the socket can hold
         return -1;
     }
-    
-    memcpy(buffer+bufferStart+bufferLength, data, len);
-    bufferLength+=len;
 
-//    DEBUG("Fed %d bytes to socket id %d, leaving it with %d bytes", len, id, bufferLength);
+//    DEBUG("Fed %d bytes to socket id %d, leaving it with %d bytes", len, id, used());
 
     return 0;
 }
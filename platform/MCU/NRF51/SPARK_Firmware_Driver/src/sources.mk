@@ -26,6 +26,7 @@ ifeq ("$(PLATFORM_ID)","269")
 CSRC += $(TARGET_SPARK_SRC_PATH)/hw_gateway_config.c
 CSRC += $(TARGET_SPARK_SRC_PATH)/spi_slave_stream.c
 CSRC += $(TARGET_SPARK_SRC_PATH)/client_handling.c
+CSRC += $(TARGET_SPARK_SRC_PATH)/block_pool.c
 endif
 
 
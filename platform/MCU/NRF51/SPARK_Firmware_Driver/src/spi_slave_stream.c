@@ -4,10 +4,31 @@
 #include "spi_slave_stream.h"
 #include "spi_slave.h"
 #include "nrf_delay.h"
+#include "app_util_platform.h"
+#include "spsc_ring.h"
 
 #include "debug.h"
 
-volatile bool busy;
+/**@brief States of the transmission to the SPI master. */
+typedef enum
+{
+    TX_IDLE,                /**< Nothing being sent. */
+    TX_WAIT_MASTER,         /**< PTS raised, waiting for the master to be ready. */
+    TX_XFER,                /**< A chunk is in m_tx_buf and SA is raised, waiting for the master to clock it out. */
+    TX_SET_BUFFERS          /**< Chunk sent, waiting for the SPI slave buffers to be set again. */
+} tx_state_t;
+
+volatile bool buffers_set;
+volatile tx_state_t tx_state;
+
+//packets waiting to be sent, as one contiguous byte stream. they are pushed by whoever sends,
+//taking turns in a critical region, and popped by the SPI slave event handler
+static uint8_t tx_queue_memory[SPI_SLAVE_TX_QUEUE_SIZE];
+static spsc_byte_ring_t tx_queue;
+
+//bytes left to send in the current burst
+static uint16_t tx_burst_remaining;
+
 uint8_t m_tx_buf[SPI_SLAVE_HW_TX_BUF_SIZE];   /**< SPI TX buffer. */
 uint8_t m_rx_buf[SPI_SLAVE_HW_RX_BUF_SIZE];   /**< SPI RX buffer. */
 
@@ -29,36 +50,96 @@ void ble_radio_ntf_handler(bool radio_state)
 //	}
 }
 
-/**@brief Function to set the tx buffer for next transaction.
+/**@brief Function for starting a burst when there is queued data.
  *
- * This will fill the tx buffer with data that will be sent to the master on the next transaction.
+ * Raises PTS to let the Photon know we want to transmit, and once it raised MR,
+ * sends the size of the burst. Everything queued at that point goes out in this burst.
+ */
+static void tx_start_if_ready(void)
+{
+    if (tx_state == TX_IDLE && spsc_byte_ring_size(&tx_queue) > 0) {
+        //let the Photon know we are about to transmit
+        nrf_gpio_pin_set(SPIS_PTS_PIN);
+        tx_state = TX_WAIT_MASTER;
+    }
+
+    if (tx_state == TX_WAIT_MASTER && nrf_gpio_pin_read(SPIS_MR_PIN) != 0) {
+        tx_burst_remaining = spsc_byte_ring_size(&tx_queue);
+
+        //send the size of the data first, the chunks follow from the event handler
+        m_tx_buf[0] = (( (tx_burst_remaining) & 0xFF00) >> 8);
+        m_tx_buf[1] = ( (tx_burst_remaining) & 0xFF);
+        tx_state = TX_XFER;
+        nrf_gpio_pin_set(SPIS_SA_PIN);
+    }
+}
+
+/**@brief Function for moving on to the next chunk of the burst once the buffers are set again.
+ */
+static void tx_next_chunk(void)
+{
+    if (tx_burst_remaining > 0) {
+        uint16_t chunkLength = (tx_burst_remaining > SPI_SLAVE_HW_TX_BUF_SIZE ? SPI_SLAVE_HW_TX_BUF_SIZE : tx_burst_remaining);
+        spsc_byte_ring_pop(&tx_queue, m_tx_buf, chunkLength);
+        tx_burst_remaining -= chunkLength;
+
+        //alert the particle board we have data to send
+        tx_state = TX_XFER;
+        nrf_gpio_pin_set(SPIS_SA_PIN);
+    } else {
+        //burst is done, start the next one right away if more packets were queued meanwhile
+        tx_state = TX_IDLE;
+        tx_start_if_ready();
+    }
+}
+
+/**@brief Function to queue data for the master.
  *
- * @param[in] data buffer
- * @param[in] data buffer
+ * This copies the data into the TX queue and returns. The data is clocked out
+ * by the master in chunks of up to SPI_SLAVE_HW_TX_BUF_SIZE, driven by the SPI slave events.
+ *
+ * @param[in] buf   data buffer
+ * @param[in] size  size of the data buffer
  */
-void spi_slave_send_data(uint8_t *buf, uint16_t size)
+uint32_t spi_slave_send_data(const uint8_t *buf, uint16_t size)
 {
-	//let the Photon know we are about to transmit
-	nrf_gpio_pin_set(SPIS_PTS_PIN);
-
-	while (nrf_gpio_pin_read(SPIS_MR_PIN) == 0) { }
-
-	//now let's send the size of the data first
-	m_tx_buf[0] = (( (size) & 0xFF00) >> 8);
-	m_tx_buf[1] = ( (size) & 0xFF);
-	busy = true;
-	nrf_gpio_pin_set(SPIS_SA_PIN);
-	while (busy) { }
-
-	//now lets send the data one chunk at a time
-	for (int i = 0; i < size; i+=SPI_SLAVE_HW_TX_BUF_SIZE) {
-		uint16_t chunkLength = (size-i > SPI_SLAVE_HW_TX_BUF_SIZE ? SPI_SLAVE_HW_TX_BUF_SIZE : size-i);
-		memcpy(m_tx_buf, buf+i, chunkLength);
-		//alert the particle board we have data to send
-		busy = true;
-		nrf_gpio_pin_set(SPIS_SA_PIN);
-		while (busy) { }
-	}
+    data_iovec_t iov = { buf, size };
+    return spi_slave_send_data_iov(&iov, 1);
+}
+
+/**@brief Function to queue a packet made of several buffers for the master.
+ *
+ * The whole packet is queued or nothing is, so packets from different contexts never interleave.
+ *
+ * @param[in] p_iov   buffers making up the packet
+ * @param[in] iovcnt  number of buffers
+ */
+uint32_t spi_slave_send_data_iov(const data_iovec_t *p_iov, uint8_t iovcnt)
+{
+    uint32_t err_code = NRF_SUCCESS;
+    uint16_t size = data_iovec_length(p_iov, iovcnt);
+
+    CRITICAL_REGION_ENTER();
+    if (spsc_byte_ring_space(&tx_queue) < size) {
+        err_code = NRF_ERROR_NO_MEM;
+    } else {
+        for (uint8_t i = 0; i < iovcnt; i++) {
+            spsc_byte_ring_push(&tx_queue, p_iov[i].p_data, p_iov[i].data_len, true);
+        }
+        tx_start_if_ready();
+    }
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+void spi_slave_stream_process(void)
+{
+    if (tx_state == TX_WAIT_MASTER) {
+        CRITICAL_REGION_ENTER();
+        tx_start_if_ready();
+        CRITICAL_REGION_EXIT();
+    }
 }
 
 /**@brief Function for SPI slave event callback.
@@ -71,9 +152,10 @@ static void spi_slave_event_handle(spi_slave_evt_t event)
 {
     if (event.evt_type == SPI_SLAVE_XFER_DONE)
     {
-    	if (busy) {
+    	if (tx_state == TX_XFER) {
     		nrf_gpio_pin_clear(SPIS_SA_PIN);
 			nrf_gpio_pin_clear(SPIS_PTS_PIN);
+			tx_state = TX_SET_BUFFERS;
     	} else {
 			if (event.rx_amount == 255) {
 				memcpy(buf+currentSPISlaveBufferSize, m_rx_buf, 254);
@@ -88,8 +170,9 @@ static void spi_slave_event_handle(spi_slave_evt_t event)
 		//Set buffers.
 		spi_slave_buffers_set(m_tx_buf, m_rx_buf, SPI_SLAVE_HW_TX_BUF_SIZE, SPI_SLAVE_HW_RX_BUF_SIZE);
     } else if (event.evt_type == SPI_SLAVE_BUFFERS_SET_DONE) {
-		if (busy) {
-			busy = false;
+		buffers_set = true;
+		if (tx_state == TX_SET_BUFFERS) {
+			tx_next_chunk();
 		}
     } else if (event.evt_type == SPI_SLAVE_RESOURCE_HELD) {
     }
@@ -114,7 +197,9 @@ uint32_t spi_slave_stream_init(void (*a)(uint8_t *m_tx_buf, uint16_t size))
 	APP_ERROR_CHECK(err_code);
 
     rx_callback = a;
-	busy = false;
+	tx_state = TX_IDLE;
+	spsc_byte_ring_init(&tx_queue, tx_queue_memory, sizeof(tx_queue_memory));
+	tx_burst_remaining = 0;
 
 	spi_slave_set_cs_pull_up_config(NRF_GPIO_PIN_PULLUP);
 
@@ -134,12 +219,12 @@ uint32_t spi_slave_stream_init(void (*a)(uint8_t *m_tx_buf, uint16_t size))
     APP_ERROR_CHECK(err_code);
 
     //Set buffers.
-	busy = true;
+	buffers_set = false;
     err_code = spi_slave_buffers_set(m_tx_buf, m_rx_buf, sizeof(m_tx_buf), sizeof(m_rx_buf));
     APP_ERROR_CHECK(err_code);
 
 	//wait for the buffers to get set, otherwise we can cause weird race conditions
-	while (busy) { }
+	while (!buffers_set) { }
 
 
     return NRF_SUCCESS;
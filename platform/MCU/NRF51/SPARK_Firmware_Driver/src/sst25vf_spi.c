@@ -31,15 +31,23 @@
 #include "nrf_error.h"
 #include "nrf_delay.h"
 #include "app_util_platform.h"
+#include <stddef.h>
 
 /* Local function forward declarations ---------------------------------------*/
 static void sFLASH_WriteByte(uint32_t WriteAddr, uint8_t byte);
 static void sFLASH_WriteBytes(const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite);
 static void sFLASH_WriteEnable(void);
 static void sFLASH_WriteDisable(void);
-static uint8_t sFLASH_SendByte(uint8_t byte);\
+static uint8_t sFLASH_SendByte(uint8_t byte);
+static void sFLASH_SendCommand(uint8_t cmd, uint32_t Addr);
+static void sFLASH_Transfer(const uint8_t *pTx, uint16_t TxLength, uint8_t *pRx, uint16_t RxLength);
 static void sFLASH_CS_LOW(void);
 static void sFLASH_CS_HIGH(void);
+static void sFLASH_WaitForErase(void);
+static void sFLASH_WaitForAAIWord(void);
+
+/* a sector erase was started by sFLASH_EraseSectorStart and not waited for yet */
+static volatile bool sFLASH_ErasePending = false;
 
 static uint8_t tx_data[TX_RX_MSG_LENGTH]; /**< SPI TX buffer. */
 static uint8_t rx_data[TX_RX_MSG_LENGTH]; /**< SPI RX buffer. */
@@ -125,24 +133,34 @@ void sFLASH_Init(void)
   */
 void sFLASH_EraseSector(uint32_t SectorAddr)
 {
+  sFLASH_EraseSectorStart(SectorAddr);
+  /* Wait for the busy status to clear */
+  sFLASH_WaitForErase();
+}
+
+/**
+  * @brief  Starts erasing the specified FLASH sector without waiting for it.
+  * @note   The next call that accesses the FLASH waits for the erase to end,
+  *         so the caller can get on with other work meanwhile.
+  * @param  SectorAddr: address of the sector to erase.
+  * @retval None
+  */
+void sFLASH_EraseSectorStart(uint32_t SectorAddr)
+{
+  sFLASH_WaitForErase();
+
   /* Enable the write access to the FLASH */
   sFLASH_WriteEnable();
 
   /* Sector Erase */
   /* Select the FLASH: Chip Select low */
   sFLASH_CS_LOW();
-  /* Send Sector Erase instruction */
-  sFLASH_SendByte(sFLASH_CMD_SE);
-  /* Send SectorAddr high nibble address byte */
-  sFLASH_SendByte((SectorAddr & 0xFF0000) >> 16);
-  /* Send SectorAddr medium nibble address byte */
-  sFLASH_SendByte((SectorAddr & 0xFF00) >> 8);
-  /* Send SectorAddr low nibble address byte */
-  sFLASH_SendByte(SectorAddr & 0xFF);
+  /* Send Sector Erase instruction and SectorAddr */
+  sFLASH_SendCommand(sFLASH_CMD_SE, SectorAddr);
   /* Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
-  /* Wait for the busy status to clear */
-  sFLASH_WaitForWriteEnd();
+
+  sFLASH_ErasePending = true;
 }
 
 /**
@@ -152,6 +170,8 @@ void sFLASH_EraseSector(uint32_t SectorAddr)
   */
 void sFLASH_EraseBulk(void)
 {
+  sFLASH_WaitForErase();
+
   /* Enable the write access to the FLASH */
   sFLASH_WriteEnable();
 
@@ -178,18 +198,18 @@ static void sFLASH_WriteByte(uint32_t WriteAddr, uint8_t byte)
   /* Enable the write access to the FLASH */
   sFLASH_WriteEnable();
 
+  uint8_t command[5] = {
+    sFLASH_CMD_WRITE,
+    (WriteAddr & 0xFF0000) >> 16,
+    (WriteAddr & 0xFF00) >> 8,
+    WriteAddr & 0xFF,
+    byte
+  };
+
   /* Select the FLASH: Chip Select low */
   sFLASH_CS_LOW();
-  /* Send "Byte Program" instruction */
-  sFLASH_SendByte(sFLASH_CMD_WRITE);
-  /* Send WriteAddr high nibble address byte to write to */
-  sFLASH_SendByte((WriteAddr & 0xFF0000) >> 16);
-  /* Send WriteAddr medium nibble address byte to write to */
-  sFLASH_SendByte((WriteAddr & 0xFF00) >> 8);
-  /* Send WriteAddr low nibble address byte to write to */
-  sFLASH_SendByte(WriteAddr & 0xFF);
-  /* Send the byte */
-  sFLASH_SendByte(byte);
+  /* Send "Byte Program" instruction, WriteAddr and the byte in one transfer */
+  sFLASH_Transfer(command, sizeof(command), NULL, 0);
   /* Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
   /* Wait for the busy status to clear */
@@ -209,54 +229,68 @@ static void sFLASH_WriteByte(uint32_t WriteAddr, uint8_t byte)
   */
 static void sFLASH_WriteBytes(const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t NumByteToWrite)
 {
+  /* The SST25VF programs each AAI word when CS goes high, so the words can't
+   * share a CS assertion. What can go is the status register round trip after
+   * each word: with EBSY the FLASH shows busy on SO whenever CS is low, and
+   * sFLASH_WaitForAAIWord reads that straight off the MISO pin. */
+  uint8_t command[6] = {
+    sFLASH_CMD_AAIP,
+    (WriteAddr & 0xFF0000) >> 16,
+    (WriteAddr & 0xFF00) >> 8,
+    WriteAddr & 0xFF,
+    pBuffer[0],
+    pBuffer[1]
+  };
+  pBuffer += 2;
+
+  /* Select the FLASH: Chip Select low */
+  sFLASH_CS_LOW();
+  /* Send "Enable SO RY/BY# Status" instruction */
+  sFLASH_SendByte(sFLASH_CMD_EBSY);
+  /* Deselect the FLASH: Chip Select high */
+  sFLASH_CS_HIGH();
+
   /* Enable the write access to the FLASH */
   sFLASH_WriteEnable();
 
   /* Select the FLASH: Chip Select low */
   sFLASH_CS_LOW();
-  /* Send "Auto Address Increment Word-Program" instruction */
-  sFLASH_SendByte(sFLASH_CMD_AAIP);
-  /* Send WriteAddr high nibble address byte to write to */
-  sFLASH_SendByte((WriteAddr & 0xFF0000) >> 16);
-  /* Send WriteAddr medium nibble address byte to write to */
-  sFLASH_SendByte((WriteAddr & 0xFF00) >> 8);
-  /* Send WriteAddr low nibble address byte to write to */
-  sFLASH_SendByte(WriteAddr & 0xFF);
-  /* Send the first byte */
-  sFLASH_SendByte(*pBuffer++);
-  /* Send the second byte */
-  sFLASH_SendByte(*pBuffer++);
+  /* Send "Auto Address Increment Word-Program" instruction, WriteAddr and the first word */
+  sFLASH_Transfer(command, sizeof(command), NULL, 0);
   /* Update NumByteToWrite */
   NumByteToWrite -= 2;
   /* Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
-  /* Wait for the busy status to clear */
-  sFLASH_WaitForWriteEnd();
+  /* Wait for SO to show ready */
+  sFLASH_WaitForAAIWord();
 
   /* while there is data to be written on the FLASH */
   while (NumByteToWrite)
   {
-	/* Select the FLASH: Chip Select low */
-	sFLASH_CS_LOW();
-	/* Send "Auto Address Increment Word-Program" instruction */
-	sFLASH_SendByte(sFLASH_CMD_AAIP);
-    /* Send the next byte and point on the next byte */
-    sFLASH_SendByte(*pBuffer++);
-    /* Send the next byte and point on the next byte */
-    sFLASH_SendByte(*pBuffer++);
+    command[1] = *pBuffer++;
+    command[2] = *pBuffer++;
+
+    /* Select the FLASH: Chip Select low */
+    sFLASH_CS_LOW();
+    /* Send "Auto Address Increment Word-Program" instruction and the next word */
+    sFLASH_Transfer(command, 3, NULL, 0);
     /* Update NumByteToWrite */
     NumByteToWrite -= 2;
     /* Deselect the FLASH: Chip Select high */
     sFLASH_CS_HIGH();
-    /* Wait for the busy status to clear */
-    sFLASH_WaitForWriteEnd();
+    /* Wait for SO to show ready */
+    sFLASH_WaitForAAIWord();
   }
 
+  /* Disable the write access to the FLASH, which ends the AAI sequence */
+  sFLASH_WriteDisable();
+
+  /* Select the FLASH: Chip Select low */
+  sFLASH_CS_LOW();
+  /* Send "Disable SO RY/BY# Status" instruction */
+  sFLASH_SendByte(sFLASH_CMD_DBSY);
   /* Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
-
-  /* Disable the write access to the FLASH */
-  sFLASH_WriteDisable();
 }
 
 /**
@@ -272,6 +306,8 @@ void sFLASH_WriteBuffer(const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t Num
 {
   uint32_t evenBytes;
 
+  sFLASH_WaitForErase();
+
   /* If write starts at an odd address, need to use single byte write
    * to write the first address. */
   if ((WriteAddr & 0x1) == 0x1)
@@ -309,25 +345,30 @@ void sFLASH_WriteBuffer(const uint8_t *pBuffer, uint32_t WriteAddr, uint32_t Num
   */
 void sFLASH_ReadBuffer(uint8_t* pBuffer, uint32_t ReadAddr, uint32_t NumByteToRead)
 {
+  sFLASH_WaitForErase();
+
+  uint8_t command[5] = {
+    sFLASH_CMD_FAST_READ,
+    (ReadAddr & 0xFF0000) >> 16,
+    (ReadAddr & 0xFF00) >> 8,
+    ReadAddr & 0xFF,
+    sFLASH_DUMMY_BYTE
+  };
+
   /* Select the FLASH: Chip Select low */
   sFLASH_CS_LOW();
 
-  /* Send "Read from Memory " instruction */
-  sFLASH_SendByte(sFLASH_CMD_READ);
-
-  /* Send ReadAddr high nibble address byte to read from */
-  sFLASH_SendByte((ReadAddr & 0xFF0000) >> 16);
-  /* Send ReadAddr medium nibble address byte to read from */
-  sFLASH_SendByte((ReadAddr& 0xFF00) >> 8);
-  /* Send ReadAddr low nibble address byte to read from */
-  sFLASH_SendByte(ReadAddr & 0xFF);
+  /* Send "High-Speed Read" instruction, ReadAddr and the dummy byte */
+  sFLASH_Transfer(command, sizeof(command), NULL, 0);
 
   while (NumByteToRead) /* while there is data to be read */
   {
-    /* Read a byte from the FLASH and point to the next location */
-    *pBuffer++ = sFLASH_SendByte(sFLASH_DUMMY_BYTE);
-    /* Decrement NumByteToRead */
-    NumByteToRead--;
+    /* Clock in as much data as the SPI master can handle in one transfer */
+    uint16_t length = (NumByteToRead > sFLASH_MAX_TRANSFER_LENGTH) ?
+                      sFLASH_MAX_TRANSFER_LENGTH : NumByteToRead;
+    sFLASH_Transfer(NULL, 0, pBuffer, length);
+    pBuffer += length;
+    NumByteToRead -= length;
   }
 
   /* Deselect the FLASH: Chip Select high */
@@ -341,27 +382,19 @@ void sFLASH_ReadBuffer(uint8_t* pBuffer, uint32_t ReadAddr, uint32_t NumByteToRe
   */
 uint32_t sFLASH_ReadID(void)
 {
-  uint8_t byte[3];
+  uint8_t command[1] = { sFLASH_CMD_RDID };
+  uint8_t byte[4];
 
   /* Select the FLASH: Chip Select low */
   sFLASH_CS_LOW();
 
-  /* Send "JEDEC ID Read" instruction */
-  sFLASH_SendByte(sFLASH_CMD_RDID);
-
-  /* Read a byte from the FLASH */
-  byte[0] = sFLASH_SendByte(sFLASH_DUMMY_BYTE);
-
-  /* Read a byte from the FLASH */
-  byte[1] = sFLASH_SendByte(sFLASH_DUMMY_BYTE);
-
-  /* Read a byte from the FLASH */
-  byte[2] = sFLASH_SendByte(sFLASH_DUMMY_BYTE);
+  /* Send "JEDEC ID Read" instruction and read the 3 ID bytes that follow it */
+  sFLASH_Transfer(command, sizeof(command), byte, sizeof(byte));
 
   /* Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
 
-  return (byte[0] << 16) | (byte[1] << 8) | byte[2];
+  return (byte[1] << 16) | (byte[2] << 8) | byte[3];
 }
 
 /**
@@ -399,17 +432,51 @@ static uint8_t sFLASH_SendByte(uint8_t byte)
 	tx_data[0] = byte;
 	rx_data[0] = 0x0;
 
+	sFLASH_Transfer(tx_data, TX_RX_MSG_LENGTH, rx_data, TX_RX_MSG_LENGTH);
+	return rx_data[0];
+}
+
+/**
+  * @brief  Sends a command followed by a 24-bit address in a single transfer.
+  * @param  cmd: the command to send.
+  * @param  Addr: the address sent after the command.
+  * @retval None
+  */
+static void sFLASH_SendCommand(uint8_t cmd, uint32_t Addr)
+{
+	uint8_t command[4] = {
+		cmd,
+		(Addr & 0xFF0000) >> 16,
+		(Addr & 0xFF00) >> 8,
+		Addr & 0xFF
+	};
+
+	sFLASH_Transfer(command, sizeof(command), NULL, 0);
+}
+
+/**
+  * @brief  Clocks a whole buffer through the SPI interface in one transaction
+  *         and waits for it to complete. Bytes past the end of pTx are sent
+  *         as dummy bytes, bytes past the end of pRx are discarded.
+  * @param  pTx: bytes to send, may be NULL when only receiving.
+  * @param  TxLength: number of bytes to send.
+  * @param  pRx: buffer that receives the bytes, may be NULL when only sending.
+  * @param  RxLength: number of bytes to receive.
+  * @retval None
+  */
+static void sFLASH_Transfer(const uint8_t *pTx, uint16_t TxLength, uint8_t *pRx, uint16_t RxLength)
+{
 	spi_transmission_completed = false;
-	uint32_t err_code = spi_master_send_recv(SPI_MASTER_0,(uint8_t *)tx_data, 1, rx_data, 1);
+	uint32_t err_code = spi_master_send_recv(SPI_MASTER_0, (uint8_t *)pTx, TxLength, pRx, RxLength);
 	if (err_code == NRF_SUCCESS)
 	{
-        long timeout = 100000;
+        /* allow for the slowest 1MHz clock on top of the original fixed timeout */
+        long timeout = 100000 + 8L * ((TxLength > RxLength) ? TxLength : RxLength);
 		while(spi_transmission_completed == false && timeout-- > 0) {
             nrf_delay_us(1);
         }
 	}
 	else { }
-	return rx_data[0];
 }
 
 /**
@@ -466,6 +533,41 @@ static void sFLASH_WriteDisable(void)
   sFLASH_CS_HIGH();
 }
 
+/**
+  * @brief  Waits for a sector erase started by sFLASH_EraseSectorStart to end.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_WaitForErase(void)
+{
+  if (sFLASH_ErasePending)
+  {
+    sFLASH_WaitForWriteEnd();
+    sFLASH_ErasePending = false;
+  }
+}
+
+/**
+  * @brief  Waits for an AAI word to be programmed, the FLASH must be in EBSY mode.
+  * @note   SO is driven low while the FLASH is busy as long as CS is low, so
+  *         the MISO pin is read directly without clocking anything.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_WaitForAAIWord(void)
+{
+  /* Select the FLASH: Chip Select low */
+  sFLASH_CS_LOW();
+
+  /* Loop as long as SO shows busy */
+  while (nrf_gpio_pin_read(SPIM0_MISO_PIN) == 0)
+  {
+  }
+
+  /* Deselect the FLASH: Chip Select high */
+  sFLASH_CS_HIGH();
+}
+
 /**
   * @brief  Polls the status of the Write In Progress (WIP) flag in the FLASH's
   *         status register and loop until write operation has completed.
@@ -608,6 +710,7 @@ int sFLASH_TestReadWrite(void)
 
 int sFLASH_WriteSingleByte(uint32_t FLASH_Address, uint8_t byteToSend)
 {
+	sFLASH_WaitForErase();
 	//sFLASH_EraseSector(FLASH_Address);
 	sFLASH_WriteByte(FLASH_Address, byteToSend);
     return 0;
@@ -0,0 +1,41 @@
+/**
+ ******************************************************************************
+ * @file    crc32.h
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#ifndef CRC32_H
+#define	CRC32_H
+
+#include <stdint.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * CRC-32 (zlib) of a buffer, continuing from crc, 0 to start. This is the CRC
+ * the update files use, on any platform.
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t length);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* CRC32_H */
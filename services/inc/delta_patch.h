@@ -0,0 +1,149 @@
+/**
+ ******************************************************************************
+ * @file    delta_patch.h
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#ifndef DELTA_PATCH_H
+#define	DELTA_PATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A delta patch rebuilds a module image from the image already installed
+ * (the source) and a stream of records. All numbers are big endian.
+ *
+ * Header, DELTA_PATCH_HEADER_SIZE bytes:
+ *      magic 'B' 'Z' 'D' 'P', version, module function, module index, 0,
+ *      module version (16), 0 (16), source address, source length,
+ *      source CRC32, target length, target CRC32 (all 32)
+ *
+ * Records, until target length bytes have been produced:
+ *      DELTA_PATCH_COPY    source offset (32), length (16)
+ *      DELTA_PATCH_ADD     source offset (32), length (16), length bytes added to the source bytes
+ *      DELTA_PATCH_INSERT  length (16), length bytes
+ *
+ * The CRCs are crc32_update over the whole images.
+ */
+#define DELTA_PATCH_MAGIC           0x425A4450
+#define DELTA_PATCH_VERSION         1
+#define DELTA_PATCH_HEADER_SIZE     32
+
+#define DELTA_PATCH_COPY            0x01
+#define DELTA_PATCH_ADD             0x02
+#define DELTA_PATCH_INSERT          0x03
+
+/**
+ * Output is collected and written in blocks this size, it is most of the
+ * RAM the applier needs.
+ */
+#ifndef DELTA_PATCH_BLOCK_SIZE
+#define DELTA_PATCH_BLOCK_SIZE      128
+#endif
+
+typedef enum {
+    DELTA_PATCH_OK = 0,
+    DELTA_PATCH_ERROR_HEADER = -1,          // not a patch, or a version this code does not know
+    DELTA_PATCH_ERROR_SOURCE = -2,          // the patch is for another module or the module has changed
+    DELTA_PATCH_ERROR_RECORD = -3,          // unknown record, or one reaching outside the images
+    DELTA_PATCH_ERROR_WRITE = -4,
+    DELTA_PATCH_ERROR_INCOMPLETE = -5,      // the patch ended before the target was complete
+    DELTA_PATCH_ERROR_CRC = -6              // the target is not the image the patch was made for
+} delta_patch_result_t;
+
+typedef struct {
+    uint8_t version;
+    uint8_t module_function;
+    uint8_t module_index;
+    uint16_t module_version;
+    uint32_t source_address;
+    uint32_t source_length;
+    uint32_t source_crc;
+    uint32_t target_length;
+    uint32_t target_crc;
+} delta_patch_info_t;
+
+typedef struct {
+    /**
+     * Checks the patch applies to the installed module, called once the header is in.
+     * @return 0 to go on, non-zero to refuse the patch.
+     */
+    int (*begin)(const delta_patch_info_t* info, void* context);
+
+    /**
+     * Reads length bytes of the source image at an address between source_address
+     * and source_address + source_length.
+     */
+    void (*read_source)(uint32_t address, uint8_t* buffer, uint32_t length, void* context);
+
+    /**
+     * Writes the next length bytes of the target image, offset bytes from its start.
+     * @return 0 on success.
+     */
+    int (*write_target)(uint32_t offset, const uint8_t* data, uint32_t length, void* context);
+} delta_patch_callbacks_t;
+
+typedef struct {
+    const delta_patch_callbacks_t* callbacks;
+    void* context;
+    delta_patch_info_t info;
+    int result;
+    uint32_t consumed;                      // patch bytes taken so far
+    uint8_t state;
+    uint8_t op;                             // the record being read or applied
+    uint8_t field_length;                   // bytes of the header or record header collected in field
+    uint8_t field[DELTA_PATCH_HEADER_SIZE];
+    uint32_t source_offset;
+    uint16_t remaining;                     // bytes left in the current record
+    uint32_t produced;                      // target bytes made so far
+    uint32_t crc;
+    uint16_t block_length;
+    uint8_t block[DELTA_PATCH_BLOCK_SIZE];
+} delta_patch_t;
+
+void delta_patch_init(delta_patch_t* patch, const delta_patch_callbacks_t* callbacks, void* context);
+
+/**
+ * Applies the next part of the patch. Parts must be given in order, but can be any size.
+ * @return DELTA_PATCH_OK, or the error that stopped the patch. Once there is an
+ * error every further call returns it.
+ */
+int delta_patch_apply(delta_patch_t* patch, const uint8_t* data, uint32_t length);
+
+/**
+ * Writes what is left of the target and checks it is complete and has the expected CRC.
+ */
+int delta_patch_finish(delta_patch_t* patch);
+
+/**
+ * Bytes of the patch applied so far.
+ */
+static inline uint32_t delta_patch_consumed(const delta_patch_t* patch) {
+    return patch->consumed;
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* DELTA_PATCH_H */
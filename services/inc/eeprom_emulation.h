@@ -24,6 +24,7 @@
 #include <memory>
 #include <vector>
 #include <limits>
+#include <algorithm>
 
 /* EEPROM Emulation using Flash memory
  *
@@ -89,6 +90,11 @@
  * not call performPendingErase() before the next page swap, the
  * alternate page will be erased just before the page swap.
  *
+ * The Flash memory is only accessed through the Store read(), write()
+ * and eraseSector() methods so the pages don't have to be memory
+ * mapped. This allows the emulation to run on top of an external SPI
+ * Flash chip as well as on the internal Flash.
+ *
  */
 
 template <typename Store, uintptr_t PageBase1, size_t PageSize1, uintptr_t PageBase2, size_t PageSize2>
@@ -224,6 +230,45 @@ public:
         updateActivePage();
     }
 
+    // Fills an EEPROM that has no active page from a raw image of its
+    // contents, e.g. data kept in another format before the emulation was
+    // used. The records go to the given page, which is only marked active
+    // once they are all written, and the other page is not touched, so
+    // the image can come from there. After a reset during the import no
+    // page is active and the import can simply be run again.
+    //
+    // The other page is left to performPendingErase()
+    bool importImage(LogicalPage page, const void *data, uint16_t length)
+    {
+        updateActivePage();
+        if(getActivePage() != LogicalPage::NoPage || page == LogicalPage::NoPage)
+        {
+            return false;
+        }
+
+        for(int tries = 0; tries < 2; tries++)
+        {
+            bool success = true;
+            erasePage(page);
+
+            success = success && writePageStatus(page, PageHeader::COPY);
+            success = success && writeRangeDirect(getPageBegin(page) + sizeof(PageHeader),
+                                                  getPageEnd(page),
+                                                  0,
+                                                  (const Data *)data,
+                                                  length);
+            success = success && writePageStatus(page, PageHeader::ACTIVE);
+
+            if(success)
+            {
+                updateActivePage();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     // Returns number of bytes that can be stored in EEPROM
     // The actual capacity is set to 50% of the records that fit in the smallest page
     constexpr size_t capacity()
@@ -323,8 +368,9 @@ public:
     // Get the current status of a page (empty, active, being copied, ...)
     uint32_t readPageStatus(LogicalPage page)
     {
-        PageHeader *header = (PageHeader *) store.dataAt(getPageBegin(page));
-        return header->status;
+        PageHeader header;
+        store.read(getPageBegin(page), &header, sizeof(header));
+        return header.status;
     }
 
     // Update the status of a page
@@ -507,7 +553,8 @@ public:
         // Walk through record list
         while(address < endAddress)
         {
-            const Record &record = *(const Record *) store.dataAt(address);
+            Record record;
+            store.read(address, &record, sizeof(record));
 
             // Yield record and potentially break early
             if(f(address, record))
@@ -597,7 +644,8 @@ public:
             {
                 if(addressOffset != 0) {
                     Address address = baseAddress + addressOffset;
-                    const Record &record = *(const Record *) store.dataAt(address);
+                    Record record;
+                    store.read(address, &record, sizeof(record));
 
                     // Yield record
                     f(address, record);
@@ -615,14 +663,23 @@ public:
     // during page erase
     bool verifyPage(LogicalPage page)
     {
-        const uint8_t *begin = store.dataAt(getPageBegin(page));
-        const uint8_t *end = store.dataAt(getPageEnd(page));
-        while(begin < end)
+        Address address = getPageBegin(page);
+        Address endAddress = getPageEnd(page);
+
+        // Read the page in small blocks to keep stack usage low
+        uint8_t block[32];
+        while(address < endAddress)
         {
-            if(*begin++ != FLASH_ERASED)
+            size_t blockSize = std::min<size_t>(sizeof(block), endAddress - address);
+            store.read(address, block, blockSize);
+            for(size_t i = 0; i < blockSize; i++)
             {
-                return false;
+                if(block[i] != FLASH_ERASED)
+                {
+                    return false;
+                }
             }
+            address += blockSize;
         }
 
         return true;
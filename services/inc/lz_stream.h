@@ -0,0 +1,133 @@
+/**
+ ******************************************************************************
+ * @file    lz_stream.h
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#ifndef LZ_STREAM_H
+#define	LZ_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * An LZSS compressed file. All numbers are big endian.
+ *
+ * Header, LZ_STREAM_HEADER_SIZE bytes:
+ *      magic 'B' 'Z' 'L' 'Z', version, window bits, 0, 0,
+ *      length (32) and crc32_update (32) of the uncompressed data
+ *
+ * Then groups of a control byte and the eight items it describes, lowest bit
+ * first. A set bit is a literal byte. A clear bit is a match of two bytes,
+ * (distance - 1) in the top window bits and (length - LZ_STREAM_MIN_MATCH)
+ * in the rest, copying length bytes from distance bytes back.
+ */
+#define LZ_STREAM_MAGIC             0x425A4C5A
+#define LZ_STREAM_VERSION           1
+#define LZ_STREAM_HEADER_SIZE       16
+#define LZ_STREAM_MIN_MATCH         3
+
+/**
+ * The largest window the decompressor keeps, 2^LZ_STREAM_WINDOW_BITS bytes
+ * of RAM. Files compressed with a larger window are refused.
+ */
+#ifndef LZ_STREAM_WINDOW_BITS
+#define LZ_STREAM_WINDOW_BITS       11
+#endif
+#define LZ_STREAM_WINDOW_SIZE       (1<<LZ_STREAM_WINDOW_BITS)
+
+/**
+ * The output is written in blocks this size, straight from the window.
+ */
+#define LZ_STREAM_BLOCK_SIZE        256
+
+typedef enum {
+    LZ_STREAM_OK = 0,
+    LZ_STREAM_ERROR_HEADER = -1,            // not compressed, or with a version or window this code does not know
+    LZ_STREAM_ERROR_DATA = -2,              // a match reaching before the start, or more data than the length
+    LZ_STREAM_ERROR_WRITE = -3,
+    LZ_STREAM_ERROR_INCOMPLETE = -4,
+    LZ_STREAM_ERROR_CRC = -5,
+    LZ_STREAM_ERROR_LENGTH = -6             // the header gives a length over the limit
+} lz_stream_result_t;
+
+/**
+ * Takes the next length bytes of the uncompressed data, offset bytes from its start.
+ * @return 0 on success.
+ */
+typedef int (*lz_stream_write_fn)(uint32_t offset, const uint8_t* data, uint32_t length, void* context);
+
+typedef struct {
+    lz_stream_write_fn write;
+    void* context;
+    int result;
+    uint32_t consumed;                      // compressed bytes taken so far
+    uint8_t state;
+    uint8_t window_bits;
+    uint8_t control;                        // what is left of the current control byte
+    uint8_t items;                          // items left in the current group
+    uint8_t match;                          // first byte of a match
+    uint8_t header_length;
+    uint8_t header[LZ_STREAM_HEADER_SIZE];
+    uint32_t length;                        // of the uncompressed data
+    uint32_t max_length;                    // longest uncompressed data taken, 0 for any
+    uint32_t expected_crc;
+    uint32_t crc;
+    uint32_t produced;
+    uint32_t written;
+    uint8_t window[LZ_STREAM_WINDOW_SIZE];
+} lz_stream_t;
+
+void lz_stream_init(lz_stream_t* stream, lz_stream_write_fn write, void* context);
+
+/**
+ * Decompresses the next part of the file. Parts must be given in order, but can be any size.
+ * @return LZ_STREAM_OK, or the error that stopped decompression. Once there is an
+ * error every further call returns it.
+ */
+int lz_stream_apply(lz_stream_t* stream, const uint8_t* data, uint32_t length);
+
+/**
+ * Writes what is left and checks the data is complete and has the expected CRC.
+ */
+int lz_stream_finish(lz_stream_t* stream);
+
+/**
+ * Refuses data longer than this, as soon as the header is in and before
+ * anything is written. Call after lz_stream_init, which sets no limit.
+ */
+static inline void lz_stream_limit(lz_stream_t* stream, uint32_t max_length) {
+    stream->max_length = max_length;
+}
+
+/**
+ * Compressed bytes taken so far.
+ */
+static inline uint32_t lz_stream_consumed(const lz_stream_t* stream) {
+    return stream->consumed;
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* LZ_STREAM_H */
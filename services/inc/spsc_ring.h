@@ -0,0 +1,314 @@
+/**
+ ******************************************************************************
+ * @file    spsc_ring.h
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+
+#include <atomic>
+
+/* A ring of Capacity elements handed from one producer to one consumer
+ * without locks, such as from an interrupt or SoftDevice event to the main
+ * loop. Every call completes in bounded time.
+ *
+ * The producer only ever writes the head and the consumer only the tail.
+ * Both are free running and masked on access, so the whole capacity is used.
+ * The elements are copied in before the head is published (release) and the
+ * head is read before the elements are read out (acquire), likewise for the
+ * tail in the other direction. On a Cortex-M0 this is a plain load or store
+ * of the index with a DMB between it and the copy.
+ *
+ * The producer calls push() and space(). The consumer calls pop(), peek(),
+ * consume(), size() and empty(). clear() may only be called when neither
+ * side is active.
+ *
+ * Only for Plain Old Data, the elements are copied with memcpy.
+ */
+
+template <typename T, size_t Capacity>
+class SpscRing {
+  static_assert(Capacity && !(Capacity & (Capacity-1)), "SpscRing capacity must be a power of 2");
+  static_assert(Capacity <= 0x8000, "SpscRing capacity must fit the 16 bit indices");
+
+  public:
+
+  typedef T ValueType;
+  typedef size_t SizeType;
+
+  SpscRing() : _head(0), _tail(0) {}
+
+  static SizeType capacity() {
+    return Capacity;
+  }
+
+  void clear() {
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+  }
+
+  // consumer
+
+  SizeType size() const {
+    return uint16_t(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed));
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  bool pop(ValueType& value) {
+    return pop(&value, 1) == 1;
+  }
+
+  /**
+   * Copies out up to count elements.
+   * @return the number of elements copied.
+   */
+  SizeType pop(ValueType* values, SizeType count) {
+    uint16_t tail = _tail.load(std::memory_order_relaxed);
+    SizeType available = uint16_t(_head.load(std::memory_order_acquire) - tail);
+    if (count > available)
+      count = available;
+    SizeType offset = tail & (Capacity-1);
+    SizeType first = Capacity - offset;
+    if (first > count)
+      first = count;
+    memcpy(values, _data + offset, first * sizeof(ValueType));
+    memcpy(values + first, _data, (count - first) * sizeof(ValueType));
+    _tail.store(uint16_t(tail + count), std::memory_order_release);
+    return count;
+  }
+
+  /**
+   * Gives the elements that can be read in place, up to the end of the
+   * storage. When the ring has wrapped, the rest follow once these are consumed.
+   * @return the number of elements at values.
+   */
+  SizeType peek(const ValueType*& values) const {
+    uint16_t tail = _tail.load(std::memory_order_relaxed);
+    SizeType available = uint16_t(_head.load(std::memory_order_acquire) - tail);
+    SizeType offset = tail & (Capacity-1);
+    values = _data + offset;
+    return available < Capacity - offset ? available : Capacity - offset;
+  }
+
+  /**
+   * Releases elements read in place with peek().
+   */
+  void consume(SizeType count) {
+    _tail.store(uint16_t(_tail.load(std::memory_order_relaxed) + count), std::memory_order_release);
+  }
+
+  // producer
+
+  SizeType space() const {
+    return Capacity - uint16_t(_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+  }
+
+  bool push(const ValueType& value) {
+    return push(&value, 1, true) == 1;
+  }
+
+  /**
+   * Copies in up to count elements.
+   * @param all   when set nothing is copied unless all of them fit.
+   * @return the number of elements copied.
+   */
+  SizeType push(const ValueType* values, SizeType count, bool all=false) {
+    uint16_t head = _head.load(std::memory_order_relaxed);
+    SizeType free = Capacity - uint16_t(head - _tail.load(std::memory_order_acquire));
+    if (count > free) {
+      if (all)
+        return 0;
+      count = free;
+    }
+    SizeType offset = head & (Capacity-1);
+    SizeType first = Capacity - offset;
+    if (first > count)
+      first = count;
+    memcpy(_data + offset, values, first * sizeof(ValueType));
+    memcpy(_data, values + first, (count - first) * sizeof(ValueType));
+    _head.store(uint16_t(head + count), std::memory_order_release);
+    return count;
+  }
+
+  private:
+  std::atomic<uint16_t> _head;
+  std::atomic<uint16_t> _tail;
+  ValueType _data[Capacity];
+};
+
+#endif
+
+/* The same ring for C sources, of bytes, with its storage and capacity given
+ * at run time. The indices follow the same discipline as SpscRing: each side
+ * writes only its own, publishes it with release and reads the other with
+ * acquire. They run from 0 to twice the capacity, so the whole capacity is
+ * used and the capacity needn't be a power of 2, up to 0x7FFF bytes.
+ *
+ * The producer calls spsc_byte_ring_push(), _space(), _reserve() and
+ * _produce(). The consumer calls _pop(), _peek(), _consume() and _size().
+ * spsc_byte_ring_init() and _clear() may only be called when neither side is
+ * active.
+ */
+
+typedef struct {
+  uint8_t * p_data;
+  uint16_t capacity;
+  uint16_t head;                  /* written by the producer only */
+  uint16_t tail;                  /* written by the consumer only */
+} spsc_byte_ring_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint16_t spsc_byte_ring_used(const spsc_byte_ring_t * p_ring, uint16_t head, uint16_t tail) {
+  return head >= tail ? head - tail : head + 2*p_ring->capacity - tail;
+}
+
+static inline uint16_t spsc_byte_ring_offset(const spsc_byte_ring_t * p_ring, uint16_t index) {
+  return index < p_ring->capacity ? index : index - p_ring->capacity;
+}
+
+static inline uint16_t spsc_byte_ring_advance(const spsc_byte_ring_t * p_ring, uint16_t index, uint16_t count) {
+  uint32_t next = (uint32_t)index + count;
+  return next < 2u*p_ring->capacity ? next : next - 2u*p_ring->capacity;
+}
+
+static inline void spsc_byte_ring_init(spsc_byte_ring_t * p_ring, uint8_t * p_data, uint16_t capacity) {
+  p_ring->p_data = p_data;
+  p_ring->capacity = capacity;
+  p_ring->head = 0;
+  p_ring->tail = 0;
+}
+
+static inline void spsc_byte_ring_clear(spsc_byte_ring_t * p_ring) {
+  __atomic_store_n(&p_ring->head, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_ring->tail, 0, __ATOMIC_RELAXED);
+}
+
+// consumer
+
+static inline uint16_t spsc_byte_ring_size(const spsc_byte_ring_t * p_ring) {
+  return spsc_byte_ring_used(p_ring, __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE),
+      __atomic_load_n(&p_ring->tail, __ATOMIC_RELAXED));
+}
+
+/**
+ * Gives the bytes that can be read in place, up to the end of the storage.
+ * @return the number of bytes at *pp_data.
+ */
+static inline uint16_t spsc_byte_ring_peek(const spsc_byte_ring_t * p_ring, const uint8_t ** pp_data) {
+  uint16_t tail = __atomic_load_n(&p_ring->tail, __ATOMIC_RELAXED);
+  uint16_t available = spsc_byte_ring_used(p_ring, __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE), tail);
+  uint16_t offset = spsc_byte_ring_offset(p_ring, tail);
+  *pp_data = p_ring->p_data + offset;
+  return available < p_ring->capacity - offset ? available : p_ring->capacity - offset;
+}
+
+/**
+ * Releases bytes read in place with spsc_byte_ring_peek().
+ */
+static inline void spsc_byte_ring_consume(spsc_byte_ring_t * p_ring, uint16_t count) {
+  uint16_t tail = __atomic_load_n(&p_ring->tail, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_ring->tail, spsc_byte_ring_advance(p_ring, tail, count), __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies out up to count bytes.
+ * @return the number of bytes copied.
+ */
+static inline uint16_t spsc_byte_ring_pop(spsc_byte_ring_t * p_ring, uint8_t * p_dest, uint16_t count) {
+  uint16_t tail = __atomic_load_n(&p_ring->tail, __ATOMIC_RELAXED);
+  uint16_t available = spsc_byte_ring_used(p_ring, __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE), tail);
+  if (count > available)
+    count = available;
+  uint16_t offset = spsc_byte_ring_offset(p_ring, tail);
+  uint16_t first = p_ring->capacity - offset;
+  if (first > count)
+    first = count;
+  memcpy(p_dest, p_ring->p_data + offset, first);
+  memcpy(p_dest + first, p_ring->p_data, count - first);
+  __atomic_store_n(&p_ring->tail, spsc_byte_ring_advance(p_ring, tail, count), __ATOMIC_RELEASE);
+  return count;
+}
+
+// producer
+
+static inline uint16_t spsc_byte_ring_space(const spsc_byte_ring_t * p_ring) {
+  return p_ring->capacity - spsc_byte_ring_used(p_ring, __atomic_load_n(&p_ring->head, __ATOMIC_RELAXED),
+      __atomic_load_n(&p_ring->tail, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Gives the free bytes that can be written in place, up to the end of the
+ * storage. Nothing written there is seen by the consumer until it is passed
+ * to spsc_byte_ring_produce().
+ * @return the number of bytes at *pp_data.
+ */
+static inline uint16_t spsc_byte_ring_reserve(const spsc_byte_ring_t * p_ring, uint8_t ** pp_data) {
+  uint16_t head = __atomic_load_n(&p_ring->head, __ATOMIC_RELAXED);
+  uint16_t free = spsc_byte_ring_space(p_ring);
+  uint16_t offset = spsc_byte_ring_offset(p_ring, head);
+  *pp_data = p_ring->p_data + offset;
+  return free < p_ring->capacity - offset ? free : p_ring->capacity - offset;
+}
+
+/**
+ * Publishes bytes written in place after spsc_byte_ring_reserve().
+ */
+static inline void spsc_byte_ring_produce(spsc_byte_ring_t * p_ring, uint16_t count) {
+  uint16_t head = __atomic_load_n(&p_ring->head, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_ring->head, spsc_byte_ring_advance(p_ring, head, count), __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies in up to count bytes.
+ * @param all   when set nothing is copied unless all of them fit.
+ * @return the number of bytes copied.
+ */
+static inline uint16_t spsc_byte_ring_push(spsc_byte_ring_t * p_ring, const uint8_t * p_src, uint16_t count, bool all) {
+  uint16_t head = __atomic_load_n(&p_ring->head, __ATOMIC_RELAXED);
+  uint16_t free = spsc_byte_ring_space(p_ring);
+  if (count > free) {
+    if (all)
+      return 0;
+    count = free;
+  }
+  uint16_t offset = spsc_byte_ring_offset(p_ring, head);
+  uint16_t first = p_ring->capacity - offset;
+  if (first > count)
+    first = count;
+  memcpy(p_ring->p_data + offset, p_src, first);
+  memcpy(p_ring->p_data, p_src + first, count - first);
+  __atomic_store_n(&p_ring->head, spsc_byte_ring_advance(p_ring, head, count), __ATOMIC_RELEASE);
+  return count;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,269 @@
+/**
+ ******************************************************************************
+ * @file    delta_patch.c
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "delta_patch.h"
+#include "crc32.h"
+#include <stdbool.h>
+#include <string.h>
+
+enum {
+    STATE_HEADER,           // collecting the patch header
+    STATE_RECORD,           // collecting the op and header of the next record
+    STATE_DATA              // taking the bytes of an add or insert record
+};
+
+static uint16_t decode_16(const uint8_t* p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t decode_32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ * The size of the header that follows the op of a record, 0 for an unknown op.
+ */
+static uint8_t record_header_size(uint8_t op)
+{
+    switch (op) {
+        case DELTA_PATCH_COPY:
+        case DELTA_PATCH_ADD:
+            return 6;
+        case DELTA_PATCH_INSERT:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static int flush(delta_patch_t* patch)
+{
+    if (patch->block_length) {
+        uint32_t offset = patch->produced - patch->block_length;
+        patch->crc = crc32_update(patch->crc, patch->block, patch->block_length);
+        if (patch->callbacks->write_target(offset, patch->block, patch->block_length, patch->context))
+            return DELTA_PATCH_ERROR_WRITE;
+        patch->block_length = 0;
+    }
+    return DELTA_PATCH_OK;
+}
+
+/**
+ * Appends length bytes of the source at offset to the target, adding diff to
+ * them when it is given.
+ */
+static int emit_source(delta_patch_t* patch, uint32_t offset, uint32_t length, const uint8_t* diff)
+{
+    while (length) {
+        uint32_t n = DELTA_PATCH_BLOCK_SIZE - patch->block_length;
+        if (n > length)
+            n = length;
+        uint8_t* out = patch->block + patch->block_length;
+        patch->callbacks->read_source(patch->info.source_address + offset, out, n, patch->context);
+        if (diff) {
+            for (uint32_t i = 0; i < n; i++)
+                out[i] += *diff++;
+        }
+        patch->block_length += n;
+        patch->produced += n;
+        offset += n;
+        length -= n;
+        if (patch->block_length == DELTA_PATCH_BLOCK_SIZE) {
+            int result = flush(patch);
+            if (result)
+                return result;
+        }
+    }
+    return DELTA_PATCH_OK;
+}
+
+static int emit_literal(delta_patch_t* patch, const uint8_t* data, uint32_t length)
+{
+    while (length) {
+        uint32_t n = DELTA_PATCH_BLOCK_SIZE - patch->block_length;
+        if (n > length)
+            n = length;
+        memcpy(patch->block + patch->block_length, data, n);
+        patch->block_length += n;
+        patch->produced += n;
+        data += n;
+        length -= n;
+        if (patch->block_length == DELTA_PATCH_BLOCK_SIZE) {
+            int result = flush(patch);
+            if (result)
+                return result;
+        }
+    }
+    return DELTA_PATCH_OK;
+}
+
+/**
+ * Checks the source image is the one the patch was made against. The block
+ * buffer is free until the first record is applied.
+ */
+static bool source_matches(delta_patch_t* patch)
+{
+    uint32_t crc = 0;
+    uint32_t offset = 0;
+    while (offset < patch->info.source_length) {
+        uint32_t n = patch->info.source_length - offset;
+        if (n > DELTA_PATCH_BLOCK_SIZE)
+            n = DELTA_PATCH_BLOCK_SIZE;
+        patch->callbacks->read_source(patch->info.source_address + offset, patch->block, n, patch->context);
+        crc = crc32_update(crc, patch->block, n);
+        offset += n;
+    }
+    return crc == patch->info.source_crc;
+}
+
+static int parse_header(delta_patch_t* patch)
+{
+    const uint8_t* h = patch->field;
+    delta_patch_info_t* info = &patch->info;
+    if (decode_32(h) != DELTA_PATCH_MAGIC || h[4] != DELTA_PATCH_VERSION)
+        return DELTA_PATCH_ERROR_HEADER;
+    info->version = h[4];
+    info->module_function = h[5];
+    info->module_index = h[6];
+    info->module_version = decode_16(h + 8);
+    info->source_address = decode_32(h + 12);
+    info->source_length = decode_32(h + 16);
+    info->source_crc = decode_32(h + 20);
+    info->target_length = decode_32(h + 24);
+    info->target_crc = decode_32(h + 28);
+
+    if (patch->callbacks->begin && patch->callbacks->begin(info, patch->context))
+        return DELTA_PATCH_ERROR_SOURCE;
+    if (!source_matches(patch))
+        return DELTA_PATCH_ERROR_SOURCE;
+    return DELTA_PATCH_OK;
+}
+
+/**
+ * Starts the record in field. Copies are done straight away, the others
+ * wait for their data.
+ */
+static int start_record(delta_patch_t* patch)
+{
+    const uint8_t* r = patch->field;
+    uint16_t length;
+    if (patch->op == DELTA_PATCH_INSERT) {
+        length = decode_16(r);
+    }
+    else {
+        patch->source_offset = decode_32(r);
+        length = decode_16(r + 4);
+        if (patch->source_offset > patch->info.source_length ||
+            length > patch->info.source_length - patch->source_offset)
+            return DELTA_PATCH_ERROR_RECORD;
+    }
+    if (length > patch->info.target_length - patch->produced)
+        return DELTA_PATCH_ERROR_RECORD;
+
+    if (patch->op == DELTA_PATCH_COPY) {
+        patch->state = STATE_RECORD;
+        return emit_source(patch, patch->source_offset, length, NULL);
+    }
+    patch->remaining = length;
+    patch->state = length ? STATE_DATA : STATE_RECORD;
+    return DELTA_PATCH_OK;
+}
+
+void delta_patch_init(delta_patch_t* patch, const delta_patch_callbacks_t* callbacks, void* context)
+{
+    memset(patch, 0, sizeof(*patch));
+    patch->callbacks = callbacks;
+    patch->context = context;
+    patch->state = STATE_HEADER;
+}
+
+int delta_patch_apply(delta_patch_t* patch, const uint8_t* data, uint32_t length)
+{
+    while (length && patch->result == DELTA_PATCH_OK) {
+        uint32_t n = 1;
+        switch (patch->state) {
+            case STATE_HEADER:
+                patch->field[patch->field_length++] = *data;
+                if (patch->field_length == DELTA_PATCH_HEADER_SIZE) {
+                    patch->result = parse_header(patch);
+                    patch->field_length = 0;
+                    patch->state = STATE_RECORD;
+                }
+                break;
+
+            case STATE_RECORD:
+                if (patch->produced == patch->info.target_length) {
+                    // more patch than target
+                    patch->result = DELTA_PATCH_ERROR_RECORD;
+                    break;
+                }
+                if (!patch->field_length && !patch->op) {
+                    patch->op = *data;
+                    if (!record_header_size(patch->op))
+                        patch->result = DELTA_PATCH_ERROR_RECORD;
+                    break;
+                }
+                patch->field[patch->field_length++] = *data;
+                if (patch->field_length == record_header_size(patch->op)) {
+                    patch->result = start_record(patch);
+                    patch->field_length = 0;
+                    if (patch->state == STATE_RECORD)
+                        patch->op = 0;
+                }
+                break;
+
+            case STATE_DATA:
+                n = (length < patch->remaining) ? length : patch->remaining;
+                if (patch->op == DELTA_PATCH_ADD) {
+                    patch->result = emit_source(patch, patch->source_offset, n, data);
+                    patch->source_offset += n;
+                }
+                else {
+                    patch->result = emit_literal(patch, data, n);
+                }
+                patch->remaining -= n;
+                if (!patch->remaining) {
+                    patch->op = 0;
+                    patch->state = STATE_RECORD;
+                }
+                break;
+        }
+        data += n;
+        length -= n;
+        patch->consumed += n;
+    }
+    return patch->result;
+}
+
+int delta_patch_finish(delta_patch_t* patch)
+{
+    if (patch->result == DELTA_PATCH_OK) {
+        if (patch->state != STATE_RECORD || patch->op || patch->produced != patch->info.target_length)
+            patch->result = DELTA_PATCH_ERROR_INCOMPLETE;
+        else
+            patch->result = flush(patch);
+    }
+    if (patch->result == DELTA_PATCH_OK && patch->crc != patch->info.target_crc)
+        patch->result = DELTA_PATCH_ERROR_CRC;
+    return patch->result;
+}
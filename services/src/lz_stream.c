@@ -0,0 +1,165 @@
+/**
+ ******************************************************************************
+ * @file    lz_stream.c
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "lz_stream.h"
+#include "crc32.h"
+#include <string.h>
+
+enum {
+    STATE_HEADER,
+    STATE_CONTROL,          // the next byte is a control byte
+    STATE_ITEM,             // the next byte is a literal or starts a match
+    STATE_MATCH             // the next byte ends a match
+};
+
+#define WINDOW_MASK (LZ_STREAM_WINDOW_SIZE-1)
+
+static uint32_t decode_32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static int parse_header(lz_stream_t* stream)
+{
+    const uint8_t* h = stream->header;
+    if (decode_32(h) != LZ_STREAM_MAGIC || h[4] != LZ_STREAM_VERSION)
+        return LZ_STREAM_ERROR_HEADER;
+    // at least 4 bits are needed for the length of a match
+    if (h[5] < 8 || h[5] > LZ_STREAM_WINDOW_BITS || h[5] > 12)
+        return LZ_STREAM_ERROR_HEADER;
+    stream->window_bits = h[5];
+    stream->length = decode_32(h + 8);
+    stream->expected_crc = decode_32(h + 12);
+    if (stream->max_length && stream->length > stream->max_length)
+        return LZ_STREAM_ERROR_LENGTH;
+    return LZ_STREAM_OK;
+}
+
+/**
+ * Writes the bytes made since the last write. Writes start on a block boundary
+ * and the window is a whole number of blocks, so they never wrap.
+ */
+static int flush(lz_stream_t* stream)
+{
+    uint32_t length = stream->produced - stream->written;
+    if (length) {
+        const uint8_t* data = stream->window + (stream->written & WINDOW_MASK);
+        stream->crc = crc32_update(stream->crc, data, length);
+        if (stream->write(stream->written, data, length, stream->context))
+            return LZ_STREAM_ERROR_WRITE;
+        stream->written = stream->produced;
+    }
+    return LZ_STREAM_OK;
+}
+
+static int put(lz_stream_t* stream, uint8_t b)
+{
+    stream->window[stream->produced++ & WINDOW_MASK] = b;
+    if ((stream->produced % LZ_STREAM_BLOCK_SIZE) == 0)
+        return flush(stream);
+    return LZ_STREAM_OK;
+}
+
+static int copy_match(lz_stream_t* stream, uint8_t low)
+{
+    uint8_t length_bits = 16 - stream->window_bits;
+    uint16_t value = (stream->match << 8) | low;
+    uint32_t distance = (value >> length_bits) + 1;
+    uint32_t length = (value & ((1 << length_bits) - 1)) + LZ_STREAM_MIN_MATCH;
+    if (distance > stream->produced || length > stream->length - stream->produced)
+        return LZ_STREAM_ERROR_DATA;
+    while (length--) {
+        int result = put(stream, stream->window[(stream->produced - distance) & WINDOW_MASK]);
+        if (result)
+            return result;
+    }
+    return LZ_STREAM_OK;
+}
+
+static void next_item(lz_stream_t* stream)
+{
+    stream->control >>= 1;
+    stream->state = --stream->items ? STATE_ITEM : STATE_CONTROL;
+}
+
+void lz_stream_init(lz_stream_t* stream, lz_stream_write_fn write, void* context)
+{
+    memset(stream, 0, offsetof(lz_stream_t, window));
+    stream->write = write;
+    stream->context = context;
+    stream->state = STATE_HEADER;
+}
+
+int lz_stream_apply(lz_stream_t* stream, const uint8_t* data, uint32_t length)
+{
+    for (; length && stream->result == LZ_STREAM_OK; data++, length--) {
+        uint8_t b = *data;
+        stream->consumed++;
+        switch (stream->state) {
+            case STATE_HEADER:
+                stream->header[stream->header_length++] = b;
+                if (stream->header_length == LZ_STREAM_HEADER_SIZE) {
+                    stream->result = parse_header(stream);
+                    stream->state = STATE_CONTROL;
+                }
+                break;
+
+            case STATE_CONTROL:
+                stream->control = b;
+                stream->items = 8;
+                stream->state = STATE_ITEM;
+                break;
+
+            case STATE_ITEM:
+                if (stream->produced == stream->length) {
+                    stream->result = LZ_STREAM_ERROR_DATA;
+                }
+                else if (stream->control & 1) {
+                    stream->result = put(stream, b);
+                    next_item(stream);
+                }
+                else {
+                    stream->match = b;
+                    stream->state = STATE_MATCH;
+                }
+                break;
+
+            case STATE_MATCH:
+                stream->result = copy_match(stream, b);
+                next_item(stream);
+                break;
+        }
+    }
+    return stream->result;
+}
+
+int lz_stream_finish(lz_stream_t* stream)
+{
+    if (stream->result == LZ_STREAM_OK) {
+        if (stream->state == STATE_HEADER || stream->state == STATE_MATCH || stream->produced != stream->length)
+            stream->result = LZ_STREAM_ERROR_INCOMPLETE;
+        else
+            stream->result = flush(stream);
+    }
+    if (stream->result == LZ_STREAM_OK && stream->crc != stream->expected_crc)
+        stream->result = LZ_STREAM_ERROR_CRC;
+    return stream->result;
+}
@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * @file    key_index.h
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * An open addressed hash index over the entries of an append_list, by key.
+ * It holds the position of each entry rather than a pointer, so it stays
+ * valid when the list is reallocated. Entries are never removed.
+ *
+ * Keys match as strncmp does, up to the first NUL or max_length characters.
+ *
+ * At most 3/4 of the slots are used. An entry added past that is not indexed
+ * and is_complete() is false from then on, the caller then searches the list.
+ */
+template <unsigned slots> class key_index
+{
+    static_assert(slots && !(slots & (slots-1)), "key_index slots must be a power of 2");
+
+    uint8_t table[slots];       // position + 1, 0 for an empty slot
+    uint8_t count;
+    bool complete;
+
+    static const unsigned mask = slots-1;
+
+public:
+
+    key_index() { clear(); }
+
+    void clear() {
+        memset(table, 0, sizeof(table));
+        count = 0;
+        complete = true;
+    }
+
+    /**
+     * FNV-1a.
+     */
+    static uint32_t hash(const char* key, size_t max_length) {
+        uint32_t h = 2166136261u;
+        for (size_t i=0; i<max_length && key[i]; i++) {
+            h ^= uint8_t(key[i]);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    /**
+     * Indexes the entry at the given position in the list.
+     * @return false when the index is full, it is then no longer complete.
+     */
+    bool add(const char* key, size_t max_length, unsigned position) {
+        if (4*(count+1u)>3*slots || position>=255) {
+            complete = false;
+            return false;
+        }
+        unsigned i = hash(key, max_length) & mask;
+        while (table[i])
+            i = (i+1) & mask;
+        table[i] = position+1;
+        count++;
+        return true;
+    }
+
+    /**
+     * Finds the entry with the given key.
+     * @param matches   called with the position of each entry the key could be,
+     *                  returns true when that entry has the key.
+     * @return the position of the entry, or -1 when it is not in the index.
+     */
+    template <typename F> int find(const char* key, size_t max_length, F matches) const {
+        for (unsigned i = hash(key, max_length) & mask; table[i]; i = (i+1) & mask) {
+            if (matches(table[i]-1u))
+                return table[i]-1;
+        }
+        return -1;
+    }
+
+    bool is_complete() const { return complete; }
+
+    unsigned size() const { return count; }
+};
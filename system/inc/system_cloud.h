@@ -92,8 +92,10 @@ STATIC_ASSERT(spark_data_typedef_is_1_byte, sizeof(Spark_Data_TypeDef)==1);
 const uint32_t PUBLISH_EVENT_FLAG_PUBLIC = 0;
 const uint32_t PUBLISH_EVENT_FLAG_PRIVATE = 1;
 const uint32_t PUBLISH_EVENT_FLAG_NO_ACK = 2;
+const uint32_t PUBLISH_EVENT_FLAG_BATCH = 8;
 
 STATIC_ASSERT(publish_no_ack_flag_matches, PUBLISH_EVENT_FLAG_NO_ACK==EventType::NO_ACK);
+STATIC_ASSERT(publish_batch_flag_matches, PUBLISH_EVENT_FLAG_BATCH==EventType::BATCH);
 
 typedef void (*EventHandler)(const char* name, const char* data);
 
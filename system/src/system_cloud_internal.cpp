@@ -29,6 +29,7 @@
 #include "spark_wiring_string.h"
 #include "spark_protocol_functions.h"
 #include "append_list.h"
+#include "key_index.h"
 #include "core_hal.h"
 #include "deviceid_hal.h"
 #include "ota_flash_hal.h"
@@ -81,11 +82,37 @@ ProtocolFacade* system_cloud_protocol_instance(void)
     return sp;
 }
 
+/**
+ * Slots in each of the hash indexes over the variable and function keys.
+ * 3/4 of them can be used, keys registered past that are found by searching
+ * the list.
+ */
+#ifndef CLOUD_KEY_INDEX_SLOTS
+#define CLOUD_KEY_INDEX_SLOTS 32
+#endif
+
 static append_list<User_Var_Lookup_Table_t> vars(5);
 static append_list<User_Func_Lookup_Table_t> funcs(5);
+static key_index<CLOUD_KEY_INDEX_SLOTS> var_index;
+static key_index<CLOUD_KEY_INDEX_SLOTS> func_index;
+
+/**
+ * The functions and variables part of the describe message, built when
+ * it is first needed after a registration.
+ */
+static char* application_info = NULL;
+static uint16_t application_info_length = 0;
+static bool application_info_changed = true;
 
 User_Var_Lookup_Table_t* find_var_by_key(const char* varKey)
 {
+    if (var_index.is_complete())
+    {
+        int i = var_index.find(varKey, USER_VAR_KEY_LENGTH, [varKey](unsigned i) {
+            return 0 == strncmp(vars[i].userVarKey, varKey, USER_VAR_KEY_LENGTH);
+        });
+        return i<0 ? NULL : &vars[i];
+    }
     for (int i = vars.size(); i-->0; )
     {
         if (0 == strncmp(vars[i].userVarKey, varKey, USER_VAR_KEY_LENGTH))
@@ -99,12 +126,22 @@ User_Var_Lookup_Table_t* find_var_by_key(const char* varKey)
 
 User_Var_Lookup_Table_t* find_var_by_key_or_add(const char* varKey)
 {
+    application_info_changed = true;
     User_Var_Lookup_Table_t* result = find_var_by_key(varKey);
-    return result ? result : vars.add();
+    if (!result && (result = vars.add()))
+        var_index.add(varKey, USER_VAR_KEY_LENGTH, vars.size()-1);
+    return result;
 }
 
 User_Func_Lookup_Table_t* find_func_by_key(const char* funcKey)
 {
+    if (func_index.is_complete())
+    {
+        int i = func_index.find(funcKey, USER_FUNC_KEY_LENGTH, [funcKey](unsigned i) {
+            return 0 == strncmp(funcs[i].userFuncKey, funcKey, USER_FUNC_KEY_LENGTH);
+        });
+        return i<0 ? NULL : &funcs[i];
+    }
     for (int i = funcs.size(); i-->0; )
     {
         if (0 == strncmp(funcs[i].userFuncKey, funcKey, USER_FUNC_KEY_LENGTH))
@@ -117,8 +154,11 @@ User_Func_Lookup_Table_t* find_func_by_key(const char* funcKey)
 
 User_Func_Lookup_Table_t* find_func_by_key_or_add(const char* funcKey)
 {
+    application_info_changed = true;
     User_Func_Lookup_Table_t* result = find_func_by_key(funcKey);
-    return result ? result : funcs.add();
+    if (!result && (result = funcs.add()))
+        func_index.add(funcKey, USER_FUNC_KEY_LENGTH, funcs.size()-1);
+    return result;
 }
 
 int call_raw_user_function(void* data, const char* param, void* reserved)
@@ -139,7 +179,7 @@ bool spark_function_internal(const cloud_function_descriptor* desc, void* reserv
     User_Func_Lookup_Table_t* item = NULL;
     if (NULL != desc->fn && NULL != desc->funcKey && strlen(desc->funcKey)<=USER_FUNC_KEY_LENGTH)
     {
-        if ((item=find_func_by_key(desc->funcKey)) || (item = funcs.add()))
+        if ((item=find_func_by_key_or_add(desc->funcKey))!=NULL)
         {
             item->pUserFunc = desc->fn;
             item->pUserFuncData = desc->data;
@@ -377,9 +417,9 @@ const char* getUserVariableKey(int variable_index)
     return vars[variable_index].userVarKey;
 }
 
-SparkReturnType::Enum wrapVarTypeInEnum(const char *varKey)
+static SparkReturnType::Enum returnType(int varType)
 {
-    switch (userVarType(varKey))
+    switch (varType)
     {
         case 1:
             return SparkReturnType::BOOLEAN;
@@ -393,6 +433,80 @@ SparkReturnType::Enum wrapVarTypeInEnum(const char *varKey)
     }
 }
 
+SparkReturnType::Enum wrapVarTypeInEnum(const char *varKey)
+{
+    return returnType(userVarType(varKey));
+}
+
+/**
+ * Writes the functions and variables part of the describe message,
+ * "f":[...],"v":{...}, through put(data, length).
+ * @return the length written.
+ */
+template <typename Put> static size_t writeApplicationInfo(Put put)
+{
+    size_t length = 0;
+    auto write = [&](const char* data, size_t size) {
+        put(data, size);
+        length += size;
+    };
+    write("\"f\":[", 5);
+    for (unsigned i = 0; i < funcs.size(); i++)
+    {
+        if (i)
+            write(",", 1);
+        write("\"", 1);
+        write(funcs[i].userFuncKey, strnlen(funcs[i].userFuncKey, USER_FUNC_KEY_LENGTH));
+        write("\"", 1);
+    }
+    write("],\"v\":{", 7);
+    for (unsigned i = 0; i < vars.size(); i++)
+    {
+        if (i)
+            write(",", 1);
+        write("\"", 1);
+        write(vars[i].userVarKey, strnlen(vars[i].userVarKey, USER_VAR_KEY_LENGTH));
+        char type[3] = { '"', ':', char('0' + returnType(vars[i].userVarType)) };
+        write(type, sizeof(type));
+    }
+    write("}", 1);
+    return length;
+}
+
+/**
+ * Appends the functions and variables to the describe message. They are kept
+ * from one describe to the next until a function or variable is registered.
+ */
+bool appendApplicationInfo(appender_fn appender, void* append, void* reserved)
+{
+    if (application_info_changed)
+    {
+        free(application_info);
+        size_t length = writeApplicationInfo([](const char*, size_t) {});
+        application_info = (char*)malloc(length);
+        if (application_info)
+        {
+            char* p = application_info;
+            writeApplicationInfo([&p](const char* data, size_t size) {
+                memcpy(p, data, size);
+                p += size;
+            });
+            application_info_length = length;
+            application_info_changed = false;
+        }
+    }
+    if (!application_info)
+    {
+        // no room to keep it, write it straight to the message
+        bool result = true;
+        writeApplicationInfo([&](const char* data, size_t size) {
+            result = appender(append, (const uint8_t*)data, size) && result;
+        });
+        return result;
+    }
+    return appender(append, (const uint8_t*)application_info, application_info_length);
+}
+
 const char* CLAIM_EVENTS = "spark/device/claim/";
 const char* RESET_EVENT = "spark/device/reset";
 
@@ -511,6 +625,7 @@ void Spark_Protocol_Init(void)
         descriptor.was_ota_upgrade_successful = HAL_OTA_Flashed_GetStatus;
         descriptor.ota_upgrade_status_sent = HAL_OTA_Flashed_ResetStatus;
         descriptor.append_system_info = system_module_info;
+        descriptor.append_application_info = appendApplicationInfo;
         descriptor.call_event_handler = invokeEventHandler;
 
         // todo - this pushes a lot of data on the stack! refactor to remove heavy stack usage
@@ -601,9 +716,13 @@ void publish_system_module_info()
 int Spark_Handshake(bool presence_announce)
 {
 	DEBUG("starting handshake announce=%d", presence_announce);
+    system_tick_t start = HAL_Timer_Get_Milli_Seconds();
     int err = spark_protocol_handshake(sp);
+    system_tick_t elapsed = HAL_Timer_Get_Milli_Seconds() - start;
     if (!err)
     {
+        INFO("handshake took %lu ms", (unsigned long)elapsed);
+
         char buf[CLAIM_CODE_SIZE + 1];
         if (!HAL_Get_Claim_Code(buf, sizeof (buf)) && *buf)
         {
@@ -18,6 +18,8 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 #include "spark_wiring_cloud.h"
 #include "spark_wiring_system.h"
 #include "spark_wiring_stream.h"
@@ -40,6 +42,8 @@
 #include "system_version.h"
 #include "spark_macros.h"
 #include "system_network_internal.h"
+#include "delta_patch.h"
+#include "lz_stream.h"
 
 #ifdef START_DFU_FLASHER_SERIAL_SPEED
 static uint32_t start_dfu_flasher_serial_speed = START_DFU_FLASHER_SERIAL_SPEED;
@@ -205,6 +209,169 @@ void set_flag(void* flag)
 	*p = true;
 }
 
+/**
+ * A streamed update is decoded as its chunks come in, so they must come in
+ * order. A delta update is a patch against a module installed in internal
+ * flash, a compressed update was compressed as lz_stream.h describes, and an
+ * update can be both, a compressed patch. The module is staged where a full
+ * image would be, so HAL_FLASH_End takes it from there as usual.
+ */
+struct StreamedUpdate
+{
+    lz_stream_t* compressed;        // the first stage when the file is compressed
+    delta_patch_t* delta;
+    uint32_t target_address;
+    uint32_t received;              // bytes of the file taken so far
+    bool failed;
+};
+
+static StreamedUpdate* streamed_update = NULL;
+
+static int streamed_update_write_target(uint32_t offset, const uint8_t* data, uint32_t length, void* context)
+{
+    // the module must stay in the OTA region, whatever the update says about its size
+    if (offset + length > HAL_OTA_FlashLength())
+        return 1;
+    // a chunk that didn't verify is not written again, the update fails instead
+    return HAL_FLASH_Update(data, streamed_update->target_address + offset, length, NULL);
+}
+
+static int delta_update_begin(const delta_patch_info_t* info, void* context)
+{
+    // the patch must be for a module that is installed and memory mapped
+    hal_system_info_t system_info;
+    memset(&system_info, 0, sizeof(system_info));
+    system_info.size = sizeof(system_info);
+    HAL_System_Info(&system_info, true, NULL);
+    bool found = false;
+    for (unsigned i=0; i<system_info.module_count && !found; i++)
+    {
+        const hal_module_t& module = system_info.modules[i];
+        const module_info_t* module_info = module.info;
+        found = module_info && module.bounds.store==MODULE_STORE_MAIN
+            && module_function(module_info)==info->module_function
+            && module_index(module_info)==info->module_index
+            && module_info->module_version==info->module_version
+            && (uintptr_t)module_info->module_start_address==info->source_address
+            // the image includes the CRC after the module end
+            && info->source_length<=module_length(module_info)+4;
+    }
+    HAL_System_Info(&system_info, false, NULL);
+    // and the module it makes must fit where it is staged
+    return (found && info->target_length<=HAL_OTA_FlashLength()) ? 0 : 1;
+}
+
+static void delta_update_read_source(uint32_t address, uint8_t* buffer, uint32_t length, void* context)
+{
+    memcpy(buffer, (const void*)(uintptr_t)address, length);
+}
+
+static const delta_patch_callbacks_t delta_update_callbacks = {
+    delta_update_begin,
+    delta_update_read_source,
+    streamed_update_write_target
+};
+
+static int compressed_update_write(uint32_t offset, const uint8_t* data, uint32_t length, void* context)
+{
+    if (streamed_update->delta)
+        return delta_patch_apply(streamed_update->delta, data, length);
+    return streamed_update_write_target(offset, data, length, context);
+}
+
+static void streamed_update_free()
+{
+    if (streamed_update)
+    {
+        free(streamed_update->compressed);
+        free(streamed_update->delta);
+        free(streamed_update);
+        streamed_update = NULL;
+    }
+}
+
+static bool streamed_update_begin(FileTransfer::Descriptor& file)
+{
+    streamed_update = (StreamedUpdate*)calloc(1, sizeof(StreamedUpdate));
+    if (!streamed_update)
+        return false;
+    streamed_update->target_address = file.file_address;
+    if (file.flags & FileTransfer::Flags::COMPRESSED)
+    {
+        streamed_update->compressed = (lz_stream_t*)malloc(sizeof(lz_stream_t));
+        if (streamed_update->compressed)
+        {
+            lz_stream_init(streamed_update->compressed, compressed_update_write, NULL);
+            // a compressed module must fit where it is staged, a compressed patch is checked by delta_update_begin
+            if (!(file.flags & FileTransfer::Flags::DELTA))
+                lz_stream_limit(streamed_update->compressed, HAL_OTA_FlashLength());
+        }
+        else
+            streamed_update->failed = true;
+    }
+    if (file.flags & FileTransfer::Flags::DELTA)
+    {
+        streamed_update->delta = (delta_patch_t*)malloc(sizeof(delta_patch_t));
+        if (streamed_update->delta)
+            delta_patch_init(streamed_update->delta, &delta_update_callbacks, NULL);
+        else
+            streamed_update->failed = true;
+    }
+    if (streamed_update->failed)
+        streamed_update_free();
+    return streamed_update!=NULL;
+}
+
+static int streamed_update_chunk(FileTransfer::Descriptor& file, const uint8_t* chunk)
+{
+    uint32_t offset = file.chunk_address - file.file_address;
+    if (offset < streamed_update->received)     // sent again, already applied
+        return 0;
+    int result = -1;
+    if (offset == streamed_update->received && !streamed_update->failed)
+    {
+        streamed_update->received += file.chunk_size;
+        if (streamed_update->compressed)
+            result = lz_stream_apply(streamed_update->compressed, chunk, file.chunk_size);
+        else
+            result = delta_patch_apply(streamed_update->delta, chunk, file.chunk_size);
+    }
+    // a chunk that is missing or could not be decoded fails the whole update
+    if (result)
+        streamed_update->failed = true;
+    return result;
+}
+
+/**
+ * Decodes the rest of the update.
+ * @return {@code true} if the staged module is complete and the one the update was made for.
+ */
+static bool streamed_update_end()
+{
+    bool success = !streamed_update->failed;
+    if (success && streamed_update->compressed)
+        success = lz_stream_finish(streamed_update->compressed)==LZ_STREAM_OK;
+    if (success && streamed_update->delta)
+        success = delta_patch_finish(streamed_update->delta)==DELTA_PATCH_OK;
+    streamed_update_free();
+    return success;
+}
+
+/**
+ * The module info only changes with a firmware update, yet it is rendered
+ * for each describe, and more than once when the describe is sent in blocks.
+ * It is rendered once into this and then copied out.
+ */
+static uint8_t* module_info_json = NULL;
+static size_t module_info_length = 0;
+
+static void invalidate_module_info()
+{
+    free(module_info_json);
+    module_info_json = NULL;
+    module_info_length = 0;
+}
+
 int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t flags, void* reserved)
 {
     if (file.store==FileTransfer::Store::FIRMWARE)
@@ -239,7 +406,19 @@ int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t f
             SPARK_FLASH_UPDATE = 1;
             TimingFlashUpdateTimeout = 0;
             system_notify_event(firmware_update, firmware_update_begin, &file);
-            HAL_FLASH_Begin(file.file_address, file.file_length, NULL);
+            streamed_update_free();
+            if (file.store==FileTransfer::Store::FIRMWARE && (file.flags & (FileTransfer::Flags::DELTA|FileTransfer::Flags::COMPRESSED)))
+            {
+                // the size of the module is only known once its header is in, so make room for the largest
+                if (streamed_update_begin(file))
+                    HAL_FLASH_Begin(file.file_address, HAL_OTA_FlashLength(), NULL);
+                else
+                    result = 1;
+            }
+            else
+            {
+                HAL_FLASH_Begin(file.file_address, file.file_length, NULL);
+            }
         }
         else
         {
@@ -306,12 +485,15 @@ int Spark_Finish_Firmware_Update(FileTransfer::Descriptor& file, uint32_t flags,
 {
     SPARK_FLASH_UPDATE = 0;
     TimingFlashUpdateTimeout = 0;
+    invalidate_module_info();
     //DEBUG("update finished flags=%d store=%d", flags, file.store);
 
     if (flags & 1) {    // update successful
         if (file.store==FileTransfer::Store::FIRMWARE)
         {
-            hal_update_complete_t result = HAL_FLASH_End(NULL);
+            hal_update_complete_t result = HAL_UPDATE_ERROR;
+            if (!streamed_update || streamed_update_end())
+                result = HAL_FLASH_End(NULL);
             system_notify_event(firmware_update, result!=HAL_UPDATE_ERROR ? firmware_update_complete : firmware_update_failed, &file);
 
             // always restart for now
@@ -323,6 +505,7 @@ int Spark_Finish_Firmware_Update(FileTransfer::Descriptor& file, uint32_t flags,
     }
     else
     {
+        streamed_update_free();
         system_notify_event(firmware_update, firmware_update_failed, &file);
     }
     RGB.control(false);
@@ -336,7 +519,10 @@ int Spark_Save_Firmware_Chunk(FileTransfer::Descriptor& file, const uint8_t* chu
     system_notify_event(firmware_update, firmware_update_progress, &file);
     if (file.store==FileTransfer::Store::FIRMWARE)
     {
-        result = HAL_FLASH_Update(chunk, file.chunk_address, file.chunk_size, NULL);
+        if (streamed_update)
+            result = streamed_update_chunk(file, chunk);
+        else
+            result = HAL_FLASH_Update(chunk, file.chunk_address, file.chunk_size, reserved);
         LED_Toggle(LED_RGB);
     }
     return result;
@@ -482,7 +668,7 @@ bool system_info_to_json(appender_fn append, void* append_data, hal_system_info_
 }
 
 
-bool system_module_info(appender_fn append, void* append_data, void* reserved)
+static bool system_module_info_uncached(appender_fn append, void* append_data)
 {
     hal_system_info_t info;
     memset(&info, 0, sizeof(info));
@@ -493,6 +679,43 @@ bool system_module_info(appender_fn append, void* append_data, void* reserved)
     return result;
 }
 
+/**
+ * Counts the bytes appended without keeping them.
+ */
+class LengthAppender : public Appender
+{
+    size_t count;
+
+public:
+    LengthAppender() : count(0) {}
+
+    bool append(const uint8_t* data, size_t length) override {
+        count += length;
+        return true;
+    }
+
+    size_t length() const { return count; }
+};
+
+bool system_module_info(appender_fn append, void* append_data, void* reserved)
+{
+    if (!module_info_json) {
+        LengthAppender measure;
+        system_module_info_uncached(append_instance, &measure);
+        uint8_t* json = (uint8_t*)malloc(measure.length());
+        if (!json)
+            return system_module_info_uncached(append, append_data);
+        BufferAppender buffer(json, measure.length());
+        if (!system_module_info_uncached(append_instance, &buffer)) {
+            free(json);
+            return system_module_info_uncached(append, append_data);
+        }
+        module_info_json = json;
+        module_info_length = measure.length();
+    }
+    return append(append_data, module_info_json, module_info_length);
+}
+
 bool append_system_version_info(Appender* appender)
 {
     bool result = appender->append("system firmware version: " stringify(SYSTEM_VERSION_STRING)
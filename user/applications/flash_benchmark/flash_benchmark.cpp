@@ -0,0 +1,70 @@
+#include "application.h"
+#include "sst25vf_spi.h"
+
+/*
+ * Measures the external SPI flash throughput on bluz.
+ *
+ * The "per byte" figures issue one flash command per byte, which is what
+ * sFLASH_ReadBuffer and sFLASH_WriteBuffer used to cost when every byte was
+ * its own SPI transaction. The "burst" figures go through the bulk transfer
+ * path. Results are printed on Serial1.
+ *
+ * WARNING: this erases and rewrites the scratch sector at FLASH_FW_ADDRESS,
+ * which is the OTA staging area.
+ */
+
+SYSTEM_MODE(MANUAL);
+
+const uint32_t TEST_ADDRESS = FLASH_FW_ADDRESS;
+const uint32_t TEST_LENGTH = 2048;
+
+uint8_t buffer[TEST_LENGTH];
+
+void report(const char* name, uint32_t bytes, uint32_t micros)
+{
+    Serial1.printlnf("%-16s %5lu bytes in %7lu us: %lu KB/s", name, bytes, micros,
+                     micros ? (bytes * 1000UL) / micros : 0);
+}
+
+void setup() {
+    Serial1.begin(38400);
+    Serial1.println("SPI flash benchmark");
+
+    for (uint32_t i = 0; i < TEST_LENGTH; i++) {
+        buffer[i] = i;
+    }
+
+    uint32_t start;
+
+    sFLASH_EraseSector(TEST_ADDRESS);
+    start = micros();
+    for (uint32_t i = 0; i < TEST_LENGTH; i++) {
+        sFLASH_WriteSingleByte(TEST_ADDRESS + i, buffer[i]);
+    }
+    report("write per byte", TEST_LENGTH, micros() - start);
+
+    start = micros();
+    for (uint32_t i = 0; i < TEST_LENGTH; i++) {
+        buffer[i] = sFLASH_ReadSingleByte(TEST_ADDRESS + i);
+    }
+    report("read per byte", TEST_LENGTH, micros() - start);
+
+    sFLASH_EraseSector(TEST_ADDRESS);
+    start = micros();
+    sFLASH_WriteBuffer(buffer, TEST_ADDRESS, TEST_LENGTH);
+    report("write burst", TEST_LENGTH, micros() - start);
+
+    start = micros();
+    sFLASH_ReadBuffer(buffer, TEST_ADDRESS, TEST_LENGTH);
+    report("read burst", TEST_LENGTH, micros() - start);
+
+    for (uint32_t i = 0; i < TEST_LENGTH; i++) {
+        if (buffer[i] != (uint8_t)i) {
+            Serial1.printlnf("Verify failed at offset %lu", i);
+            break;
+        }
+    }
+}
+
+void loop() {
+}
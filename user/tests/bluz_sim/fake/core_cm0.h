@@ -0,0 +1,24 @@
+/* Host build of the Cortex-M0 core header.
+ *
+ * The real header maps the core peripherals to fixed addresses. The few the drivers
+ * read on the data path are pointed at plain memory instead, see sim_softdevice.c.
+ */
+#include_next "core_cm0.h"
+
+#ifndef SIM_CORE_CM0_H
+#define SIM_CORE_CM0_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern SCB_Type sim_scb;
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef SCB
+#define SCB (&sim_scb)
+
+#endif /* SIM_CORE_CM0_H */
@@ -0,0 +1,15 @@
+/* Host build of the CMSIS core register access. The simulation runs interrupts
+ * synchronously, so masking them has nothing to do.
+ */
+#ifndef __CORE_CMFUNC_H
+#define __CORE_CMFUNC_H
+
+#include <stdint.h>
+
+static inline void __enable_irq(void) { }
+static inline void __disable_irq(void) { }
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask) { (void)priMask; }
+static inline uint32_t __get_IPSR(void) { return 0; }
+
+#endif /* __CORE_CMFUNC_H */
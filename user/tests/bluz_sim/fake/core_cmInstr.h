@@ -0,0 +1,16 @@
+/* Host build of the CMSIS core instructions, just the ones the firmware uses. */
+#ifndef __CORE_CMINSTR_H
+#define __CORE_CMINSTR_H
+
+#include <stdint.h>
+
+static inline void __NOP(void) { }
+static inline void __WFI(void) { }
+static inline void __WFE(void) { }
+static inline void __SEV(void) { }
+static inline void __ISB(void) { __sync_synchronize(); }
+static inline void __DSB(void) { __sync_synchronize(); }
+static inline void __DMB(void) { __sync_synchronize(); }
+static inline uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+
+#endif /* __CORE_CMINSTR_H */
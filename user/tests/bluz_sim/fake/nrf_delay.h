@@ -0,0 +1,29 @@
+/* Host build of the busy wait delays. Waiting lets simulated time pass, so events
+ * the firmware is waiting for (TX complete, SPI transfers) arrive meanwhile.
+ */
+#ifndef _NRF_DELAY_H
+#define _NRF_DELAY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sim_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline void nrf_delay_us(uint32_t volatile number_of_us)
+{
+    sim_delay_us(number_of_us);
+}
+
+static inline void nrf_delay_ms(uint32_t volatile number_of_ms)
+{
+    sim_delay_us(number_of_ms * 1000);
+}
+
+#endif /* _NRF_DELAY_H */
@@ -0,0 +1,43 @@
+/* Host build of the GPIO HAL. The types come from the real header, the pin accessors
+ * it defines are renamed out of the way and replaced by ones working on the simulated
+ * pins of the node, so the host can watch and drive the handshake lines.
+ */
+#ifndef SIM_NRF_GPIO_H
+#define SIM_NRF_GPIO_H
+
+#define nrf_gpio_cfg_output         nrf_gpio_cfg_output_hw
+#define nrf_gpio_cfg_input          nrf_gpio_cfg_input_hw
+#define nrf_gpio_pin_set            nrf_gpio_pin_set_hw
+#define nrf_gpio_pin_clear          nrf_gpio_pin_clear_hw
+#define nrf_gpio_pin_toggle         nrf_gpio_pin_toggle_hw
+#define nrf_gpio_pin_write          nrf_gpio_pin_write_hw
+#define nrf_gpio_pin_read           nrf_gpio_pin_read_hw
+#include_next "nrf_gpio.h"
+#undef nrf_gpio_cfg_output
+#undef nrf_gpio_cfg_input
+#undef nrf_gpio_pin_set
+#undef nrf_gpio_pin_clear
+#undef nrf_gpio_pin_toggle
+#undef nrf_gpio_pin_write
+#undef nrf_gpio_pin_read
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sim_gpio_write(uint32_t pin_number, uint32_t value);
+uint32_t sim_gpio_read(uint32_t pin_number);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline void nrf_gpio_cfg_output(uint32_t pin_number) { (void)pin_number; }
+static inline void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config) { (void)pin_number; (void)pull_config; }
+static inline void nrf_gpio_pin_set(uint32_t pin_number) { sim_gpio_write(pin_number, 1); }
+static inline void nrf_gpio_pin_clear(uint32_t pin_number) { sim_gpio_write(pin_number, 0); }
+static inline void nrf_gpio_pin_toggle(uint32_t pin_number) { sim_gpio_write(pin_number, !sim_gpio_read(pin_number)); }
+static inline void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value) { sim_gpio_write(pin_number, value); }
+static inline uint32_t nrf_gpio_pin_read(uint32_t pin_number) { return sim_gpio_read(pin_number); }
+
+#endif /* SIM_NRF_GPIO_H */
@@ -0,0 +1,113 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLUZ_SIM_H
+#define BLUZ_SIM_H
+
+/* Interface between the simulated world and the nodes in it.
+ *
+ * A node is the data path firmware of one board, the peripheral (PLATFORM_ID 103) or the
+ * gateway (PLATFORM_ID 269), built for the host as a shared object around a fake SoftDevice
+ * and SPI slave driver. The two platforms define the same symbols, so every node is loaded
+ * into its own namespace and only talks to the host through the functions below.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_MAX_PACKET_SIZE     32      /**< Largest packet payload the air carries, the ATT MTU is 23. */
+
+/**@brief Kinds of packet carried over the simulated air. */
+typedef enum
+{
+    SIM_PACKET_NOTIFICATION,            /**< Peripheral to gateway, from sd_ble_gatts_hvx. */
+    SIM_PACKET_WRITE_CMD,               /**< Gateway to peripheral, from sd_ble_gattc_write without response. */
+    SIM_PACKET_WRITE_REQ,               /**< Gateway to peripheral, from sd_ble_gattc_write with response. */
+    SIM_PACKET_WRITE_RSP                /**< Peripheral to gateway, the answer to a write request. */
+} sim_packet_type_t;
+
+/**@brief Attribute handles of the SCS service of a peripheral, as the gateway discovers them. */
+typedef struct
+{
+    uint16_t    up_value_handle;        /**< Characteristic the peripheral notifies. */
+    uint16_t    up_cccd_handle;         /**< Its client characteristic configuration descriptor. */
+    uint16_t    dn_value_handle;        /**< Characteristic the gateway writes. */
+} sim_gatt_t;
+
+/**@brief Entry points of a node, exported as the symbol "sim_node".
+ *
+ * Everything is called from the host, which stands in for the interrupts of the board:
+ * packets, TX complete and SPI transfers are delivered as they would be by the SoftDevice
+ * and the SPI slave peripheral.
+ */
+typedef struct
+{
+    uint16_t    platform_id;
+
+    void     (* init)(uint8_t node_id, uint8_t tx_buffers);                /**< Brings the modules up as the firmware does at boot. */
+    void     (* loop)(void);                                                /**< One pass of the main loop. */
+
+    void     (* connected)(uint16_t conn_handle, const sim_gatt_t * p_gatt);    /**< A link came up, the gateway discovers p_gatt. */
+    void     (* gatt)(sim_gatt_t * p_gatt);                                 /**< Peripheral: the handles of its service. */
+    void     (* packet)(uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t * p_data, uint16_t len);
+    void     (* tx_complete)(uint16_t conn_handle, uint8_t count);
+
+    /* gateway: the SPI slave and its handshake lines */
+    uint16_t (* spi_transfer)(const uint8_t * p_mosi, uint8_t * p_miso, uint16_t len);
+    uint32_t (* pin_read)(uint32_t pin);
+    void     (* pin_write)(uint32_t pin, uint32_t value);
+
+    /* peripheral: the socket an application uses to talk to the cloud */
+    int32_t  (* socket_open)(void);
+    int32_t  (* socket_send)(int32_t sd, const void * p_buffer, uint32_t len);
+    int32_t  (* socket_receive)(int32_t sd, void * p_buffer, uint32_t len);
+} sim_node_t;
+
+/* Provided by the host, called by the nodes. */
+
+uint32_t sim_host_millis(void);
+
+/**@brief Lets simulated time pass while a node busy waits. Events for the nodes are
+ *        delivered meanwhile, as interrupts would be.
+ */
+void sim_host_delay_us(uint8_t node_id, uint32_t us);
+
+/**@brief Lets simulated time pass up to the next event for any node, as sd_app_evt_wait sleeps
+ *        until the next interrupt.
+ */
+void sim_host_wait_event(uint8_t node_id);
+
+/**@brief Puts a packet on the air. The SoftDevice of the node has already accounted for the buffer. */
+void sim_host_send(uint8_t node_id, uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t * p_data, uint16_t len);
+
+/**@brief Bookkeeping for the benchmark: bytes the firmware copied, and how deep its stack got. */
+void sim_host_copied(size_t len);
+void sim_host_stack_probe(void);
+
+/**@brief Stops the run, the firmware hit APP_ERROR_CHECK or something it can't get out of. */
+void sim_host_fatal(uint8_t node_id, const char * p_message, uint32_t code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLUZ_SIM_H */
@@ -0,0 +1,122 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "catch.hpp"
+#include "sim_host.h"
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// about what the cloud protocol puts in one message
+const size_t MESSAGE_SIZE = 512;
+const int MESSAGES = 40;
+
+std::vector<uint8_t> message(int index)
+{
+    std::vector<uint8_t> data(MESSAGE_SIZE);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 7 + index);
+    }
+    return data;
+}
+
+void report(const char* name, const Sim& sim, int peripherals, size_t bytes, uint64_t started)
+{
+    double seconds = (sim.now_us() - started) / 1e6;
+    uint64_t peripheralCopied = 0;
+    size_t peripheralStack = 0, peripheralHeap = 0;
+    for (int i = 0; i < peripherals; i++) {
+        peripheralCopied += sim.peripheral_stats(i).bytes_copied;
+        peripheralStack = std::max(peripheralStack, sim.peripheral_stats(i).stack_peak);
+        peripheralHeap = std::max(peripheralHeap, sim.peripheral_stats(i).heap_peak);
+    }
+    const SimNodeStats& gateway = sim.gateway_stats();
+
+    printf("%s: %zu bytes in %.2f s, %.0f bytes/s\n", name, bytes, seconds, bytes / seconds);
+    printf("    copies per byte: peripheral %.2f, gateway %.2f\n",
+            (double)peripheralCopied / bytes, (double)gateway.bytes_copied / bytes);
+    printf("    peak stack: peripheral %zu, gateway %zu bytes (host frames, compare runs only)\n",
+            peripheralStack, gateway.stack_peak);
+    printf("    peak heap: peripheral %zu, gateway %zu bytes\n", peripheralHeap, gateway.heap_peak);
+    printf("    packets: %llu up, %llu down\n", (unsigned long long)sim.packets_up(), (unsigned long long)sim.packets_down());
+}
+
+} // namespace
+
+TEST_CASE("Uplink benchmark, socket to cloud", "[bluz_sim][benchmark]") {
+    Sim sim;
+    REQUIRE(sim.start());
+    sim.reset_stats();
+
+    std::vector<uint8_t> expected;
+    uint64_t started = sim.now_us();
+    for (int i = 0; i < MESSAGES; i++) {
+        std::vector<uint8_t> data = message(i);
+        sim.device_send(0, data.data(), data.size());
+        expected.insert(expected.end(), data.begin(), data.end());
+    }
+    REQUIRE(sim.run_until([&] { return sim.cloud_received(0).size() >= expected.size(); }, 600000000));
+    CHECK(sim.cloud_received(0) == expected);
+    report("uplink", sim, 1, expected.size(), started);
+}
+
+TEST_CASE("Downlink benchmark, cloud to socket", "[bluz_sim][benchmark]") {
+    Sim sim;
+    REQUIRE(sim.start());
+    sim.reset_stats();
+
+    std::vector<uint8_t> expected;
+    uint64_t started = sim.now_us();
+    for (int i = 0; i < MESSAGES; i++) {
+        std::vector<uint8_t> data = message(i);
+        sim.cloud_send(0, data.data(), data.size());
+        expected.insert(expected.end(), data.begin(), data.end());
+    }
+    REQUIRE(sim.run_until([&] { return sim.device_received(0).size() >= expected.size(); }, 600000000));
+    CHECK(sim.device_received(0) == expected);
+    report("downlink", sim, 1, expected.size(), started);
+}
+
+TEST_CASE("Downlink benchmark, three peripherals", "[bluz_sim][benchmark]") {
+    SimConfig config;
+    config.peripherals = 3;
+    config.downlink_window = 320;
+    Sim sim(config);
+    REQUIRE(sim.start());
+    sim.reset_stats();
+
+    std::vector<uint8_t> expected;
+    uint64_t started = sim.now_us();
+    for (int i = 0; i < MESSAGES; i++) {
+        std::vector<uint8_t> data = message(i);
+        sim.cloud_send(i % 3, data.data(), data.size());
+        if (i % 3 == 0) {
+            expected.insert(expected.end(), data.begin(), data.end());
+        }
+    }
+    REQUIRE(sim.run_until([&] {
+        size_t total = 0;
+        for (int i = 0; i < 3; i++) {
+            total += sim.device_received(i).size();
+        }
+        return total >= MESSAGES * MESSAGE_SIZE;
+    }, 600000000));
+    CHECK(sim.device_received(0) == expected);
+    report("downlink, 3 peripherals", sim, 3, MESSAGES * MESSAGE_SIZE, started);
+}
@@ -0,0 +1,40 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_COPY_H
+#define SIM_COPY_H
+
+/* Included ahead of every module under test, so each memcpy it makes is counted by the
+ * host. The library headers are pulled in first and keep the real declaration.
+ */
+
+#ifdef __cplusplus
+#include <cstring>
+extern "C" {
+#else
+#include <string.h>
+#endif
+
+void * sim_memcpy(void * dest, const void * src, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define memcpy sim_memcpy
+
+#endif /* SIM_COPY_H */
@@ -0,0 +1,80 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The gateway node: client_handling.c and the SPI slave stream between the peripherals and
+ * the Photon, driven by gateway_loop as on the board.
+ */
+
+#include <cstring>
+#include "sim_softdevice.h"
+
+extern "C" {
+#include "hw_gateway_config.h"
+#include "client_handling.h"
+
+void ble_evt_dispatch(ble_evt_t * p_ble_evt)
+{
+    client_handling_ble_evt_handler(p_ble_evt);
+}
+
+void sys_evt_dispatch(uint32_t sys_evt)
+{
+}
+}
+
+namespace {
+
+void init(uint8_t node_id, uint8_t tx_buffers)
+{
+    sim_softdevice_init(node_id, tx_buffers);
+    gateway_init();
+}
+
+void connected(uint16_t conn_handle, const sim_gatt_t * p_gatt)
+{
+    dm_handle_t handle;
+    memset(&handle, 0, sizeof(handle));
+    handle.connection_id = conn_handle;
+
+    ble_gap_addr_t address;
+    memset(&address, 0, sizeof(address));
+    address.addr[0] = 0xB1;
+    address.addr[1] = conn_handle;
+
+    sim_softdevice_connected(conn_handle);
+    sim_softdevice_peer_gatt(conn_handle, p_gatt);
+    m_peer_count++;
+    client_handling_create(&handle, conn_handle, &address);
+}
+
+} // namespace
+
+extern "C" __attribute__((visibility("default"))) const sim_node_t sim_node = {
+    269,
+    init,
+    gateway_loop,
+    connected,
+    NULL,
+    sim_softdevice_packet,
+    sim_softdevice_tx_complete,
+    sim_spi_slave_transfer,
+    sim_gpio_read,
+    sim_gpio_write,
+    NULL,
+    NULL,
+    NULL
+};
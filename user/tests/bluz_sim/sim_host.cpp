@@ -0,0 +1,693 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sim_host.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+// the handshake lines of the gateway, as in spi_slave_stream.h
+const uint32_t SPIS_PTS_PIN = 14;
+const uint32_t SPIS_MR_PIN = 13;
+const uint32_t SPIS_SA_PIN = 12;
+const uint16_t SPI_TRANSFER_SIZE = 255;
+
+// messages on the SPI bus: length, peripheral id, then the service, command and socket
+const size_t SPI_MESSAGE_HEADER_SIZE = 5;
+const uint8_t SOCKET_DATA_SERVICE = 1;
+enum { SOCKET_DATA, SOCKET_CONNECT, SOCKET_DISCONNECT };
+
+// a node busy waiting this long in an interrupt handler waits for something that can't happen
+const uint64_t INTERRUPT_STALL_US = 10000000;
+// and no socket call takes this long
+const uint64_t MAIN_STALL_US = 600000000;
+
+Sim* current = nullptr;
+
+} // namespace
+
+/* Heap use of the nodes: whatever is allocated while a node is on top of the host stack
+ * is charged to it. Each block remembers its size and owner in front of it.
+ */
+
+void* operator new(size_t size)
+{
+    size_t* block = static_cast<size_t*>(malloc(size + 2 * sizeof(size_t)));
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    int node = current ? current->current_node() : -1;
+    block[0] = size;
+    block[1] = node + 1;
+    if (node >= 0) {
+        current->heap_alloc(node, size);
+    }
+    return block + 2;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr == nullptr) {
+        return;
+    }
+    size_t* block = static_cast<size_t*>(ptr) - 2;
+    if (block[1] != 0 && current != nullptr) {
+        current->heap_free(block[1] - 1, block[0]);
+    }
+    free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+extern "C" {
+
+uint32_t sim_host_millis(void)
+{
+    return current->now_us() / 1000;
+}
+
+void sim_host_delay_us(uint8_t node_id, uint32_t us)
+{
+    current->delay(node_id, us);
+}
+
+void sim_host_wait_event(uint8_t node_id)
+{
+    current->wait_event(node_id);
+}
+
+void sim_host_send(uint8_t node_id, uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t* p_data, uint16_t len)
+{
+    current->send(node_id, conn_handle, type, handle, p_data, len);
+}
+
+void sim_host_copied(size_t len)
+{
+    current->copied(len);
+}
+
+void sim_host_stack_probe(void)
+{
+    current->stack_probe(static_cast<const char*>(__builtin_frame_address(0)));
+}
+
+void sim_host_fatal(uint8_t node_id, const char* p_message, uint32_t code)
+{
+    // the firmware can't be unwound, so this ends the run
+    fprintf(stderr, "bluz_sim: node %d stopped at %.3f s: %s (0x%x)\n", node_id,
+            current ? current->now_us() / 1e6 : 0.0, p_message ? p_message : "", (unsigned)code);
+    abort();
+}
+
+}
+
+/* Every call into a node goes through one of these, so the host knows which node is
+ * running and where its stack started.
+ */
+
+template <typename F> void Sim::call_main(int node, F f)
+{
+    Node& n = nodes[node];
+    uint64_t started = n.mainStarted;
+    if (n.mainDepth++ == 0) {
+        n.mainStarted = now;
+    }
+    entries.push_back({ node, static_cast<const char*>(__builtin_frame_address(0)) });
+    f();
+    entries.pop_back();
+    if (--n.mainDepth == 0) {
+        n.mainStarted = started;
+    }
+}
+
+template <typename F> void Sim::call_interrupt(int node, F f)
+{
+    Node& n = nodes[node];
+    n.interruptDepth++;
+    entries.push_back({ node, static_cast<const char*>(__builtin_frame_address(0)) });
+    f();
+    entries.pop_back();
+    if (--n.interruptDepth == 0) {
+        n.interruptDelay = 0;
+    }
+}
+
+Sim::Sim(const SimConfig& config) : config(config)
+{
+    if (current != nullptr) {
+        throw std::logic_error("only one Sim at a time");
+    }
+    if (config.peripherals < 1 || config.peripherals > 3) {
+        throw std::invalid_argument("the gateway takes 1 to 3 peripherals");
+    }
+    current = this;
+    // pushing an entry must never allocate, or the node underneath would be charged for it
+    entries.reserve(64);
+}
+
+Sim::~Sim()
+{
+    for (Node& node : nodes) {
+        if (node.library != nullptr) {
+            dlclose(node.library);
+        }
+    }
+    current = nullptr;
+}
+
+void Sim::load(int index, const char* name)
+{
+    Node& node = nodes[index];
+
+    // the nodes are next to the runner
+    char exe[4096];
+    ssize_t length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (length <= 0) {
+        throw std::runtime_error("can't find the runner");
+    }
+    exe[length] = 0;
+    std::string path(exe);
+    path = path.substr(0, path.rfind('/') + 1) + name;
+
+    // the loader shares a library opened twice, so every node is loaded from its own copy
+    // and starts with statics of its own
+    char copy[] = "/tmp/bluz_sim_XXXXXX.so";
+    int out = mkstemps(copy, 3);
+    int in = open(path.c_str(), O_RDONLY);
+    if (out < 0 || in < 0) {
+        throw std::runtime_error("can't copy " + path);
+    }
+    char buffer[65536];
+    ssize_t count;
+    while ((count = read(in, buffer, sizeof(buffer))) > 0) {
+        if (write(out, buffer, count) != count) {
+            throw std::runtime_error("can't copy " + path);
+        }
+    }
+    close(in);
+    close(out);
+
+    entries.push_back({ index, static_cast<const char*>(__builtin_frame_address(0)) });
+    node.library = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+    entries.pop_back();
+    unlink(copy);
+    if (node.library == nullptr) {
+        throw std::runtime_error(dlerror());
+    }
+    node.api = static_cast<const sim_node_t*>(dlsym(node.library, "sim_node"));
+    if (node.api == nullptr) {
+        throw std::runtime_error(path + " is not a node");
+    }
+}
+
+bool Sim::start()
+{
+    nodes.resize(1 + config.peripherals);
+    load(0, "gateway.so");
+    for (int i = 0; i < config.peripherals; i++) {
+        load(1 + i, "peripheral.so");
+    }
+
+    call_main(0, [&] { gateway().api->init(0, config.gateway_tx_buffers); });
+    for (int i = 0; i < config.peripherals; i++) {
+        call_main(1 + i, [&] { peripheral(i).api->init(1 + i, config.peripheral_tx_buffers); });
+        clouds.push_back(Cloud());
+    }
+    nextTick = now + config.loop_period_us;
+
+    // the links come up one after the other, their connection events spread over the interval
+    for (int i = 0; i < config.peripherals; i++) {
+        Link link;
+        link.peripheral = 1 + i;
+        link.gatewayConn = i;
+        link.peripheralConn = 0;
+        link.nextEvent = now + config.connection_interval_us + i * config.connection_interval_us / config.peripherals;
+        links.push_back(link);
+
+        sim_gatt_t gatt;
+        Node& p = peripheral(i);
+        call_interrupt(1 + i, [&] {
+            p.api->connected(0, nullptr);
+            p.api->gatt(&gatt);
+        });
+        call_interrupt(0, [&] { gateway().api->connected(i, &gatt); });
+    }
+    if (!run_until([&] {
+            return std::all_of(links.begin(), links.end(), [](const Link& link) { return link.ready; });
+        }, 1000000)) {
+        return false;
+    }
+
+    for (int i = 0; i < config.peripherals; i++) {
+        Node& p = peripheral(i);
+        call_main(1 + i, [&] { p.socket = p.api->socket_open(); });
+    }
+    return run_until([&] {
+        return std::all_of(clouds.begin(), clouds.end(), [](const Cloud& cloud) { return cloud.connected; });
+    }, 1000000);
+}
+
+void Sim::run_for(uint64_t us)
+{
+    process_until(now + us);
+}
+
+bool Sim::run_until(const std::function<bool()>& done, uint64_t timeout_us)
+{
+    uint64_t deadline = now + timeout_us;
+    while (!done()) {
+        if (now >= deadline) {
+            return false;
+        }
+        process_until(std::min(next_event(), deadline));
+    }
+    return true;
+}
+
+void Sim::process_until(uint64_t target)
+{
+    while (true) {
+        uint64_t next = next_event();
+        if (next > target) {
+            break;
+        }
+        now = next;
+        for (Link& link : links) {
+            if (link.nextEvent <= now) {
+                connection_event(link);
+            }
+        }
+        if (master.busy && master.doneAt <= now) {
+            master_transfer_done();
+        }
+        if (nextTick <= now) {
+            tick();
+        }
+    }
+    now = std::max(now, target);
+}
+
+uint64_t Sim::next_event() const
+{
+    uint64_t next = nextTick;
+    for (const Link& link : links) {
+        next = std::min(next, link.nextEvent);
+    }
+    if (master.busy) {
+        next = std::min(next, master.doneAt);
+    }
+    return next;
+}
+
+void Sim::connection_event(Link& link)
+{
+    Node& p = nodes[link.peripheral];
+    Node& g = gateway();
+    link.nextEvent += config.connection_interval_us;
+
+    // the SoftDevice events wait for the interrupt handler the application is in, and with
+    // them the buffers, so nothing moves on this link until it returns
+    if (p.interruptDepth > 0 || g.interruptDepth > 0) {
+        return;
+    }
+
+    uint8_t written = 0;
+    for (int i = 0; i < config.packets_per_event && !link.down.empty(); i++) {
+        Packet packet = link.down.front();
+        link.down.pop_front();
+        packetsDown++;
+        if (packet.type == SIM_PACKET_WRITE_CMD) {
+            written++;
+        }
+        call_interrupt(link.peripheral, [&] {
+            p.api->packet(link.peripheralConn, packet.type, packet.handle, packet.data, packet.len);
+        });
+    }
+    if (written > 0) {
+        call_interrupt(0, [&] { g.api->tx_complete(link.gatewayConn, written); });
+    }
+
+    uint8_t notified = 0;
+    for (int i = 0; i < config.packets_per_event && !link.up.empty(); i++) {
+        Packet packet = link.up.front();
+        link.up.pop_front();
+        packetsUp++;
+        if (packet.type == SIM_PACKET_NOTIFICATION) {
+            notified++;
+        } else if (packet.type == SIM_PACKET_WRITE_RSP) {
+            link.ready = true;
+        }
+        call_interrupt(0, [&] {
+            g.api->packet(link.gatewayConn, packet.type, packet.handle, packet.data, packet.len);
+        });
+    }
+    if (notified > 0) {
+        call_interrupt(link.peripheral, [&] { p.api->tx_complete(link.peripheralConn, notified); });
+    }
+
+    master_poll();
+}
+
+void Sim::tick()
+{
+    nextTick = now + config.loop_period_us;
+
+    // a board that is busy waiting, in its main loop or an interrupt, doesn't get round
+    for (size_t i = 0; i < nodes.size(); i++) {
+        Node& node = nodes[i];
+        if (node.mainDepth > 0 || node.interruptDepth > 0) {
+            continue;
+        }
+        call_main(i, [&] { node.api->loop(); });
+        if (i > 0 && config.auto_receive && node.socket >= 0) {
+            device_receive(i - 1);
+        }
+    }
+    master_poll();
+}
+
+/* The Photon, the SPI master. It raises MR when the gateway has something for it, reads
+ * the size of the burst and then the burst in chunks while the gateway raises SA. When the
+ * bus is quiet it writes cloud data for the peripherals, a message at a time in transfers
+ * of 255 bytes, the last one shorter.
+ */
+
+void Sim::master_poll()
+{
+    if (master.busy) {
+        return;
+    }
+    const sim_node_t* api = gateway().api;
+    bool pts = api->pin_read(SPIS_PTS_PIN) != 0;
+    bool sa = api->pin_read(SPIS_SA_PIN) != 0;
+
+    uint64_t transferTime = 0;
+    if (!master.out.empty()) {
+        size_t remaining = master.out.size() - master.outOffset;
+        master.reading = false;
+        master.transferLength = remaining >= SPI_TRANSFER_SIZE ? SPI_TRANSFER_SIZE : remaining;
+    } else if (sa) {
+        master.reading = true;
+        master.transferLength = master.header ? 2 : std::min<uint16_t>(master.burstRemaining, SPI_TRANSFER_SIZE);
+    } else if (pts && !master.mr) {
+        master.mr = true;
+        api->pin_write(SPIS_MR_PIN, 1);
+        return;
+    } else {
+        if (!pts && master.mr && master.header) {
+            master.mr = false;
+            api->pin_write(SPIS_MR_PIN, 0);
+        }
+        if (master.mr || pts) {
+            return;
+        }
+
+        // round robin over the peripherals with cloud data and room in their window
+        for (size_t i = 0; i < clouds.size() && master.out.empty(); i++) {
+            size_t index = (master.nextPeripheral + i) % clouds.size();
+            Cloud& cloud = clouds[index];
+            size_t pending = cloud.pending.size() - cloud.pendingOffset;
+            size_t inFlight = cloud.sent - peripheral(index).received.size();
+            if (!cloud.connected || pending == 0 || inFlight >= config.downlink_window) {
+                continue;
+            }
+            size_t length = std::min<size_t>({ pending, config.downlink_message_size, config.downlink_window - inFlight });
+            master.out.resize(SPI_MESSAGE_HEADER_SIZE + length);
+            master.out[0] = (length >> 8) & 0xFF;
+            master.out[1] = length & 0xFF;
+            master.out[2] = index;
+            master.out[3] = SOCKET_DATA_SERVICE;
+            master.out[4] = ((SOCKET_DATA << 4) & 0xF0) | (peripheral(index).socket & 0x0F);
+            memcpy(master.out.data() + SPI_MESSAGE_HEADER_SIZE, cloud.pending.data() + cloud.pendingOffset, length);
+            master.outOffset = 0;
+            cloud.pendingOffset += length;
+            cloud.sent += length;
+            master.nextPeripheral = index + 1;
+        }
+        if (master.out.empty()) {
+            return;
+        }
+        size_t remaining = master.out.size();
+        master.reading = false;
+        master.transferLength = remaining >= SPI_TRANSFER_SIZE ? SPI_TRANSFER_SIZE : remaining;
+    }
+
+    transferTime = config.spi_transfer_overhead_us + (uint64_t)master.transferLength * config.spi_byte_ns / 1000;
+    master.busy = true;
+    master.doneAt = now + transferTime;
+}
+
+void Sim::master_transfer_done()
+{
+    uint8_t data[SPI_TRANSFER_SIZE];
+    uint16_t length = master.transferLength;
+    master.busy = false;
+
+    if (master.reading) {
+        call_interrupt(0, [&] { gateway().api->spi_transfer(nullptr, data, length); });
+        if (master.header) {
+            master.burstRemaining = (data[0] << 8) | data[1];
+            master.burst.clear();
+            master.header = master.burstRemaining == 0;
+        } else {
+            master.burst.insert(master.burst.end(), data, data + length);
+            master.burstRemaining -= length;
+            if (master.burstRemaining == 0) {
+                master.header = true;
+                master_parse_burst();
+            }
+        }
+    } else {
+        // a full transfer carries 254 bytes and says more is coming
+        size_t remaining = master.out.size() - master.outOffset;
+        size_t carried = length == SPI_TRANSFER_SIZE ? SPI_TRANSFER_SIZE - 1 : remaining;
+        memset(data, 0, sizeof(data));
+        memcpy(data, master.out.data() + master.outOffset, carried);
+        master.outOffset += carried;
+        call_interrupt(0, [&] { gateway().api->spi_transfer(data, nullptr, length); });
+        if (master.outOffset == master.out.size()) {
+            master.out.clear();
+            master.outOffset = 0;
+        }
+    }
+    master_poll();
+}
+
+void Sim::master_parse_burst()
+{
+    size_t offset = 0;
+    while (offset + SPI_MESSAGE_HEADER_SIZE <= master.burst.size()) {
+        const uint8_t* message = master.burst.data() + offset;
+        size_t length = (message[0] << 8) | message[1];
+        uint8_t id = message[2];
+        uint8_t service = message[3];
+        uint8_t command = message[4] >> 4;
+        if (offset + SPI_MESSAGE_HEADER_SIZE + length > master.burst.size()) {
+            sim_host_fatal(0, "message runs past the end of the burst", length);
+        }
+
+        if (id < clouds.size() && service == SOCKET_DATA_SERVICE) {
+            Cloud& cloud = clouds[id];
+            switch (command) {
+            case SOCKET_DATA:
+                cloud.received.insert(cloud.received.end(), message + SPI_MESSAGE_HEADER_SIZE,
+                                      message + SPI_MESSAGE_HEADER_SIZE + length);
+                break;
+            case SOCKET_CONNECT:
+                cloud.connected = true;
+                break;
+            case SOCKET_DISCONNECT:
+                cloud.connected = false;
+                break;
+            }
+        }
+        offset += SPI_MESSAGE_HEADER_SIZE + length;
+    }
+}
+
+void Sim::cloud_send(int peripheral, const uint8_t* data, size_t len)
+{
+    Cloud& cloud = clouds.at(peripheral);
+    cloud.pending.insert(cloud.pending.end(), data, data + len);
+    master_poll();
+}
+
+const std::vector<uint8_t>& Sim::cloud_received(int peripheral) const
+{
+    return clouds.at(peripheral).received;
+}
+
+bool Sim::cloud_connected(int peripheral) const
+{
+    return clouds.at(peripheral).connected;
+}
+
+size_t Sim::cloud_pending(int peripheral) const
+{
+    const Cloud& cloud = clouds.at(peripheral);
+    return cloud.pending.size() - cloud.pendingOffset;
+}
+
+int32_t Sim::device_send(int index, const void* data, size_t len)
+{
+    Node& p = peripheral(index);
+    int32_t result = 0;
+    call_main(1 + index, [&] { result = p.api->socket_send(p.socket, data, len); });
+    return result;
+}
+
+size_t Sim::device_receive(int index)
+{
+    Node& p = peripheral(index);
+    uint8_t buffer[256];
+    size_t total = 0;
+    int32_t count;
+    do {
+        call_main(1 + index, [&] { count = p.api->socket_receive(p.socket, buffer, sizeof(buffer)); });
+        if (count > 0) {
+            p.received.insert(p.received.end(), buffer, buffer + count);
+            total += count;
+        }
+    } while (count > 0);
+    return total;
+}
+
+const std::vector<uint8_t>& Sim::device_received(int index) const
+{
+    return nodes.at(1 + index).received;
+}
+
+void Sim::reset_stats()
+{
+    for (Node& node : nodes) {
+        node.stats.bytes_copied = 0;
+        node.stats.stack_peak = 0;
+    }
+    packetsUp = 0;
+    packetsDown = 0;
+}
+
+const SimNodeStats& Sim::gateway_stats() const
+{
+    return nodes.at(0).stats;
+}
+
+const SimNodeStats& Sim::peripheral_stats(int index) const
+{
+    return nodes.at(1 + index).stats;
+}
+
+/* Called by the nodes */
+
+void Sim::delay(uint8_t id, uint32_t us)
+{
+    Node& node = nodes.at(id);
+    if (node.interruptDepth > 0) {
+        node.interruptDelay += us;
+        if (node.interruptDelay > INTERRUPT_STALL_US) {
+            sim_host_fatal(id, "stuck waiting in an interrupt handler", node.interruptDelay);
+        }
+    } else if (node.mainDepth > 0 && now - node.mainStarted > MAIN_STALL_US) {
+        sim_host_fatal(id, "stuck waiting in the main loop", (now - node.mainStarted) / 1000);
+    }
+
+    // the host runs while the node waits, the nodes it calls are new entries
+    entries.push_back({ -1, nullptr });
+    process_until(now + us);
+    entries.pop_back();
+}
+
+void Sim::wait_event(uint8_t id)
+{
+    delay(id, next_event() - now);
+}
+
+void Sim::send(uint8_t id, uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t* data, uint16_t len)
+{
+    Packet packet;
+    packet.type = type;
+    packet.handle = handle;
+    packet.len = std::min<uint16_t>(len, SIM_MAX_PACKET_SIZE);
+    if (data != nullptr) {
+        memcpy(packet.data, data, packet.len);
+    }
+
+    entries.push_back({ -1, nullptr });
+    for (Link& link : links) {
+        if (id == 0 && link.gatewayConn == conn_handle) {
+            link.down.push_back(packet);
+        } else if (id != 0 && link.peripheral == id) {
+            link.up.push_back(packet);
+        }
+    }
+    entries.pop_back();
+}
+
+void Sim::copied(size_t len)
+{
+    int node = current_node();
+    if (node >= 0) {
+        nodes[node].stats.bytes_copied += len;
+    }
+}
+
+void Sim::stack_probe(const char* sp)
+{
+    int node = current_node();
+    if (node < 0) {
+        return;
+    }
+    // from where the host first entered this node, interrupts nest on the same stack
+    for (const Entry& entry : entries) {
+        if (entry.node == node) {
+            size_t depth = entry.base - sp;
+            nodes[node].stats.stack_peak = std::max(nodes[node].stats.stack_peak, depth);
+            break;
+        }
+    }
+}
+
+void Sim::heap_alloc(int node, size_t size)
+{
+    SimNodeStats& stats = nodes[node].stats;
+    stats.heap_current += size;
+    stats.heap_peak = std::max(stats.heap_peak, stats.heap_current);
+}
+
+void Sim::heap_free(int node, size_t size)
+{
+    if (node < (int)nodes.size()) {
+        nodes[node].stats.heap_current -= size;
+    }
+}
+
+int Sim::current_node() const
+{
+    return entries.empty() ? -1 : entries.back().node;
+}
@@ -0,0 +1,191 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_HOST_H
+#define SIM_HOST_H
+
+#include "sim.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * Timing of the simulated world. The defaults are what the gateway asks for and what
+ * the SoftDevices give the bluz boards.
+ */
+struct SimConfig
+{
+    int         peripherals = 1;                    // connected to the gateway, at most MAX_CLIENTS
+    uint32_t    connection_interval_us = 7500;      // MIN_CONNECTION_INTERVAL of the gateway
+    uint8_t     packets_per_event = 4;              // per link and direction in one connection event
+    uint8_t     peripheral_tx_buffers = 7;          // S110 application TX buffers
+    uint8_t     gateway_tx_buffers = 6;             // S120 application TX buffers per link
+    uint32_t    spi_byte_ns = 1000;                 // 8 MHz SPI clock
+    uint32_t    spi_transfer_overhead_us = 20;      // chip select and interrupt latency on the Photon
+    uint32_t    loop_period_us = 100;               // how often the main loops get round
+    uint32_t    downlink_message_size = 500;        // most socket data the Photon puts in one SPI message
+    uint32_t    downlink_window = 1024;             // cloud bytes in flight to a peripheral, as a TCP window would
+    bool        auto_receive = true;                // peripheral applications read their socket every loop
+};
+
+/** What a node did since the statistics were last reset. */
+struct SimNodeStats
+{
+    uint64_t    bytes_copied = 0;                   // by memcpy in the firmware, not counting the SoftDevice
+    size_t      stack_peak = 0;                     // deepest stack seen from the entry into the node
+    size_t      heap_current = 0;
+    size_t      heap_peak = 0;                      // since the node was loaded
+};
+
+/**
+ * A gateway, its peripherals and the Photon behind the gateway, all in one process.
+ *
+ * Only one can exist at a time, the nodes call back into it through plain functions.
+ */
+class Sim
+{
+public:
+    explicit Sim(const SimConfig& config = SimConfig());
+    ~Sim();
+
+    // loads the nodes, brings every link up and opens a socket on every peripheral
+    bool start();
+
+    void run_for(uint64_t us);
+    bool run_until(const std::function<bool()>& done, uint64_t timeout_us);
+    uint64_t now_us() const { return now; }
+
+    // the cloud end of each peripheral's socket, through the Photon
+    void cloud_send(int peripheral, const uint8_t* data, size_t len);
+    const std::vector<uint8_t>& cloud_received(int peripheral) const;
+    bool cloud_connected(int peripheral) const;
+    size_t cloud_pending(int peripheral) const;
+
+    // the application on a peripheral, send blocks as Socket::send does
+    int32_t device_send(int peripheral, const void* data, size_t len);
+    size_t device_receive(int peripheral);
+    const std::vector<uint8_t>& device_received(int peripheral) const;
+
+    void set_auto_receive(bool on) { config.auto_receive = on; }
+
+    void reset_stats();
+    const SimNodeStats& gateway_stats() const;
+    const SimNodeStats& peripheral_stats(int peripheral) const;
+    uint64_t packets_up() const { return packetsUp; }
+    uint64_t packets_down() const { return packetsDown; }
+
+    // called by the nodes, through the sim_host_ functions
+    void delay(uint8_t node, uint32_t us);
+    void wait_event(uint8_t node);
+    void send(uint8_t node, uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t* data, uint16_t len);
+    void copied(size_t len);
+    void stack_probe(const char* sp);
+    void heap_alloc(int node, size_t size);
+    void heap_free(int node, size_t size);
+    int current_node() const;
+
+private:
+    struct Packet
+    {
+        uint8_t type;
+        uint16_t handle;
+        uint16_t len;
+        uint8_t data[SIM_MAX_PACKET_SIZE];
+    };
+
+    struct Node
+    {
+        void* library = nullptr;
+        const sim_node_t* api = nullptr;
+        int mainDepth = 0;                          // the main loop of the board is on the host stack
+        int interruptDepth = 0;                     // so is one of its interrupt handlers
+        uint64_t interruptDelay = 0;                // time spent waiting inside interrupt handlers
+        uint64_t mainStarted = 0;                   // when the host called into the main loop
+        int32_t socket = -1;
+        std::vector<uint8_t> received;
+        SimNodeStats stats;
+    };
+
+    struct Link
+    {
+        int peripheral;                             // node index
+        uint16_t gatewayConn;
+        uint16_t peripheralConn;
+        uint64_t nextEvent;
+        bool ready = false;                         // notifications enabled
+        std::deque<Packet> down;
+        std::deque<Packet> up;
+    };
+
+    struct Cloud
+    {
+        std::vector<uint8_t> pending;
+        size_t pendingOffset = 0;
+        size_t sent = 0;
+        std::vector<uint8_t> received;
+        bool connected = false;
+    };
+
+    struct Master
+    {
+        bool mr = false;
+        bool busy = false;                          // a transfer completes at doneAt
+        uint64_t doneAt = 0;
+        bool reading = false;
+        bool header = true;                         // the next read is the size of a burst
+        uint16_t burstRemaining = 0;
+        std::vector<uint8_t> burst;
+        std::vector<uint8_t> out;                   // message being written to the gateway
+        size_t outOffset = 0;
+        uint16_t transferLength = 0;
+        int nextPeripheral = 0;
+    };
+
+    struct Entry
+    {
+        int node;
+        const char* base;
+    };
+
+    void load(int index, const char* name);
+    void process_until(uint64_t target);
+    uint64_t next_event() const;
+    void connection_event(Link& link);
+    void tick();
+    void master_poll();
+    void master_transfer_done();
+    void master_parse_burst();
+    Node& gateway() { return nodes[0]; }
+    Node& peripheral(int index) { return nodes[1 + index]; }
+
+    template <typename F> void call_main(int node, F f);
+    template <typename F> void call_interrupt(int node, F f);
+
+    SimConfig config;
+    uint64_t now = 0;
+    uint64_t nextTick = UINT64_MAX;                 // the loops only run once every node is up
+    std::vector<Node> nodes;
+    std::vector<Link> links;
+    std::vector<Cloud> clouds;
+    Master master;
+    std::vector<Entry> entries;
+    uint64_t packetsUp = 0;
+    uint64_t packetsDown = 0;
+};
+
+#endif /* SIM_HOST_H */
@@ -0,0 +1,108 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The peripheral node: the data path of a bluz DK, from the SCS service up to the socket an
+ * application reads and writes. Wired up as hw_config.c and nrf51_callbacks.c do on the board.
+ */
+
+#include <cstring>
+#include "sim_softdevice.h"
+#include "data_management_layer.h"
+#include "socket_manager.h"
+#include "registered_data_services.h"
+
+extern "C" {
+#include "ble_scs.h"
+
+//defined by nrf51_config.h, which particle_data_service.c brings in
+extern scs_t m_scs;
+
+void ble_evt_dispatch(ble_evt_t * p_ble_evt)
+{
+    scs_on_ble_evt(&m_scs, p_ble_evt);
+}
+
+void data_write_handler(scs_t * p_lbs, uint8_t *data, uint16_t length)
+{
+    dataManagementFeedData(length, data);
+}
+}
+
+namespace {
+
+void init(uint8_t node_id, uint8_t tx_buffers)
+{
+    sim_softdevice_init(node_id, tx_buffers);
+
+    scs_init_t init;
+    init.data_write_handler = data_write_handler;
+    scs_init(&m_scs, &init);
+
+    DataManagementLayer::registerService(SocketManager::instance());
+}
+
+void loop()
+{
+}
+
+void connected(uint16_t conn_handle, const sim_gatt_t * p_gatt)
+{
+    sim_softdevice_connected(conn_handle);
+}
+
+int32_t socket_open()
+{
+    sockaddr_b address;
+    memset(&address, 0, sizeof(address));
+    address.sa_family = 2;
+    address.sa_data[2] = 10;
+    address.sa_data[5] = 1;
+
+    int32_t sd = SocketManager::instance()->create(2, 1, 6, 80, 0);
+    if (sd >= 0) {
+        SocketManager::instance()->connect(sd, &address, sizeof(address));
+    }
+    return sd;
+}
+
+int32_t socket_send(int32_t sd, const void * p_buffer, uint32_t len)
+{
+    return SocketManager::instance()->send(sd, p_buffer, len);
+}
+
+int32_t socket_receive(int32_t sd, void * p_buffer, uint32_t len)
+{
+    return SocketManager::instance()->receive(sd, p_buffer, len, 0);
+}
+
+} // namespace
+
+extern "C" __attribute__((visibility("default"))) const sim_node_t sim_node = {
+    103,
+    init,
+    loop,
+    connected,
+    sim_softdevice_gatt,
+    sim_softdevice_packet,
+    sim_softdevice_tx_complete,
+    NULL,
+    NULL,
+    NULL,
+    socket_open,
+    socket_send,
+    socket_receive
+};
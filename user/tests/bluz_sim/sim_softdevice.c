@@ -0,0 +1,506 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "sim_softdevice.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+#include "app_util.h"
+#if PLATFORM_ID==269
+#include "ble_db_discovery.h"
+#include "device_manager.h"
+#include "ble_radio_notification.h"
+#include "softdevice_handler.h"
+#include "pstorage.h"
+#include "spi_slave.h"
+#endif
+
+//room for the largest packet behind the event header
+#define EVT_BUFFER_WORDS        CEIL_DIV(sizeof(ble_evt_t) + SIM_MAX_PACKET_SIZE, sizeof(uint32_t))
+
+SCB_Type sim_scb;                                   /**< Reads as thread mode, so critical regions go through the SoftDevice. */
+
+static uint8_t  m_node_id;
+static uint8_t  m_tx_buffers;                       /**< Application TX buffers per link. */
+static uint8_t  m_tx_free[SIM_MAX_LINKS];           /**< Of those, the ones not waiting for the peer. */
+static uint32_t m_pins;
+
+/* Hooks the modules under test are built with, see the makefile. */
+
+void * sim_memcpy(void * dest, const void * src, size_t n)
+{
+    sim_host_copied(n);
+    sim_host_stack_probe();
+    return memcpy(dest, src, n);
+}
+
+void sim_delay_us(uint32_t us)
+{
+    sim_host_delay_us(m_node_id, us);
+}
+
+uint32_t sd_app_evt_wait(void)
+{
+    sim_host_wait_event(m_node_id);
+    return NRF_SUCCESS;
+}
+
+uint32_t system_millis(void)
+{
+    return sim_host_millis();
+}
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name)
+{
+    sim_host_fatal(m_node_id, (const char *)p_file_name, error_code);
+}
+
+uint32_t sim_gpio_read(uint32_t pin_number)
+{
+    return (m_pins >> pin_number) & 1;
+}
+
+void sim_gpio_write(uint32_t pin_number, uint32_t value)
+{
+    if (value) {
+        m_pins |= (1UL << pin_number);
+    } else {
+        m_pins &= ~(1UL << pin_number);
+    }
+}
+
+void sim_softdevice_init(uint8_t node_id, uint8_t tx_buffers)
+{
+    m_node_id = node_id;
+    m_tx_buffers = tx_buffers;
+    memset(m_tx_free, 0, sizeof(m_tx_free));
+    m_pins = 0;
+}
+
+/* SoftDevice calls common to both roles */
+
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region)
+{
+    *p_is_nested_critical_region = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_tx_buffer_count_get(uint8_t * p_count)
+{
+    *p_count = m_tx_buffers;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    //both roles only ever add the one base
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    //links stay up for the whole run
+    return NRF_SUCCESS;
+}
+
+/**@brief Takes a TX buffer for a packet, as the SoftDevice does for notifications and write commands. */
+static uint32_t tx_buffer_take(uint16_t conn_handle)
+{
+    sim_host_stack_probe();
+    if (conn_handle >= SIM_MAX_LINKS) {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (m_tx_free[conn_handle] == 0) {
+        return BLE_ERROR_NO_TX_BUFFERS;
+    }
+    m_tx_free[conn_handle]--;
+    return NRF_SUCCESS;
+}
+
+void sim_softdevice_tx_complete(uint16_t conn_handle, uint8_t count)
+{
+    uint32_t buffer[EVT_BUFFER_WORDS];
+    ble_evt_t * p_ble_evt = (ble_evt_t *)buffer;
+
+    m_tx_free[conn_handle] += count;
+
+    memset(buffer, 0, sizeof(buffer));
+    p_ble_evt->header.evt_id = BLE_EVT_TX_COMPLETE;
+    p_ble_evt->header.evt_len = sizeof(ble_evt_t);
+    p_ble_evt->evt.common_evt.conn_handle = conn_handle;
+    p_ble_evt->evt.common_evt.params.tx_complete.count = count;
+    ble_evt_dispatch(p_ble_evt);
+}
+
+#if PLATFORM_ID==103
+
+static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
+static uint16_t m_next_handle = 0x000C;
+static sim_gatt_t m_gatt;
+static bool m_notifications_enabled;
+
+void sim_softdevice_connected(uint16_t conn_handle)
+{
+    uint32_t buffer[EVT_BUFFER_WORDS];
+    ble_evt_t * p_ble_evt = (ble_evt_t *)buffer;
+
+    m_conn_handle = conn_handle;
+    m_tx_free[conn_handle] = m_tx_buffers;
+    m_notifications_enabled = false;
+
+    memset(buffer, 0, sizeof(buffer));
+    p_ble_evt->header.evt_id = BLE_GAP_EVT_CONNECTED;
+    p_ble_evt->header.evt_len = sizeof(ble_evt_t);
+    p_ble_evt->evt.gap_evt.conn_handle = conn_handle;
+    p_ble_evt->evt.gap_evt.params.connected.peer_addr.addr[0] = 0xB1;
+    ble_evt_dispatch(p_ble_evt);
+}
+
+void sim_softdevice_packet(uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t * p_data, uint16_t len)
+{
+    uint32_t buffer[EVT_BUFFER_WORDS];
+    ble_evt_t * p_ble_evt = (ble_evt_t *)buffer;
+
+    if (handle == m_gatt.up_cccd_handle && len >= 1) {
+        m_notifications_enabled = (p_data[0] & BLE_GATT_HVX_NOTIFICATION) != 0;
+    }
+
+    memset(buffer, 0, sizeof(buffer));
+    p_ble_evt->header.evt_id = BLE_GATTS_EVT_WRITE;
+    p_ble_evt->header.evt_len = sizeof(ble_evt_t) + len;
+    p_ble_evt->evt.gatts_evt.conn_handle = conn_handle;
+    p_ble_evt->evt.gatts_evt.params.write.handle = handle;
+    p_ble_evt->evt.gatts_evt.params.write.op = (type == SIM_PACKET_WRITE_REQ ? BLE_GATTS_OP_WRITE_REQ : BLE_GATTS_OP_WRITE_CMD);
+    p_ble_evt->evt.gatts_evt.params.write.len = len;
+    memcpy(p_ble_evt->evt.gatts_evt.params.write.data, p_data, len);
+    ble_evt_dispatch(p_ble_evt);
+
+    if (type == SIM_PACKET_WRITE_REQ) {
+        //the SoftDevice answers write requests itself, the value is in the attribute table
+        sim_host_send(m_node_id, conn_handle, SIM_PACKET_WRITE_RSP, handle, NULL, 0);
+    }
+}
+
+void sim_softdevice_gatt(sim_gatt_t * p_gatt)
+{
+    *p_gatt = m_gatt;
+}
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle)
+{
+    *p_handle = m_next_handle++;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const * p_attr_char_value, ble_gatts_char_handles_t * p_handles)
+{
+    //declaration, value, then the descriptors
+    m_next_handle++;
+    memset(p_handles, 0, sizeof(ble_gatts_char_handles_t));
+    p_handles->value_handle = m_next_handle++;
+    if (p_char_md->p_cccd_md != NULL) {
+        p_handles->cccd_handle = m_next_handle++;
+    }
+
+    if (p_char_md->char_props.notify) {
+        m_gatt.up_value_handle = p_handles->value_handle;
+        m_gatt.up_cccd_handle = p_handles->cccd_handle;
+    } else {
+        m_gatt.dn_value_handle = p_handles->value_handle;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    uint16_t len = *p_hvx_params->p_len;
+
+    if (conn_handle != m_conn_handle) {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (!m_notifications_enabled) {
+        return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+    }
+    if (len > GATT_MTU_SIZE_DEFAULT - 3) {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    uint32_t err_code = tx_buffer_take(conn_handle);
+    if (err_code == NRF_SUCCESS) {
+        sim_host_send(m_node_id, conn_handle, SIM_PACKET_NOTIFICATION, p_hvx_params->handle, p_hvx_params->p_data, len);
+    }
+    return err_code;
+}
+
+#endif
+
+#if PLATFORM_ID==269
+
+static sim_gatt_t m_peer_gatt[SIM_MAX_LINKS];
+static bool m_write_req_pending[SIM_MAX_LINKS];
+static ble_db_discovery_evt_handler_t m_discovery_handler;
+
+void sim_softdevice_connected(uint16_t conn_handle)
+{
+    m_tx_free[conn_handle] = m_tx_buffers;
+    m_write_req_pending[conn_handle] = false;
+}
+
+void sim_softdevice_peer_gatt(uint16_t conn_handle, const sim_gatt_t * p_gatt)
+{
+    m_peer_gatt[conn_handle] = *p_gatt;
+}
+
+void sim_softdevice_packet(uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t * p_data, uint16_t len)
+{
+    uint32_t buffer[EVT_BUFFER_WORDS];
+    ble_evt_t * p_ble_evt = (ble_evt_t *)buffer;
+
+    memset(buffer, 0, sizeof(buffer));
+    p_ble_evt->evt.gattc_evt.conn_handle = conn_handle;
+    p_ble_evt->evt.gattc_evt.gatt_status = BLE_GATT_STATUS_SUCCESS;
+    if (type == SIM_PACKET_WRITE_RSP) {
+        m_write_req_pending[conn_handle] = false;
+        p_ble_evt->header.evt_id = BLE_GATTC_EVT_WRITE_RSP;
+        p_ble_evt->header.evt_len = sizeof(ble_evt_t);
+        p_ble_evt->evt.gattc_evt.params.write_rsp.handle = handle;
+        p_ble_evt->evt.gattc_evt.params.write_rsp.write_op = BLE_GATT_OP_WRITE_REQ;
+    } else {
+        p_ble_evt->header.evt_id = BLE_GATTC_EVT_HVX;
+        p_ble_evt->header.evt_len = sizeof(ble_evt_t) + len;
+        p_ble_evt->evt.gattc_evt.params.hvx.handle = handle;
+        p_ble_evt->evt.gattc_evt.params.hvx.type = BLE_GATT_HVX_NOTIFICATION;
+        p_ble_evt->evt.gattc_evt.params.hvx.len = len;
+        memcpy(p_ble_evt->evt.gattc_evt.params.hvx.data, p_data, len);
+    }
+    ble_evt_dispatch(p_ble_evt);
+}
+
+uint32_t sd_ble_gattc_write(uint16_t conn_handle, ble_gattc_write_params_t const * p_write_params)
+{
+    uint32_t err_code;
+
+    if (conn_handle >= SIM_MAX_LINKS) {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_write_params->len > GATT_MTU_SIZE_DEFAULT - 3) {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    if (p_write_params->write_op == BLE_GATT_OP_WRITE_REQ) {
+        //one request at a time, the response frees the procedure again
+        if (m_write_req_pending[conn_handle]) {
+            return NRF_ERROR_BUSY;
+        }
+        m_write_req_pending[conn_handle] = true;
+        sim_host_send(m_node_id, conn_handle, SIM_PACKET_WRITE_REQ, p_write_params->handle, p_write_params->p_value, p_write_params->len);
+        return NRF_SUCCESS;
+    }
+
+    err_code = tx_buffer_take(conn_handle);
+    if (err_code == NRF_SUCCESS) {
+        sim_host_send(m_node_id, conn_handle, SIM_PACKET_WRITE_CMD, p_write_params->handle, p_write_params->p_value, p_write_params->len);
+    }
+    return err_code;
+}
+
+/* Service discovery finds the peer's SCS service straight away. */
+
+uint32_t ble_db_discovery_init(void)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t ble_db_discovery_evt_register(const ble_uuid_t * const p_uuid, const ble_db_discovery_evt_handler_t evt_handler)
+{
+    m_discovery_handler = evt_handler;
+    return NRF_SUCCESS;
+}
+
+uint32_t ble_db_discovery_start(ble_db_discovery_t * const p_db_discovery, uint16_t conn_handle)
+{
+    ble_db_discovery_evt_t evt;
+    ble_db_discovery_srv_t * p_srv = &p_db_discovery->services[0];
+    const sim_gatt_t * p_gatt = &m_peer_gatt[conn_handle];
+
+    memset(p_srv, 0, sizeof(ble_db_discovery_srv_t));
+    p_srv->srv_uuid.type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    p_srv->srv_uuid.uuid = 0x0223;
+    p_srv->char_count = 2;
+
+    //the characteristic the peripheral notifies, its UUID as in ble_scs.h
+    p_srv->charateristics[0].characteristic.uuid.type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    p_srv->charateristics[0].characteristic.uuid.uuid = 0x0224;
+    p_srv->charateristics[0].characteristic.char_props.notify = 1;
+    p_srv->charateristics[0].characteristic.handle_value = p_gatt->up_value_handle;
+    p_srv->charateristics[0].cccd_handle = p_gatt->up_cccd_handle;
+
+    p_srv->charateristics[1].characteristic.uuid.type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    p_srv->charateristics[1].characteristic.uuid.uuid = 0x0225;
+    p_srv->charateristics[1].characteristic.char_props.write_wo_resp = 1;
+    p_srv->charateristics[1].characteristic.handle_value = p_gatt->dn_value_handle;
+    p_srv->charateristics[1].cccd_handle = BLE_GATT_HANDLE_INVALID;
+    p_db_discovery->srv_count = 1;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.evt_type = BLE_DB_DISCOVERY_COMPLETE;
+    evt.conn_handle = conn_handle;
+    evt.params.discovered_db = *p_srv;
+    m_discovery_handler(&evt);
+    return NRF_SUCCESS;
+}
+
+void ble_db_discovery_on_ble_evt(ble_db_discovery_t * const p_db_discovery, const ble_evt_t * const p_ble_evt)
+{
+}
+
+/* Start up and link management, the host sets links up directly. */
+
+ret_code_t dm_security_setup_req(dm_handle_t * p_handle)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t ble_radio_notification_init(nrf_app_irq_priority_t irq_priority, nrf_radio_notification_distance_t distance,
+                                     ble_radio_notification_evt_handler_t evt_handler)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t softdevice_handler_init(nrf_clock_lfclksrc_t clock_source, void * p_ble_evt_buffer, uint16_t ble_evt_buffer_size,
+                                 softdevice_evt_schedule_func_t evt_schedule_func)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_enable(ble_enable_params_t * p_ble_enable_params)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t pstorage_access_status_get(uint32_t * p_count)
+{
+    *p_count = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_scan_start(ble_gap_scan_params_t const * p_scan_params)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_connect_cancel(void)
+{
+    return NRF_SUCCESS;
+}
+
+/* SPI slave driver. Setting the buffers takes the semaphore straight away, and a transfer
+ * is whatever the master clocks, up to the size of the buffers.
+ */
+
+static spi_slave_event_handler_t m_spi_handler;
+static uint8_t * m_spi_tx_buf;
+static uint8_t * m_spi_rx_buf;
+static uint8_t m_spi_tx_len;
+static uint8_t m_spi_rx_len;
+static bool m_spi_buffers_set;
+
+uint32_t spi_slave_evt_handler_register(spi_slave_event_handler_t event_handler)
+{
+    m_spi_handler = event_handler;
+    return NRF_SUCCESS;
+}
+
+uint32_t spi_slave_init(const spi_slave_config_t * p_spi_slave_config)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t spi_slave_set_cs_pull_up_config(uint32_t alternate_config)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t spi_slave_buffers_set(uint8_t * p_tx_buf, uint8_t * p_rx_buf, uint8_t tx_buf_length, uint8_t rx_buf_length)
+{
+    spi_slave_evt_t event;
+
+    sim_host_stack_probe();
+    m_spi_tx_buf = p_tx_buf;
+    m_spi_rx_buf = p_rx_buf;
+    m_spi_tx_len = tx_buf_length;
+    m_spi_rx_len = rx_buf_length;
+    m_spi_buffers_set = true;
+
+    memset(&event, 0, sizeof(event));
+    event.evt_type = SPI_SLAVE_BUFFERS_SET_DONE;
+    m_spi_handler(event);
+    return NRF_SUCCESS;
+}
+
+uint16_t sim_spi_slave_transfer(const uint8_t * p_mosi, uint8_t * p_miso, uint16_t len)
+{
+    spi_slave_evt_t event;
+
+    if (!m_spi_buffers_set) {
+        //the CPU holds the buffers, the master only gets DEF back
+        if (p_miso != NULL) {
+            memset(p_miso, 0xAA, len);
+        }
+        return 0;
+    }
+
+    uint16_t tx_amount = len < m_spi_tx_len ? len : m_spi_tx_len;
+    uint16_t rx_amount = len < m_spi_rx_len ? len : m_spi_rx_len;
+    if (p_miso != NULL) {
+        memcpy(p_miso, m_spi_tx_buf, tx_amount);
+        memset(p_miso + tx_amount, 0x55, len - tx_amount);
+    }
+    if (p_mosi != NULL) {
+        memcpy(m_spi_rx_buf, p_mosi, rx_amount);
+    } else {
+        memset(m_spi_rx_buf, 0, rx_amount);
+    }
+    m_spi_buffers_set = false;
+
+    memset(&event, 0, sizeof(event));
+    event.evt_type = SPI_SLAVE_XFER_DONE;
+    event.rx_amount = rx_amount;
+    event.tx_amount = tx_amount;
+    m_spi_handler(event);
+    return rx_amount;
+}
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_SOFTDEVICE_H
+#define SIM_SOFTDEVICE_H
+
+/* The fake SoftDevice and board of a node. Only the calls the data path makes are there,
+ * each behaving as the SoftDevice documents it: packets are copied when queued, a write
+ * command or notification takes one of a fixed number of TX buffers per link, and the
+ * buffers come back with BLE_EVT_TX_COMPLETE once the peer has the packets.
+ */
+
+#include "sim.h"
+#include "ble.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_MAX_LINKS           4
+
+void sim_softdevice_init(uint8_t node_id, uint8_t tx_buffers);
+
+/* Turn what the host delivers into SoftDevice events for ble_evt_dispatch. */
+void sim_softdevice_connected(uint16_t conn_handle);
+void sim_softdevice_packet(uint16_t conn_handle, uint8_t type, uint16_t handle, const uint8_t * p_data, uint16_t len);
+void sim_softdevice_tx_complete(uint16_t conn_handle, uint8_t count);
+
+/* Peripheral: the handles sd_ble_gatts_characteristic_add handed out. */
+void sim_softdevice_gatt(sim_gatt_t * p_gatt);
+
+/* Gateway: what ble_db_discovery finds on the peer of a link. */
+void sim_softdevice_peer_gatt(uint16_t conn_handle, const sim_gatt_t * p_gatt);
+
+/* Gateway: the SPI slave peripheral, as clocked by the master. */
+uint16_t sim_spi_slave_transfer(const uint8_t * p_mosi, uint8_t * p_miso, uint16_t len);
+
+uint32_t sim_gpio_read(uint32_t pin_number);
+void sim_gpio_write(uint32_t pin_number, uint32_t value);
+
+/* Implemented by each node, as nrf51_callbacks.c does on the board. */
+void ble_evt_dispatch(ble_evt_t * p_ble_evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_SOFTDEVICE_H */
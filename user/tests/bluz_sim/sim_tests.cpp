@@ -0,0 +1,115 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "catch.hpp"
+#include "sim_host.h"
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> pattern(size_t length, unsigned seed)
+{
+    std::vector<uint8_t> data(length);
+    srand(seed);
+    for (uint8_t& byte : data) {
+        byte = rand() & 0xFF;
+    }
+    return data;
+}
+
+} // namespace
+
+TEST_CASE("Links come up and the socket connects to the cloud", "[bluz_sim]") {
+    Sim sim;
+    REQUIRE(sim.start());
+    CHECK(sim.cloud_connected(0));
+    CHECK(sim.cloud_received(0).empty());
+}
+
+TEST_CASE("Socket writes arrive intact at the cloud", "[bluz_sim]") {
+    Sim sim;
+    REQUIRE(sim.start());
+
+    std::vector<uint8_t> expected;
+    for (size_t length : { 1, 18, 19, 20, 100, 500 }) {
+        std::vector<uint8_t> data = pattern(length, length);
+        REQUIRE(sim.device_send(0, data.data(), data.size()) == (int32_t)length);
+        expected.insert(expected.end(), data.begin(), data.end());
+    }
+    REQUIRE(sim.run_until([&] { return sim.cloud_received(0).size() >= expected.size(); }, 10000000));
+    CHECK(sim.cloud_received(0) == expected);
+}
+
+TEST_CASE("Cloud data arrives intact in the socket", "[bluz_sim]") {
+    Sim sim;
+    REQUIRE(sim.start());
+
+    std::vector<uint8_t> data = pattern(5000, 1);
+    sim.cloud_send(0, data.data(), data.size());
+    REQUIRE(sim.run_until([&] { return sim.device_received(0).size() >= data.size(); }, 20000000));
+    CHECK(sim.device_received(0) == data);
+}
+
+TEST_CASE("A socket that isn't read keeps what it was sent", "[bluz_sim]") {
+    Sim sim;
+    REQUIRE(sim.start());
+    sim.set_auto_receive(false);
+
+    // the cloud's window, and nothing else, keeps it from overrunning the socket's buffer
+    std::vector<uint8_t> data = pattern(3000, 2);
+    sim.cloud_send(0, data.data(), data.size());
+    sim.run_for(2000000);
+    CHECK(sim.device_received(0).empty());
+    CHECK(sim.cloud_pending(0) == data.size() - SimConfig().downlink_window);
+
+    sim.set_auto_receive(true);
+    REQUIRE(sim.run_until([&] { return sim.device_received(0).size() >= data.size(); }, 20000000));
+    CHECK(sim.device_received(0) == data);
+}
+
+TEST_CASE("Three peripherals share the gateway", "[bluz_sim]") {
+    SimConfig config;
+    config.peripherals = 3;
+    // the cloud data in flight for all of them has to fit in the downlink pool of the gateway
+    config.downlink_window = 320;
+    Sim sim(config);
+    REQUIRE(sim.start());
+
+    std::vector<std::vector<uint8_t>> down, up;
+    for (int i = 0; i < 3; i++) {
+        down.push_back(pattern(1500, 10 + i));
+        up.push_back(pattern(600, 20 + i));
+        sim.cloud_send(i, down[i].data(), down[i].size());
+    }
+    for (int i = 0; i < 3; i++) {
+        sim.device_send(i, up[i].data(), up[i].size());
+    }
+    REQUIRE(sim.run_until([&] {
+        for (int i = 0; i < 3; i++) {
+            if (sim.device_received(i).size() < down[i].size() || sim.cloud_received(i).size() < up[i].size()) {
+                return false;
+            }
+        }
+        return true;
+    }, 30000000));
+    for (int i = 0; i < 3; i++) {
+        CHECK(sim.device_received(i) == down[i]);
+        CHECK(sim.cloud_received(i) == up[i]);
+    }
+}
@@ -0,0 +1,7 @@
+/* Host build of the RTOS layer. The modem driver only needs std::recursive_mutex,
+ * which the host library provides without the gthread glue of the real header.
+ */
+#ifndef CONCURRENT_HAL_H
+#define CONCURRENT_HAL_H
+
+#endif /* CONCURRENT_HAL_H */
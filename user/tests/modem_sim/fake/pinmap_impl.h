@@ -0,0 +1,16 @@
+/* Host build of the STM32 pin map, only the fields the modem driver uses.
+ */
+#ifndef PINMAP_IMPL_H
+#define PINMAP_IMPL_H
+
+#include "pinmap_hal.h"
+#include "stm32f2xx.h"
+
+typedef struct STM32_Pin_Info {
+    GPIO_TypeDef* gpio_peripheral;
+    pin_t gpio_pin;
+} STM32_Pin_Info;
+
+STM32_Pin_Info* HAL_Pin_Map(void);
+
+#endif /* PINMAP_IMPL_H */
@@ -0,0 +1,15 @@
+/* Host build of the STM32F2 device header, only the GPIO port registers the modem
+ * driver writes directly when it powers the modem on.
+ */
+#ifndef __STM32F2xx_H
+#define __STM32F2xx_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    volatile uint16_t BSRRL;
+    volatile uint16_t BSRRH;
+} GPIO_TypeDef;
+
+#endif /* __STM32F2xx_H */
@@ -0,0 +1,176 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "sim_modem.h"
+#include "test_modem.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+#include <cstdio>
+
+namespace {
+
+// every byte value, and the framing the parser looks for inside the payload
+std::string payload(size_t length, int seed)
+{
+    std::string data;
+    const char* framing = "\"\r\nOK\r\n\"";
+    for (size_t i = 0; i < length; i++)
+        data += (i % 97 == 0) ? framing[(i / 97) % 8] : (char)(i * 31 + seed);
+    return data;
+}
+
+int open_tcp(TestModem& mdm)
+{
+    int socket = mdm.socketSocket(MDM_IPPROTO_TCP);
+    if (socket >= 0 && mdm.socketConnect(socket, IPADR(10,0,0,1), 5683))
+        mdm.socketSetBlocking(socket, 5000);
+    return socket;
+}
+
+std::string receive(TestModem& mdm, int socket, size_t length)
+{
+    std::string data(length, 0);
+    int received = 0;
+    while (received < (int)length) {
+        int n = mdm.socketRecv(socket, &data[received], length - received);
+        if (n <= 0)
+            break;
+        received += n;
+    }
+    data.resize(received);
+    return data;
+}
+
+// lets the +UUSORD/+UUSORF arrive
+int wait_readable(SimModem& modem, TestModem& mdm, int socket)
+{
+    int available = 0;
+    for (int i = 0; i < 100 && available == 0; i++) {
+        modem.advance(10000);
+        available = mdm.socketReadable(socket);
+    }
+    return available;
+}
+
+// compared outside the assertion, so a failure doesn't print the binary
+bool same(const std::string& a, const std::string& b)
+{
+    return a == b;
+}
+
+void report(const char* name, const SimModem& modem, size_t bytes, uint64_t started)
+{
+    double seconds = (modem.now_us() - started) / 1e6;
+    const SimModemStats& stats = modem.statistics();
+    printf("%s: %zu bytes in %.2f s, %.0f bytes/s\n", name, bytes, seconds, bytes / seconds);
+    printf("    link: %llu bytes to the modem, %llu from it, %llu commands\n",
+            (unsigned long long)stats.bytes_to_modem, (unsigned long long)stats.bytes_from_modem,
+            (unsigned long long)stats.commands);
+}
+
+} // namespace
+
+TEST_CASE("Socket data is written after the prompt", "[modem_sim]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = open_tcp(mdm);
+    REQUIRE(socket >= 0);
+
+    std::string data = payload(3000, 1);
+    CHECK(mdm.socketSend(socket, data.data(), data.size()) == (int)data.size());
+    CHECK(same(modem.network_received(0), data));
+    CHECK(modem.statistics().early_bytes == 0);
+}
+
+TEST_CASE("Binary socket data larger than the rx pipe is read intact", "[modem_sim]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = open_tcp(mdm);
+    REQUIRE(socket >= 0);
+
+    std::string data = payload(5000, 2);
+    modem.network_send(0, data);
+    CHECK(same(receive(mdm, socket, data.size()), data));
+    CHECK(modem.statistics().overruns == 0);
+}
+
+TEST_CASE("Datagrams are sent and read with their address", "[modem_sim]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = mdm.socketSocket(MDM_IPPROTO_UDP, 5684);
+    REQUIRE(socket >= 0);
+
+    std::string out = payload(600, 3);
+    CHECK(mdm.socketSendTo(socket, IPADR(10,0,0,1), 5684, out.data(), out.size()) == (int)out.size());
+    CHECK(same(modem.network_received(0), out));
+
+    std::string in = payload(700, 4);
+    modem.network_send(0, in);
+    std::string buf(in.size(), 0);
+    MDM_IP ip = NOIP;
+    int port = 0;
+    REQUIRE(wait_readable(modem, mdm, socket) == (int)in.size());
+    CHECK(mdm.socketRecvFrom(socket, &ip, &port, &buf[0], buf.size()) == (int)in.size());
+    CHECK(same(buf, in));
+    CHECK(ip == IPADR(10,0,0,1));
+    CHECK(port == 5684);
+}
+
+TEST_CASE("A short read leaves the rest pending", "[modem_sim]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = open_tcp(mdm);
+    REQUIRE(socket >= 0);
+
+    std::string data = payload(100, 5);
+    modem.network_send(0, data);
+    CHECK(same(receive(mdm, socket, 40), data.substr(0, 40)));
+    CHECK(mdm.socketReadable(socket) == 60);
+    CHECK(same(receive(mdm, socket, 60), data.substr(40)));
+}
+
+TEST_CASE("Socket write benchmark", "[modem_sim][benchmark]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = open_tcp(mdm);
+    REQUIRE(socket >= 0);
+    modem.reset_stats();
+
+    std::string data = payload(64 * 1024, 6);
+    uint64_t started = modem.now_us();
+    CHECK(mdm.socketSend(socket, data.data(), data.size()) == (int)data.size());
+    CHECK(same(modem.network_received(0), data));
+    report("write", modem, data.size(), started);
+}
+
+TEST_CASE("Socket read benchmark", "[modem_sim][benchmark]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = open_tcp(mdm);
+    REQUIRE(socket >= 0);
+    modem.reset_stats();
+
+    std::string data = payload(64 * 1024, 7);
+    uint64_t started = modem.now_us();
+    modem.network_send(0, data);
+    CHECK(same(receive(mdm, socket, data.size()), data));
+    CHECK(modem.statistics().overruns == 0);
+    report("read", modem, data.size(), started);
+}
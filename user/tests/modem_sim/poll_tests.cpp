@@ -0,0 +1,213 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "sim_modem.h"
+#include "test_modem.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+/**
+ * socket_receive() of the Electron HAL without a timeout, as TCPClient calls it.
+ */
+int hal_receive(TestModem& mdm, int socket, char* buffer, int len)
+{
+    mdm.socketSetBlocking(socket, 0);
+    int result = mdm.socketReadable(socket);
+    if (result <= 0)
+        return result;
+    return mdm.socketRecv(socket, buffer, len);
+}
+
+int open_tcp(TestModem& mdm)
+{
+    int socket = mdm.socketSocket(MDM_IPPROTO_TCP);
+    if (socket >= 0 && !mdm.socketConnect(socket, IPADR(10,0,0,1), 5683))
+        socket = -1;
+    return socket;
+}
+
+struct Session
+{
+    uint64_t bulk_done_us = 0;
+    std::vector<uint64_t> latencies_us;
+};
+
+/**
+ * A download on one socket and small messages arriving every message_period_us on
+ * the other, both read by an application loop in TCPClient sized pieces.
+ */
+Session run_session(SimModem& modem, TestModem& mdm, size_t bulk_size, int messages, uint64_t message_period_us)
+{
+    const size_t MESSAGE_SIZE = 32;
+    int bulk = open_tcp(mdm);
+    int interactive = open_tcp(mdm);
+    Session session;
+    if (bulk < 0 || interactive < 0)
+        return session;
+
+    uint64_t started = modem.now_us();
+    modem.network_send(0, std::string(bulk_size, 'b'));
+    size_t bulk_received = 0;
+    std::vector<uint64_t> sent;
+    size_t interactive_received = 0;
+    char buffer[128];
+
+    while (bulk_received < bulk_size || session.latencies_us.size() < (size_t)messages) {
+        if ((int)sent.size() < messages && modem.now_us() >= started + sent.size() * message_period_us) {
+            sent.push_back(modem.now_us());
+            modem.network_send(1, std::string(MESSAGE_SIZE, 'i'));
+        }
+        int n = hal_receive(mdm, bulk, buffer, sizeof(buffer));
+        if (n > 0) {
+            bulk_received += n;
+            if (bulk_received == bulk_size)
+                session.bulk_done_us = modem.now_us() - started;
+        }
+        int m = hal_receive(mdm, interactive, buffer, sizeof(buffer));
+        if (m > 0) {
+            interactive_received += m;
+            while (interactive_received >= (session.latencies_us.size() + 1) * MESSAGE_SIZE)
+                session.latencies_us.push_back(modem.now_us() - sent[session.latencies_us.size()]);
+        }
+        if (n <= 0 && m <= 0)
+            modem.advance(1000);        // the rest of the application loop
+        if (modem.now_us() - started > 60000000)
+            break;
+    }
+    return session;
+}
+
+// compared outside the assertion, so a failure doesn't print the binary
+bool same(const std::string& a, const std::string& b)
+{
+    return a == b;
+}
+
+} // namespace
+
+TEST_CASE("Polling reads ahead on every socket with data", "[modem_sim][poll]") {
+    SimModem modem;
+    TestModem mdm;
+    int first = open_tcp(mdm);
+    int second = open_tcp(mdm);
+    int idle = open_tcp(mdm);
+    REQUIRE(first >= 0);
+    REQUIRE(second >= 0);
+    REQUIRE(idle >= 0);
+
+    std::string a(300, 'a'), b(40, 'b');
+    modem.network_send(0, a);
+    modem.network_send(1, b);
+    modem.advance(10000);
+    CHECK(mdm.socketPoll() == 2);
+    CHECK(mdm.socketReadable(first) == 300);
+    CHECK(mdm.socketReadable(second) == 40);
+    CHECK(mdm.socketReadable(idle) == 0);
+
+    // already read, so this takes no time on the link
+    uint64_t before = modem.now_us();
+    std::string buf(300, 0);
+    CHECK(hal_receive(mdm, second, &buf[0], buf.size()) == 40);
+    CHECK(same(buf.substr(0, 40), b));
+    CHECK(modem.now_us() == before);
+    CHECK(hal_receive(mdm, first, &buf[0], buf.size()) == 300);
+    CHECK(same(buf, a));
+}
+
+TEST_CASE("Interleaved data on two sockets is read intact", "[modem_sim][poll]") {
+    SimModem modem;
+    TestModem mdm;
+    int first = open_tcp(mdm);
+    int second = open_tcp(mdm);
+    REQUIRE(first >= 0);
+    REQUIRE(second >= 0);
+
+    std::string a, b;
+    for (int i = 0; i < 3000; i++) {
+        a += (char)(i * 7);
+        b += (char)(i * 13 + 1);
+    }
+    std::string got_a, got_b;
+    char buffer[100];
+    for (int i = 0; i < 30; i++) {
+        modem.network_send(0, a.substr(i * 100, 100));
+        modem.network_send(1, b.substr(i * 100, 100));
+        for (int n; (n = hal_receive(mdm, first, buffer, sizeof(buffer) - i)) > 0;)
+            got_a.append(buffer, n);
+        for (int n; (n = hal_receive(mdm, second, buffer, sizeof(buffer) - i)) > 0;)
+            got_b.append(buffer, n);
+        modem.advance(5000);
+    }
+    for (int i = 0; i < 1000 && (got_a.size() < a.size() || got_b.size() < b.size()); i++) {
+        for (int n; (n = hal_receive(mdm, first, buffer, sizeof(buffer))) > 0;)
+            got_a.append(buffer, n);
+        for (int n; (n = hal_receive(mdm, second, buffer, sizeof(buffer))) > 0;)
+            got_b.append(buffer, n);
+        modem.advance(5000);
+    }
+    CHECK(same(got_a, a));
+    CHECK(same(got_b, b));
+    CHECK(modem.statistics().overruns == 0);
+}
+
+TEST_CASE("A read that only other sockets make progress on times out", "[modem_sim][poll]") {
+    SimModem modem;
+    TestModem mdm;
+    int stale = open_tcp(mdm);
+    int other = open_tcp(mdm);
+    REQUIRE(stale >= 0);
+    REQUIRE(other >= 0);
+
+    modem.network_send(1, std::string(40, 'o'));
+    modem.advance(10000);
+    mdm.overstate_pending(stale, 50);
+    char buffer[100];
+    CHECK(hal_receive(mdm, stale, buffer, sizeof(buffer)) == 0);
+
+    mdm.socketSetBlocking(stale, 200);
+    uint64_t before = modem.now_us();
+    CHECK(mdm.socketRecv(stale, buffer, sizeof(buffer)) == 0);
+    uint64_t waited = modem.now_us() - before;
+    CHECK(waited >= 200000);
+    CHECK(hal_receive(mdm, other, buffer, sizeof(buffer)) == 40);
+}
+
+TEST_CASE("Multi-socket read latency benchmark", "[modem_sim][benchmark]") {
+    SimModem modem;
+    TestModem mdm;
+    Session session = run_session(modem, mdm, 16 * 1024, 20, 250000);
+    REQUIRE(session.bulk_done_us > 0);
+    REQUIRE(session.latencies_us.size() == 20);
+
+    std::vector<uint64_t> latencies = session.latencies_us;
+    std::sort(latencies.begin(), latencies.end());
+    uint64_t total = 0;
+    for (uint64_t latency : latencies)
+        total += latency;
+    printf("multi-socket: download of 16384 bytes in %.2f s, %.0f bytes/s\n",
+            session.bulk_done_us / 1e6, 16384 / (session.bulk_done_us / 1e6));
+    printf("    message latency: mean %.1f ms, median %.1f ms, max %.1f ms\n",
+            total / 1e3 / latencies.size(), latencies[latencies.size() / 2] / 1e3, latencies.back() / 1e3);
+}
@@ -0,0 +1,296 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sim_modem.h"
+#include "mdm_hal.h"
+#include "delay_hal.h"
+#include "timer_hal.h"
+#include "gpio_hal.h"
+#include "pinmap_impl.h"
+#include "net_hal.h"
+#include <cstdio>
+
+namespace {
+
+SimModem* modem = nullptr;
+ElectronSerialPipe* serial = nullptr;
+
+} // namespace
+
+SimModem::SimModem(const SimModemConfig& config) : config(config)
+{
+    // 8 data bits with a start and stop bit
+    byte_us = (10 * 1000000ull + config.baud - 1) / config.baud;
+    modem = this;
+}
+
+SimModem::~SimModem()
+{
+    modem = nullptr;
+}
+
+SimModem* SimModem::current()
+{
+    return modem;
+}
+
+void SimModem::advance(uint64_t us)
+{
+    now += us;
+    if (serial)
+        serial->rxIrqBuf();
+}
+
+void SimModem::replay(const std::string& text)
+{
+    rxFree = std::max(rxFree, now);
+    for (char c : text)
+        rx.push_back(std::make_pair(rxFree, c));
+    stats.bytes_from_modem += text.size();
+}
+
+void SimModem::network_send(int handle, const std::string& data)
+{
+    Socket& s = socket(handle);
+    s.pending += data;
+    char urc[32];
+    sprintf(urc, "\r\n+UUSOR%c: %d,%d\r\n", s.udp ? 'F' : 'D', handle, (int)s.pending.size());
+    respond(urc, now);
+}
+
+const std::string& SimModem::network_received(int handle)
+{
+    return socket(handle).received;
+}
+
+void SimModem::from_device(const char* data, int length)
+{
+    for (int i = 0; i < length; i++) {
+        txFree = std::max(txFree, now) + byte_us;
+        byte_from_device(data[i], txFree);
+    }
+    stats.bytes_to_modem += length;
+}
+
+void SimModem::to_device(Pipe<char>& pipe)
+{
+    while (!rx.empty() && rx.front().first <= now) {
+        if (pipe.writeable())
+            pipe.putc(rx.front().second);
+        else
+            stats.overruns++;
+        rx.pop_front();
+    }
+}
+
+void SimModem::byte_from_device(char c, uint64_t at)
+{
+    if (dataRemaining) {
+        if (at < dataAfter)
+            stats.early_bytes++;
+        else
+            socket(dataSocket).received += c;
+        if (!--dataRemaining)
+            respond(dataCommand, at + config.response_latency_us);
+        return;
+    }
+    // the driver ends every command with \r\n, so the \n can't be taken for socket data
+    if (c == '\n') {
+        if (!line.empty())
+            command(line, at);
+        line.clear();
+    }
+    else if (c != '\r') {
+        line += c;
+    }
+}
+
+void SimModem::command(const std::string& line, uint64_t at)
+{
+    stats.commands++;
+    uint64_t reply = at + config.response_latency_us;
+    char text[64];
+    int handle, length, port;
+    if (sscanf(line.c_str(), "AT+USOCR=%d", &port) == 1) {
+        handle = nextHandle++;
+        socket(handle).udp = (port == 17);
+        sprintf(text, "\r\n+USOCR: %d\r\n\r\nOK\r\n", handle);
+        respond(text, reply);
+    }
+    else if (line.compare(0, 10, "AT+USOCTL=") == 0) {
+        respond("\r\n+CME ERROR: operation not allowed\r\n", reply);
+    }
+    else if (sscanf(line.c_str(), "AT+USOCL=%d", &handle) == 1) {
+        sockets.erase(handle);
+        respond("\r\nOK\r\n", reply);
+    }
+    else if (sscanf(line.c_str(), "AT+USOWR=%d,%d", &handle, &length) == 2 ||
+             sscanf(line.c_str(), "AT+USOST=%d,\"%*[0-9.]\",%*d,%d", &handle, &length) == 2) {
+        bool udp = line[7] == 'S';
+        sprintf(text, "\r\n+USO%s: %d,%d\r\n\r\nOK\r\n", udp ? "ST" : "WR", handle, length);
+        dataCommand = text;
+        dataSocket = handle;
+        dataRemaining = length;
+        respond("\r\n@", at + config.prompt_latency_us);
+        dataAfter = rxFree + config.prompt_guard_us;
+    }
+    else if (sscanf(line.c_str(), "AT+USORD=%d,%d", &handle, &length) == 2 ||
+             sscanf(line.c_str(), "AT+USORF=%d,%d", &handle, &length) == 2) {
+        Socket& s = socket(handle);
+        if (length > (int)s.pending.size())
+            length = s.pending.size();
+        if (line[7] == 'F')
+            sprintf(text, "\r\n+USORF: %d,\"10.0.0.1\",5684,%d,\"", handle, length);
+        else
+            sprintf(text, "\r\n+USORD: %d,%d,\"", handle, length);
+        respond(text + s.pending.substr(0, length) + "\"\r\n\r\nOK\r\n", reply);
+        s.pending.erase(0, length);
+    }
+    else {
+        respond("\r\nOK\r\n", reply);
+    }
+}
+
+void SimModem::respond(const std::string& text, uint64_t at)
+{
+    rxFree = std::max(rxFree, at);
+    for (char c : text) {
+        rxFree += byte_us;
+        rx.push_back(std::make_pair(rxFree, c));
+    }
+    stats.bytes_from_modem += text.size();
+}
+
+/*
+ * The HAL under the parser.
+ */
+
+void HAL_Delay_Milliseconds(uint32_t millis)
+{
+    if (modem)
+        modem->advance(millis * 1000ull);
+}
+
+system_tick_t HAL_Timer_Get_Milli_Seconds(void)
+{
+    if (!modem)
+        return 0;
+    modem->advance(0);
+    return modem->now_us() / 1000;
+}
+
+void HAL_Pin_Mode(pin_t pin, PinMode mode)
+{
+}
+
+void HAL_GPIO_Write(pin_t pin, uint8_t value)
+{
+}
+
+STM32_Pin_Info* HAL_Pin_Map(void)
+{
+    static GPIO_TypeDef port;
+    static STM32_Pin_Info pins[TOTAL_PINS];
+    for (STM32_Pin_Info& pin : pins)
+        pin.gpio_peripheral = &port;
+    return pins;
+}
+
+void HAL_NET_notify_disconnected()
+{
+}
+
+void HAL_NET_notify_dhcp(bool dhcp)
+{
+}
+
+/*
+ * USART3, the received bytes are put in the pipe when their time has come.
+ */
+
+ElectronSerialPipe::ElectronSerialPipe(int rxSize, int txSize) :
+    _pipeRx(rxSize), _pipeTx(txSize)
+{
+    serial = this;
+}
+
+ElectronSerialPipe::~ElectronSerialPipe(void)
+{
+    if (serial == this)
+        serial = nullptr;
+}
+
+void ElectronSerialPipe::begin(unsigned int baud)
+{
+}
+
+int ElectronSerialPipe::writeable(void)
+{
+    return _pipeTx.free();
+}
+
+int ElectronSerialPipe::putc(int c)
+{
+    char ch = c;
+    put(&ch, 1, true);
+    return c;
+}
+
+int ElectronSerialPipe::put(const void* buffer, int length, bool blocking)
+{
+    if (modem)
+        modem->from_device((const char*)buffer, length);
+    return length;
+}
+
+int ElectronSerialPipe::readable(void)
+{
+    rxIrqBuf();
+    return _pipeRx.size();
+}
+
+int ElectronSerialPipe::getc(void)
+{
+    rxIrqBuf();
+    return _pipeRx.getc();
+}
+
+int ElectronSerialPipe::get(void* buffer, int length, bool blocking)
+{
+    rxIrqBuf();
+    return _pipeRx.get((char*)buffer, length, blocking);
+}
+
+void ElectronSerialPipe::rxIrqBuf(void)
+{
+    if (modem)
+        modem->to_device(_pipeRx);
+}
+
+void ElectronSerialPipe::txIrqBuf(void)
+{
+}
+
+void ElectronSerialPipe::txStart(void)
+{
+}
+
+void ElectronSerialPipe::txCopy(void)
+{
+}
+
+MDMElectronSerial electronMDM;
@@ -0,0 +1,112 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_MODEM_H
+#define SIM_MODEM_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include "pipe_hal.h"
+
+/**
+ * Timing of the simulated serial link and modem. The defaults are the Electron's
+ * USART3 without flow control and a SARA-U2 answering the socket commands.
+ */
+struct SimModemConfig
+{
+    uint32_t    baud = 115200;                      // electronMDM.begin()
+    uint32_t    response_latency_us = 1000;         // from the end of a command to the start of its response
+    uint32_t    prompt_latency_us = 1000;           // from AT+USOWR/AT+USOST to the @ prompt
+    uint32_t    prompt_guard_us = 0;                // bytes arriving sooner than this after the @ are lost
+};
+
+/** What went over the link since the statistics were last reset. */
+struct SimModemStats
+{
+    uint64_t    commands = 0;
+    uint64_t    bytes_to_modem = 0;
+    uint64_t    bytes_from_modem = 0;
+    uint64_t    overruns = 0;                       // bytes that arrived while the rx pipe was full, lost without flow control
+    uint64_t    early_bytes = 0;                    // socket data sent inside the prompt guard
+};
+
+/**
+ * The serial link and a u-blox modem with sockets open to the network, for the
+ * real MDMParser running on the host.
+ *
+ * Time is simulated and only passes when the parser waits, through HAL_Delay_Milliseconds,
+ * or while its bytes are on the wire. Only one can exist at a time, the HAL functions
+ * find it through current().
+ */
+class SimModem
+{
+public:
+    explicit SimModem(const SimModemConfig& config = SimModemConfig());
+    ~SimModem();
+
+    static SimModem* current();
+
+    uint64_t now_us() const { return now; }
+    void advance(uint64_t us);
+
+    // lines the modem sends at once, taken as fast as the parser reads them, such as a recorded session
+    void replay(const std::string& text);
+    size_t backlog() const { return rx.size(); }
+
+    // the network end of the modem's sockets
+    void network_send(int handle, const std::string& data);
+    const std::string& network_received(int handle);
+
+    void reset_stats() { stats = SimModemStats(); }
+    const SimModemStats& statistics() const { return stats; }
+
+    // called by the fake serial driver
+    void from_device(const char* data, int length);
+    void to_device(Pipe<char>& rx);
+
+private:
+    struct Socket
+    {
+        std::string pending;                        // received from the network, not yet read
+        std::string received;                       // written by the device
+        bool udp = false;
+    };
+
+    void byte_from_device(char c, uint64_t at);
+    void command(const std::string& line, uint64_t at);
+    void respond(const std::string& text, uint64_t at);
+    Socket& socket(int handle) { return sockets[handle]; }
+
+    SimModemConfig config;
+    uint64_t now = 0;
+    uint64_t byte_us;
+    uint64_t txFree = 0;                            // when the wire to the modem is next idle
+    uint64_t rxFree = 0;                            // when the wire from the modem is next idle
+    std::deque<std::pair<uint64_t, char>> rx;       // bytes on their way to the device, with their arrival
+    std::string line;                               // the command being received
+    int dataSocket = -1;                            // socket data follows the @ prompt
+    int dataRemaining = 0;
+    uint64_t dataAfter = 0;                         // data before this is lost
+    std::string dataCommand;
+    std::map<int, Socket> sockets;
+    int nextHandle = 0;
+    SimModemStats stats;
+};
+
+#endif /* SIM_MODEM_H */
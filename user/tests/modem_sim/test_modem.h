@@ -0,0 +1,45 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEST_MODEM_H
+#define TEST_MODEM_H
+
+#include "mdm_hal.h"
+
+/**
+ * The parser on the simulated link, registered on the network as join() leaves it,
+ * with the state the unsolicited results change opened up to the tests.
+ */
+class TestModem : public MDMElectronSerial
+{
+public:
+    TestModem()
+    {
+        _attached = true;
+        _ip = IPADR(10,1,2,3);
+    }
+
+    const NetStatus& net() const { return _net; }
+    bool attached() const { return _attached; }
+    bool attached_urc() const { return _attached_urc; }
+    MDM_IP ip() const { return _ip; }
+
+    // as if an unsolicited result had reported more than the modem then gives
+    void overstate_pending(int socket, int bytes) { _sockets[socket].pending += bytes; }
+};
+
+#endif /* TEST_MODEM_H */
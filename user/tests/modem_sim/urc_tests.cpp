@@ -0,0 +1,162 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "sim_modem.h"
+#include "test_modem.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+// what the modem sends during registration and a cloud session, as the parser sees it
+const char* const session[] = {
+    "+CREG: 2",
+    "+CGREG: 2",
+    "+CIEV: 2,3",
+    "+CREG: 5,\"2D3A\",\"0B1C2D3\",2",
+    "+CGREG: 5,\"2D3A\",\"0B1C2D3\",2",
+    "+CIEV: 9,2",
+    "+CSQ: 17,99",
+    "OK",
+    "+COPS: 0,0,\"AT&T\",2",
+    "OK",
+    "+UUSORD: 0,128",
+    "+USORD: 0,16,\"0123456789abcdef\"",
+    "OK",
+    "+UUSORF: 1,64",
+    "+USORF: 1,\"10.0.0.1\",5684,8,\"ABCDEFGH\"",
+    "OK",
+    "+CMTI: \"SM\",4",
+    "+UUSOCL: 2",
+    "+UUPSDD: 1",
+    "+CIEV: 7,0",
+};
+
+std::string lines(std::initializer_list<const char*> list)
+{
+    std::string text;
+    for (const char* line : list)
+        text += std::string("\r\n") + line + "\r\n";
+    return text;
+}
+
+// until the parser has read everything and waited for more
+void drain(SimModem& modem, TestModem& mdm)
+{
+    while (mdm.waitFinalResp(NULL, NULL, 0) != WAIT || modem.backlog())
+        ;
+}
+
+} // namespace
+
+TEST_CASE("A registration URC gives the status, area, cell and access technology", "[modem_sim][urc]") {
+    SimModem modem;
+    TestModem mdm;
+    modem.replay(lines({ "+CREG: 5,\"2D3A\",\"0B1C2D3\",2" }));
+    drain(modem, mdm);
+    CHECK(mdm.net().csd == REG_ROAMING);
+    CHECK(mdm.net().lac == 0x2D3A);
+    CHECK(mdm.net().ci == 0x0B1C2D3);
+    CHECK(mdm.net().act == ACT_UTRAN);
+}
+
+TEST_CASE("A registration reply gives the status after the mode", "[modem_sim][urc]") {
+    SimModem modem;
+    TestModem mdm;
+    modem.replay(lines({ "+CGREG: 2,1", "+CREG: 0,3" }));
+    drain(modem, mdm);
+    CHECK(mdm.net().psd == REG_HOME);
+    CHECK(mdm.net().csd == REG_DENIED);
+    CHECK(mdm.net().lac == 0xFFFF);
+}
+
+TEST_CASE("Socket URCs update the pending data and close the socket", "[modem_sim][urc]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = mdm.socketSocket(MDM_IPPROTO_TCP);
+    REQUIRE(socket >= 0);
+    REQUIRE(mdm.socketConnect(socket, IPADR(10,0,0,1), 5683));
+
+    modem.replay(lines({ "+UUSORD: 0,321" }));
+    drain(modem, mdm);
+    CHECK(mdm.socketReadable(socket) == 321);
+
+    modem.replay(lines({ "+UUSOCL: 0" }));
+    drain(modem, mdm);
+    CHECK_FALSE(mdm.socketIsConnected(socket));
+}
+
+TEST_CASE("The PDP context of our profile going down detaches", "[modem_sim][urc]") {
+    SimModem modem;
+    TestModem mdm;
+    modem.replay(lines({ "+UUPSDD: 1" }));
+    drain(modem, mdm);
+    CHECK(mdm.attached());
+
+    modem.replay(lines({ "+UUPSDD: 0" }));
+    drain(modem, mdm);
+    CHECK_FALSE(mdm.attached());
+    CHECK(mdm.ip() == NOIP);
+}
+
+TEST_CASE("The GPRS indicator follows attach and detach", "[modem_sim][urc]") {
+    SimModem modem;
+    TestModem mdm;
+    modem.replay(lines({ "+CIEV: 9,1" }));
+    drain(modem, mdm);
+    CHECK_FALSE(mdm.attached_urc());
+
+    modem.replay(lines({ "+CIEV: 9,2" }));
+    drain(modem, mdm);
+    CHECK(mdm.attached_urc());
+}
+
+TEST_CASE("Lines that only look like URCs are left alone", "[modem_sim][urc]") {
+    SimModem modem;
+    TestModem mdm;
+    modem.replay(lines({ "+CREGX: 3", "+UUSORDER: 0,5", "+CIEV: 9", "+CREG" }));
+    drain(modem, mdm);
+    CHECK(mdm.net().csd == REG_UNKNOWN);
+    CHECK(mdm.attached());
+}
+
+TEST_CASE("URC replay benchmark", "[modem_sim][benchmark]") {
+    SimModem modem;
+    TestModem mdm;
+    int socket = mdm.socketSocket(MDM_IPPROTO_TCP);
+    REQUIRE(socket >= 0);
+
+    std::string text;
+    for (const char* line : session)
+        text += std::string("\r\n") + line + "\r\n";
+    const int replays = 20000;
+    const int count = replays * (sizeof(session) / sizeof(*session));
+
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < replays; i++) {
+        modem.replay(text);
+        drain(modem, mdm);
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - started;
+    printf("urc replay: %d lines in %.2f s, %.0f lines/s\n", count, seconds.count(), count / seconds.count());
+    CHECK(mdm.net().psd == REG_ROAMING);
+}
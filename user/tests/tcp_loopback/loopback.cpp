@@ -0,0 +1,141 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loopback.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+LoopbackServer::LoopbackServer()
+{
+    listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    ::bind(listener, (sockaddr*)&address, sizeof(address));
+    ::listen(listener, 1);
+    ::socklen_t length = sizeof(address);
+    ::getsockname(listener, (sockaddr*)&address, &length);
+    port_ = ntohs(address.sin_port);
+}
+
+LoopbackServer::~LoopbackServer()
+{
+    if (thread.joinable())
+        thread.join();
+    ::close(listener);
+}
+
+void LoopbackServer::serve(const std::string& data)
+{
+    this->data = data;
+    thread = std::thread(&LoopbackServer::accept_and, this, true);
+}
+
+void LoopbackServer::sink()
+{
+    data.clear();
+    thread = std::thread(&LoopbackServer::accept_and, this, false);
+}
+
+std::string LoopbackServer::join()
+{
+    if (thread.joinable())
+        thread.join();
+    return data;
+}
+
+void LoopbackServer::accept_and(bool send)
+{
+    int client = ::accept(listener, NULL, NULL);
+    if (client < 0)
+        return;
+    if (send) {
+        for (size_t sent = 0; sent < data.size();) {
+            ssize_t n = ::send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            sent += n;
+        }
+    }
+    else {
+        char buffer[4096];
+        ssize_t n;
+        while ((n = ::recv(client, buffer, sizeof(buffer), 0)) > 0)
+            data.append(buffer, n);
+    }
+    ::close(client);
+}
+
+LoopbackStats& LoopbackServer::statistics()
+{
+    static LoopbackStats stats;
+    return stats;
+}
+
+namespace host {
+
+int tcp_socket()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    // the device sends each write as it comes
+    int one = 1;
+    if (fd >= 0)
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+int tcp_connect(int fd, const uint8_t* port_and_address)
+{
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    memcpy(&address.sin_port, port_and_address, 2);
+    memcpy(&address.sin_addr, port_and_address + 2, 4);
+    return ::connect(fd, (sockaddr*)&address, sizeof(address));
+}
+
+int tcp_receive(int fd, void* buffer, size_t length)
+{
+    ssize_t n = ::recv(fd, buffer, length, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    return n > 0 ? n : -1;
+}
+
+int tcp_send(int fd, const void* buffer, size_t length)
+{
+    return ::send(fd, buffer, length, MSG_NOSIGNAL);
+}
+
+bool tcp_closed(int fd)
+{
+    char c;
+    ssize_t n = ::recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+int tcp_close(int fd)
+{
+    return ::close(fd);
+}
+
+} // namespace host
@@ -0,0 +1,85 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/** The socket HAL calls TCPClient made since the counts were last reset. */
+struct LoopbackStats
+{
+    uint64_t    receives = 0;                       // socket_receive calls
+    uint64_t    empty_receives = 0;                 // of those, the ones that found nothing to read
+    uint64_t    sends = 0;                          // socket_send calls
+};
+
+/**
+ * A TCP server on 127.0.0.1 for one client, run on its own thread. It either sends
+ * the client the data it was given and closes, or keeps what the client sends
+ * until the client closes.
+ *
+ * The socket HAL under TCPClient is a thin layer over the host's sockets, without
+ * a receive timeout like the Photon's, and counts the calls made to it.
+ */
+class LoopbackServer
+{
+public:
+    LoopbackServer();
+    ~LoopbackServer();
+
+    uint16_t port() const { return port_; }
+
+    /** Sends this to the next client that connects, then closes the connection. */
+    void serve(const std::string& data);
+
+    /** Keeps what the next client that connects sends, until it closes. */
+    void sink();
+
+    /** Waits for the client to be served and returns what it sent. */
+    std::string join();
+
+    static LoopbackStats& statistics();
+    static void reset_stats() { statistics() = LoopbackStats(); }
+
+private:
+    void accept_and(bool send);
+
+    int listener;
+    uint16_t port_;
+    std::thread thread;
+    std::string data;
+};
+
+/**
+ * The host's TCP sockets for the socket HAL, which can't include the host's
+ * headers alongside its own.
+ */
+namespace host {
+
+int tcp_socket();
+int tcp_connect(int fd, const uint8_t* port_and_address);  // the sa_data of a sockaddr_t
+int tcp_receive(int fd, void* buffer, size_t length);       // without waiting, 0 when there is nothing yet, -1 once closed
+int tcp_send(int fd, const void* buffer, size_t length);
+bool tcp_closed(int fd);
+int tcp_close(int fd);
+
+} // namespace host
+
+#endif
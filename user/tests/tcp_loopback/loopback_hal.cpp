@@ -0,0 +1,101 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loopback.h"
+#include "socket_hal.h"
+#include "net_hal.h"
+#include "spark_wiring_network.h"
+
+/*
+ * The socket HAL under TCPClient, a socket handle is the host's descriptor.
+ */
+
+sock_handle_t socket_handle_invalid()
+{
+    return sock_handle_t(-1);
+}
+
+uint8_t socket_handle_valid(sock_handle_t handle)
+{
+    return handle != socket_handle_invalid();
+}
+
+sock_handle_t socket_create(uint8_t family, uint8_t type, uint8_t protocol, uint16_t port, network_interface_t nif)
+{
+    int fd = host::tcp_socket();
+    return fd < 0 ? socket_handle_invalid() : sock_handle_t(fd);
+}
+
+sock_result_t socket_connect(sock_handle_t sd, const sockaddr_t* addr, long addrlen)
+{
+    return host::tcp_connect(sd, addr->sa_data);
+}
+
+uint8_t socket_active_status(sock_handle_t socket)
+{
+    return host::tcp_closed(socket) ? SOCKET_STATUS_INACTIVE : SOCKET_STATUS_ACTIVE;
+}
+
+sock_result_t socket_receive(sock_handle_t sd, void* buffer, socklen_t len, system_tick_t _timeout)
+{
+    LoopbackStats& stats = LoopbackServer::statistics();
+    stats.receives++;
+    int n = host::tcp_receive(sd, buffer, len);
+    if (n == 0)
+        stats.empty_receives++;
+    return n;
+}
+
+sock_result_t socket_send(sock_handle_t sd, const void* buffer, socklen_t len)
+{
+    LoopbackServer::statistics().sends++;
+    return host::tcp_send(sd, buffer, len);
+}
+
+sock_result_t socket_close(sock_handle_t sd)
+{
+    return host::tcp_close(sd);
+}
+
+uint32_t HAL_NET_SetNetWatchDog(uint32_t timeOutInuS)
+{
+    return 0;
+}
+
+int inet_gethostbyname(const char* hostname, uint16_t hostnameLen, HAL_IPAddress* out_ip_addr,
+        network_interface_t nif, void* reserved)
+{
+    return -1;
+}
+
+namespace {
+
+class LoopbackNetwork : public spark::NetworkClass
+{
+public:
+    bool ready() override { return true; }
+};
+
+LoopbackNetwork loopback;
+
+} // namespace
+
+namespace spark {
+
+NetworkClass& Network = loopback;
+
+}
@@ -0,0 +1,244 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "loopback.h"
+#include "spark_wiring_tcpclient.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// while set, array allocations fail the way they do on the device, by returning null
+bool fail_allocation = false;
+
+std::string payload(size_t length, int seed)
+{
+    std::string data(length, 0);
+    for (size_t i = 0; i < length; i++)
+        data[i] = (char)(i * 31 + i / 251 + seed);
+    return data;
+}
+
+bool connect(TCPClient& client, LoopbackServer& server)
+{
+    return client.connect(IPAddress(127,0,0,1), server.port());
+}
+
+// reads in pieces of the given size until there is length or the server has gone quiet
+std::string receive(TCPClient& client, size_t length, size_t piece)
+{
+    std::string data;
+    std::vector<uint8_t> buffer(piece);
+    auto quiet = std::chrono::steady_clock::now();
+    while (data.size() < length && std::chrono::steady_clock::now() - quiet < std::chrono::seconds(5)) {
+        int n = client.read(buffer.data(), std::min(piece, length - data.size()));
+        if (n > 0) {
+            data.append((const char*)buffer.data(), n);
+            quiet = std::chrono::steady_clock::now();
+        }
+    }
+    return data;
+}
+
+// compared outside the assertion, so a failure doesn't print the binary
+bool same(const std::string& a, const std::string& b)
+{
+    return a == b;
+}
+
+void report(const char* name, size_t bytes, std::chrono::duration<double> seconds)
+{
+    const LoopbackStats& stats = LoopbackServer::statistics();
+    printf("%s: %zu bytes in %.3f s, %.1f MB/s\n", name, bytes, seconds.count(), bytes / seconds.count() / 1e6);
+    printf("    %llu socket_receive calls (%llu empty), %llu socket_send calls\n",
+            (unsigned long long)stats.receives, (unsigned long long)stats.empty_receives,
+            (unsigned long long)stats.sends);
+}
+
+void download(const char* name, size_t buffer_size, size_t piece)
+{
+    LoopbackServer server;
+    std::string data = payload(16 * 1024 * 1024, 9);
+    server.serve(data);
+    TCPClient client;
+    REQUIRE(connect(client, server));
+    if (buffer_size)
+        REQUIRE(client.setBuffer(buffer_size));
+    LoopbackServer::reset_stats();
+
+    auto started = std::chrono::steady_clock::now();
+    std::string received = receive(client, data.size(), piece);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - started;
+    CHECK(same(received, data));
+    report(name, data.size(), seconds);
+    client.stop();
+}
+
+} // namespace
+
+void* operator new[](size_t size)
+{
+    return fail_allocation ? nullptr : malloc(size);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+TEST_CASE("Reads larger than the buffer are received intact", "[tcpclient]") {
+    LoopbackServer server;
+    std::string data = payload(100000, 1);
+    server.serve(data);
+    TCPClient client;
+    REQUIRE(connect(client, server));
+    CHECK(same(receive(client, data.size(), 1000), data));
+}
+
+TEST_CASE("Small and large reads keep the data in order", "[tcpclient]") {
+    LoopbackServer server;
+    std::string data = payload(20000, 2);
+    server.serve(data);
+    TCPClient client;
+    REQUIRE(connect(client, server));
+
+    std::string received = receive(client, 7, 7);
+    received += receive(client, 3000, 3000);
+    int c;
+    while ((c = client.read()) < 0)
+        ;
+    received += (char)c;
+    received += receive(client, 50, 50);
+    received += receive(client, data.size() - received.size(), 4096);
+    CHECK(same(received, data));
+}
+
+TEST_CASE("A bigger buffer keeps the data already received", "[tcpclient]") {
+    LoopbackServer server;
+    std::string data = payload(8000, 3);
+    server.serve(data);
+    TCPClient client;
+    REQUIRE(connect(client, server));
+    CHECK(client.bufferSize() == TCPCLIENT_BUF_MAX_SIZE);
+
+    std::string received = receive(client, 1, 1);
+    int buffered = client.available();
+    REQUIRE(buffered > 1);
+    CHECK_FALSE(client.setBuffer(buffered - 1));
+    REQUIRE(client.setBuffer(4096));
+    CHECK(client.bufferSize() == 4096);
+    CHECK(client.available() >= buffered);
+
+    received += receive(client, 100, 100);
+    uint8_t own[5000];
+    REQUIRE(client.setBuffer(sizeof(own), own));
+    received += receive(client, data.size() - received.size(), 100);
+    CHECK(same(received, data));
+    REQUIRE(client.setBuffer(0));
+    CHECK(client.bufferSize() == TCPCLIENT_BUF_MAX_SIZE);
+}
+
+TEST_CASE("A copy of a client has a buffer of its own", "[tcpclient]") {
+    LoopbackServer server;
+    std::string data = payload(1000, 4);
+    server.serve(data);
+    TCPClient client;
+    REQUIRE(connect(client, server));
+    REQUIRE(client.setBuffer(2048));
+
+    std::string received = receive(client, 1, 1);
+    TCPClient copy(client);
+    CHECK(copy.bufferSize() == 2048);
+    CHECK(same(receive(copy, 10, 10), data.substr(1, 10)));
+    CHECK(same(receive(client, 10, 10), data.substr(1, 10)));
+
+    TCPClient assigned;
+    assigned = copy;
+    CHECK(same(receive(assigned, 5, 5), data.substr(11, 5)));
+}
+
+TEST_CASE("A copy that can't allocate its buffer keeps what fits in the local one", "[tcpclient]") {
+    LoopbackServer server;
+    std::string data = payload(1000, 5);
+    server.serve(data);
+    TCPClient client;
+    REQUIRE(connect(client, server));
+    REQUIRE(client.setBuffer(2048));
+
+    // fill the client's buffer with more than the local buffer holds
+    std::string received = receive(client, 1, 1);
+    auto started = std::chrono::steady_clock::now();
+    while (client.available() < 600 && std::chrono::steady_clock::now() - started < std::chrono::seconds(5))
+        ;
+    REQUIRE(client.available() >= 600);
+
+    fail_allocation = true;
+    TCPClient copy(client);
+    fail_allocation = false;
+    CHECK(copy.bufferSize() == TCPCLIENT_BUF_MAX_SIZE);
+    CHECK(copy.available() == TCPCLIENT_BUF_MAX_SIZE);
+    CHECK(same(receive(copy, TCPCLIENT_BUF_MAX_SIZE, 10), data.substr(1, TCPCLIENT_BUF_MAX_SIZE)));
+}
+
+TEST_CASE("A line ending goes out in one send", "[tcpclient]") {
+    LoopbackServer server;
+    server.sink();
+    TCPClient client;
+    REQUIRE(connect(client, server));
+    LoopbackServer::reset_stats();
+
+    client.println();
+    CHECK(LoopbackServer::statistics().sends == 1);
+    client.println("GET / HTTP/1.0");
+    CHECK(LoopbackServer::statistics().sends == 3);
+    client.stop();
+    CHECK(server.join() == "\r\nGET / HTTP/1.0\r\n");
+}
+
+TEST_CASE("Download benchmark", "[tcpclient][benchmark]") {
+    download("read(64), 128 byte buffer", 0, 64);
+    download("read(1024), straight to the caller", 0, 1024);
+    download("read(100), 2048 byte buffer", 2048, 100);
+}
+
+TEST_CASE("Upload benchmark", "[tcpclient][benchmark]") {
+    LoopbackServer server;
+    server.sink();
+    TCPClient client;
+    REQUIRE(connect(client, server));
+    LoopbackServer::reset_stats();
+
+    std::string block = payload(1024, 5);
+    const int blocks = 4096;
+    const int lines = 20000;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < blocks; i++)
+        client.write((const uint8_t*)block.data(), block.size());
+    for (int i = 0; i < lines; i++)
+        client.println("Host: example.com");
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - started;
+    client.stop();
+    size_t bytes = server.join().size();
+    CHECK(bytes == blocks * block.size() + lines * 19);
+    report("write(1024) and println", bytes, seconds);
+}
@@ -0,0 +1,64 @@
+/**
+ ******************************************************************************
+ * @file    block_pool.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "block_pool.h"
+
+SCENARIO("A buffer takes a run of adjacent blocks", "[block_pool]") {
+  uint8_t memory[64 * 24];
+  block_pool_t pool;
+  block_pool_init(&pool, memory, 64, 24);
+
+  uint8_t* first = block_pool_alloc(&pool, 100);
+  uint8_t* second = block_pool_alloc(&pool, 64);
+  REQUIRE(first == memory);
+  REQUIRE(second == memory + 128);
+  CHECK(pool.blocks_used == 3);
+
+  block_pool_free(&pool, first, 100);
+  CHECK(pool.blocks_used == 1);
+  CHECK(block_pool_alloc(&pool, 128) == memory);
+}
+
+SCENARIO("A buffer larger than the pool is refused", "[block_pool]") {
+  uint8_t memory[64 * 24];
+  block_pool_t pool;
+  block_pool_init(&pool, memory, 64, 24);
+
+  CHECK(block_pool_alloc(&pool, 64 * 24 + 1) == NULL);
+  // 257 blocks, which used to wrap to a single block
+  CHECK(block_pool_alloc(&pool, 16448) == NULL);
+  CHECK(block_pool_alloc(&pool, 65535) == NULL);
+  CHECK(pool.blocks_used == 0);
+  CHECK(pool.alloc_failures == 3);
+
+  CHECK(block_pool_alloc(&pool, 64 * 24) == memory);
+  CHECK(pool.blocks_used == 24);
+}
+
+SCENARIO("An empty buffer is refused", "[block_pool]") {
+  uint8_t memory[32 * 4];
+  block_pool_t pool;
+  block_pool_init(&pool, memory, 32, 4);
+
+  CHECK(block_pool_alloc(&pool, 0) == NULL);
+  CHECK(pool.used_mask == 0);
+}
@@ -0,0 +1,343 @@
+/**
+ ******************************************************************************
+ * @file    chunked_transfer.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "chunked_transfer.h"
+#include "crc32.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+
+#include <vector>
+#include <set>
+#include <deque>
+#include <cstring>
+
+using namespace particle::protocol;
+
+typedef std::vector<uint8_t> Bytes;
+
+// the communication sources log through this when built with DEBUG_BUILD
+extern "C" void log_print_(int level, int line, const char *func, const char *file, const char *msg, ...)
+{
+}
+
+namespace {
+
+/**
+ * The device end of the transfer, the image is staged in RAM.
+ */
+struct Device : ChunkedTransfer::Callbacks
+{
+    Bytes image;
+    system_tick_t now = 0;
+    int saves = 0;
+    bool finished = false;
+    uint32_t finish_flags = 0;
+
+    int prepare_for_firmware_update(FileTransfer::Descriptor& file, uint32_t flags, void*) override
+    {
+        if (!flags)
+            image.assign(file.file_length, 0);
+        return 0;
+    }
+
+    int save_firmware_chunk(FileTransfer::Descriptor& file, const unsigned char* chunk, void*) override
+    {
+        uint32_t offset = file.chunk_address - file.file_address;
+        REQUIRE(size_t(offset+file.chunk_size)<=image.size());
+        memcpy(image.data()+offset, chunk, file.chunk_size);
+        saves++;
+        return 0;
+    }
+
+    int finish_firmware_update(FileTransfer::Descriptor& file, uint32_t flags, void*) override
+    {
+        finished = true;
+        finish_flags = flags;
+        return 0;
+    }
+
+    uint32_t calculate_crc(const unsigned char *buf, uint32_t buflen) override
+    {
+        return crc32_update(0, buf, buflen);
+    }
+
+    system_tick_t millis() override
+    {
+        return now;
+    }
+};
+
+/**
+ * A channel over a single static buffer, as the real channels are, that
+ * loses some of what the device sends.
+ */
+struct LossyChannel : MessageChannel
+{
+    uint8_t buffer[512];
+    std::vector<Bytes> sent;        // what the server got
+    unsigned loss_percent = 0;
+    uint32_t seed = 1;
+    int sends = 0;
+
+    bool lose()
+    {
+        seed = seed*1103515245+12345;
+        return ((seed>>16)%100)<loss_percent;
+    }
+
+    ProtocolError send(Message& message) override
+    {
+        sends++;
+        if (!lose())
+            sent.push_back(Bytes(message.buf(), message.buf()+message.length()));
+        return NO_ERROR;
+    }
+
+    ProtocolError create(Message& message, size_t minimum_size) override
+    {
+        message.set_buffer(buffer, sizeof(buffer));
+        return NO_ERROR;
+    }
+
+    ProtocolError response(Message& original, Message& response, size_t required) override
+    {
+        size_t used = original.buf()-buffer+original.length();
+        response.set_buffer(buffer+used, sizeof(buffer)-used);
+        return NO_ERROR;
+    }
+
+    ProtocolError receive(Message& message) override { message.set_length(0); return NO_ERROR; }
+    ProtocolError command(Command cmd, void* arg) override { return NO_ERROR; }
+    bool is_unreliable() override { return false; }
+    ProtocolError establish() override { return NO_ERROR; }
+    ProtocolError notify_established() override { return NO_ERROR; }
+};
+
+enum Mode { REGULAR = 0, FAST = 1, WINDOWED = 1|8 };
+
+/**
+ * Plays the server, sending a file to the device over a channel that loses
+ * chunks both ways, resending the chunks the device reports missing.
+ */
+struct Transfer
+{
+    static const uint16_t CHUNK_SIZE = 64;
+
+    Device device;
+    LossyChannel channel;
+    ChunkedTransfer transfer;
+    Bytes file;
+    unsigned chunks;
+
+    int chunks_sent = 0;
+    int tail_chunks = 0;            // chunks sent after the server said it was done
+    int bitmaps = 0;
+
+    Transfer(unsigned chunks, unsigned loss_percent) : chunks(chunks)
+    {
+        transfer.init(&device);
+        transfer.reset();
+        channel.loss_percent = loss_percent;
+        for (unsigned i=0; i<chunks*CHUNK_SIZE; i++)
+            file.push_back(uint8_t(i*31+(i>>8)));
+    }
+
+    Message message(size_t length)
+    {
+        return Message(channel.buffer, sizeof(channel.buffer), length);
+    }
+
+    void begin(Mode mode)
+    {
+        uint8_t* b = channel.buffer;
+        uint8_t begin[] = { 0x51, 0x02, 0, 1, 7, 0xb1, 'u', 0xFF, uint8_t(mode), 0, CHUNK_SIZE };
+        memcpy(b, begin, sizeof(begin));
+        uint32_t length = file.size();
+        b[11] = length>>24; b[12] = length>>16; b[13] = length>>8; b[14] = length;
+        b[15] = FileTransfer::Store::FIRMWARE;
+        memset(b+16, 0, 4);
+        Message m = message(20);
+        REQUIRE(transfer.handle_update_begin(7, m, channel)==NO_ERROR);
+        REQUIRE(transfer.is_updating());
+        channel.sent.clear();
+        channel.sends = 0;
+    }
+
+    void send_chunk(chunk_index_t index, bool with_index)
+    {
+        chunks_sent++;
+        device.now += 10;
+        if (channel.lose())
+            return;
+        uint8_t* b = channel.buffer;
+        const uint8_t* chunk = file.data()+index*CHUNK_SIZE;
+        uint32_t crc = crc32_update(0, chunk, CHUNK_SIZE);
+        uint8_t header[] = { 0x51, 0x02, 0, 2, 7, 0xb1, 'c', 0x44, uint8_t(crc>>24), uint8_t(crc>>16), uint8_t(crc>>8), uint8_t(crc) };
+        size_t length = sizeof(header);
+        memcpy(b, header, length);
+        if (with_index) {
+            b[length++] = 0x02;
+            b[length++] = index>>8;
+            b[length++] = index;
+        }
+        b[length++] = 0xFF;
+        memcpy(b+length, chunk, CHUNK_SIZE);
+        Message m = message(length+CHUNK_SIZE);
+        REQUIRE(transfer.handle_chunk(7, m, channel)==NO_ERROR);
+    }
+
+    void send_done()
+    {
+        uint8_t done[] = { 0x51, 0x03, 0, 3, 7, 0xb1, 'u' };
+        memcpy(channel.buffer, done, sizeof(done));
+        Message m = message(sizeof(done));
+        transfer.handle_update_done(7, m, channel);
+    }
+
+    /**
+     * Queues the chunks the device asked for, or that a bitmap shows missing.
+     */
+    void receive(std::deque<chunk_index_t>& resend, std::set<chunk_index_t>& queued, chunk_index_t sent_end)
+    {
+        for (const Bytes& m : channel.sent) {
+            if (m.size()<9 || m[4]!=0xb1 || m[5]!='c')
+                continue;
+            std::vector<chunk_index_t> missing;
+            if (m[1]==0x01) {           // GET, a list of missing chunks
+                for (size_t i=7; i+1<m.size(); i+=2)
+                    missing.push_back((m[i]<<8) | m[i+1]);
+            }
+            else if (m[1]==0x02) {      // POST, a bitmap of the chunks received
+                bitmaps++;
+                chunk_index_t first = (m[7]<<8) | m[8];
+                for (size_t i=0; i<(m.size()-9)*8; i++) {
+                    chunk_index_t index = first+i;
+                    if (index<sent_end && !(m[9+i/8] & (1<<(i&7))))
+                        missing.push_back(index);
+                }
+            }
+            for (chunk_index_t index : missing) {
+                if (queued.insert(index).second)
+                    resend.push_back(index);
+            }
+        }
+        channel.sent.clear();
+    }
+
+    void run(Mode mode)
+    {
+        begin(mode);
+        std::deque<chunk_index_t> resend;
+        std::set<chunk_index_t> queued;
+        chunk_index_t next = 0;
+        bool done = false;
+        for (int rounds=0; !device.finished && rounds<100000; rounds++) {
+            if (!resend.empty()) {
+                chunk_index_t index = resend.front();
+                resend.pop_front();
+                queued.erase(index);
+                send_chunk(index, true);
+                if (done)
+                    tail_chunks++;
+            }
+            else if (next<chunks) {
+                send_chunk(next++, mode!=REGULAR);
+            }
+            else if (!done) {
+                done = true;
+                send_done();
+            }
+            else {
+                // nothing to send, wait for the device to ask again
+                device.now += 4000;
+                transfer.idle(channel);
+            }
+            receive(resend, queued, next);
+        }
+    }
+};
+
+}
+
+SCENARIO("A file sent with regular OTA is acknowledged chunk by chunk", "[chunked_transfer]") {
+    Transfer t(200, 0);
+    t.run(REGULAR);
+    CHECK(t.device.finished);
+    CHECK(t.device.finish_flags==1);
+    CHECK(t.device.image==t.file);
+    // an ack and a chunk received response for each chunk
+    CHECK(t.channel.sends>=400);
+}
+
+SCENARIO("A file sent with fast OTA over a lossy link is complete", "[chunked_transfer]") {
+    Transfer t(200, 10);
+    t.run(FAST);
+    CHECK(t.device.finished);
+    CHECK(t.device.image==t.file);
+    CHECK(t.bitmaps==0);
+    // the lost chunks are all sent again at the end
+    CHECK(t.tail_chunks>=15);
+}
+
+SCENARIO("A file sent with windowed fast OTA over a lossy link is complete", "[chunked_transfer]") {
+    Transfer t(200, 10);
+    t.run(WINDOWED);
+    CHECK(t.device.finished);
+    CHECK(t.device.finish_flags==1);
+    CHECK(t.device.image==t.file);
+    CHECK(t.bitmaps>0);
+    // each chunk is written once however many times it is sent
+    CHECK(t.device.saves==200);
+}
+
+SCENARIO("Windowed fast OTA sends a fraction of the acks and has no tail", "[chunked_transfer]") {
+    Transfer regular(200, 0);
+    regular.run(REGULAR);
+    Transfer fast(200, 10);
+    fast.run(FAST);
+    Transfer windowed(200, 10);
+    windowed.run(WINDOWED);
+
+    // a bitmap every CHUNKS_PER_BITMAP chunks rather than two messages a chunk
+    int windowed_sends = windowed.channel.sends*8;
+    CHECK(windowed_sends<regular.channel.sends);
+    // gaps are filled as the file is sent rather than after it
+    int windowed_tail = windowed.tail_chunks*4;
+    CHECK(windowed_tail<fast.tail_chunks);
+    // and it takes no more chunks over the air to do it
+    int fast_sent = fast.chunks_sent+2;
+    CHECK(windowed.chunks_sent<=fast_sent);
+}
+
+SCENARIO("The chunk bitmap starts at the first chunk missing", "[chunked_transfer]") {
+    uint8_t buf[32];
+    uint8_t bitmap[] = { 0xFF, 0x7F };
+    size_t size = Messages::chunk_bitmap(buf, 0, 16, bitmap, 2);
+    REQUIRE(size==11);
+    CHECK(buf[1]==0x02);
+    CHECK(buf[5]=='c');
+    CHECK(buf[7]==0);
+    CHECK(buf[8]==16);
+    CHECK(buf[9]==0xFF);
+    CHECK(buf[10]==0x7F);
+}
@@ -0,0 +1,192 @@
+/**
+ ******************************************************************************
+ * @file    coap_message_store.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "coap_channel.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+
+#include <vector>
+
+using namespace particle::protocol;
+
+namespace {
+
+struct NullChannel : Channel
+{
+    int sends = 0;
+
+    ProtocolError receive(Message& message) override { return NO_ERROR; }
+    ProtocolError send(Message& message) override { sends++; return NO_ERROR; }
+    ProtocolError command(Command cmd, void* arg) override { return NO_ERROR; }
+};
+
+/**
+ * Builds a message of the given type and ID in its own buffer.
+ */
+struct TestMessage
+{
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    Message message;
+
+    TestMessage(CoAPType::Enum type, message_id_t id, size_t length) : message(buf, sizeof(buf))
+    {
+        memset(buf, 0, sizeof(buf));
+        buf[0] = 0x40 | (type<<4);
+        buf[1] = 0x02;
+        buf[2] = id>>8;
+        buf[3] = id;
+        message.set_length(length);
+        message.decode_id();
+    }
+};
+
+const size_t ALL_SLOTS = CoAPMessagePool::SMALL_SLOTS+CoAPMessagePool::LARGE_SLOTS;
+
+}
+
+SCENARIO("Messages are allocated from the pool by size", "[coap_message_store]") {
+    REQUIRE(CoAPMessagePool::available(0)==ALL_SLOTS);
+    TestMessage small(CoAPType::CON, 1, 5);
+    TestMessage large(CoAPType::CON, 2, 200);
+
+    CoAPMessage* s = CoAPMessage::create(small.message);
+    REQUIRE(s!=nullptr);
+    CHECK(CoAPMessagePool::available(CoAPMessagePool::LARGE_DATA)==CoAPMessagePool::LARGE_SLOTS);
+    CoAPMessage* l = CoAPMessage::create(large.message);
+    REQUIRE(l!=nullptr);
+    CHECK(CoAPMessagePool::available(CoAPMessagePool::LARGE_DATA)==CoAPMessagePool::LARGE_SLOTS-1);
+    CHECK(l->get_data_length()==200);
+    CHECK(memcmp(l->get_data(), large.buf, 200)==0);
+
+    delete s;
+    delete l;
+    CHECK(CoAPMessagePool::available(0)==ALL_SLOTS);
+    CHECK(CoAPMessage::messages()==0);
+}
+
+SCENARIO("The pool refuses messages once it is full", "[coap_message_store]") {
+    TestMessage large(CoAPType::CON, 1, CoAPMessagePool::LARGE_DATA);
+    std::vector<CoAPMessage*> messages;
+    for (size_t i=0; i<CoAPMessagePool::LARGE_SLOTS; i++) {
+        messages.push_back(CoAPMessage::create(large.message));
+        REQUIRE(messages.back()!=nullptr);
+    }
+    CHECK(CoAPMessage::create(large.message)==nullptr);
+
+    // small messages still fit, and take a large slot when the small ones run out
+    TestMessage small(CoAPType::CON, 2, 5);
+    for (size_t i=0; i<CoAPMessagePool::SMALL_SLOTS; i++) {
+        messages.push_back(CoAPMessage::create(small.message));
+        REQUIRE(messages.back()!=nullptr);
+    }
+    CHECK(CoAPMessage::create(small.message)==nullptr);
+
+    delete messages[0];
+    CoAPMessage* m = CoAPMessage::create(small.message);
+    CHECK(m!=nullptr);
+    messages[0] = m;
+    for (CoAPMessage* m : messages)
+        delete m;
+    CHECK(CoAPMessagePool::available(0)==ALL_SLOTS);
+}
+
+SCENARIO("A message larger than the protocol buffer is refused", "[coap_message_store]") {
+    CHECK(CoAPMessagePool::allocate(sizeof(CoAPMessage)+CoAPMessagePool::LARGE_DATA+4)==nullptr);
+}
+
+SCENARIO("Messages in the same bucket are found and removed by id", "[coap_message_store]") {
+    CoAPMessageStore store;
+    // IDs 8 apart share a bucket
+    for (message_id_t id=3; id<3+8*5; id+=8)
+        REQUIRE(store.add(new CoAPMessage(id))==NO_ERROR);
+    REQUIRE(store.add(new CoAPMessage(4))==NO_ERROR);
+    CHECK(store.messages()==6);
+
+    for (message_id_t id=3; id<3+8*5; id+=8)
+        CHECK(store.from_id(id)!=nullptr);
+    CHECK(store.from_id(4)!=nullptr);
+    CHECK(store.from_id(5)==nullptr);
+    CHECK(store.from_id(3+8*5)==nullptr);
+
+    // from the middle of the chain
+    CHECK(store.clear_message(19));
+    CHECK(store.from_id(19)==nullptr);
+    CHECK(store.from_id(11)!=nullptr);
+    CHECK(store.from_id(27)!=nullptr);
+    CHECK(store.messages()==5);
+
+    store.clear();
+    CHECK_FALSE(store.has_messages());
+    CHECK(CoAPMessage::messages()==0);
+    CHECK(CoAPMessagePool::available(0)==ALL_SLOTS);
+}
+
+SCENARIO("A confirmable message is refused before it is sent when the pool is full", "[coap_message_store]") {
+    CoAPMessageStore store;
+    for (message_id_t id=1; id<=ALL_SLOTS; id++) {
+        TestMessage m(CoAPType::CON, id, 100);
+        if (id>CoAPMessagePool::LARGE_SLOTS)
+            m.message.set_length(5);
+        REQUIRE(store.send(m.message, 0)==NO_ERROR);
+    }
+    CHECK(store.messages()==ALL_SLOTS);
+
+    TestMessage request(CoAPType::CON, 100, 5);
+    CHECK(store.send(request.message, 0)==INSUFFICIENT_STORAGE);
+    CHECK(store.from_id(100)==nullptr);
+
+    // a response goes out anyway, it is just not kept
+    TestMessage ack(CoAPType::ACK, 101, 4);
+    CHECK(store.send(ack.message, 0)==NO_ERROR);
+    CHECK(store.from_id(101)==nullptr);
+
+    // a request received is passed on without being kept
+    NullChannel channel;
+    TestMessage received(CoAPType::CON, 102, 10);
+    CHECK(store.receive(received.message, channel, 0)==NO_ERROR);
+    CHECK(received.message.length()==10);
+
+    // acknowledging a message frees its slot
+    TestMessage ack1(CoAPType::ACK, 1, 4);
+    CHECK(store.receive(ack1.message, channel, 0)==NO_ERROR);
+    CHECK(store.send(request.message, 0)==NO_ERROR);
+    CHECK(store.from_id(100)!=nullptr);
+
+    store.clear();
+    CHECK(CoAPMessagePool::available(0)==ALL_SLOTS);
+}
+
+SCENARIO("Messages that time out are removed from every bucket", "[coap_message_store]") {
+    CoAPMessageStore store;
+    for (message_id_t id=1; id<=6; id++) {
+        TestMessage m(CoAPType::ACK, id, 4);
+        REQUIRE(store.send(m.message, 0)==NO_ERROR);
+    }
+    NullChannel channel;
+    store.process(CoAPMessage::MAX_TRANSMIT_SPAN-1, channel);
+    CHECK(store.messages()==6);
+    store.process(CoAPMessage::MAX_TRANSMIT_SPAN+1, channel);
+    CHECK(store.messages()==0);
+    CHECK(channel.sends==0);
+    CHECK(CoAPMessagePool::available(0)==ALL_SLOTS);
+}
@@ -0,0 +1,138 @@
+/**
+ Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+#include "data_management_layer.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+class CountingService : public DataService
+{
+public:
+    CountingService(int32_t id) : id(id), calls(0), lastLength(-1) {}
+
+    virtual int32_t getServiceID() { return id; }
+    virtual int32_t DataCallback(uint8_t *data, int16_t length)
+    {
+        calls++;
+        lastLength = length;
+        return 0;
+    }
+
+    int32_t id;
+    int calls;
+    int16_t lastLength;
+};
+
+// the layer is static, so the services have to outlive every test case
+CountingService socketService(1), infoService(2), customService(4);
+std::vector<CountingService*> fillers;
+
+// adds services with IDs from 100 up until the table is full
+void fill_table()
+{
+    for (int id = 100; fillers.size() < MAX_NUMBER_OF_SERVICES - 3; id++) {
+        fillers.push_back(new CountingService(id));
+        REQUIRE(DataManagementLayer::registerService(fillers.back()));
+    }
+}
+
+} // namespace
+
+// the registrations stay for the rest of the run, so this case also leaves the table full
+TEST_CASE("Data management layer dispatches by service ID", "[data_management_layer]") {
+    REQUIRE(DataManagementLayer::registerService(&socketService));
+    REQUIRE(DataManagementLayer::registerService(&infoService));
+    REQUIRE(DataManagementLayer::registerService(&customService));
+
+    uint8_t packet[] = { 2, 10, 20, 30 };
+    DataManagementLayer::feedData(sizeof(packet), packet);
+    CHECK(infoService.calls == 1);
+    CHECK(infoService.lastLength == 3);
+    CHECK(socketService.calls == 0);
+    CHECK(customService.calls == 0);
+
+    // nothing registered for 3, the packet is dropped
+    packet[0] = 3;
+    DataManagementLayer::feedData(sizeof(packet), packet);
+    int total = socketService.calls + infoService.calls + customService.calls;
+    CHECK(total == 1);
+
+    // an ID can only be taken once, and has to fit in the 1 byte header
+    CountingService duplicate(2), tooLarge(256), negative(-1);
+    CHECK_FALSE(DataManagementLayer::registerService(&duplicate));
+    CHECK_FALSE(DataManagementLayer::registerService(&tooLarge));
+    CHECK_FALSE(DataManagementLayer::registerService(&negative));
+
+    fill_table();
+    CountingService oneTooMany(255);
+    CHECK_FALSE(DataManagementLayer::registerService(&oneTooMany));
+
+    packet[0] = fillers.back()->id;
+    DataManagementLayer::feedData(sizeof(packet), packet);
+    CHECK(fillers.back()->calls == 1);
+    packet[0] = 255;
+    DataManagementLayer::feedData(sizeof(packet), packet);
+    CHECK(oneTooMany.calls == 0);
+}
+
+// hidden, run it with "[benchmark]"
+TEST_CASE("Data management layer dispatch benchmark", "[.][data_management_layer][benchmark]") {
+    // registers the services unless the case above already has, the last of them is the worst
+    // case for a linear scan
+    if (fillers.empty()) {
+        REQUIRE(DataManagementLayer::registerService(&socketService));
+        REQUIRE(DataManagementLayer::registerService(&infoService));
+        REQUIRE(DataManagementLayer::registerService(&customService));
+        fill_table();
+    }
+    CountingService* target = fillers.back();
+    std::vector<DataService*> services = { &socketService, &infoService, &customService };
+    services.insert(services.end(), fillers.begin(), fillers.end());
+
+    const int packets = 1000000;
+    uint8_t packet[20] = { (uint8_t)target->id };
+    typedef std::chrono::steady_clock clock;
+
+    int before = target->calls;
+    clock::time_point start = clock::now();
+    for (int i = 0; i < packets; i++) {
+        DataManagementLayer::feedData(sizeof(packet), packet);
+    }
+    double table = std::chrono::duration<double, std::nano>(clock::now() - start).count() / packets;
+    CHECK(target->calls == before + packets);
+
+    // what feedData used to do, for comparison
+    before = target->calls;
+    start = clock::now();
+    for (int i = 0; i < packets; i++) {
+        for (DataService* service : services) {
+            if (packet[0] == service->getServiceID()) {
+                service->DataCallback(packet+1, sizeof(packet)-1);
+                break;
+            }
+        }
+    }
+    double scan = std::chrono::duration<double, std::nano>(clock::now() - start).count() / packets;
+    CHECK(target->calls == before + packets);
+
+    printf("feedData dispatch with %d services: table %.1f ns/packet, linear scan %.1f ns/packet\n",
+            (int)services.size(), table, scan);
+}
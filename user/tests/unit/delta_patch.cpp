@@ -0,0 +1,234 @@
+/**
+ ******************************************************************************
+ * @file    delta_patch.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "delta_patch.h"
+#include "crc32.h"
+#include <vector>
+#include <cstring>
+
+typedef std::vector<uint8_t> Bytes;
+
+const uint32_t SOURCE_ADDRESS = 0x33000;
+
+/**
+ * Stands in for the internal flash holding the source and the external flash
+ * the target is staged in.
+ */
+struct Device
+{
+    Bytes source;
+    Bytes target;
+    bool refuse = false;
+    int writes = 0;
+
+    static int begin(const delta_patch_info_t* info, void* context)
+    {
+        Device* device = (Device*)context;
+        return device->refuse || info->source_address!=SOURCE_ADDRESS;
+    }
+
+    static void read_source(uint32_t address, uint8_t* buffer, uint32_t length, void* context)
+    {
+        Device* device = (Device*)context;
+        REQUIRE(address>=SOURCE_ADDRESS);
+        REQUIRE(size_t(address-SOURCE_ADDRESS+length)<=device->source.size());
+        memcpy(buffer, device->source.data()+address-SOURCE_ADDRESS, length);
+    }
+
+    static int write_target(uint32_t offset, const uint8_t* data, uint32_t length, void* context)
+    {
+        Device* device = (Device*)context;
+        REQUIRE(offset==device->target.size());     // written in order
+        REQUIRE(length<=DELTA_PATCH_BLOCK_SIZE);
+        device->target.insert(device->target.end(), data, data+length);
+        device->writes++;
+        return 0;
+    }
+};
+
+const delta_patch_callbacks_t callbacks = { Device::begin, Device::read_source, Device::write_target };
+
+void put16(Bytes& b, uint16_t v) { b.push_back(v>>8); b.push_back(v); }
+void put32(Bytes& b, uint32_t v) { put16(b, v>>16); put16(b, v); }
+
+Bytes header(const Bytes& source, const Bytes& target)
+{
+    Bytes h = { 'B', 'Z', 'D', 'P', DELTA_PATCH_VERSION, 5, 2, 0 };
+    put16(h, 3);
+    put16(h, 0);
+    put32(h, SOURCE_ADDRESS);
+    put32(h, source.size());
+    put32(h, crc32_update(0, source.data(), source.size()));
+    put32(h, target.size());
+    put32(h, crc32_update(0, target.data(), target.size()));
+    return h;
+}
+
+void copy(Bytes& patch, uint32_t offset, uint16_t length)
+{
+    patch.push_back(DELTA_PATCH_COPY);
+    put32(patch, offset);
+    put16(patch, length);
+}
+
+void add(Bytes& patch, const Bytes& source, uint32_t offset, const Bytes& target, uint32_t target_offset, uint16_t length)
+{
+    patch.push_back(DELTA_PATCH_ADD);
+    put32(patch, offset);
+    put16(patch, length);
+    for (unsigned i=0; i<length; i++)
+        patch.push_back(uint8_t(target[target_offset+i]-source[offset+i]));
+}
+
+void insert(Bytes& patch, const Bytes& target, uint32_t target_offset, uint16_t length)
+{
+    patch.push_back(DELTA_PATCH_INSERT);
+    put16(patch, length);
+    patch.insert(patch.end(), target.begin()+target_offset, target.begin()+target_offset+length);
+}
+
+Bytes pattern(size_t length, uint32_t seed)
+{
+    Bytes b(length);
+    for (auto& x : b) {
+        seed = seed*1103515245+12345;
+        x = seed>>16;
+    }
+    return b;
+}
+
+/**
+ * A new image made from the old one: a block moved, some addresses in it
+ * changed by a small amount, and new code in the middle.
+ */
+struct Update
+{
+    Bytes source = pattern(3000, 1);
+    Bytes target;
+    Bytes patch;
+
+    Update()
+    {
+        Bytes inserted = pattern(300, 2);
+        target.insert(target.end(), source.begin()+1000, source.begin()+2000);
+        target.insert(target.end(), inserted.begin(), inserted.end());
+        target.insert(target.end(), source.begin(), source.begin()+1000);
+        for (unsigned i=1300; i<2300; i+=40)
+            target[i] += 4;
+
+        patch = header(source, target);
+        copy(patch, 1000, 1000);
+        insert(patch, target, 1000, 300);
+        add(patch, source, 0, target, 1300, 1000);
+    }
+};
+
+int apply(Device& device, const Bytes& patch, size_t part)
+{
+    delta_patch_t p;
+    delta_patch_init(&p, &callbacks, &device);
+    for (size_t i=0; i<patch.size(); i+=part) {
+        size_t n = std::min(part, patch.size()-i);
+        int result = delta_patch_apply(&p, patch.data()+i, n);
+        if (result)
+            return result;
+    }
+    return delta_patch_finish(&p);
+}
+
+SCENARIO("crc32_update is the zlib CRC", "[delta_patch]") {
+    const char* text = "123456789";
+    CHECK(crc32_update(0, (const uint8_t*)text, 9)==0xCBF43926);
+    uint32_t crc = crc32_update(0, (const uint8_t*)text, 4);
+    CHECK(crc32_update(crc, (const uint8_t*)text+4, 5)==0xCBF43926);
+}
+
+SCENARIO("A patch rebuilds the target whatever size the chunks are", "[delta_patch]") {
+    Update update;
+    for (size_t part : { size_t(1), size_t(7), size_t(20), size_t(512), update.patch.size() }) {
+        Device device;
+        device.source = update.source;
+        CHECK(apply(device, update.patch, part)==DELTA_PATCH_OK);
+        CHECK(device.target==update.target);
+    }
+}
+
+SCENARIO("A patch for another module is refused", "[delta_patch]") {
+    Update update;
+    Device device;
+    device.source = update.source;
+    device.refuse = true;
+    CHECK(apply(device, update.patch, 512)==DELTA_PATCH_ERROR_SOURCE);
+    CHECK(device.writes==0);
+}
+
+SCENARIO("A patch against a changed module is refused", "[delta_patch]") {
+    Update update;
+    Device device;
+    device.source = update.source;
+    device.source[2999] ^= 1;
+    CHECK(apply(device, update.patch, 512)==DELTA_PATCH_ERROR_SOURCE);
+    CHECK(device.writes==0);
+}
+
+SCENARIO("Something that is not a patch is refused", "[delta_patch]") {
+    Update update;
+    Device device;
+    device.source = update.source;
+    update.patch[3] = 'X';
+    CHECK(apply(device, update.patch, 512)==DELTA_PATCH_ERROR_HEADER);
+}
+
+SCENARIO("A truncated patch does not complete", "[delta_patch]") {
+    Update update;
+    Device device;
+    device.source = update.source;
+    update.patch.resize(update.patch.size()-1);
+    CHECK(apply(device, update.patch, 512)==DELTA_PATCH_ERROR_INCOMPLETE);
+}
+
+SCENARIO("A damaged patch fails the target CRC", "[delta_patch]") {
+    Update update;
+    Device device;
+    device.source = update.source;
+    update.patch[update.patch.size()-10] ^= 0x10;
+    CHECK(apply(device, update.patch, 512)==DELTA_PATCH_ERROR_CRC);
+}
+
+SCENARIO("Records outside the images are refused", "[delta_patch]") {
+    Update update;
+    Device device;
+    device.source = update.source;
+
+    Bytes patch = header(update.source, update.target);
+    copy(patch, 2500, 1000);
+    CHECK(apply(device, patch, 512)==DELTA_PATCH_ERROR_RECORD);
+
+    patch = header(update.source, update.source);
+    copy(patch, 0, 3000);
+    copy(patch, 0, 1);
+    CHECK(apply(device, patch, 512)==DELTA_PATCH_ERROR_RECORD);
+
+    patch = header(update.source, update.target);
+    patch.push_back(0x7F);
+    CHECK(apply(device, patch, 512)==DELTA_PATCH_ERROR_RECORD);
+}
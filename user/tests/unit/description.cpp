@@ -0,0 +1,186 @@
+/**
+ ******************************************************************************
+ * @file    description.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "description.h"
+#include "protocol_defs.h"
+#include "catch.hpp"
+
+#include <string>
+
+using namespace particle::protocol;
+
+namespace {
+
+int function_count = 0;
+
+int num_functions() { return function_count; }
+
+const char* get_function_key(int index)
+{
+    static char key[16];
+    sprintf(key, "function%d", index);
+    return key;
+}
+
+int num_variables() { return 1; }
+const char* get_variable_key(int index) { return "temp"; }
+SparkReturnType::Enum variable_type(const char* key) { return SparkReturnType::DOUBLE; }
+
+bool append_system_info(appender_fn append, void* data, void* reserved)
+{
+    const char* info = "\"p\":103";
+    return append(data, (const uint8_t*)info, strlen(info));
+}
+
+SparkDescriptor descriptor(int functions)
+{
+    function_count = functions;
+    SparkDescriptor d;
+    memset(&d, 0, sizeof(d));
+    d.size = sizeof(d);
+    d.num_functions = num_functions;
+    d.get_function_key = get_function_key;
+    d.num_variables = num_variables;
+    d.get_variable_key = get_variable_key;
+    d.variable_type = variable_type;
+    d.append_system_info = append_system_info;
+    return d;
+}
+
+std::string render(const SparkDescriptor& d, int flags)
+{
+    BlockAppender measure(nullptr, 0, 0);
+    append_description(d, measure, flags);
+    std::string s(measure.total(), 0);
+    BlockAppender all((uint8_t*)&s[0], 0, s.size());
+    append_description(d, all, flags);
+    return s;
+}
+
+/**
+ * Finds the start of the payload of a response with a one byte token.
+ */
+size_t payload_offset(const uint8_t* buf, size_t length)
+{
+    size_t i = 5;
+    while (i<length && buf[i]!=0xff)
+        i++;
+    return i+1;
+}
+
+}
+
+SCENARIO("A block appender keeps only the bytes in its window", "[description]") {
+    uint8_t buf[4];
+    BlockAppender a(buf, 3, sizeof(buf));
+    a.append("ab");
+    a.append("cdefg");
+    a.append("hij");
+    CHECK(a.total()==10);
+    CHECK(a.written()==4);
+    CHECK(memcmp(buf, "defg", 4)==0);
+}
+
+SCENARIO("The description lists functions, variables and system info", "[description]") {
+    SparkDescriptor d = descriptor(2);
+    CHECK(render(d, DESCRIBE_APPLICATION)=="{\"f\":[\"function0\",\"function1\"],\"v\":{\"temp\":9}}");
+    CHECK(render(d, DESCRIBE_SYSTEM)=="{\"p\":103}");
+    CHECK(render(d, DESCRIBE_ALL)=="{\"f\":[\"function0\",\"function1\"],\"v\":{\"temp\":9},\"p\":103}");
+}
+
+SCENARIO("A description that fits is sent whole", "[description]") {
+    SparkDescriptor d = descriptor(1);
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    size_t length = build_description(buf, sizeof(buf), 0x1234, 7, d, DESCRIBE_ALL, -1, DESCRIBE_BLOCK_SZX);
+    const uint8_t header[] = { 0x61, 0x45, 0x12, 0x34, 7, 0xff };
+    REQUIRE(length>sizeof(header));
+    CHECK(memcmp(buf, header, sizeof(header))==0);
+    std::string payload((const char*)buf+6, length-6);
+    CHECK(payload==render(d, DESCRIBE_ALL));
+}
+
+SCENARIO("A description too large for the buffer is sent in blocks", "[description]") {
+    SparkDescriptor d = descriptor(60);
+    std::string whole = render(d, DESCRIBE_ALL);
+    const size_t capacity = 300;
+    REQUIRE(whole.size()>capacity);
+
+    uint8_t buf[capacity];
+    size_t length = build_description(buf, capacity, 1, 7, d, DESCRIBE_ALL, -1, DESCRIBE_BLOCK_SZX);
+    REQUIRE(length<=capacity);
+    // Block2 option, block 0, more, 256 byte blocks
+    const uint8_t option[] = { 0xd1, 10, 0x0c };
+    CHECK(memcmp(buf+5, option, sizeof(option))==0);
+
+    std::string received;
+    unsigned num = 0;
+    bool more = true;
+    while (more) {
+        length = build_description(buf, capacity, 1, 7, d, DESCRIBE_ALL, num, 4);
+        REQUIRE(length<=capacity);
+        const uint8_t* p = buf+5;
+        unsigned number = 0;
+        const uint8_t* value;
+        size_t value_length;
+        REQUIRE(CoAP::next_option(p, buf+length, number, value, value_length));
+        CHECK(number==CoAPOption::BLOCK2);
+        unsigned block;
+        uint8_t szx;
+        CoAP::decode_block(value, value_length, block, more, szx);
+        CHECK(block==num);
+        CHECK(szx==4);
+        size_t start = payload_offset(buf, length);
+        received.append((const char*)buf+start, length-start);
+        num++;
+    }
+    CHECK(received==whole);
+    CHECK(num==(whole.size()+255)/256);
+}
+
+SCENARIO("The block size is reduced to fit the buffer", "[description]") {
+    SparkDescriptor d = descriptor(60);
+    uint8_t buf[200];
+    size_t length = build_description(buf, sizeof(buf), 1, 7, d, DESCRIBE_ALL, 0, 6);
+    CHECK(length==6+3+128);
+    CHECK((buf[7]&7)==3);
+}
+
+SCENARIO("A describe request gives its flags and block", "[description]") {
+    int flags, block;
+    uint8_t szx;
+
+    const uint8_t plain[] = { 0x41, 0x01, 0, 1, 7, 0xb1, 'd' };
+    decode_describe_request(plain, sizeof(plain), flags, block, szx);
+    CHECK(flags==DESCRIBE_ALL);
+    CHECK(block==-1);
+
+    const uint8_t with_flags[] = { 0x41, 0x01, 0, 1, 7, 0xb1, 'd', 0x01, DESCRIBE_SYSTEM };
+    decode_describe_request(with_flags, sizeof(with_flags), flags, block, szx);
+    CHECK(flags==DESCRIBE_SYSTEM);
+    CHECK(block==-1);
+
+    // block 18 of 512 byte blocks, a two byte option value
+    const uint8_t with_block[] = { 0x41, 0x01, 0, 1, 7, 0xb1, 'd', 0x01, DESCRIBE_APPLICATION, 0xc2, 0x01, 0x25 };
+    decode_describe_request(with_block, sizeof(with_block), flags, block, szx);
+    CHECK(flags==DESCRIBE_APPLICATION);
+    CHECK(block==18);
+    CHECK(szx==5);
+}
@@ -1240,6 +1240,71 @@ TEST_CASE("Migration from legacy format", "[eeprom]")
     REQUIRE(point.y == 21098.0);
 }
 
+TEST_CASE("Import raw image", "[eeprom]")
+{
+    TestEEPROM eeprom;
+    EEPROMTester tester(eeprom);
+
+    // Raw data in page 1 that isn't in the record format
+    uint8_t image[3] = { 0x12, 0xFF, 0x34 };
+    eeprom.store.eraseSector(PageBase1);
+    eeprom.store.write(PageBase1, image, sizeof(image));
+
+    SECTION("The image is written to the other page before it becomes active")
+    {
+        eeprom.store.eraseSector(PageBase2);
+
+        REQUIRE(eeprom.importImage(Page2, image, sizeof(image)) == true);
+
+        REQUIRE(eeprom.getActivePage() == Page2);
+        tester.requireContents(PageBase2, PAGE_ACTIVE, {
+            Record(0, 0x12),
+            Record(2, 0x34)
+        });
+
+        // The source is only erased on request
+        uint8_t source[sizeof(image)];
+        eeprom.store.read(PageBase1, source, sizeof(source));
+        REQUIRE(std::memcmp(source, image, sizeof(image)) == 0);
+        REQUIRE(eeprom.hasPendingErase() == true);
+        eeprom.performPendingErase();
+
+        uint8_t dataRead[sizeof(image)];
+        eeprom.get(0, dataRead, sizeof(dataRead));
+        REQUIRE(std::memcmp(dataRead, image, sizeof(image)) == 0);
+    }
+
+    SECTION("An import interrupted by a reset is done again")
+    {
+        tester.populate(PageBase2, PAGE_COPY, {
+            Record(0, 0x12)
+        });
+
+        eeprom.updateActivePage();
+        REQUIRE(eeprom.getActivePage() == NoPage);
+
+        REQUIRE(eeprom.importImage(Page2, image, sizeof(image)) == true);
+
+        tester.requireContents(PageBase2, PAGE_ACTIVE, {
+            Record(0, 0x12),
+            Record(2, 0x34)
+        });
+    }
+
+    SECTION("Nothing is imported over an active page")
+    {
+        tester.populate(PageBase2, PAGE_ACTIVE, {
+            Record(1, 0x56)
+        });
+
+        REQUIRE(eeprom.importImage(Page2, image, sizeof(image)) == false);
+
+        tester.requireContents(PageBase2, PAGE_ACTIVE, {
+            Record(1, 0x56)
+        });
+    }
+}
+
 TEST_CASE("Recover from data corruption", "[eeprom]")
 {
     TestEEPROM eeprom;
@@ -1338,3 +1403,37 @@ TEST_CASE("Page swap with data in multiple batches", "[eeprom]")
         REQUIRE(dataRead == data);
     }
 }
+
+// A store that only exposes read/write/erase, like the external SPI flash
+// on bluz, to check that the emulation never relies on memory mapped access
+class ReadOnlyAccessStore
+{
+public:
+    int eraseSector(unsigned address) { return flash.eraseSector(address); }
+    int write(unsigned offset, const void* data, unsigned size) { return flash.write(offset, data, size); }
+    int read(unsigned offset, void* data, unsigned size) { return flash.read(offset, data, size); }
+
+private:
+    TestStore flash;
+};
+
+TEST_CASE("Store without memory mapped access", "[eeprom]")
+{
+    EEPROMEmulation<ReadOnlyAccessStore, PageBase1, PageSize1, PageBase2, PageSize2> eeprom;
+    eeprom.init();
+
+    // when
+    for(uint16_t i = 0; i < 3 * eeprom.capacity(); i++)
+    {
+        eeprom.put(i % eeprom.capacity(), (uint8_t)i);
+    }
+
+    // then
+    for(uint16_t i = 0; i < eeprom.capacity(); i++)
+    {
+        uint8_t dataRead;
+        eeprom.get(i, dataRead);
+        CAPTURE(i);
+        REQUIRE(dataRead == (uint8_t)(2 * eeprom.capacity() + i));
+    }
+}
@@ -0,0 +1,250 @@
+/**
+ ******************************************************************************
+ * @file    event_batch.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include <strings.h>
+#include "publisher.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+
+#include <vector>
+#include <string>
+
+using namespace particle::protocol;
+
+typedef std::vector<uint8_t> Bytes;
+
+namespace {
+
+struct RecordingChannel : MessageChannel
+{
+    uint8_t buffer[PROTOCOL_BUFFER_SIZE];
+    std::vector<Bytes> sent;
+
+    ProtocolError send(Message& message) override
+    {
+        sent.push_back(Bytes(message.buf(), message.buf()+message.length()));
+        return NO_ERROR;
+    }
+
+    ProtocolError create(Message& message, size_t minimum_size) override
+    {
+        message.set_buffer(buffer, sizeof(buffer));
+        return NO_ERROR;
+    }
+
+    ProtocolError response(Message& original, Message& response, size_t required) override { return NO_ERROR; }
+    ProtocolError receive(Message& message) override { message.set_length(0); return NO_ERROR; }
+    ProtocolError command(Command cmd, void* arg) override { return NO_ERROR; }
+    bool is_unreliable() override { return true; }
+    ProtocolError establish() override { return NO_ERROR; }
+    ProtocolError notify_established() override { return NO_ERROR; }
+};
+
+size_t single_size(const char* name, const char* data, int ttl)
+{
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    return Messages::event(buf, 0, name, data, ttl, EventType::PUBLIC, true);
+}
+
+/**
+ * The publisher rate limit is kept in statics, so each scenario starts well
+ * clear of the others.
+ */
+system_tick_t start_time()
+{
+    static system_tick_t next = 100000;
+    return next += 100000;
+}
+
+}
+
+SCENARIO("A batch is one event with the data of each event on a line", "[event_batch]") {
+    EventBatch batch;
+    REQUIRE(batch.add("t", "21.5", 60, EventType::PUBLIC, 0));
+    REQUIRE(batch.add("t", "21.75", 60, EventType::PUBLIC, 10));
+    CHECK(batch.events()==2);
+
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    size_t size = batch.encode(buf, 0x1234, true);
+    const uint8_t expected[] = {
+        0x40, 0x02, 0x12, 0x34, 0xb1, 'e', 0x01, 't', 0xff,
+        '2', '1', '.', '5', '\n', '2', '1', '.', '7', '5'
+    };
+    REQUIRE(size==sizeof(expected));
+    CHECK(memcmp(buf, expected, size)==0);
+    CHECK(batch.is_empty());
+}
+
+SCENARIO("A batch keeps the ttl and type of its events", "[event_batch]") {
+    EventBatch batch;
+    REQUIRE(batch.add("humidity", nullptr, 3600, EventType::PRIVATE, 0));
+    REQUIRE(batch.add("humidity", "40", 3600, EventType::PRIVATE, 0));
+
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    uint8_t expected[PROTOCOL_BUFFER_SIZE];
+    size_t size = batch.encode(buf, 7, true);
+    REQUIRE(size==Messages::event(expected, 7, "humidity", "\n40", 3600, EventType::PRIVATE, true));
+    CHECK(memcmp(buf, expected, size)==0);
+}
+
+SCENARIO("The stats count the bytes the events would have taken on their own", "[event_batch]") {
+    EventBatch batch;
+    const char* data[] = { "1", "22.25", nullptr };
+    size_t unbatched = 0;
+    for (int i=0; i<3; i++) {
+        REQUIRE(batch.add("sensor/temperature", data[i], 120, EventType::PUBLIC, 0));
+        unbatched += single_size("sensor/temperature", data[i], 120);
+    }
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    size_t size = batch.encode(buf, 0, false);
+
+    const event_batch_stats_t& stats = batch.get_stats();
+    CHECK(stats.size==sizeof(event_batch_stats_t));
+    CHECK(stats.events==3);
+    CHECK(stats.messages==1);
+    CHECK(size_t(stats.bytes_saved)==unbatched-size);
+}
+
+SCENARIO("A batch refuses an event that does not fit", "[event_batch]") {
+    EventBatch batch;
+    std::string data(200, 'd');
+    REQUIRE(batch.add("a", data.c_str(), 60, EventType::PUBLIC, 0));
+    CHECK_FALSE(batch.add("a", data.c_str(), 60, EventType::PUBLIC, 0));
+    CHECK(batch.events()==1);
+    CHECK(batch.add("a", "1", 60, EventType::PUBLIC, 0));
+}
+
+SCENARIO("A batch refuses an event with another name, type or ttl", "[event_batch]") {
+    EventBatch batch;
+    REQUIRE(batch.add("a", "1", 60, EventType::PUBLIC, 0));
+    CHECK_FALSE(batch.add("b", "1", 60, EventType::PUBLIC, 0));
+    CHECK_FALSE(batch.add("a", "1", 60, EventType::PRIVATE, 0));
+    CHECK_FALSE(batch.add("a", "1", 61, EventType::PUBLIC, 0));
+    CHECK(batch.events()==1);
+}
+
+SCENARIO("A batch is due once its first event has waited the window", "[event_batch]") {
+    EventBatch batch;
+    CHECK_FALSE(batch.is_due(EVENT_BATCH_WINDOW*2));
+    batch.add("a", "1", 60, EventType::PUBLIC, 500);
+    batch.add("a", "2", 60, EventType::PUBLIC, 900);
+    CHECK_FALSE(batch.is_due(500+EVENT_BATCH_WINDOW-1));
+    CHECK(batch.is_due(500+EVENT_BATCH_WINDOW));
+    batch.defer(500+EVENT_BATCH_WINDOW);
+    CHECK_FALSE(batch.is_due(500+EVENT_BATCH_WINDOW));
+}
+
+SCENARIO("Batched events are published as one confirmable event", "[event_batch]") {
+    Publisher publisher;
+    RecordingChannel channel;
+    system_tick_t now = start_time();
+    int flags = EventType::BATCH;
+
+    // more than the 4 a second the rate limit allows on their own
+    for (int i=0; i<10; i++)
+        REQUIRE(publisher.send_event(channel, "r", "1", 60, EventType::PUBLIC, flags, now+i)==NO_ERROR);
+    CHECK(channel.sent.empty());
+
+    REQUIRE(publisher.process(channel, now+EVENT_BATCH_WINDOW-1)==NO_ERROR);
+    CHECK(channel.sent.empty());
+    REQUIRE(publisher.process(channel, now+EVENT_BATCH_WINDOW)==NO_ERROR);
+    REQUIRE(channel.sent.size()==1);
+    const Bytes& m = channel.sent[0];
+    CHECK(m[0]==0x40);
+    CHECK(m[5]=='e');
+    CHECK(m[7]=='r');
+    CHECK(m.size()==9+10*2-1);
+
+    CHECK(publisher.batch_stats().events==10);
+    CHECK(publisher.batch_stats().messages==1);
+}
+
+SCENARIO("An event published without the batch flag sends the batch first", "[event_batch]") {
+    Publisher publisher;
+    RecordingChannel channel;
+    system_tick_t now = start_time();
+    REQUIRE(publisher.send_event(channel, "a", "1", 60, EventType::PUBLIC, EventType::BATCH, now)==NO_ERROR);
+    REQUIRE(publisher.send_event(channel, "b", "2", 60, EventType::PUBLIC, 0, now+1)==NO_ERROR);
+    REQUIRE(channel.sent.size()==2);
+    CHECK(channel.sent[0][7]=='a');
+    CHECK(channel.sent[1][7]=='b');
+}
+
+SCENARIO("An event with another name sends the batch first", "[event_batch]") {
+    Publisher publisher;
+    RecordingChannel channel;
+    system_tick_t now = start_time();
+    REQUIRE(publisher.send_event(channel, "a", "1", 60, EventType::PUBLIC, EventType::BATCH, now)==NO_ERROR);
+    REQUIRE(publisher.send_event(channel, "b", "2", 60, EventType::PUBLIC, EventType::BATCH, now+1)==NO_ERROR);
+    REQUIRE(channel.sent.size()==1);
+    CHECK(channel.sent[0][7]=='a');
+    CHECK(publisher.batch_stats().events==1);
+}
+
+SCENARIO("An event with a newline in its data is sent on its own", "[event_batch]") {
+    Publisher publisher;
+    RecordingChannel channel;
+    system_tick_t now = start_time();
+    REQUIRE(publisher.send_event(channel, "a", "1", 60, EventType::PUBLIC, EventType::BATCH, now)==NO_ERROR);
+    REQUIRE(publisher.send_event(channel, "a", "2\n3", 60, EventType::PUBLIC, EventType::BATCH, now+1)==NO_ERROR);
+    REQUIRE(channel.sent.size()==2);
+    CHECK(channel.sent[0].back()=='1');
+    CHECK(channel.sent[1].back()=='3');
+    CHECK(publisher.batch_stats().events==1);
+}
+
+SCENARIO("A full batch is sent to make room for the next event", "[event_batch]") {
+    Publisher publisher;
+    RecordingChannel channel;
+    system_tick_t now = start_time();
+    std::string data(100, 'd');
+    for (int i=0; i<3; i++)
+        REQUIRE(publisher.send_event(channel, "a", data.c_str(), 60, EventType::PUBLIC, EventType::BATCH, now)==NO_ERROR);
+    CHECK(channel.sent.size()==1);
+    CHECK(publisher.batch_stats().events==2);
+}
+
+SCENARIO("A rate limited batch waits for the next window", "[event_batch]") {
+    Publisher publisher;
+    RecordingChannel channel;
+    system_tick_t now = start_time();
+    for (int i=0; i<4; i++)
+        REQUIRE(publisher.send_event(channel, "a", "1", 60, EventType::PUBLIC, 0, now)==NO_ERROR);
+    REQUIRE(publisher.send_event(channel, "b", "2", 60, EventType::PUBLIC, EventType::BATCH, now)==NO_ERROR);
+    // the fifth message in a second is refused, the batch is kept
+    REQUIRE(publisher.send_batch(channel, now+10)==BANDWIDTH_EXCEEDED);
+    CHECK(channel.sent.size()==4);
+    CHECK(publisher.process(channel, now+10+EVENT_BATCH_WINDOW-1)==NO_ERROR);
+    CHECK(channel.sent.size()==4);
+    CHECK(publisher.process(channel, now+10+EVENT_BATCH_WINDOW)==NO_ERROR);
+    CHECK(channel.sent.size()==5);
+}
+
+SCENARIO("System events are never batched", "[event_batch]") {
+    Publisher publisher;
+    RecordingChannel channel;
+    system_tick_t now = start_time();
+    REQUIRE(publisher.send_event(channel, "spark/status", "online", 60, EventType::PRIVATE, EventType::BATCH, now)==NO_ERROR);
+    CHECK(channel.sent.size()==1);
+    CHECK(publisher.batch_stats().events==0);
+}
@@ -0,0 +1,136 @@
+/**
+ ******************************************************************************
+ * @file    key_index.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include <stdlib.h>
+#include "key_index.h"
+#include "append_list.h"
+#include "catch.hpp"
+
+#include <cstdio>
+
+namespace {
+
+const size_t KEY_LENGTH = 12;
+
+struct Entry
+{
+    char key[KEY_LENGTH];
+    int value;
+};
+
+/**
+ * A list with an index over it, as the cloud variables and functions are kept.
+ */
+template <unsigned slots> struct Registry
+{
+    append_list<Entry> list;
+    key_index<slots> index;
+    int compares = 0;
+
+    Entry* find(const char* key)
+    {
+        if (!index.is_complete()) {
+            for (unsigned i=0; i<list.size(); i++) {
+                compares++;
+                if (!strncmp(list[i].key, key, KEY_LENGTH))
+                    return &list[i];
+            }
+            return nullptr;
+        }
+        int i = index.find(key, KEY_LENGTH, [&](unsigned i) {
+            compares++;
+            return !strncmp(list[i].key, key, KEY_LENGTH);
+        });
+        return i<0 ? nullptr : &list[i];
+    }
+
+    Entry* add(const char* key, int value)
+    {
+        Entry* e = find(key);
+        if (!e && (e = list.add())) {
+            index.add(key, KEY_LENGTH, list.size()-1);
+        }
+        if (e) {
+            memset(e->key, 0, KEY_LENGTH);
+            strncpy(e->key, key, KEY_LENGTH);
+            e->value = value;
+        }
+        return e;
+    }
+};
+
+}
+
+SCENARIO("Keys are found through the index as the list grows", "[key_index]") {
+    Registry<32> r;
+    char key[16];
+    for (int i=0; i<24; i++) {
+        sprintf(key, "var%d", i);
+        REQUIRE(r.add(key, i)!=nullptr);
+    }
+    CHECK(r.index.is_complete());
+    CHECK(r.index.size()==24);
+
+    r.compares = 0;
+    for (int i=0; i<24; i++) {
+        sprintf(key, "var%d", i);
+        Entry* e = r.find(key);
+        REQUIRE(e!=nullptr);
+        CHECK(e->value==i);
+    }
+    // far fewer than the 300 a linear search would make
+    CHECK(r.compares<60);
+    CHECK(r.find("missing")==nullptr);
+}
+
+SCENARIO("Registering a key again updates the entry", "[key_index]") {
+    Registry<32> r;
+    r.add("temp", 1);
+    r.add("temp", 2);
+    CHECK(r.list.size()==1);
+    CHECK(r.find("temp")->value==2);
+}
+
+SCENARIO("Keys match on their first 12 characters", "[key_index]") {
+    Registry<32> r;
+    r.add("abcdefghijkl", 1);
+    Entry* e = r.find("abcdefghijklmnop");
+    REQUIRE(e!=nullptr);
+    CHECK(e->value==1);
+    CHECK(r.find("abcdefghijk")==nullptr);
+}
+
+SCENARIO("Once the index is full keys are found by searching the list", "[key_index]") {
+    Registry<8> r;
+    char key[16];
+    for (int i=0; i<10; i++) {
+        sprintf(key, "k%d", i);
+        REQUIRE(r.add(key, i)!=nullptr);
+    }
+    CHECK_FALSE(r.index.is_complete());
+    CHECK(r.index.size()==6);
+    for (int i=0; i<10; i++) {
+        sprintf(key, "k%d", i);
+        Entry* e = r.find(key);
+        REQUIRE(e!=nullptr);
+        CHECK(e->value==i);
+    }
+}
@@ -0,0 +1,238 @@
+/**
+ ******************************************************************************
+ * @file    lz_stream.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "lz_stream.h"
+#include "crc32.h"
+#include <vector>
+#include <memory>
+
+typedef std::vector<uint8_t> Bytes;
+
+namespace {
+
+struct Output
+{
+    Bytes data;
+    int writes = 0;
+
+    static int write(uint32_t offset, const uint8_t* data, uint32_t length, void* context)
+    {
+        Output* output = (Output*)context;
+        REQUIRE(offset==output->data.size());       // written in order
+        REQUIRE(length<=LZ_STREAM_BLOCK_SIZE);
+        output->data.insert(output->data.end(), data, data+length);
+        output->writes++;
+        return 0;
+    }
+};
+
+void put32(Bytes& b, uint32_t v)
+{
+    for (int shift=24; shift>=0; shift-=8)
+        b.push_back(v>>shift);
+}
+
+Bytes header(const Bytes& data, uint8_t window_bits)
+{
+    Bytes h = { 'B', 'Z', 'L', 'Z', LZ_STREAM_VERSION, window_bits, 0, 0 };
+    put32(h, data.size());
+    put32(h, crc32_update(0, data.data(), data.size()));
+    return h;
+}
+
+/**
+ * The simplest compressor for the format, the longest match at each position
+ * found by looking through the whole window.
+ */
+Bytes compress(const Bytes& data, uint8_t window_bits=LZ_STREAM_WINDOW_BITS)
+{
+    const unsigned length_bits = 16-window_bits;
+    const size_t window = size_t(1)<<window_bits;
+    const size_t max_match = LZ_STREAM_MIN_MATCH+(1<<length_bits)-1;
+    Bytes out = header(data, window_bits);
+    size_t control = 0;
+    int items = 8;
+    for (size_t i=0; i<data.size();) {
+        if (items==8) {
+            control = out.size();
+            out.push_back(0);
+            items = 0;
+        }
+        size_t best_length = 0, best_distance = 0;
+        for (size_t distance=1; distance<=window && distance<=i; distance++) {
+            size_t n = 0;
+            while (n<max_match && i+n<data.size() && data[i+n]==data[i-distance+n])
+                n++;
+            if (n>best_length) {
+                best_length = n;
+                best_distance = distance;
+            }
+        }
+        if (best_length>=LZ_STREAM_MIN_MATCH) {
+            uint16_t value = ((best_distance-1)<<length_bits) | (best_length-LZ_STREAM_MIN_MATCH);
+            out.push_back(value>>8);
+            out.push_back(value);
+            i += best_length;
+        }
+        else {
+            out[control] |= 1<<items;
+            out.push_back(data[i++]);
+        }
+        items++;
+    }
+    return out;
+}
+
+/**
+ * Something like code, repeated instructions with a few that vary.
+ */
+Bytes pattern(size_t length, uint32_t seed)
+{
+    Bytes b(length);
+    for (size_t i=0; i<length; i++) {
+        seed = seed*1103515245+12345;
+        b[i] = (seed>>29)==0 ? uint8_t(seed>>16) : uint8_t(i%4==3 ? 0x46 : (i*7)>>3);
+    }
+    return b;
+}
+
+int decompress(Output& output, const Bytes& file, size_t part, uint32_t max_length=0)
+{
+    // the window makes it too big for the stack of the test runner's threads
+    std::unique_ptr<lz_stream_t> stream(new lz_stream_t);
+    lz_stream_init(stream.get(), Output::write, &output);
+    lz_stream_limit(stream.get(), max_length);
+    for (size_t i=0; i<file.size(); i+=part) {
+        size_t n = std::min(part, file.size()-i);
+        int result = lz_stream_apply(stream.get(), file.data()+i, n);
+        if (result)
+            return result;
+    }
+    CHECK(lz_stream_consumed(stream.get())==file.size());
+    return lz_stream_finish(stream.get());
+}
+
+}
+
+SCENARIO("A compressed file is decompressed whatever size the parts are", "[lz_stream]") {
+    Bytes data = pattern(10000, 1);
+    Bytes file = compress(data);
+    REQUIRE(file.size()<data.size());
+    for (size_t part : { size_t(1), size_t(2), size_t(7), size_t(512), file.size() }) {
+        Output output;
+        CHECK(decompress(output, file, part)==LZ_STREAM_OK);
+        CHECK(output.data==data);
+    }
+}
+
+SCENARIO("Matches can reach across the whole window and past where it wraps", "[lz_stream]") {
+    Bytes block = pattern(LZ_STREAM_WINDOW_SIZE-10, 2);
+    Bytes data = block;
+    data.insert(data.end(), block.begin(), block.end());
+    data.insert(data.end(), block.begin(), block.end());
+    Output output;
+    CHECK(decompress(output, compress(data), 100)==LZ_STREAM_OK);
+    CHECK(output.data==data);
+}
+
+SCENARIO("A smaller window is decompressed", "[lz_stream]") {
+    Bytes data = pattern(3000, 3);
+    Output output;
+    CHECK(decompress(output, compress(data, 8), 512)==LZ_STREAM_OK);
+    CHECK(output.data==data);
+}
+
+SCENARIO("Empty and incompressible files are decompressed", "[lz_stream]") {
+    Bytes empty;
+    Output output;
+    CHECK(decompress(output, compress(empty), 512)==LZ_STREAM_OK);
+    CHECK(output.writes==0);
+
+    Bytes bytes;
+    for (int i=0; i<256; i++)
+        bytes.push_back(i);
+    Output output2;
+    CHECK(decompress(output2, compress(bytes), 512)==LZ_STREAM_OK);
+    CHECK(output2.data==bytes);
+}
+
+SCENARIO("Something that is not compressed is refused", "[lz_stream]") {
+    Bytes file = compress(pattern(1000, 4));
+    file[3] = 'X';
+    Output output;
+    CHECK(decompress(output, file, 512)==LZ_STREAM_ERROR_HEADER);
+    CHECK(output.writes==0);
+}
+
+SCENARIO("A file compressed with a larger window than the device keeps is refused", "[lz_stream]") {
+    Bytes data = pattern(1000, 5);
+    Bytes file = compress(data, LZ_STREAM_WINDOW_BITS);
+    file[5] = LZ_STREAM_WINDOW_BITS+1;
+    Output output;
+    CHECK(decompress(output, file, 512)==LZ_STREAM_ERROR_HEADER);
+}
+
+SCENARIO("A file longer than the limit is refused before anything is written", "[lz_stream]") {
+    Bytes data = pattern(2000, 7);
+    Bytes file = compress(data);
+    Output output;
+    CHECK(decompress(output, file, 512, 1999)==LZ_STREAM_ERROR_LENGTH);
+    CHECK(output.writes==0);
+
+    Output output2;
+    CHECK(decompress(output2, file, 512, 2000)==LZ_STREAM_OK);
+    CHECK(output2.data==data);
+}
+
+SCENARIO("A match reaching before the start is refused", "[lz_stream]") {
+    Bytes data = { 1, 2, 3 };
+    Bytes file = header(data, LZ_STREAM_WINDOW_BITS);
+    file.push_back(0x01);           // a literal then a match
+    file.push_back(1);
+    uint16_t value = (5<<(16-LZ_STREAM_WINDOW_BITS)) | 0;
+    file.push_back(value>>8);
+    file.push_back(value);
+    Output output;
+    CHECK(decompress(output, file, 512)==LZ_STREAM_ERROR_DATA);
+}
+
+SCENARIO("A file that is cut short or damaged is refused", "[lz_stream]") {
+    Bytes data = pattern(2000, 6);
+    Bytes file = compress(data);
+
+    Bytes truncated(file.begin(), file.end()-3);
+    Output output;
+    CHECK(decompress(output, truncated, 512)==LZ_STREAM_ERROR_INCOMPLETE);
+
+    // a literal changed keeps the length right but not the CRC
+    Bytes damaged = file;
+    REQUIRE((damaged[LZ_STREAM_HEADER_SIZE] & 1));
+    damaged[LZ_STREAM_HEADER_SIZE+1] ^= 0x40;
+    Output output2;
+    CHECK(decompress(output2, damaged, 512)==LZ_STREAM_ERROR_CRC);
+
+    Bytes longer = file;
+    longer.push_back(0xFF);
+    longer.push_back(0);
+    Output output3;
+    CHECK(decompress(output3, longer, 512)==LZ_STREAM_ERROR_DATA);
+}
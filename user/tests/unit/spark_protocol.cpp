@@ -0,0 +1,622 @@
+/**
+ ******************************************************************************
+ * @file    spark_protocol.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "spark_protocol.h"
+#include "handshake.h"
+#include "description.h"
+#include "crc32.h"
+#undef WARN
+#undef INFO
+
+#include "catch.hpp"
+
+#include <vector>
+#include <set>
+#include <deque>
+#include <cstring>
+#include <string>
+
+typedef std::vector<uint8_t> Bytes;
+
+namespace {
+
+// the keys and session credentials of communication/tests/ConstructorFixture.cpp
+const char device_id[13] =
+  "\x54\xE1\xC8\x88\xF6\xD9\x49\x2B\xEB\xEE\x1E\xE9";
+
+uint8_t server_public_key[295] =
+  "\x30\x82\x01\x22\x30\x0D\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x01"
+  "\x01\x05\x00\x03\x82\x01\x0F\x00\x30\x82\x01\x0A\x02\x82\x01\x01"
+  "\x00\xA4\x4B\x8F\x50\xBF\xD7\x94\x77\xF6\xC9\xBC\xEB\x1A\x00\xF3"
+  "\x1D\x31\x51\xA8\xE0\xB0\xD4\x0F\x3C\xFF\x49\x85\x71\xBA\xFA\x54"
+  "\x80\x9C\x91\x3D\x24\xD8\x9A\x4F\x99\x64\x30\xFC\xB5\x96\x44\xB1"
+  "\x24\x8A\xA8\xD2\xC1\xBE\xEA\x3D\x95\x9B\x2F\xB2\x0F\x1C\x9D\xF7"
+  "\x26\x51\xE9\x74\x7B\x8E\x7B\x3A\xEF\xF5\x47\x83\xC9\x71\x85\xEF"
+  "\x3C\x51\x10\x35\x40\xA5\x79\x61\xFB\x21\x60\x1E\xDB\xCC\xA3\xE7"
+  "\x98\x18\xA5\x61\x4E\x7C\xB2\x91\xB9\x92\xA7\x81\x5C\x49\x35\xF2"
+  "\x0B\x23\x71\xCA\xFE\x10\x4D\x9D\x50\x04\xD8\xF1\x0F\x19\xD8\xC3"
+  "\x7A\x63\x9D\xF5\x22\x23\x67\x09\x12\xDC\x8D\xC9\x0F\x7F\xCC\xD4"
+  "\x52\x64\x96\xCF\x7A\x2C\x76\x32\x38\xCA\x9B\x7A\xC7\xD4\x27\x0F"
+  "\x3F\xD1\xFB\x8A\x62\x04\x8B\xB7\x03\x25\x18\xCB\xF4\x3B\x0A\x90"
+  "\x50\x2A\x5E\xBE\x1F\xC8\x36\x3E\x8F\x79\xD2\xB3\xDA\xE1\x44\xE3"
+  "\x09\xF7\x12\x17\x49\x00\xC9\x38\x8C\xA3\xFF\xDD\x6A\xD1\x43\xB8"
+  "\x05\xF8\x6A\x4A\xB6\xE0\x19\x2A\x02\x45\x92\x6F\xF9\x61\xB7\xE8"
+  "\x39\x17\x05\x19\x14\x28\xB3\x8E\x4F\x63\xA5\x7F\x87\x7A\xA7\x62"
+  "\x6B\x7A\x8C\xFD\xD3\x10\xED\x9E\xAB\x8B\xC5\xA1\x28\xB6\x17\x8E"
+  "\x3D\x02\x03\x01\x00\x01";
+
+uint8_t device_private_key[613] =
+  "\x30\x82\x02\x5E\x02\x01\x00\x02\x81\x81\x00\xC4\xC8\xEB\xFA\x99"
+  "\xA5\xD1\xE5\xF9\x9D\x33\xEA\x1C\x93\xF2\x4A\x71\xC7\x1E\xA0\x1E"
+  "\xE6\x71\x87\x39\x5E\x5F\x69\x56\x4F\x76\xC1\x83\x61\x10\xEA\x78"
+  "\x69\x6E\x5A\xA2\x4D\x5E\x83\x4E\x41\xD0\xE5\x44\xBC\x48\x5F\x7D"
+  "\x85\x65\x24\xB0\x9C\x9C\x3C\xD0\x0F\x42\x6A\x6D\x46\x51\x9C\x3E"
+  "\xDC\x88\x33\x84\xC5\xF4\x6D\xAD\x89\xFD\x01\xDC\x2B\x3F\xB0\x6F"
+  "\x12\x80\xEC\xE2\xD9\x53\x00\x66\x93\x58\x3C\x0B\x15\x66\xEA\x47"
+  "\xD9\xDD\x8F\x49\xEE\xD7\x1A\x81\xBA\xE6\x58\x5C\x63\x7A\xDD\xC5"
+  "\x11\xF1\xD2\xCE\x8C\x01\x60\xAD\xF3\xB4\x5F\x02\x03\x01\x00\x01"
+  "\x02\x81\x81\x00\xBB\xC5\x58\xDE\xF4\x13\xB4\xF8\xB3\xB9\x5C\x5B"
+  "\x2C\xCF\xC3\x27\x63\xEF\xF3\x7A\x28\x62\x0D\xBC\x51\x72\x8A\xAA"
+  "\x51\xD0\x5B\x6A\x05\x79\xEE\x91\x3D\x3A\xA5\x31\x58\xA3\x68\xE6"
+  "\xF4\x1A\x7B\x40\xF9\xD8\x8B\x5A\x8A\xC4\x69\xA1\x9B\xE0\xA4\x78"
+  "\xA6\xB3\x98\xD3\x96\x20\x7B\xE4\x93\x9A\x0E\xFE\xD9\x44\x54\x6C"
+  "\xCF\x2D\x5E\x9B\x91\x94\x58\x90\x30\xAC\x08\xA5\xE1\x8E\x5F\x84"
+  "\xC3\x36\xD0\xCD\x0F\x10\xBF\x05\x6E\x29\x27\x8A\x16\x7A\xC6\xC2"
+  "\x78\xCF\x2C\xBC\x5E\x5B\x00\x38\x3E\x66\xBF\x12\x2B\x20\x17\x8E"
+  "\xE7\xE2\x7A\x09\x02\x41\x00\xEA\x0B\x61\xD6\x8D\x8C\xAD\x1C\xFC"
+  "\x0A\x6F\x37\x69\x3A\xD7\x9F\x3C\x4E\xFF\xFA\x97\x72\x5C\x31\x36"
+  "\x1F\x12\x23\x4B\x00\x29\x70\x82\x5F\x3F\xBF\x98\xE3\x35\x24\xD2"
+  "\x3F\xE6\x88\x9D\xA6\x72\xE3\x4A\x09\xEA\xCA\xF2\x42\xCE\x8B\xB6"
+  "\x18\x04\xAC\x01\x73\x4C\xCD\x02\x41\x00\xD7\x3E\xBE\x61\xA3\xF0"
+  "\x75\x2B\xE4\xDD\x60\x67\xA6\x9E\x6A\xDF\x41\xB1\x71\xC9\x54\xDA"
+  "\xF1\xB6\xAC\xEB\x3E\x12\x3C\xA8\x6C\xCB\x75\xFC\xDA\xE5\x69\xBF"
+  "\xB1\x61\x4F\x4F\xD0\x32\x21\xF8\x52\x27\x1C\x59\x69\xBE\x3E\xB3"
+  "\xF3\x16\x41\xBC\xAF\x3A\x6F\x15\x05\xDB\x02\x40\x5A\x18\xE9\xA0"
+  "\x1B\xBB\xB5\x04\xBC\x6E\x13\xE4\x63\xE9\x18\x0A\x9F\xBF\xD5\xC1"
+  "\x15\x3E\x1C\x09\x81\xC9\x32\x45\x4D\xE1\x11\x12\xD3\xCD\x71\x10"
+  "\x03\xFE\x2B\x7E\x32\x46\x11\x2C\x34\x6C\x58\x3B\xF1\x4B\xA2\x0C"
+  "\x60\x78\xA1\x64\x9D\x43\xDF\xC0\x8B\x8A\x64\x5D\x02\x41\x00\xD3"
+  "\x42\xDE\x11\x6F\x9A\xDF\x26\x49\xE7\x8E\x6B\xAD\x79\xE7\x63\x61"
+  "\x53\x0C\x5F\x93\x4D\xA1\xD8\xAE\x37\xE6\x20\x78\x30\xC7\x37\x9B"
+  "\x82\xA6\x46\x6D\x58\x9C\x7C\xEA\x1F\x68\x35\x0C\x6A\x72\x17\xB9"
+  "\x17\x79\x56\x24\xAC\xF2\x76\x71\xE7\x04\x05\xD2\x69\x4B\xE9\x02"
+  "\x41\x00\x83\x7B\x91\x02\x66\xA0\x81\xA9\xBD\xBA\xA2\x86\x3D\x2B"
+  "\x03\x61\xE8\x8F\x05\x12\xE3\x33\xAF\x6C\x9D\xFD\x22\xBF\xC5\xC0"
+  "\x3B\xD3\x69\x45\x37\xAF\x3D\xC5\xFE\x91\x14\x73\x5C\x8E\xEC\xEE"
+  "\xA3\x1B\x90\xB7\x23\x43\xC3\x5D\x7E\xF8\xBE\xDB\x3E\x62\x1A\x17"
+  "\xE9\xBF\x00\x00";
+
+const uint8_t signed_encrypted_credentials[385] =
+  "\x0B\xAD\x19\x22\xB6\x60\xF4\xC7\xB4\xEA\x34\xD9\xBF\xBB\x31\xDC"
+  "\x1A\x60\x99\xD8\x57\xF5\x4A\x88\xC7\x5C\x61\x2F\x91\x59\xE9\xE6"
+  "\x9E\x6B\x1F\x86\xCF\x83\xE3\xE5\xE7\x8F\x7B\x89\x12\x63\xEC\xA2"
+  "\x85\xA7\x87\x11\x41\xC2\xE0\xA1\x5C\x4F\xD3\x1D\x23\xDD\x19\xF5"
+  "\x38\xB0\x6C\x4B\x70\xE4\x26\x31\xE6\x16\x81\x2A\x82\x80\xA6\xE0"
+  "\x78\x3E\xE3\xDE\xB2\x29\x0F\x81\x72\x48\x27\x6E\x48\x01\x13\xED"
+  "\xFF\x09\x8D\xFC\xBB\xA2\x46\x5C\xB2\x07\xDC\x8D\x58\x36\x8B\xA8"
+  "\x21\xA6\x5D\xAC\x6E\x6E\xF0\x8E\x39\x5A\xD3\x71\x65\x92\x6B\xF0"
+  "\x9E\x27\x75\x13\x79\xA7\xCD\xAD\x74\xF8\xAF\xA4\x4D\xDA\x11\x1D"
+  "\x0A\x8F\xE7\x7B\xFC\xB7\x1A\x45\x45\x88\x01\x7E\x86\x03\x3D\x75"
+  "\xE2\x37\x9C\x3D\x26\x51\x59\x3F\x73\xF7\x36\x44\xD1\xB7\x6C\x59"
+  "\x72\x0E\xE9\x42\x10\x48\xE0\xA0\xB5\x3F\x11\x35\xD2\x5C\x6F\x55"
+  "\x98\x13\xAF\xEF\x0C\xFE\x2D\x36\xB9\x63\x20\xD7\x69\x81\xE8\xAB"
+  "\x2E\x78\x0A\xFD\x27\x5B\x4E\xC9\x1F\x1A\xC1\xFB\x06\x86\x8E\x63"
+  "\xA3\xE5\xDC\x97\x05\x09\x16\x5A\xD2\x54\x1C\xA0\x16\x67\x53\x4C"
+  "\xFB\x30\x6A\xB6\x85\x4E\x96\x11\xCF\xA1\xC4\x85\x4F\x1B\xB5\xD6"
+  "\x8A\x91\xEA\x26\xD1\xA7\xD0\x25\x58\x93\x05\x93\x2B\xEC\x93\xD2"
+  "\xCD\x96\x3D\x03\xF4\xEB\x80\x9E\x17\x3E\x64\xB2\xA1\xA8\x95\xB8"
+  "\xE5\xB0\xC9\xD8\x39\xDA\x18\x32\xC1\xC7\xF8\x85\x62\xBA\x8F\x2E"
+  "\x45\xA2\x41\x31\x2F\x26\x44\x5B\xA6\xA4\x4D\x70\xCD\xC0\xFB\x8B"
+  "\x68\x6A\xBA\x0E\xE0\xD5\xF4\x28\x31\x6C\xC7\xE5\x40\x30\x6A\xC1"
+  "\xEE\x2F\x3F\xA6\x74\x81\x3D\xA1\xDC\xBA\x34\xE4\xC7\x44\x58\x3F"
+  "\x0C\x99\xD0\xCD\xC0\xC0\x4A\x9F\x10\x95\x50\x49\x09\xCE\x09\xE2"
+  "\xF7\xBD\x88\x2E\xAE\x86\xCD\x19\x1E\xAC\x3A\x0E\xB2\x29\x1B\x6B";
+
+/**
+ * Plays the cloud end of a SparkProtocol session with the session key
+ * already agreed, so the tests exchange plain CoAP messages with the device.
+ */
+struct Cloud
+{
+    static Cloud* current;
+
+    SparkKeys keys;
+    SparkCallbacks callbacks;
+    SparkDescriptor descriptor;
+    SparkProtocol protocol;
+
+    aes_context aes;
+    uint8_t key[16];
+    uint8_t iv_to_device[16];
+    uint8_t iv_from_device[16];
+    std::deque<uint8_t> to_device;
+    Bytes stream;                   // what the device sent, not yet a whole message
+    std::vector<Bytes> received;    // the messages from the device, decrypted
+    int sends = 0;
+    system_tick_t now = 0;
+
+    // the application described
+    int functions = 0;
+
+    // the device end of an update, the image is staged in RAM
+    Bytes image;
+    int saves = 0;
+    bool finished = false;
+    uint32_t finish_flags = 0;
+
+    Cloud()
+    {
+        current = this;
+        memset(&keys, 0, sizeof(keys));
+        keys.size = sizeof(keys);
+        keys.core_private = device_private_key;
+        keys.server_public = server_public_key;
+        memset(&callbacks, 0, sizeof(callbacks));
+        callbacks.size = sizeof(callbacks);
+        callbacks.send = send;
+        callbacks.receive = receive;
+        callbacks.prepare_for_firmware_update = prepare_for_firmware_update;
+        callbacks.save_firmware_chunk = save_firmware_chunk;
+        callbacks.finish_firmware_update = finish_firmware_update;
+        callbacks.calculate_crc = calculate_crc;
+        callbacks.millis = millis;
+        memset(&descriptor, 0, sizeof(descriptor));
+        descriptor.size = sizeof(descriptor);
+        descriptor.num_functions = num_functions;
+        descriptor.get_function_key = get_function_key;
+        descriptor.num_variables = num_variables;
+        descriptor.get_variable_key = get_variable_key;
+        descriptor.variable_type = variable_type;
+        descriptor.append_system_info = append_system_info;
+        protocol.init(device_id, keys, callbacks, descriptor);
+        REQUIRE(protocol.set_key(signed_encrypted_credentials)==0);
+
+        uint8_t credentials[40];
+        REQUIRE(decipher_aes_credentials(device_private_key, signed_encrypted_credentials, credentials)==0);
+        memcpy(key, credentials, 16);
+        memcpy(iv_to_device, credentials+16, 16);
+        memcpy(iv_from_device, credentials+16, 16);
+    }
+
+    ~Cloud()
+    {
+        if (current==this)
+            current = nullptr;
+    }
+
+    /**
+     * Encrypts a message and queues it for the device.
+     */
+    void send_to_device(Bytes m)
+    {
+        size_t padded = (m.size() & ~15) + 16;
+        m.resize(padded, uint8_t(padded-m.size()));     // PKCS #7 padding
+        aes_setkey_enc(&aes, key, 128);
+        aes_crypt_cbc(&aes, AES_ENCRYPT, m.size(), iv_to_device, m.data(), m.data());
+        memcpy(iv_to_device, m.data(), 16);
+        to_device.push_back(m.size()>>8);
+        to_device.push_back(m.size() & 0xFF);
+        to_device.insert(to_device.end(), m.begin(), m.end());
+    }
+
+    /**
+     * Runs the device until it has handled everything queued for it.
+     */
+    void run_device()
+    {
+        CoAPMessageType::Enum type;
+        while (!to_device.empty())
+            REQUIRE(protocol.event_loop(type));
+    }
+
+    /**
+     * Runs the device with nothing to receive, after the given time has passed.
+     */
+    void idle(system_tick_t millis)
+    {
+        now += millis;
+        CoAPMessageType::Enum type;
+        REQUIRE(protocol.event_loop(type));
+    }
+
+    void decode()
+    {
+        while (stream.size()>=2) {
+            size_t length = (stream[0]<<8) | stream[1];
+            if (stream.size()<length+2)
+                break;
+            Bytes m(stream.begin()+2, stream.begin()+2+length);
+            stream.erase(stream.begin(), stream.begin()+2+length);
+            uint8_t next_iv[16];
+            memcpy(next_iv, m.data(), 16);
+            aes_setkey_dec(&aes, key, 128);
+            aes_crypt_cbc(&aes, AES_DECRYPT, m.size(), iv_from_device, m.data(), m.data());
+            memcpy(iv_from_device, next_iv, 16);
+            m.resize(m.size()-m.back());
+            received.push_back(m);
+            sends++;
+        }
+    }
+
+    static int send(const unsigned char* buf, uint32_t length, void*)
+    {
+        current->stream.insert(current->stream.end(), buf, buf+length);
+        current->decode();
+        return length;
+    }
+
+    static int receive(unsigned char* buf, uint32_t length, void*)
+    {
+        std::deque<uint8_t>& from = current->to_device;
+        uint32_t count = 0;
+        for (; count<length && !from.empty(); count++) {
+            buf[count] = from.front();
+            from.pop_front();
+        }
+        return count;
+    }
+
+    static int prepare_for_firmware_update(FileTransfer::Descriptor& file, uint32_t flags, void*)
+    {
+        if (!flags)
+            current->image.assign(file.file_length, 0);
+        return 0;
+    }
+
+    static int save_firmware_chunk(FileTransfer::Descriptor& file, const unsigned char* chunk, void*)
+    {
+        uint32_t offset = file.chunk_address - file.file_address;
+        REQUIRE(size_t(offset+file.chunk_size)<=current->image.size());
+        memcpy(current->image.data()+offset, chunk, file.chunk_size);
+        current->saves++;
+        return 0;
+    }
+
+    static int finish_firmware_update(FileTransfer::Descriptor& file, uint32_t flags, void*)
+    {
+        current->finished = true;
+        current->finish_flags = flags;
+        return 0;
+    }
+
+    static uint32_t calculate_crc(const unsigned char *buf, uint32_t buflen)
+    {
+        return crc32_update(0, buf, buflen);
+    }
+
+    static system_tick_t millis()
+    {
+        return current->now;
+    }
+
+    static int num_functions()
+    {
+        return current->functions;
+    }
+
+    static const char* get_function_key(int index)
+    {
+        static char key[16];
+        sprintf(key, "function%d", index);
+        return key;
+    }
+
+    static int num_variables() { return 1; }
+    static const char* get_variable_key(int index) { return "temp"; }
+    static SparkReturnType::Enum variable_type(const char* key) { return SparkReturnType::DOUBLE; }
+
+    static bool append_system_info(appender_fn append, void* data, void* reserved)
+    {
+        const char* info = "\"p\":103";
+        return append(data, (const uint8_t*)info, strlen(info));
+    }
+};
+
+Cloud* Cloud::current = nullptr;
+
+/**
+ * A describe response: its payload and Block2 option, if any.
+ */
+struct Description
+{
+    std::string payload;
+    bool has_block = false;
+    unsigned block = 0;
+    bool more = false;
+
+    Description(const Bytes& m)
+    {
+        REQUIRE(m.size()>5);
+        REQUIRE(m[1]==0x45);             // 2.05 content
+        const uint8_t* p = m.data()+5;
+        const uint8_t* end = m.data()+m.size();
+        unsigned number = 0;
+        const uint8_t* value;
+        size_t length;
+        while (CoAP::next_option(p, end, number, value, length)) {
+            if (number==CoAPOption::BLOCK2) {
+                uint8_t szx;
+                CoAP::decode_block(value, length, block, more, szx);
+                has_block = true;
+            }
+        }
+        if (p<end && *p==0xFF)
+            payload.assign((const char*)p+1, end-p-1);
+    }
+};
+
+/**
+ * Asks the device for its description as the server does, without flags,
+ * with a Block2 option for the blocks after the first.
+ */
+std::vector<Description> describe(Cloud& cloud, int block)
+{
+    Bytes request = { 0x41, 0x01, 0, uint8_t(block+1), 7, 0xb1, 'd' };
+    if (block>=0) {
+        request.push_back(0xc1);        // Block2, 12 after Uri-Path
+        request.push_back(uint8_t(block<<4 | DESCRIBE_BLOCK_SZX));
+    }
+    cloud.send_to_device(request);
+    cloud.run_device();
+    std::vector<Description> result;
+    for (const Bytes& m : cloud.received)
+        result.push_back(Description(m));
+    cloud.received.clear();
+    return result;
+}
+
+std::string render(const SparkDescriptor& d, int flags)
+{
+    BlockAppender measure(nullptr, 0, 0);
+    append_description(d, measure, flags);
+    std::string s(measure.total(), 0);
+    BlockAppender all((uint8_t*)&s[0], 0, s.size());
+    append_description(d, all, flags);
+    return s;
+}
+
+enum Mode { FAST = 1, WINDOWED = 1|8 };
+
+/**
+ * Sends a file to the device with fast OTA. The TCP stream loses nothing,
+ * so some chunks are sent with a bad CRC instead, which the device drops
+ * and asks for again like a lost one.
+ */
+struct Transfer
+{
+    static const uint16_t CHUNK_SIZE = 64;
+
+    Cloud cloud;
+    Bytes file;
+    unsigned chunks;
+    unsigned bad_percent;
+    uint32_t seed = 1;
+    uint16_t message_id = 0;
+    uint8_t ready_flags = 0;
+
+    int chunks_sent = 0;
+    int tail_chunks = 0;            // chunks sent after the server said it was done
+    int bitmaps = 0;
+
+    Transfer(unsigned chunks, unsigned bad_percent) : chunks(chunks), bad_percent(bad_percent)
+    {
+        for (unsigned i=0; i<chunks*CHUNK_SIZE; i++)
+            file.push_back(uint8_t(i*31+(i>>8)));
+    }
+
+    bool bad()
+    {
+        seed = seed*1103515245+12345;
+        return ((seed>>16)%100)<bad_percent;
+    }
+
+    Bytes header(uint8_t code, char path)
+    {
+        message_id++;
+        return Bytes { 0x51, code, uint8_t(message_id>>8), uint8_t(message_id), 7, 0xb1, uint8_t(path) };
+    }
+
+    void begin(Mode mode)
+    {
+        Bytes m = header(0x02, 'u');
+        uint32_t length = file.size();
+        uint8_t fields[] = { 0xFF, uint8_t(mode), 0, CHUNK_SIZE,
+            uint8_t(length>>24), uint8_t(length>>16), uint8_t(length>>8), uint8_t(length),
+            FileTransfer::Store::FIRMWARE, 0, 0, 0, 0 };
+        m.insert(m.end(), fields, fields+sizeof(fields));
+        cloud.send_to_device(m);
+        cloud.run_device();
+        // the ack and then update ready, with the flags of the mode accepted
+        REQUIRE(cloud.received.size()==2);
+        const Bytes& ready = cloud.received[1];
+        REQUIRE(ready.size()==7);
+        CHECK(ready[1]==0x44);
+        ready_flags = ready[6];
+        cloud.received.clear();
+        cloud.sends = 0;
+    }
+
+    void send_chunk(chunk_index_t index)
+    {
+        chunks_sent++;
+        cloud.now += 10;
+        const uint8_t* chunk = file.data()+index*CHUNK_SIZE;
+        uint32_t crc = crc32_update(0, chunk, CHUNK_SIZE);
+        if (bad())
+            crc = ~crc;
+        Bytes m = header(0x02, 'c');
+        uint8_t options[] = { 0x44, uint8_t(crc>>24), uint8_t(crc>>16), uint8_t(crc>>8), uint8_t(crc),
+            0x02, uint8_t(index>>8), uint8_t(index), 0xFF };
+        m.insert(m.end(), options, options+sizeof(options));
+        m.insert(m.end(), chunk, chunk+CHUNK_SIZE);
+        cloud.send_to_device(m);
+        cloud.run_device();
+    }
+
+    void send_done()
+    {
+        cloud.send_to_device(header(0x03, 'u'));
+        cloud.run_device();
+    }
+
+    /**
+     * Queues the chunks the device asked for, or that a bitmap shows missing.
+     */
+    void receive(std::deque<chunk_index_t>& resend, std::set<chunk_index_t>& queued, chunk_index_t sent_end)
+    {
+        for (const Bytes& m : cloud.received) {
+            if (m.size()<9 || m[4]!=0xb1 || m[5]!='c')
+                continue;
+            std::vector<chunk_index_t> missing;
+            if (m[1]==0x01) {           // GET, a list of missing chunks
+                for (size_t i=7; i+1<m.size(); i+=2)
+                    missing.push_back((m[i]<<8) | m[i+1]);
+            }
+            else if (m[1]==0x02) {      // POST, a bitmap of the chunks received
+                bitmaps++;
+                chunk_index_t first = (m[7]<<8) | m[8];
+                for (size_t i=0; i<(m.size()-9)*8; i++) {
+                    chunk_index_t index = first+i;
+                    if (index<sent_end && !(m[9+i/8] & (1<<(i&7))))
+                        missing.push_back(index);
+                }
+            }
+            for (chunk_index_t index : missing) {
+                if (queued.insert(index).second)
+                    resend.push_back(index);
+            }
+        }
+        cloud.received.clear();
+    }
+
+    void run(Mode mode)
+    {
+        begin(mode);
+        std::deque<chunk_index_t> resend;
+        std::set<chunk_index_t> queued;
+        chunk_index_t next = 0;
+        bool done = false;
+        for (int rounds=0; !cloud.finished && rounds<100000; rounds++) {
+            if (!resend.empty()) {
+                chunk_index_t index = resend.front();
+                resend.pop_front();
+                queued.erase(index);
+                send_chunk(index);
+                if (done)
+                    tail_chunks++;
+            }
+            else if (next<chunks) {
+                send_chunk(next++);
+            }
+            else if (!done) {
+                done = true;
+                send_done();
+            }
+            else {
+                // nothing to send, wait for the device to ask again
+                cloud.idle(4000);
+            }
+            receive(resend, queued, next);
+        }
+    }
+};
+
+}
+
+SCENARIO("SparkProtocol accepts windowed fast OTA when the server asks for it", "[spark_protocol]") {
+    {
+        Transfer t(8, 0);
+        t.begin(FAST);
+        CHECK(t.ready_flags==1);
+    }
+    {
+        Transfer t(8, 0);
+        t.begin(WINDOWED);
+        CHECK(t.ready_flags==3);
+    }
+}
+
+SCENARIO("A file sent to SparkProtocol with fast OTA is complete", "[spark_protocol]") {
+    Transfer t(200, 10);
+    t.run(FAST);
+    CHECK(t.cloud.finished);
+    CHECK(t.cloud.finish_flags==1);
+    CHECK(t.cloud.image==t.file);
+    CHECK(t.bitmaps==0);
+    // the bad chunks are all sent again at the end
+    CHECK(t.tail_chunks>=15);
+}
+
+SCENARIO("A file sent to SparkProtocol with windowed fast OTA has no tail", "[spark_protocol]") {
+    Transfer fast(200, 10);
+    fast.run(FAST);
+    Transfer t(200, 10);
+    t.run(WINDOWED);
+    CHECK(t.cloud.finished);
+    CHECK(t.cloud.finish_flags==1);
+    CHECK(t.cloud.image==t.file);
+    CHECK(t.bitmaps>0);
+    // each chunk is written once however many times it is sent
+    CHECK(t.cloud.saves==200);
+    // gaps are filled as the file is sent rather than after it
+    int windowed_tail = t.tail_chunks*4;
+    CHECK(windowed_tail<fast.tail_chunks);
+    int fast_sent = fast.chunks_sent+2;
+    CHECK(t.chunks_sent<=fast_sent);
+}
+
+SCENARIO("SparkProtocol sends the system and application descriptions when they fit", "[spark_protocol]") {
+    Cloud cloud;
+    cloud.functions = 2;
+    std::vector<Description> d = describe(cloud, -1);
+    REQUIRE(d.size()==2);
+    CHECK(!d[0].has_block);
+    CHECK(!d[1].has_block);
+    CHECK(d[0].payload==render(cloud.descriptor, DESCRIBE_SYSTEM));
+    CHECK(d[1].payload==render(cloud.descriptor, DESCRIBE_APPLICATION));
+}
+
+SCENARIO("SparkProtocol pages a description larger than its buffer as one document", "[spark_protocol]") {
+    Cloud cloud;
+    cloud.functions = 80;
+    std::string whole = render(cloud.descriptor, DESCRIBE_ALL);
+    REQUIRE(whole.size()>PROTOCOL_BUFFER_SIZE);
+
+    std::vector<Description> d = describe(cloud, -1);
+    REQUIRE(d.size()==1);
+    CHECK(d[0].has_block);
+    CHECK(d[0].block==0);
+    std::string received = d[0].payload;
+    bool more = d[0].more;
+    unsigned blocks = 1;
+    while (more && blocks<100) {
+        d = describe(cloud, blocks);
+        REQUIRE(d.size()==1);
+        REQUIRE(d[0].has_block);
+        CHECK(d[0].block==blocks);
+        received += d[0].payload;
+        more = d[0].more;
+        blocks++;
+    }
+    // the later blocks are cut from the same document as the first
+    CHECK(received==whole);
+    CHECK(blocks==(whole.size()+511)/512);
+}
@@ -0,0 +1,267 @@
+/**
+ ******************************************************************************
+ * @file    spsc_ring.cpp
+ ******************************************************************************
+  Copyright (c) 2016 MidAir Technology, LLC.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "spsc_ring.h"
+
+#include <thread>
+#include <vector>
+
+SCENARIO("Ring is empty after creation", "[spsc_ring]") {
+  SpscRing<char, 8> r;
+  CHECK(r.empty());
+  CHECK(r.space() == 8);
+}
+
+SCENARIO("Pop returns the pushed values in order", "[spsc_ring]") {
+  SpscRing<int, 4> r;
+  CHECK(r.push(1));
+  CHECK(r.push(2));
+  int value;
+  CHECK(r.pop(value));
+  CHECK(value == 1);
+  CHECK(r.pop(value));
+  CHECK(value == 2);
+  CHECK_FALSE(r.pop(value));
+}
+
+SCENARIO("Ring holds its whole capacity", "[spsc_ring]") {
+  SpscRing<char, 4> r;
+  for (char c = 0; c < 4; c++)
+    CHECK(r.push(c));
+  CHECK_FALSE(r.push(4));
+  CHECK(r.size() == 4);
+  CHECK(r.space() == 0);
+}
+
+SCENARIO("Bulk push copies what fits unless all are required", "[spsc_ring]") {
+  SpscRing<char, 8> r;
+  const char data[] = "abcdefghij";
+  CHECK(r.push(data, 10, true) == 0);
+  CHECK(r.empty());
+  CHECK(r.push(data, 10) == 8);
+  char out[10];
+  CHECK(r.pop(out, 10) == 8);
+  CHECK(memcmp(out, data, 8) == 0);
+}
+
+SCENARIO("Bulk push and pop wrap around the storage", "[spsc_ring]") {
+  SpscRing<char, 8> r;
+  char out[8];
+  CHECK(r.push("abcdef", 6) == 6);
+  CHECK(r.pop(out, 5) == 5);
+  CHECK(r.push("ghijklm", 7) == 7);
+  CHECK(r.pop(out, 8) == 8);
+  CHECK(memcmp(out, "fghijklm", 8) == 0);
+}
+
+SCENARIO("Peek gives the contiguous span up to the end of the storage", "[spsc_ring]") {
+  SpscRing<char, 8> r;
+  char out[8];
+  r.push("abcdef", 6);
+  r.pop(out, 5);
+  r.push("ghij", 4);
+
+  const char* span;
+  REQUIRE(r.peek(span) == 3);
+  CHECK(memcmp(span, "fgh", 3) == 0);
+  r.consume(3);
+  REQUIRE(r.peek(span) == 2);
+  CHECK(memcmp(span, "ij", 2) == 0);
+  r.consume(2);
+  CHECK(r.peek(span) == 0);
+  CHECK(r.empty());
+}
+
+SCENARIO("Indices keep working past the 16 bit wrap", "[spsc_ring]") {
+  SpscRing<uint8_t, 32> r;
+  uint8_t in[7], out[7];
+  unsigned errors = 0;
+  for (unsigned i = 0; i < 20000; i++) {
+    for (unsigned j = 0; j < sizeof(in); j++)
+      in[j] = uint8_t(i + j);
+    errors += r.push(in, sizeof(in), true) != sizeof(in);
+    errors += r.pop(out, sizeof(out)) != sizeof(out);
+    errors += memcmp(in, out, sizeof(in)) != 0;
+  }
+  CHECK(errors == 0);
+  CHECK(r.empty());
+}
+
+SCENARIO("A producer and consumer thread pass every value through in order", "[spsc_ring]") {
+  static SpscRing<uint32_t, 64> r;
+  r.clear();
+  const uint32_t count = 200000;
+
+  std::thread producer([&]() {
+    uint32_t next = 0;
+    uint32_t values[13];
+    while (next < count) {
+      // vary the batch size so pushes straddle the wrap
+      size_t n = 1 + next % 13;
+      if (n > count - next)
+        n = count - next;
+      for (size_t i = 0; i < n; i++)
+        values[i] = next + i;
+      size_t pushed = r.push(values, n);
+      if (!pushed)
+        std::this_thread::yield();
+      next += pushed;
+    }
+  });
+
+  uint32_t expected = 0;
+  uint32_t errors = 0;
+  uint32_t values[17];
+  while (expected < count) {
+    size_t n;
+    if (expected & 1) {
+      n = r.pop(values, 1 + expected % 17);
+      for (size_t i = 0; i < n; i++)
+        errors += values[i] != expected++;
+    } else {
+      const uint32_t* span;
+      n = r.peek(span);
+      for (size_t i = 0; i < n; i++)
+        errors += span[i] != expected++;
+      r.consume(n);
+    }
+    if (!n)
+      std::this_thread::yield();
+  }
+  producer.join();
+
+  CHECK(errors == 0);
+  CHECK(r.empty());
+}
+
+SCENARIO("Bytes pushed all or nothing arrive as whole packets", "[spsc_ring]") {
+  static SpscRing<uint8_t, 256> r;
+  r.clear();
+  const unsigned packets = 50000;
+
+  std::thread producer([&]() {
+    uint8_t packet[40];
+    for (unsigned p = 0; p < packets; p++) {
+      size_t length = 1 + p % sizeof(packet);
+      packet[0] = uint8_t(length);
+      for (size_t i = 1; i < length; i++)
+        packet[i] = uint8_t(p + i);
+      while (r.push(packet, length, true) != length)
+        std::this_thread::yield();
+    }
+  });
+
+  unsigned errors = 0;
+  uint8_t packet[40];
+  for (unsigned p = 0; p < packets; p++) {
+    size_t length = 1 + p % sizeof(packet);
+    while (r.size() < length)
+      std::this_thread::yield();
+    r.pop(packet, length);
+    errors += packet[0] != length;
+    for (size_t i = 1; i < length; i++)
+      errors += packet[i] != uint8_t(p + i);
+  }
+  producer.join();
+
+  CHECK(errors == 0);
+}
+
+SCENARIO("The C ring wraps around a capacity that isn't a power of 2", "[spsc_ring]") {
+  uint8_t storage[10];
+  spsc_byte_ring_t r;
+  spsc_byte_ring_init(&r, storage, sizeof(storage));
+  uint8_t out[10];
+  CHECK(spsc_byte_ring_space(&r) == 10);
+  CHECK(spsc_byte_ring_push(&r, (const uint8_t*)"abcdefgh", 8, false) == 8);
+  CHECK(spsc_byte_ring_pop(&r, out, 7) == 7);
+  CHECK(spsc_byte_ring_push(&r, (const uint8_t*)"ijklmnopqrs", 11, true) == 0);
+  CHECK(spsc_byte_ring_push(&r, (const uint8_t*)"ijklmnopqrs", 11, false) == 9);
+  CHECK(spsc_byte_ring_space(&r) == 0);
+  CHECK(spsc_byte_ring_size(&r) == 10);
+  CHECK(spsc_byte_ring_pop(&r, out, 10) == 10);
+  CHECK(memcmp(out, "hijklmnopq", 10) == 0);
+  CHECK(spsc_byte_ring_size(&r) == 0);
+}
+
+SCENARIO("The C ring can be written and read in place", "[spsc_ring]") {
+  uint8_t storage[8];
+  spsc_byte_ring_t r;
+  spsc_byte_ring_init(&r, storage, sizeof(storage));
+  uint8_t out[8];
+  spsc_byte_ring_push(&r, (const uint8_t*)"abcdef", 6, false);
+  spsc_byte_ring_pop(&r, out, 5);
+
+  uint8_t* p_free;
+  REQUIRE(spsc_byte_ring_reserve(&r, &p_free) == 2);
+  memcpy(p_free, "gh", 2);
+  const uint8_t* p_span;
+  CHECK(spsc_byte_ring_peek(&r, &p_span) == 1);
+  spsc_byte_ring_produce(&r, 2);
+  REQUIRE(spsc_byte_ring_reserve(&r, &p_free) == 5);
+  CHECK(p_free == storage);
+  memcpy(p_free, "ij", 2);
+  spsc_byte_ring_produce(&r, 2);
+
+  REQUIRE(spsc_byte_ring_peek(&r, &p_span) == 3);
+  CHECK(memcmp(p_span, "fgh", 3) == 0);
+  spsc_byte_ring_consume(&r, 3);
+  REQUIRE(spsc_byte_ring_peek(&r, &p_span) == 2);
+  CHECK(memcmp(p_span, "ij", 2) == 0);
+  spsc_byte_ring_consume(&r, 2);
+  CHECK(spsc_byte_ring_size(&r) == 0);
+}
+
+SCENARIO("Bytes pushed all or nothing through the C ring arrive as whole packets", "[spsc_ring]") {
+  static uint8_t storage[250];
+  static spsc_byte_ring_t r;
+  spsc_byte_ring_init(&r, storage, sizeof(storage));
+  const unsigned packets = 50000;
+
+  std::thread producer([&]() {
+    uint8_t packet[40];
+    for (unsigned p = 0; p < packets; p++) {
+      uint16_t length = 1 + p % sizeof(packet);
+      packet[0] = uint8_t(length);
+      for (size_t i = 1; i < length; i++)
+        packet[i] = uint8_t(p + i);
+      while (spsc_byte_ring_push(&r, packet, length, true) != length)
+        std::this_thread::yield();
+    }
+  });
+
+  unsigned errors = 0;
+  uint8_t packet[40];
+  for (unsigned p = 0; p < packets; p++) {
+    uint16_t length = 1 + p % sizeof(packet);
+    while (spsc_byte_ring_size(&r) < length)
+      std::this_thread::yield();
+    spsc_byte_ring_pop(&r, packet, length);
+    errors += packet[0] != length;
+    for (size_t i = 1; i < length; i++)
+      errors += packet[i] != uint8_t(p + i);
+  }
+  producer.join();
+
+  CHECK(errors == 0);
+  CHECK(spsc_byte_ring_size(&r) == 0);
+}
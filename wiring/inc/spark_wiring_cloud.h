@@ -65,6 +65,8 @@ private:
 const PublishFlag PUBLIC(PUBLISH_EVENT_FLAG_PUBLIC);
 const PublishFlag PRIVATE(PUBLISH_EVENT_FLAG_PRIVATE);
 const PublishFlag NO_ACK(PUBLISH_EVENT_FLAG_NO_ACK);
+// events of the same name are held and sent as one, their data a line each, see EventBatch
+const PublishFlag BATCH(PUBLISH_EVENT_FLAG_BATCH);
 
 
 class CloudClass {
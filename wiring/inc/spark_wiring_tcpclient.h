@@ -39,7 +39,25 @@ class TCPClient : public Client {
 public:
 	TCPClient();
 	TCPClient(sock_handle_t sock);
-        virtual ~TCPClient() {};
+	TCPClient(const TCPClient& client);
+        virtual ~TCPClient() { releaseBuffer(); };
+
+	TCPClient& operator=(const TCPClient& client);
+
+        /**
+         * Sets the buffer data is received into. A bigger buffer takes more
+         * from the network with each receive.
+         *
+         * @param buffer_size The size of the buffer, 0 for the built-in
+         *  TCPCLIENT_BUF_MAX_SIZE bytes.
+         * @param buffer    A pre-allocated buffer. This is optional, and if not specified
+         *  the TCPClient class will allocate the buffer dynamically.
+         * @return true if the buffer was set. Data already received is kept, so
+         *  the buffer can't be made smaller than the data waiting in it.
+         */
+        bool setBuffer(size_t buffer_size, uint8_t* buffer=NULL);
+
+        size_t bufferSize() { return _buffer_size; }
 
         uint8_t status();
 	virtual int connect(IPAddress ip, uint16_t port, network_interface_t=0);
@@ -68,11 +86,20 @@ protected:
 private:
 	static uint16_t _srcport;
 	sock_handle_t _sock;
-	uint8_t _buffer[TCPCLIENT_BUF_MAX_SIZE];
-	uint16_t _offset;
-	uint16_t _total;
+	uint8_t _local_buffer[TCPCLIENT_BUF_MAX_SIZE];
+	/**
+	 * The buffer data is received into, the built-in one or the one set by setBuffer().
+	 * read() with room for a whole buffer bypasses it when it is empty.
+	 */
+	uint8_t* _buffer;
+	size_t _buffer_size;
+	uint8_t _buffer_allocated;
+	size_t _offset;
+	size_t _total;
         IPAddress _remoteIP;
 	inline int bufferCount();
+	void releaseBuffer();
+	void assign(const TCPClient& client);
 
 };
 
@@ -109,9 +109,7 @@ size_t Print::print(double n, int digits)
 
 size_t Print::println(void)
 {
-  size_t n = print('\r');
-  n += print('\n');
-  return n;
+  return write("\r\n");
 }
 
 size_t Print::println(const char c[])
@@ -46,11 +46,86 @@ TCPClient::TCPClient() : TCPClient(socket_handle_invalid())
 {
 }
 
-TCPClient::TCPClient(sock_handle_t sock) : _sock(sock)
+TCPClient::TCPClient(sock_handle_t sock) : _sock(sock), _buffer(_local_buffer), _buffer_size(arraySize(_local_buffer)), _buffer_allocated(false)
 {
   flush_buffer();
 }
 
+TCPClient::TCPClient(const TCPClient& client) : Client(client), _buffer(_local_buffer), _buffer_size(arraySize(_local_buffer)), _buffer_allocated(false)
+{
+  assign(client);
+}
+
+TCPClient& TCPClient::operator=(const TCPClient& client)
+{
+  if (this != &client)
+  {
+    Client::operator=(client);
+    assign(client);
+  }
+  return *this;
+}
+
+/**
+ * Takes the socket and the data received so far. A copy gets a buffer of its
+ * own the same size, the two clients must not receive into the same memory.
+ * When that can't be allocated the copy keeps the local buffer and only the
+ * data that fits in it.
+ */
+void TCPClient::assign(const TCPClient& client)
+{
+  _sock = client._sock;
+  _remoteIP = client._remoteIP;
+  flush_buffer();
+  if (client._buffer == client._local_buffer || !setBuffer(client._buffer_size))
+    setBuffer(0);
+  _total = client._total - client._offset;
+  if (_total > _buffer_size)
+    _total = _buffer_size;
+  memcpy(_buffer, client._buffer + client._offset, _total);
+}
+
+bool TCPClient::setBuffer(size_t buffer_size, uint8_t* buffer)
+{
+  if (!buffer_size)
+  {
+    buffer_size = arraySize(_local_buffer);
+    buffer = _local_buffer;
+  }
+  int count = bufferCount();
+  if (buffer_size < (size_t)count)
+    return false;
+
+  bool allocated = false;
+  if (!buffer)                          // requested allocation
+  {
+    buffer = new uint8_t[buffer_size];
+    allocated = true;
+  }
+  if (!buffer)
+    return false;
+
+  memmove(buffer, _buffer + _offset, count);
+  releaseBuffer();
+  _buffer = buffer;
+  _buffer_size = buffer_size;
+  _buffer_allocated = allocated;
+  _offset = 0;
+  _total = count;
+  return true;
+}
+
+void TCPClient::releaseBuffer()
+{
+  if (_buffer_allocated && _buffer)
+  {
+    delete[] _buffer;
+  }
+  _buffer = _local_buffer;
+  _buffer_size = arraySize(_local_buffer);
+  _buffer_allocated = false;
+}
+
 int TCPClient::connect(const char* host, uint16_t port, network_interface_t nif)
 {
     stop();
@@ -137,9 +212,9 @@ int TCPClient::available()
     if(Network.from(nif).ready() && isOpen(_sock))
     {
         // Have room
-        if ( _total < arraySize(_buffer))
+        if ( _total < _buffer_size)
         {
-            int ret = socket_receive(_sock, _buffer + _total , arraySize(_buffer)-_total, 0);
+            int ret = socket_receive(_sock, _buffer + _total , _buffer_size-_total, 0);
             if (ret > 0)
             {
                 DEBUG("recv(=%d)",ret);
@@ -160,7 +235,17 @@ int TCPClient::read()
 int TCPClient::read(uint8_t *buffer, size_t size)
 {
         int read = -1;
-        if (bufferCount() || available())
+        if (!bufferCount() && size >= _buffer_size)
+        {
+          // room for a whole buffer, receive straight into the caller's buffer
+          if (Network.from(nif).ready() && isOpen(_sock))
+          {
+            int ret = socket_receive(_sock, buffer, size, 0);
+            if (ret > 0)
+              read = ret;
+          }
+        }
+        else if (bufferCount() || available())
         {
           read = (size > (size_t) bufferCount()) ? bufferCount() : size;
           memcpy(buffer, &_buffer[_offset], read);